@@ -641,6 +641,7 @@ BucketManagerImpl::forgetUnreferencedBuckets()
     ZoneScoped;
     std::lock_guard<std::recursive_mutex> lock(mBucketMutex);
     auto referenced = getReferencedBuckets();
+    std::vector<std::string> garbage;
 
     for (auto i = mSharedBuckets.begin(); i != mSharedBuckets.end();)
     {
@@ -669,9 +670,24 @@ BucketManagerImpl::forgetUnreferencedBuckets()
             if (!filename.empty() && !mApp.getConfig().DISABLE_BUCKET_GC)
             {
                 CLOG(TRACE, "Bucket") << "removing bucket file: " << filename;
-                std::remove(filename.c_str());
-                auto gzfilename = filename + ".gz";
-                std::remove(gzfilename.c_str());
+                // Moving the files out of the way frees their names for a
+                // bucket with the same hash at once; the (slower) removal of
+                // large files is left to an action off the main thread.
+                auto moved = getTmpDir() + "/gc-" +
+                             bucketBasename(binToHex(j->first));
+                for (auto const& suffix : {"", ".gz"})
+                {
+                    auto from = filename + suffix;
+                    auto to = moved + suffix;
+                    if (std::rename(from.c_str(), to.c_str()) == 0)
+                    {
+                        garbage.emplace_back(to);
+                    }
+                    else
+                    {
+                        std::remove(from.c_str());
+                    }
+                }
             }
 
             // Dropping this bucket means we'll no longer be able to
@@ -704,6 +720,19 @@ BucketManagerImpl::forgetUnreferencedBuckets()
         }
     }
     mSharedBucketsSize.set_count(mSharedBuckets.size());
+
+    if (!garbage.empty())
+    {
+        // the tmp dir is removed with the BucketManager, files and all
+        mApp.postThreadSafeAction(
+            [garbage]() {
+                for (auto const& name : garbage)
+                {
+                    std::remove(name.c_str());
+                }
+            },
+            "BucketManager: remove garbage buckets");
+    }
 }
 
 void
@@ -75,6 +75,18 @@ ApplyCheckpointWork::onReset()
     mFilesOpen = false;
 }
 
+void
+ApplyCheckpointWork::onSuccess()
+{
+    mHdrIn.close();
+    mTxIn.close();
+    mFilesOpen = false;
+    FileTransferInfo ti(mDownloadDir, HISTORY_FILE_TYPE_TRANSACTIONS,
+                        mCheckpoint);
+    std::remove(ti.localPath_nogz().c_str());
+    BasicWork::onSuccess();
+}
+
 void
 ApplyCheckpointWork::openInputFiles()
 {
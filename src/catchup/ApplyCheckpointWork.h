@@ -42,6 +42,9 @@ struct LedgerHeaderHistoryEntry;
  * * downloadDir - directory containing ledger and transaction files
  * * range - LedgerRange to apply, must be checkpoint-aligned,
  * and cover at most one checkpoint.
+ *
+ * Once applied, the transactions file of the checkpoint is deleted, so a
+ * long replay doesn't keep every checkpoint's transactions on disk.
  */
 
 class ApplyCheckpointWork : public BasicWork
@@ -78,5 +81,6 @@ class ApplyCheckpointWork : public BasicWork
     void onReset() override;
     State onRun() override;
     bool onAbort() override;
+    void onSuccess() override;
 };
 }
@@ -82,6 +82,7 @@ CatchupWork::doReset()
     ZoneScoped;
     mBucketsAppliedEmitted = false;
     mTransactionsVerifyEmitted = false;
+    mApplyTransactions = false;
     mBuckets.clear();
     mDownloadVerifyLedgersSeq.reset();
     mBucketVerifyApplySeq.reset();
@@ -205,8 +206,15 @@ CatchupWork::downloadApplyTransactions(CatchupRange const& catchupRange)
     ZoneScoped;
     auto waitForPublish = mCatchupConfiguration.offline();
     auto range = catchupRange.getReplayRange();
+    std::weak_ptr<CatchupWork> weak(
+        std::static_pointer_cast<CatchupWork>(shared_from_this()));
+    auto canApply = [weak]() {
+        auto self = weak.lock();
+        return self && self->mApplyTransactions;
+    };
     mTransactionsVerifyApplySeq = std::make_shared<DownloadApplyTxsWork>(
-        mApp, *mDownloadDir, range, mLastApplied, waitForPublish, mArchive);
+        mApp, *mDownloadDir, range, mLastApplied, waitForPublish, mArchive,
+        canApply);
 }
 
 BasicWork::State
@@ -312,57 +320,47 @@ CatchupWork::runCatchupStep()
 
     // Step 4: Download, verify and apply ledgers, buckets and transactions
 
+    // Transactions are downloaded from the start of step 4, so a failure
+    // there ends catchup whatever else is running
+    if (mTransactionsVerifyApplySeq &&
+        mTransactionsVerifyApplySeq->getState() == State::WORK_FAILURE)
+    {
+        return State::WORK_FAILURE;
+    }
+
     // Bucket and transaction processing has started
     if (mCatchupSeq)
     {
         assert(mDownloadVerifyLedgersSeq);
         assert(mTransactionsVerifyApplySeq || !catchupRange.replayLedgers());
 
-        if (mCatchupSeq->getState() == State::WORK_SUCCESS)
+        if (mBucketVerifyApplySeq &&
+            mBucketVerifyApplySeq->getState() == State::WORK_SUCCESS &&
+            !mBucketsAppliedEmitted)
         {
-            // Step 4.4: Apply buffered ledgers
-            if (mApplyBufferedLedgersWork)
-            {
-                if (mApplyBufferedLedgersWork->getState() ==
-                    State::WORK_SUCCESS)
-                {
-                    mApplyBufferedLedgersWork.reset();
-                }
-                else
-                {
-                    // waiting for mApplyBufferedLedgersWork to complete/error
-                    // out
-                    return mApplyBufferedLedgersWork->getState();
-                }
-            }
-            // see if we need to apply buffered ledgers
-            if (mApp.getCatchupManager().hasBufferedLedger())
-            {
-                mApplyBufferedLedgersWork = addWork<ApplyBufferedLedgersWork>();
-                mCurrentWork = mApplyBufferedLedgersWork;
-                return State::WORK_RUNNING;
-            }
+            mApp.getLedgerManager().setLastClosedLedger(
+                mVerifiedLedgerRangeStart);
+            mBucketsAppliedEmitted = true;
+            mBuckets.clear();
+            mLastApplied = mApp.getLedgerManager().getLastClosedLedgerHeader();
+        }
 
-            return State::WORK_SUCCESS;
+        if (mCatchupSeq->getState() != State::WORK_SUCCESS)
+        {
+            return mCatchupSeq->getState();
         }
-        else if (mBucketVerifyApplySeq)
+
+        // Step 4.3: Apply the (already downloading) ledger chain
+        if (mTransactionsVerifyApplySeq)
         {
-            if (mBucketVerifyApplySeq->getState() == State::WORK_SUCCESS &&
-                !mBucketsAppliedEmitted)
+            mApplyTransactions = true;
+            if (mTransactionsVerifyApplySeq->getState() !=
+                State::WORK_SUCCESS)
             {
-                mApp.getLedgerManager().setLastClosedLedger(
-                    mVerifiedLedgerRangeStart);
-                mBucketsAppliedEmitted = true;
-                mBuckets.clear();
-                mLastApplied =
-                    mApp.getLedgerManager().getLastClosedLedgerHeader();
+                mCurrentWork = mTransactionsVerifyApplySeq;
+                return mTransactionsVerifyApplySeq->getState();
             }
-        }
-        else if (mTransactionsVerifyApplySeq)
-        {
-            if (mTransactionsVerifyApplySeq->getState() ==
-                    State::WORK_SUCCESS &&
-                !mTransactionsVerifyEmitted)
+            if (!mTransactionsVerifyEmitted)
             {
                 mTransactionsVerifyEmitted = true;
 
@@ -375,7 +373,29 @@ CatchupWork::runCatchupStep()
                 assert(mLastApplied.header == lastClosed.header);
             }
         }
-        return mCatchupSeq->getState();
+
+        // Step 4.4: Apply buffered ledgers
+        if (mApplyBufferedLedgersWork)
+        {
+            if (mApplyBufferedLedgersWork->getState() == State::WORK_SUCCESS)
+            {
+                mApplyBufferedLedgersWork.reset();
+            }
+            else
+            {
+                // waiting for mApplyBufferedLedgersWork to complete/error out
+                return mApplyBufferedLedgersWork->getState();
+            }
+        }
+        // see if we need to apply buffered ledgers
+        if (mApp.getCatchupManager().hasBufferedLedger())
+        {
+            mApplyBufferedLedgersWork = addWork<ApplyBufferedLedgersWork>();
+            mCurrentWork = mApplyBufferedLedgersWork;
+            return State::WORK_RUNNING;
+        }
+
+        return State::WORK_SUCCESS;
     }
     // Still waiting for ledger headers
     else if (mDownloadVerifyLedgersSeq)
@@ -404,13 +424,6 @@ CatchupWork::runCatchupStep()
                 seq.push_back(mBucketVerifyApplySeq);
             }
 
-            if (catchupRange.replayLedgers())
-            {
-                // Step 4.3: Download and apply ledger chain
-                downloadApplyTransactions(catchupRange);
-                seq.push_back(mTransactionsVerifyApplySeq);
-            }
-
             mCatchupSeq =
                 addWork<WorkSequence>("catchup-seq", seq, RETRY_NEVER);
             mCurrentWork = mCatchupSeq;
@@ -424,6 +437,15 @@ CatchupWork::runCatchupStep()
         catchupRange,
         LedgerNumHashPair(catchupRange.last(), mCatchupConfiguration.hash()));
 
+    // Transactions to replay are downloaded while the ledger chain is
+    // verified and buckets are applied, up to CATCHUP_LOOKAHEAD_CHECKPOINTS
+    // checkpoints ahead; they are applied once everything else succeeded.
+    if (catchupRange.replayLedgers())
+    {
+        downloadApplyTransactions(catchupRange);
+        addWork(nullptr, mTransactionsVerifyApplySeq);
+    }
+
     return State::WORK_RUNNING;
 }
 
@@ -35,8 +35,9 @@ using WorkSeqPtr = std::shared_ptr<WorkSequence>;
 // buffered in LedgerManager).
 //
 // Then, depending on configuration, it can download, verify and apply buckets
-// (as in MINIMAL and RECENT catchups), and then download and apply
-// transactions (as in COMPLETE and RECENT catchups).
+// (as in MINIMAL and RECENT catchups), and then apply transactions (as in
+// COMPLETE and RECENT catchups). Transactions are downloaded, a bounded
+// number of checkpoints ahead, from the time ledger download starts.
 //
 // After that, catchup is done and node can replay buffered ledgers and take
 // part in consensus protocol.
@@ -82,6 +83,9 @@ class CatchupWork : public Work
     std::shared_ptr<HistoryArchive> mArchive;
     bool mBucketsAppliedEmitted{false};
     bool mTransactionsVerifyEmitted{false};
+    // Set once ledgers and buckets are in place, letting the transactions
+    // downloaded meanwhile be applied.
+    bool mApplyTransactions{false};
 
     std::shared_ptr<GetHistoryArchiveStateWork> mGetHistoryArchiveStateWork;
     std::shared_ptr<GetHistoryArchiveStateWork> mGetBucketStateWork;
@@ -8,6 +8,7 @@
 #include "history/HistoryManager.h"
 #include "historywork/GetAndUnzipRemoteFileWork.h"
 #include "ledger/LedgerManager.h"
+#include "main/Application.h"
 #include "work/ConditionalWork.h"
 #include "work/WorkSequence.h"
 #include <Tracy.hpp>
@@ -19,7 +20,7 @@ namespace diamnet
 DownloadApplyTxsWork::DownloadApplyTxsWork(
     Application& app, TmpDir const& downloadDir, LedgerRange const& range,
     LedgerHeaderHistoryEntry& lastApplied, bool waitForPublish,
-    std::shared_ptr<HistoryArchive> archive)
+    std::shared_ptr<HistoryArchive> archive, std::function<bool()> canApply)
     : BatchWork(app, "download-apply-ledgers")
     , mRange(range)
     , mDownloadDir(downloadDir)
@@ -28,6 +29,7 @@ DownloadApplyTxsWork::DownloadApplyTxsWork(
           app.getHistoryManager().checkpointContainingLedger(range.mFirst))
     , mWaitForPublish(waitForPublish)
     , mArchive(archive)
+    , mCanApply(canApply)
 {
 }
 
@@ -56,22 +58,22 @@ DownloadApplyTxsWork::yieldMoreWork()
 
     std::vector<std::shared_ptr<BasicWork>> seq{getAndUnzip};
 
-    if (mLastYieldedWork)
+    if (mLastYieldedWork || mCanApply)
     {
         auto prev = mLastYieldedWork;
         bool pqFellBehind = false;
         auto predicate = [
-            prev, pqFellBehind, waitForPublish = mWaitForPublish, &hm
+            prev, pqFellBehind, waitForPublish = mWaitForPublish, &hm,
+            canApply = mCanApply
         ]() mutable
         {
-            if (!prev)
+            if (canApply && !canApply())
             {
-                throw std::runtime_error("Download and apply txs: related Work "
-                                         "is destroyed unexpectedly");
+                return false;
             }
 
-            // First, ensure download work is finished
-            if (prev->getState() != State::WORK_SUCCESS)
+            // First, ensure previous checkpoint is applied
+            if (prev && prev->getState() != State::WORK_SUCCESS)
             {
                 return false;
             }
@@ -130,6 +132,12 @@ DownloadApplyTxsWork::hasNext() const
     return mCheckpointToQueue <= last;
 }
 
+size_t
+DownloadApplyTxsWork::getBandwidth() const
+{
+    return mApp.getConfig().CATCHUP_LOOKAHEAD_CHECKPOINTS;
+}
+
 void
 DownloadApplyTxsWork::onSuccess()
 {
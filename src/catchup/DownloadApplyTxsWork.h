@@ -8,6 +8,7 @@
 #include "util/XDRStream.h"
 #include "work/BatchWork.h"
 #include "xdr/Diamnet-ledger.h"
+#include <functional>
 
 namespace medida
 {
@@ -30,13 +31,19 @@ class DownloadApplyTxsWork : public BatchWork
     std::shared_ptr<BasicWork> mLastYieldedWork;
     bool const mWaitForPublish;
     std::shared_ptr<HistoryArchive> mArchive;
+    std::function<bool()> const mCanApply;
 
   public:
+    // Transactions of up to CATCHUP_LOOKAHEAD_CHECKPOINTS checkpoints are
+    // downloaded ahead of the checkpoint being applied. If given, canApply
+    // holds back applying any of them until it returns true, so downloading
+    // can start before the ledgers they apply on top of are in place.
     DownloadApplyTxsWork(Application& app, TmpDir const& downloadDir,
                          LedgerRange const& range,
                          LedgerHeaderHistoryEntry& lastApplied,
                          bool waitForPublish,
-                         std::shared_ptr<HistoryArchive> archive = nullptr);
+                         std::shared_ptr<HistoryArchive> archive = nullptr,
+                         std::function<bool()> canApply = nullptr);
 
     std::string getStatus() const override;
 
@@ -44,6 +51,7 @@ class DownloadApplyTxsWork : public BatchWork
     bool hasNext() const override;
     std::shared_ptr<BasicWork> yieldMoreWork() override;
     void resetIter() override;
+    size_t getBandwidth() const override;
     void onSuccess() override;
 };
 }
\ No newline at end of file
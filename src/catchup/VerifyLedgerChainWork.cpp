@@ -86,74 +86,21 @@ verifyLastLedgerInCheckpoint(LedgerHeaderHistoryEntry const& ledger,
     return HistoryManager::VERIFY_STATUS_OK;
 }
 
-VerifyLedgerChainWork::VerifyLedgerChainWork(
-    Application& app, TmpDir const& downloadDir, LedgerRange const& range,
-    LedgerNumHashPair const& lastClosedLedger,
-    std::shared_future<LedgerNumHashPair> trustedMaxLedger,
-    std::shared_ptr<std::ofstream> outputStream)
-    : BasicWork(app, "verify-ledger-chain", BasicWork::RETRY_NEVER)
-    , mDownloadDir(downloadDir)
-    , mRange(range)
-    , mCurrCheckpoint(mRange.mCount == 0
-                          ? 0
-                          : mApp.getHistoryManager().checkpointContainingLedger(
-                                mRange.last()))
-    , mLastClosed(lastClosedLedger)
-    , mTrustedMaxLedger(trustedMaxLedger)
-    , mVerifiedMinLedgerPrevFuture(mVerifiedMinLedgerPrev.get_future().share())
-    , mOutputStream(outputStream)
-    , mVerifyLedgerSuccess(app.getMetrics().NewMeter(
-          {"history", "verify-ledger", "success"}, "event"))
-    , mVerifyLedgerChainSuccess(app.getMetrics().NewMeter(
-          {"history", "verify-ledger-chain", "success"}, "event"))
-    , mVerifyLedgerChainFailure(app.getMetrics().NewMeter(
-          {"history", "verify-ledger-chain", "failure"}, "event"))
-{
-    // LCL should be at-or-after genesis and we should have a hash.
-    releaseAssert(lastClosedLedger.first >= LedgerManager::GENESIS_LEDGER_SEQ);
-    releaseAssert(lastClosedLedger.second);
-}
-
-std::string
-VerifyLedgerChainWork::getStatus() const
-{
-    if (!isDone() && !isAborting() && mRange.mCount != 0)
-    {
-        std::string task = "verifying checkpoint";
-        return fmtProgress(mApp, task, mRange,
-                           (mRange.last() - mCurrCheckpoint));
-    }
-    return BasicWork::getStatus();
-}
-
-void
-VerifyLedgerChainWork::onReset()
-{
-    CLOG(INFO, "History") << "Verifying ledgers " << mRange.toString();
-
-    mVerifiedAhead = LedgerNumHashPair(0, nullptr);
-    mMaxVerifiedLedgerOfMinCheckpoint = {};
-    mVerifiedLedgers.clear();
-    mCurrCheckpoint = mRange.mCount == 0
-                          ? 0
-                          : mApp.getHistoryManager().checkpointContainingLedger(
-                                mRange.last());
-}
-
-HistoryManager::LedgerVerificationStatus
-VerifyLedgerChainWork::verifyHistoryOfSingleCheckpoint()
+// Scans the headers of a single checkpoint: everything that can be verified
+// without knowing about any other checkpoint. Runs on a worker thread.
+static VerifyLedgerChainWork::CheckpointScan
+scanCheckpoint(std::string const& path, uint32_t checkpoint,
+               uint32_t rangeLast, LedgerNumHashPair const& lastClosed)
 {
     ZoneScoped;
-    // When verifying a checkpoint, we rely on the fact that the next checkpoint
-    // has been verified (unless there's 1 checkpoint).
-    // Once the end of the range is reached, ensure that the chain agrees with
-    // trusted hash passed in. If LCL is reached, verify that it agrees with
-    // the chain.
+    VerifyLedgerChainWork::CheckpointScan scan;
+    auto fail = [&](HistoryManager::LedgerVerificationStatus status) {
+        scan.mStatus = status;
+        return scan;
+    };
 
-    FileTransferInfo ft(mDownloadDir, HISTORY_FILE_TYPE_LEDGER,
-                        mCurrCheckpoint);
     XDRInputFileStream hdrIn;
-    hdrIn.open(ft.localPath_nogz());
+    hdrIn.open(path);
 
     bool beginCheckpoint = true;
 
@@ -166,44 +113,43 @@ VerifyLedgerChainWork::verifyHistoryOfSingleCheckpoint()
     LedgerHeaderHistoryEntry first;
     LedgerHeaderHistoryEntry prev;
 
-    CLOG(DEBUG, "History") << "Verifying ledger headers from "
-                           << ft.localPath_nogz() << " for checkpoint "
-                           << mCurrCheckpoint;
+    CLOG(DEBUG, "History") << "Verifying ledger headers from " << path
+                           << " for checkpoint " << checkpoint;
 
     while (hdrIn && hdrIn.readOne(curr))
     {
         if (curr.header.ledgerVersion > Config::CURRENT_LEDGER_PROTOCOL_VERSION)
         {
-            return HistoryManager::VERIFY_STATUS_ERR_BAD_LEDGER_VERSION;
+            return fail(HistoryManager::VERIFY_STATUS_ERR_BAD_LEDGER_VERSION);
         }
 
         // Verify ledger with local state by comparing to LCL
-        if (curr.header.ledgerSeq == mLastClosed.first)
+        if (curr.header.ledgerSeq == lastClosed.first)
         {
-            if (sha256(xdr::xdr_to_opaque(curr.header)) != *mLastClosed.second)
+            if (sha256(xdr::xdr_to_opaque(curr.header)) != *lastClosed.second)
             {
                 CLOG(ERROR, "History")
                     << "Bad ledger-header history entry: claimed ledger "
                     << LedgerManager::ledgerAbbrev(curr)
                     << " does not agree with LCL "
-                    << LedgerManager::ledgerAbbrev(mLastClosed.first,
-                                                   *mLastClosed.second);
-                return HistoryManager::VERIFY_STATUS_ERR_BAD_HASH;
+                    << LedgerManager::ledgerAbbrev(lastClosed.first,
+                                                   *lastClosed.second);
+                return fail(HistoryManager::VERIFY_STATUS_ERR_BAD_HASH);
             }
         }
         // Verify LCL that is just before the first ledger in range
-        else if (curr.header.ledgerSeq == mLastClosed.first + 1)
+        else if (curr.header.ledgerSeq == lastClosed.first + 1)
         {
-            auto lclResult = verifyLedgerHistoryLink(*mLastClosed.second, curr);
+            auto lclResult = verifyLedgerHistoryLink(*lastClosed.second, curr);
             if (lclResult != HistoryManager::VERIFY_STATUS_OK)
             {
                 CLOG(ERROR, "History")
                     << "Bad ledger-header history entry: claimed ledger "
                     << LedgerManager::ledgerAbbrev(curr)
                     << " previous hash does not agree with LCL: "
-                    << LedgerManager::ledgerAbbrev(mLastClosed.first,
-                                                   *mLastClosed.second);
-                return lclResult;
+                    << LedgerManager::ledgerAbbrev(lastClosed.first,
+                                                   *lastClosed.second);
+                return fail(lclResult);
             }
         }
 
@@ -215,7 +161,7 @@ VerifyLedgerChainWork::verifyHistoryOfSingleCheckpoint()
             auto hashResult = verifyLedgerHistoryEntry(curr);
             if (hashResult != HistoryManager::VERIFY_STATUS_OK)
             {
-                return hashResult;
+                return fail(hashResult);
             }
 
             // Save first ledger in the checkpoint, in case we use it below in
@@ -232,7 +178,7 @@ VerifyLedgerChainWork::verifyHistoryOfSingleCheckpoint()
                     << "History chain undershot expected ledger seq "
                     << expectedSeq << ", got " << curr.header.ledgerSeq
                     << " instead";
-                return HistoryManager::VERIFY_STATUS_ERR_UNDERSHOT;
+                return fail(HistoryManager::VERIFY_STATUS_ERR_UNDERSHOT);
             }
             else if (curr.header.ledgerSeq > expectedSeq)
             {
@@ -240,37 +186,180 @@ VerifyLedgerChainWork::verifyHistoryOfSingleCheckpoint()
                     << "History chain overshot expected ledger seq "
                     << expectedSeq << ", got " << curr.header.ledgerSeq
                     << " instead";
-                return HistoryManager::VERIFY_STATUS_ERR_OVERSHOT;
+                return fail(HistoryManager::VERIFY_STATUS_ERR_OVERSHOT);
             }
             auto linkResult = verifyLedgerHistoryLink(prev.hash, curr);
             if (linkResult != HistoryManager::VERIFY_STATUS_OK)
             {
-                return linkResult;
+                return fail(linkResult);
             }
         }
 
-        mVerifyLedgerSuccess.Mark();
+        ++scan.mVerified;
         prev = curr;
 
         // No need to keep verifying if the range is covered
-        if (curr.header.ledgerSeq == mRange.last())
+        if (curr.header.ledgerSeq == rangeLast)
         {
             break;
         }
     }
 
-    if (curr.header.ledgerSeq != mCurrCheckpoint &&
-        curr.header.ledgerSeq != mRange.last())
+    if (curr.header.ledgerSeq != checkpoint &&
+        curr.header.ledgerSeq != rangeLast)
     {
-        // We can end at mCurrCheckpoint if checkpoint was valid
-        // or at mRange.last() if history chain file was valid and we
-        // reached last ledger in the range. Any other ledger here means
-        // that file is corrupted.
+        // We can end at checkpoint if checkpoint was valid or at rangeLast if
+        // history chain file was valid and we reached last ledger in the
+        // range. Any other ledger here means that file is corrupted.
         CLOG(ERROR, "History") << "History chain did not end with "
-                               << mCurrCheckpoint << " or " << mRange.last();
-        return HistoryManager::VERIFY_STATUS_ERR_MISSING_ENTRIES;
+                               << checkpoint << " or " << rangeLast;
+        return fail(HistoryManager::VERIFY_STATUS_ERR_MISSING_ENTRIES);
     }
 
+    scan.mFirst = first;
+    scan.mLast = curr;
+    return scan;
+}
+
+VerifyLedgerChainWork::VerifyLedgerChainWork(
+    Application& app, TmpDir const& downloadDir, LedgerRange const& range,
+    LedgerNumHashPair const& lastClosedLedger,
+    std::shared_future<LedgerNumHashPair> trustedMaxLedger,
+    std::shared_ptr<std::ofstream> outputStream)
+    : BasicWork(app, "verify-ledger-chain", BasicWork::RETRY_NEVER)
+    , mDownloadDir(downloadDir)
+    , mRange(range)
+    , mCurrCheckpoint(mRange.mCount == 0
+                          ? 0
+                          : mApp.getHistoryManager().checkpointContainingLedger(
+                                mRange.last()))
+    , mLastClosed(lastClosedLedger)
+    , mTrustedMaxLedger(trustedMaxLedger)
+    , mVerifiedMinLedgerPrevFuture(mVerifiedMinLedgerPrev.get_future().share())
+    , mOutputStream(outputStream)
+    , mVerifyLedgerSuccess(app.getMetrics().NewMeter(
+          {"history", "verify-ledger", "success"}, "event"))
+    , mVerifyLedgerChainSuccess(app.getMetrics().NewMeter(
+          {"history", "verify-ledger-chain", "success"}, "event"))
+    , mVerifyLedgerChainFailure(app.getMetrics().NewMeter(
+          {"history", "verify-ledger-chain", "failure"}, "event"))
+{
+    // LCL should be at-or-after genesis and we should have a hash.
+    releaseAssert(lastClosedLedger.first >= LedgerManager::GENESIS_LEDGER_SEQ);
+    releaseAssert(lastClosedLedger.second);
+}
+
+std::string
+VerifyLedgerChainWork::getStatus() const
+{
+    if (!isDone() && !isAborting() && mRange.mCount != 0)
+    {
+        std::string task = "verifying checkpoint";
+        return fmtProgress(mApp, task, mRange,
+                           (mRange.last() - mCurrCheckpoint));
+    }
+    return BasicWork::getStatus();
+}
+
+void
+VerifyLedgerChainWork::onReset()
+{
+    CLOG(INFO, "History") << "Verifying ledgers " << mRange.toString();
+
+    mVerifiedAhead = LedgerNumHashPair(0, nullptr);
+    mMaxVerifiedLedgerOfMinCheckpoint = {};
+    mVerifiedLedgers.clear();
+    mCurrCheckpoint = mRange.mCount == 0
+                          ? 0
+                          : mApp.getHistoryManager().checkpointContainingLedger(
+                                mRange.last());
+    mNextScan = mCurrCheckpoint;
+    mScansInFlight = 0;
+    mScans.clear();
+    ++mRun;
+}
+
+void
+VerifyLedgerChainWork::startScans()
+{
+    auto& hm = mApp.getHistoryManager();
+    auto minCheckpoint = hm.checkpointContainingLedger(mRange.mFirst);
+    // Completed scans are small, but don't run too far ahead of a walk that
+    // may fail on its next checkpoint.
+    size_t maxAhead =
+        4 * static_cast<size_t>(std::max(1, mApp.getConfig().WORKER_THREADS));
+    size_t maxInFlight =
+        static_cast<size_t>(std::max(1, mApp.getConfig().WORKER_THREADS));
+
+    Application& app = mApp;
+    std::weak_ptr<VerifyLedgerChainWork> weak(
+        std::static_pointer_cast<VerifyLedgerChainWork>(shared_from_this()));
+    while (mNextScan != 0 && mScansInFlight < maxInFlight &&
+           mScansInFlight + mScans.size() < maxAhead)
+    {
+        auto checkpoint = mNextScan;
+        FileTransferInfo ft(mDownloadDir, HISTORY_FILE_TYPE_LEDGER,
+                            checkpoint);
+        auto path = ft.localPath_nogz();
+        auto rangeLast = mRange.last();
+        auto lastClosed = mLastClosed;
+        auto run = mRun;
+        app.postOnBackgroundThread(
+            [&app, weak, path, checkpoint, rangeLast, lastClosed, run]() {
+                VerifyLedgerChainWork::CheckpointScan scan;
+                try
+                {
+                    scan = scanCheckpoint(path, checkpoint, rangeLast,
+                                          lastClosed);
+                }
+                catch (FileSystemException&)
+                {
+                    scan.mFileSystemError = true;
+                }
+                catch (...)
+                {
+                    // rethrown on the main thread, as if scanned there
+                    scan.mError = std::current_exception();
+                }
+                app.postOnMainThread(
+                    [weak, checkpoint, run, scan]() {
+                        auto self = weak.lock();
+                        if (self && self->mRun == run)
+                        {
+                            --self->mScansInFlight;
+                            self->mScans.emplace(checkpoint, scan);
+                            self->wakeUp();
+                        }
+                    },
+                    "VerifyLedgerChain: scanned checkpoint");
+            },
+            "VerifyLedgerChain: scan checkpoint");
+        ++mScansInFlight;
+        mNextScan = checkpoint == minCheckpoint
+                        ? 0
+                        : checkpoint - hm.getCheckpointFrequency();
+    }
+}
+
+HistoryManager::LedgerVerificationStatus
+VerifyLedgerChainWork::verifyHistoryOfSingleCheckpoint(
+    CheckpointScan const& scan)
+{
+    ZoneScoped;
+    // When verifying a checkpoint, we rely on the fact that the next checkpoint
+    // has been verified (unless there's 1 checkpoint).
+    // Once the end of the range is reached, ensure that the chain agrees with
+    // trusted hash passed in. If LCL is reached, verify that it agrees with
+    // the chain. Everything within the checkpoint was already checked by
+    // scanCheckpoint.
+    mVerifyLedgerSuccess.Mark(scan.mVerified);
+    if (scan.mStatus != HistoryManager::VERIFY_STATUS_OK)
+    {
+        return scan.mStatus;
+    }
+    auto const& first = scan.mFirst;
+    auto const& curr = scan.mLast;
+
     // We just finished scanning a checkpoint. We first grab the _incoming_
     // hash-link our caller (or previous call to this method) saved for us.
     auto incoming = mVerifiedAhead;
@@ -404,14 +493,21 @@ VerifyLedgerChainWork::onRun()
             "Verification undershot first ledger in the range.");
     }
 
-    HistoryManager::LedgerVerificationStatus result;
+    startScans();
+    auto scan = mScans.find(mCurrCheckpoint);
+    if (scan == mScans.end())
+    {
+        // woken up when a scan completes
+        return BasicWork::State::WORK_WAITING;
+    }
 
-    // Catch FS-related errors to gracefully fail Work instead of crashing
-    try
+    if (scan->second.mError)
     {
-        result = verifyHistoryOfSingleCheckpoint();
+        std::rethrow_exception(scan->second.mError);
     }
-    catch (FileSystemException&)
+
+    // Gracefully fail Work on FS-related errors instead of crashing
+    if (scan->second.mFileSystemError)
     {
         CLOG(ERROR, "History") << "Catchup material failed verification";
         CLOG(ERROR, "History") << POSSIBLY_CORRUPTED_LOCAL_FS;
@@ -419,6 +515,9 @@ VerifyLedgerChainWork::onRun()
         return BasicWork::State::WORK_FAILURE;
     }
 
+    auto result = verifyHistoryOfSingleCheckpoint(scan->second);
+    mScans.erase(scan);
+
     switch (result)
     {
     case HistoryManager::VERIFY_STATUS_OK:
@@ -7,8 +7,10 @@
 #include "history/HistoryManager.h"
 #include "ledger/LedgerRange.h"
 #include "work/Work.h"
+#include <exception>
 #include <future>
 #include <iosfwd>
+#include <map>
 #include <vector>
 
 namespace medida
@@ -25,13 +27,41 @@ struct LedgerHeaderHistoryEntry;
 // This class verifies ledger chain of a given range by checking the hashes.
 // Note that verification is done starting with the latest checkpoint in the
 // range, and working its way backwards to the beginning of the range.
+//
+// Hashing the headers of a checkpoint and checking the links between them
+// doesn't depend on any other checkpoint, so checkpoints are scanned on
+// worker threads, several at a time, ahead of the serial walk on the main
+// thread which only checks the link from each checkpoint to the one after it.
 class VerifyLedgerChainWork : public BasicWork
 {
+  public:
+    // Result of scanning the headers of a single checkpoint.
+    struct CheckpointScan
+    {
+        HistoryManager::LedgerVerificationStatus mStatus{
+            HistoryManager::VERIFY_STATUS_OK};
+        bool mFileSystemError{false};
+        std::exception_ptr mError;
+        // first and last ledgers scanned
+        LedgerHeaderHistoryEntry mFirst;
+        LedgerHeaderHistoryEntry mLast;
+        uint32_t mVerified{0};
+    };
+
+  private:
     TmpDir const& mDownloadDir;
     LedgerRange const mRange;
     uint32_t mCurrCheckpoint;
     LedgerNumHashPair const mLastClosed;
 
+    // Next (numerically lower) checkpoint to start scanning, 0 once all
+    // scans have started; scans completed but not yet linked, by checkpoint.
+    uint32_t mNextScan{0};
+    size_t mScansInFlight{0};
+    std::map<uint32_t, CheckpointScan> mScans;
+    // bumped on reset, so scans from an earlier run are dropped
+    uint64_t mRun{0};
+
     // Incoming var to read trusted hash of max ledger from. We use a
     // shared_future here because it allows reading the value multiple
     // times and we might be reset and re-run.
@@ -63,7 +93,9 @@ class VerifyLedgerChainWork : public BasicWork
     medida::Meter& mVerifyLedgerChainSuccess;
     medida::Meter& mVerifyLedgerChainFailure;
 
-    HistoryManager::LedgerVerificationStatus verifyHistoryOfSingleCheckpoint();
+    void startScans();
+    HistoryManager::LedgerVerificationStatus
+    verifyHistoryOfSingleCheckpoint(CheckpointScan const& scan);
 
   public:
     VerifyLedgerChainWork(
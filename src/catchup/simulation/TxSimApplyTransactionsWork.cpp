@@ -9,6 +9,7 @@
 #include "herder/LedgerCloseData.h"
 #include "herder/simulation/TxSimTxSetFrame.h"
 #include "history/HistoryArchiveManager.h"
+#include "history/TxHistorySegments.h"
 #include "ledger/LedgerManagerImpl.h"
 #include "ledger/LedgerRange.h"
 #include "ledger/LedgerTxn.h"
@@ -167,7 +168,10 @@ static void
 checkResults(Application& app, uint32_t ledger,
              std::vector<TransactionResultPair> const& results)
 {
-    auto resSet = getTransactionHistoryResults(app.getDatabase(), ledger);
+    auto resSet =
+        TxHistorySegments::isEnabled(app.getConfig())
+            ? TxHistorySegments::getTransactionHistoryResults(app, ledger)
+            : getTransactionHistoryResults(app.getDatabase(), ledger);
 
     assert(resSet.results.size() == results.size());
     for (size_t i = 0; i < results.size(); i++)
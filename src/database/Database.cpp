@@ -21,6 +21,7 @@
 #include "herder/HerderPersistence.h"
 #include "herder/Upgrades.h"
 #include "history/HistoryManager.h"
+#include "history/TxHistorySegments.h"
 #include "ledger/LedgerHeaderUtils.h"
 #include "ledger/LedgerTxn.h"
 #include "main/ExternalQueue.h"
@@ -62,7 +63,7 @@ bool Database::gDriversRegistered = false;
 
 // smallest schema version supported
 static unsigned long const MIN_SCHEMA_VERSION = 12;
-static unsigned long const SCHEMA_VERSION = 13;
+static unsigned long const SCHEMA_VERSION = 14;
 
 // These should always match our compiled version precisely, since we are
 // using a bundled version to get access to carray(). But in case someone
@@ -176,6 +177,8 @@ class DatabaseConfigureSessionOp : public DatabaseTypeSpecificOperation<void>
         mSession
             << "SET SESSION CHARACTERISTICS AS TRANSACTION ISOLATION LEVEL "
                "SERIALIZABLE";
+        // the format BinaryColumn reads bytea values in
+        mSession << "SET bytea_output = 'hex'";
     }
 #endif
 };
@@ -238,6 +241,25 @@ Database::applySchemaUpgrade(unsigned long vers)
             mApp.getLedgerTxnRoot().dropClaimableBalances();
         }
         break;
+    case 14:
+        if (!mApp.getConfig().MODE_USES_IN_MEMORY_LEDGER)
+        {
+            // Store the opaque XDR (and other raw byte) columns of the
+            // ledger entry tables as binary instead of base64 text. Key
+            // columns stay as they are.
+            convertBase64ColumnsToBinary(
+                "accounts", {"homedomain", "thresholds", "signers",
+                             "extension", "ledgerext"});
+            convertBase64ColumnsToBinary("trustlines",
+                                         {"extension", "ledgerext"});
+            convertBase64ColumnsToBinary(
+                "offers",
+                {"sellingasset", "buyingasset", "extension", "ledgerext"});
+            convertBase64ColumnsToBinary(
+                "accountdata", {"datavalue", "extension", "ledgerext"});
+            convertBase64ColumnsToBinary("claimablebalance", {"ledgerentry"});
+        }
+        break;
     default:
         throw std::runtime_error("Unknown DB schema version");
     }
@@ -286,6 +308,98 @@ Database::addTextColumn(std::string const& table, std::string const& column)
     mSession << addColumnStr;
 }
 
+void
+Database::convertBase64ColumnsToBinary(std::string const& table,
+                                       std::vector<std::string> const& columns)
+{
+    CLOG(INFO, "Database") << "Converting columns of table '" << table
+                           << "' from base64 to binary";
+    if (!isSqlite())
+    {
+        std::string alter = "ALTER TABLE " + table;
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            alter += (i == 0 ? " " : ", ");
+            alter += "ALTER COLUMN " + columns[i] +
+                     " TYPE BYTEA USING decode(" + columns[i] + ", 'base64')";
+        }
+        mSession << alter;
+        return;
+    }
+
+    // SQLite can't change the type of a column, but a BLOB stored in a TEXT
+    // column stays a BLOB, so re-encoding the values in place is enough.
+    // soci reads rowid as a string, since it has no declared type
+    struct Fields
+    {
+        std::string mRowID;
+        std::vector<std::vector<uint8_t>> mValues;
+        std::vector<soci::indicator> mInds;
+        // bound by prepUpdate, so must live as long as the row's update
+        mutable std::vector<std::unique_ptr<BinaryColumn>> mBinds;
+    };
+
+    std::string selectStr = "SELECT rowid";
+    std::string updateStr = "UPDATE " + table + " SET ";
+    for (size_t i = 0; i < columns.size(); ++i)
+    {
+        selectStr += ", " + columns[i];
+        updateStr += (i == 0 ? "" : ", ") + columns[i] + " = :v" +
+                     std::to_string(i);
+    }
+    selectStr += " FROM " + table;
+    updateStr += " WHERE rowid = :id";
+
+    auto makeFields = [&columns](soci::row const& row) {
+        Fields f{row.get<std::string>(0), {}, {}, {}};
+        for (size_t i = 0; i < columns.size(); ++i)
+        {
+            auto ind = row.get_indicator(i + 1);
+            f.mInds.emplace_back(ind);
+            f.mValues.emplace_back();
+            if (ind == soci::i_ok)
+            {
+                decoder::decode_b64(row.get<std::string>(i + 1),
+                                    f.mValues.back());
+            }
+        }
+        return f;
+    };
+    auto prepUpdate = [this](soci::statement& st_update, Fields const& data) {
+        for (size_t i = 0; i < data.mValues.size(); ++i)
+        {
+            data.mBinds.emplace_back(
+                std::make_unique<BinaryColumn>(mSession));
+            auto& bind = *data.mBinds.back();
+            if (data.mInds[i] == soci::i_ok)
+            {
+                bind.set(data.mValues[i]);
+            }
+            else
+            {
+                bind.setNull();
+            }
+            st_update.exchange(bind.use());
+        }
+        st_update.exchange(soci::use(data.mRowID));
+    };
+    auto postUpdate = [&table](long long const affected_rows,
+                               Fields const& data) {
+        if (affected_rows != 1)
+        {
+            throw std::runtime_error(fmt::format(
+                "{}: updating row {} of {} affected {} row(s)", __func__,
+                data.mRowID, table, affected_rows));
+        }
+    };
+
+    size_t numUpdated = selectUpdateMap<Fields>(
+        *this, selectStr, makeFields, updateStr, prepUpdate, postUpdate);
+
+    CLOG(INFO, "Database") << __func__ << ": converted " << numUpdated
+                           << " record(s) in " << table << " table";
+}
+
 void
 Database::dropNullableColumn(std::string const& table,
                              std::string const& column)
@@ -500,11 +614,14 @@ Database::getInsertTimer(std::string const& entityName)
         .TimeScope();
 }
 
+static thread_local uint64_t gThreadSelectCount = 0;
+
 medida::TimerContext
 Database::getSelectTimer(std::string const& entityName)
 {
     mEntityTypes.insert(entityName);
     mQueryMeter.Mark();
+    ++gThreadSelectCount;
     return mApp.getMetrics()
         .NewTimer({"database", "select", entityName})
         .TimeScope();
@@ -540,6 +657,12 @@ Database::getUpsertTimer(std::string const& entityName)
         .TimeScope();
 }
 
+uint64_t
+Database::getThreadSelectCount()
+{
+    return gThreadSelectCount;
+}
+
 void
 Database::setCurrentTransactionReadOnly()
 {
@@ -614,6 +737,7 @@ Database::initialize()
     ExternalQueue::dropAll(*this);
     LedgerHeaderUtils::dropAll(*this);
     dropTransactionHistory(*this);
+    TxHistorySegments::dropAll(mApp);
     HistoryManager::dropAll(*this);
     HerderPersistence::dropAll(*this);
     BanManager::dropAll(*this);
@@ -808,4 +932,77 @@ DBTimeExcluder::~DBTimeExcluder()
     auto deltaT = mApp.getClock().now() - mStartTotalTime;
     mApp.getDatabase().excludeTime(deltaQ, deltaT);
 }
+
+BinaryColumn::BinaryColumn(soci::session& sess)
+{
+    if (dynamic_cast<soci::sqlite3_session_backend*>(sess.get_backend()))
+    {
+        mBlob = std::make_unique<soci::blob>(sess);
+    }
+}
+
+soci::details::into_type_ptr
+BinaryColumn::into()
+{
+    if (mBlob)
+    {
+        return soci::into(*mBlob, mInd);
+    }
+    return soci::into(mText, mInd);
+}
+
+soci::details::use_type_ptr
+BinaryColumn::use()
+{
+    if (mBlob)
+    {
+        return soci::use(*mBlob, mInd);
+    }
+    return soci::use(mText, mInd);
+}
+
+std::vector<uint8_t>
+BinaryColumn::get() const
+{
+    if (isNull())
+    {
+        throw std::runtime_error("Unexpected NULL binary column");
+    }
+    if (mBlob)
+    {
+        std::vector<uint8_t> res(mBlob->get_len());
+        if (!res.empty())
+        {
+            mBlob->read(0, reinterpret_cast<char*>(res.data()), res.size());
+        }
+        return res;
+    }
+    if (mText.compare(0, 2, "\\x") != 0)
+    {
+        throw std::runtime_error("Unexpected bytea format in SQL");
+    }
+    return hexToBin(mText.substr(2));
+}
+
+void
+BinaryColumn::set(ByteSlice const& bin)
+{
+    mInd = soci::i_ok;
+    if (mBlob)
+    {
+        mBlob->trim(0);
+        mBlob->write(0, reinterpret_cast<char const*>(bin.data()),
+                     bin.size());
+    }
+    else
+    {
+        mText = "\\x" + binToHex(bin);
+    }
+}
+
+void
+BinaryColumn::setNull()
+{
+    mInd = soci::i_null;
+}
 }
@@ -4,6 +4,7 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "crypto/Hex.h"
 #include "database/DatabaseTypeSpecificOperation.h"
 #include "medida/timer_context.h"
 #include "overlay/DiamnetXDR.h"
@@ -114,6 +115,9 @@ class Database : NonMovableOrCopyable
     std::string getOldLiabilitySelect(std::string const& table,
                                       std::string const& fields);
     void addTextColumn(std::string const& table, std::string const& column);
+    // Convert base64-encoded text columns to binary ones, in place.
+    void convertBase64ColumnsToBinary(std::string const& table,
+                                      std::vector<std::string> const& columns);
     void dropNullableColumn(std::string const& table,
                             std::string const& column);
 
@@ -174,6 +178,10 @@ class Database : NonMovableOrCopyable
     medida::TimerContext getUpdateTimer(std::string const& entityName);
     medida::TimerContext getUpsertTimer(std::string const& entityName);
 
+    // Number of select queries run so far by the calling thread, so the
+    // loads of some piece of work can be counted from before and after it.
+    static uint64_t getThreadSelectCount();
+
     // If possible (i.e. "on postgres") issue an SQL pragma that marks
     // the current transaction as read-only. The effects of this last
     // only as long as the current SQL transaction.
@@ -348,4 +356,43 @@ decodeOpaqueXDR(std::string const& in, soci::indicator const& ind, T& out)
         decodeOpaqueXDR(in, out);
     }
 }
+
+// A BYTEA (postgres) or BLOB (SQLite) column value, bound natively on each
+// backend: as a soci::blob on SQLite, and on postgres in bytea's own text
+// format ("\x" followed by hex), which is what libpq exchanges bytea values
+// as. soci's postgres blob is a large object, which a bytea is not.
+class BinaryColumn : NonCopyable
+{
+    std::unique_ptr<soci::blob> mBlob; // SQLite
+    std::string mText;                 // postgres
+    soci::indicator mInd{soci::i_ok};
+
+  public:
+    explicit BinaryColumn(soci::session& sess);
+
+    soci::details::into_type_ptr into();
+    soci::details::use_type_ptr use();
+
+    bool
+    isNull() const
+    {
+        return mInd == soci::i_null;
+    }
+
+    // The bytes fetched into the column; throws if it is NULL.
+    std::vector<uint8_t> get() const;
+
+    void set(ByteSlice const& bin);
+    void setNull();
+};
+
+template <typename T>
+void
+decodeBinaryXDR(BinaryColumn const& in, T& out)
+{
+    if (!in.isNull())
+    {
+        xdr::xdr_from_opaque(in.get(), out);
+    }
+}
 }
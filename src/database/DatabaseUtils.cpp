@@ -3,11 +3,27 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "DatabaseUtils.h"
+#include <Tracy.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#ifdef USE_POSTGRES
+#include <libpq-fe.h>
+#endif
 
 namespace diamnet
 {
 namespace DatabaseUtils
 {
+// SQLITE_MAX_VARIABLE_NUMBER as compiled into the bundled sqlite.
+static size_t const SQLITE_MAX_BOUND_PARAMS = 999;
+
+// Size at which buffered COPY rows are handed to libpq.
+static size_t const COPY_FLUSH_BYTES = 1 << 20;
+
 void
 deleteOldEntriesHelper(soci::session& sess, uint32_t ledgerSeq, uint32_t count,
                        std::string const& tableName,
@@ -30,5 +46,285 @@ deleteOldEntriesHelper(soci::session& sess, uint32_t ledgerSeq, uint32_t count,
              << " <= " << m;
     }
 }
+
+void
+appendCopyValue(std::string& out, std::string const& v)
+{
+    for (char c : v)
+    {
+        switch (c)
+        {
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        default:
+            out += c;
+        }
+    }
+}
+
+void
+appendCopyValue(std::string& out, int32_t v)
+{
+    out += std::to_string(v);
+}
+
+void
+appendCopyValue(std::string& out, int64_t v)
+{
+    out += std::to_string(v);
+}
+
+void
+appendCopyValue(std::string& out, double v)
+{
+    // As in marshalToPGArrayItem, max_digits10 is what makes the double
+    // round-trip exactly through its decimal representation.
+    std::ostringstream oss;
+    oss << std::setprecision(std::numeric_limits<double>::max_digits10) << v;
+    out += oss.str();
+}
+
+BulkUpsert::BulkUpsert(Database& db, std::string const& table,
+                       std::string const& entityName,
+                       std::string const& conflictClause, size_t rows)
+    : mDB(db)
+    , mTable(table)
+    , mEntityName(entityName)
+    , mConflictClause(conflictClause)
+    , mRows(rows)
+{
+}
+
+void
+BulkUpsert::addBinaryColumn(std::string const& name,
+                            std::vector<std::vector<uint8_t>>& values,
+                            std::vector<soci::indicator>* inds)
+{
+    assert(values.size() == mRows);
+    assert(!inds || inds->size() == mRows);
+    Column c;
+    c.mName = name;
+    // bound values have to live until the statement has run
+    auto binds = std::make_shared<std::vector<std::unique_ptr<BinaryColumn>>>();
+    auto& sess = mDB.getSession();
+    c.mBind = [&values, inds, binds, &sess](soci::statement& st, size_t i) {
+        binds->emplace_back(std::make_unique<BinaryColumn>(sess));
+        auto& bind = *binds->back();
+        if (inds && (*inds)[i] == soci::i_null)
+        {
+            bind.setNull();
+        }
+        else
+        {
+            bind.set(values[i]);
+        }
+        st.exchange(bind.use());
+    };
+    // bytea's hex input format, with its backslash escaped for COPY
+    c.mFormat = [&values, inds](std::string& out, size_t i) {
+        if (inds && (*inds)[i] == soci::i_null)
+        {
+            out += "\\N";
+        }
+        else
+        {
+            out += "\\\\x";
+            out += binToHex(values[i]);
+        }
+    };
+    mColumns.emplace_back(std::move(c));
+}
+
+std::string
+BulkUpsert::columnList() const
+{
+    std::string res;
+    for (auto const& c : mColumns)
+    {
+        if (!res.empty())
+        {
+            res += ", ";
+        }
+        res += c.mName;
+    }
+    return res;
+}
+
+void
+BulkUpsert::execute(soci::sqlite3_session_backend* sq)
+{
+    ZoneScoped;
+    assert(!mColumns.empty());
+    size_t const rowsPerStatement =
+        std::max<size_t>(1, SQLITE_MAX_BOUND_PARAMS / mColumns.size());
+    std::string const prefix =
+        "INSERT INTO " + mTable + " ( " + columnList() + " ) VALUES ";
+
+    size_t affected = 0;
+    auto timer = mDB.getUpsertTimer(mEntityName);
+    for (size_t begin = 0; begin < mRows; begin += rowsPerStatement)
+    {
+        size_t const n = std::min(rowsPerStatement, mRows - begin);
+
+        std::string sql = prefix;
+        size_t param = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            sql += (i == 0) ? "( " : ", ( ";
+            for (size_t j = 0; j < mColumns.size(); ++j)
+            {
+                sql += (j == 0) ? ":v" : ", :v";
+                sql += std::to_string(param++);
+            }
+            sql += " )";
+        }
+        sql += " ";
+        sql += mConflictClause;
+
+        // Full-sized chunks share one cached statement; only the tail of a
+        // batch needs a statement of its own.
+        auto prep = mDB.getPreparedStatement(sql);
+        soci::statement& st = prep.statement();
+        for (size_t i = begin; i < begin + n; ++i)
+        {
+            for (auto const& c : mColumns)
+            {
+                c.mBind(st, i);
+            }
+        }
+        st.define_and_bind();
+        st.execute(true);
+        affected += static_cast<size_t>(st.get_affected_rows());
+    }
+    if (affected != mRows)
+    {
+        throw std::runtime_error("Could not update data in SQL");
+    }
+}
+
+#ifdef USE_POSTGRES
+static void
+execPG(PGconn* conn, std::string const& sql, ExecStatusType expected)
+{
+    PGresult* res = PQexec(conn, sql.c_str());
+    bool ok = PQresultStatus(res) == expected;
+    PQclear(res);
+    if (!ok)
+    {
+        throw std::runtime_error(std::string("Could not update data in SQL: ") +
+                                 PQerrorMessage(conn));
+    }
+}
+
+static void
+putCopyData(PGconn* conn, std::string& buf)
+{
+    if (PQputCopyData(conn, buf.data(), static_cast<int>(buf.size())) != 1)
+    {
+        throw std::runtime_error(std::string("Could not COPY data in SQL: ") +
+                                 PQerrorMessage(conn));
+    }
+    buf.clear();
+}
+
+void
+BulkUpsert::execute(soci::postgresql_session_backend* pg)
+{
+    ZoneScoped;
+    assert(!mColumns.empty());
+    PGconn* conn = pg->conn_;
+    std::string const tmpTable = "upsert_" + mTable;
+    std::string const columns = columnList();
+
+    auto timer = mDB.getUpsertTimer(mEntityName);
+
+    // The staging table is created and dropped within a single transaction:
+    // the caller's if one is open, else one of our own, so a failure part
+    // way through never leaves it behind.
+    std::unique_ptr<soci::transaction> localTx;
+    if (PQtransactionStatus(conn) == PQTRANS_IDLE)
+    {
+        localTx = std::make_unique<soci::transaction>(mDB.getSession());
+    }
+    assert(PQtransactionStatus(conn) == PQTRANS_INTRANS);
+
+    execPG(conn,
+           "CREATE TEMP TABLE " + tmpTable + " (LIKE " + mTable +
+               " INCLUDING DEFAULTS)",
+           PGRES_COMMAND_OK);
+
+    execPG(conn, "COPY " + tmpTable + " ( " + columns + " ) FROM STDIN",
+           PGRES_COPY_IN);
+    std::string buf;
+    for (size_t i = 0; i < mRows; ++i)
+    {
+        for (size_t j = 0; j < mColumns.size(); ++j)
+        {
+            if (j != 0)
+            {
+                buf += '\t';
+            }
+            mColumns[j].mFormat(buf, i);
+        }
+        buf += '\n';
+        if (buf.size() >= COPY_FLUSH_BYTES)
+        {
+            putCopyData(conn, buf);
+        }
+    }
+    if (!buf.empty())
+    {
+        putCopyData(conn, buf);
+    }
+    if (PQputCopyEnd(conn, nullptr) != 1)
+    {
+        throw std::runtime_error(std::string("Could not COPY data in SQL: ") +
+                                 PQerrorMessage(conn));
+    }
+    bool copied = true;
+    while (PGresult* res = PQgetResult(conn))
+    {
+        copied = copied && PQresultStatus(res) == PGRES_COMMAND_OK;
+        PQclear(res);
+    }
+    if (!copied)
+    {
+        throw std::runtime_error(std::string("Could not COPY data in SQL: ") +
+                                 PQerrorMessage(conn));
+    }
+
+    std::string sql = "INSERT INTO " + mTable + " ( " + columns +
+                      " ) SELECT " + columns + " FROM " + tmpTable + " " +
+                      mConflictClause;
+    PGresult* res = PQexec(conn, sql.c_str());
+    bool merged = PQresultStatus(res) == PGRES_COMMAND_OK;
+    size_t affected = merged ? std::stoull(PQcmdTuples(res)) : 0;
+    PQclear(res);
+    if (!merged)
+    {
+        throw std::runtime_error(std::string("Could not update data in SQL: ") +
+                                 PQerrorMessage(conn));
+    }
+    if (affected != mRows)
+    {
+        throw std::runtime_error("Could not update data in SQL");
+    }
+    execPG(conn, "DROP TABLE " + tmpTable, PGRES_COMMAND_OK);
+    if (localTx)
+    {
+        localTx->commit();
+    }
+}
+#endif
+}
 }
-}
\ No newline at end of file
@@ -5,6 +5,11 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "Database.h"
+#include "util/NonCopyable.h"
+#include <cassert>
+#include <functional>
+#include <string>
+#include <vector>
 
 namespace diamnet
 {
@@ -13,5 +18,93 @@ namespace DatabaseUtils
 void deleteOldEntriesHelper(soci::session& sess, uint32_t ledgerSeq,
                             uint32_t count, std::string const& tableName,
                             std::string const& ledgerSeqColumn);
+
+// Appends a value to a row in postgres' COPY text format, escaping anything
+// that would be taken for a delimiter.
+void appendCopyValue(std::string& out, std::string const& v);
+void appendCopyValue(std::string& out, int32_t v);
+void appendCopyValue(std::string& out, int64_t v);
+void appendCopyValue(std::string& out, double v);
+
+// Group-commits a batch of rows into `table` as an "INSERT ... ON CONFLICT"
+// upsert, so that the cost of a statement is paid per batch instead of per
+// row. Columns are added by reference to vectors owned by the caller, which
+// must outlive the BulkUpsert and hold one value per row.
+//
+// On SQLite the rows are sent as prepared multi-row "VALUES (...), (...)"
+// statements, each as large as the bound-parameter limit allows. On postgres
+// they are streamed with "COPY ... FROM STDIN" into a temporary table and
+// merged into `table` with a single "INSERT ... SELECT ... ON CONFLICT", all
+// within the caller's transaction, or one of its own if none is open.
+//
+// Both paths time themselves with the upsert timer of `entityName` and throw
+// if the number of affected rows does not match the number of rows.
+class BulkUpsert : NonCopyable
+{
+    struct Column
+    {
+        std::string mName;
+        std::function<void(soci::statement&, size_t)> mBind;
+        std::function<void(std::string&, size_t)> mFormat;
+    };
+
+    Database& mDB;
+    std::string const mTable;
+    std::string const mEntityName;
+    std::string const mConflictClause;
+    size_t const mRows;
+    std::vector<Column> mColumns;
+
+    std::string columnList() const;
+
+  public:
+    // conflictClause is the complete "ON CONFLICT (...) DO UPDATE SET ..."
+    // clause, referring to the new values as `excluded`.
+    BulkUpsert(Database& db, std::string const& table,
+               std::string const& entityName,
+               std::string const& conflictClause, size_t rows);
+
+    template <typename T>
+    void
+    addColumn(std::string const& name, std::vector<T>& values,
+              std::vector<soci::indicator>* inds = nullptr)
+    {
+        assert(values.size() == mRows);
+        assert(!inds || inds->size() == mRows);
+        Column c;
+        c.mName = name;
+        c.mBind = [&values, inds](soci::statement& st, size_t i) {
+            if (inds)
+            {
+                st.exchange(soci::use(values[i], (*inds)[i]));
+            }
+            else
+            {
+                st.exchange(soci::use(values[i]));
+            }
+        };
+        c.mFormat = [&values, inds](std::string& out, size_t i) {
+            if (inds && (*inds)[i] == soci::i_null)
+            {
+                out += "\\N";
+            }
+            else
+            {
+                appendCopyValue(out, values[i]);
+            }
+        };
+        mColumns.emplace_back(std::move(c));
+    }
+
+    // Adds a BYTEA / BLOB column, bound as a BinaryColumn.
+    void addBinaryColumn(std::string const& name,
+                         std::vector<std::vector<uint8_t>>& values,
+                         std::vector<soci::indicator>* inds = nullptr);
+
+    void execute(soci::sqlite3_session_backend* sq);
+#ifdef USE_POSTGRES
+    void execute(soci::postgresql_session_backend* pg);
+#endif
+};
 }
 }
@@ -113,6 +113,15 @@ class Herder
     // We are learning about a new envelope.
     virtual EnvelopeStatus recvSCPEnvelope(SCPEnvelope const& envelope) = 0;
 
+    // We are learning about a new envelope from the network: its signature
+    // is checked on a worker thread, in a batch with other envelopes, and
+    // `done` is then called on the main thread with the status it was
+    // received with by recvSCPEnvelope (or ENVELOPE_STATUS_DISCARDED if the
+    // signature is bad).
+    using EnvelopeCallback = std::function<void(EnvelopeStatus)>;
+    virtual void recvUnverifiedSCPEnvelope(SCPEnvelope const& envelope,
+                                           EnvelopeCallback done) = 0;
+
     // We are learning about a new fully-fetched envelope.
     virtual EnvelopeStatus recvSCPEnvelope(SCPEnvelope const& envelope,
                                            const SCPQuorumSet& qset,
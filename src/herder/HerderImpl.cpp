@@ -70,6 +70,8 @@ HerderImpl::SCPMetrics::SCPMetrics(Application& app)
           {"scp", "envelope", "validsig"}, "envelope"))
     , mEnvelopeInvalidSig(app.getMetrics().NewMeter(
           {"scp", "envelope", "invalidsig"}, "envelope"))
+    , mEnvelopeDuplicate(app.getMetrics().NewMeter(
+          {"scp", "envelope", "duplicate"}, "envelope"))
 {
 }
 
@@ -510,6 +512,126 @@ HerderImpl::recvSCPEnvelope(SCPEnvelope const& envelope)
         return Herder::ENVELOPE_STATUS_DISCARDED;
     }
 
+    return recvVerifiedSCPEnvelope(envelope);
+}
+
+void
+HerderImpl::recvUnverifiedSCPEnvelope(SCPEnvelope const& envelope,
+                                      EnvelopeCallback done)
+{
+    ZoneScoped;
+    if (mApp.getConfig().MANUAL_CLOSE)
+    {
+        done(Herder::ENVELOPE_STATUS_DISCARDED);
+        return;
+    }
+
+    // peers flood the same envelope to us many times over: only the first
+    // copy is verified
+    auto h = xdrSha256(envelope);
+    if (mVerifyingEnvelopes.addCallback(h, done) ||
+        mUnverifiedEnvelopes.addCallback(h, done))
+    {
+        mSCPMetrics.mEnvelopeDuplicate.Mark();
+        return;
+    }
+
+    auto& batch = mUnverifiedEnvelopes;
+    batch.mIndex.emplace(h, batch.mEnvelopes.size());
+    batch.mEnvelopes.emplace_back(envelope);
+    batch.mCallbacks.emplace_back();
+    batch.mCallbacks.back().emplace_back(std::move(done));
+    maybeVerifySCPEnvelopes();
+}
+
+bool
+HerderImpl::EnvelopeBatch::addCallback(Hash const& h, EnvelopeCallback& done)
+{
+    auto it = mIndex.find(h);
+    if (it == mIndex.end())
+    {
+        return false;
+    }
+    mCallbacks[it->second].emplace_back(std::move(done));
+    return true;
+}
+
+void
+HerderImpl::maybeVerifySCPEnvelopes()
+{
+    if (!mVerifyingEnvelopes.mEnvelopes.empty() ||
+        mUnverifiedEnvelopes.mEnvelopes.empty())
+    {
+        return;
+    }
+
+    // envelopes arriving while this batch is in flight make up the next one
+    std::swap(mVerifyingEnvelopes, mUnverifiedEnvelopes);
+    auto envelopes = mVerifyingEnvelopes.mEnvelopes;
+    auto networkID = mApp.getNetworkID();
+    auto& app = mApp;
+    std::weak_ptr<HerderImpl*> weak(mVerifyingHandle);
+    mApp.postOnBackgroundThread(
+        [weak, &app, envelopes, networkID]() {
+            ZoneNamedN(verifyZone, "verify SCP envelopes", true);
+            std::vector<bool> valid;
+            valid.reserve(envelopes.size());
+            for (auto const& e : envelopes)
+            {
+                valid.emplace_back(PubKeyUtils::verifySig(
+                    e.statement.nodeID, e.signature,
+                    xdr::xdr_to_opaque(networkID, ENVELOPE_TYPE_SCP,
+                                       e.statement)));
+            }
+            app.postOnMainThread(
+                [weak, valid]() {
+                    auto self = weak.lock();
+                    if (!self || (*self)->mApp.isStopping())
+                    {
+                        return;
+                    }
+                    (*self)->finishVerifyingSCPEnvelopes(valid);
+                },
+                "HerderImpl: verified SCP envelopes");
+        },
+        "HerderImpl: verify SCP envelopes");
+}
+
+void
+HerderImpl::finishVerifyingSCPEnvelopes(std::vector<bool> const& valid)
+{
+    ZoneScoped;
+    EnvelopeBatch batch;
+    std::swap(batch, mVerifyingEnvelopes);
+    assert(valid.size() == batch.mEnvelopes.size());
+
+    for (size_t i = 0; i < batch.mEnvelopes.size(); ++i)
+    {
+        EnvelopeStatus status;
+        if (valid[i])
+        {
+            mSCPMetrics.mEnvelopeValidSig.Mark();
+            status = recvVerifiedSCPEnvelope(batch.mEnvelopes[i]);
+        }
+        else
+        {
+            mSCPMetrics.mEnvelopeInvalidSig.Mark();
+            CLOG(TRACE, "Herder") << "Received bad envelope, discarding";
+            status = Herder::ENVELOPE_STATUS_DISCARDED;
+        }
+        for (auto& done : batch.mCallbacks[i])
+        {
+            done(status);
+        }
+    }
+
+    maybeVerifySCPEnvelopes();
+}
+
+Herder::EnvelopeStatus
+HerderImpl::recvVerifiedSCPEnvelope(SCPEnvelope const& envelope)
+{
+    ZoneScoped;
     mSCPMetrics.mEnvelopeReceive.Mark();
 
     uint32_t minLedgerSeq = getMinLedgerSeqToRemember();
@@ -1453,13 +1575,17 @@ HerderImpl::checkAndMaybeReanalyzeQuorumMap()
         mLastQuorumMapIntersectionState.mInterruptFlag = false;
         mLastQuorumMapIntersectionState.mCheckingQuorumMapHash = curr;
         auto& cfg = mApp.getConfig();
+        auto cache = mLastQuorumMapIntersectionState.mSCCCache;
+        cache->startRun();
         auto qic = QuorumIntersectionChecker::create(
-            qmap, cfg, mLastQuorumMapIntersectionState.mInterruptFlag);
+            qmap, cfg, mLastQuorumMapIntersectionState.mInterruptFlag,
+            /*quiet=*/false, cache);
         auto ledger = getCurrentLedgerSeq();
         auto nNodes = qmap.size();
         auto& hState = mLastQuorumMapIntersectionState;
         auto& app = mApp;
-        auto worker = [curr, ledger, nNodes, qic, qmap, cfg, &app, &hState] {
+        auto worker = [curr, ledger, nNodes, qic, qmap, cfg, cache, &app,
+                       &hState] {
             try
             {
                 ZoneScoped;
@@ -1472,8 +1598,8 @@ HerderImpl::checkAndMaybeReanalyzeQuorumMap()
                     // intersecting; if not intersecting we should finish ASAP
                     // and raise an alarm.
                     critical = QuorumIntersectionChecker::
-                        getIntersectionCriticalGroups(qmap, cfg,
-                                                      hState.mInterruptFlag);
+                        getIntersectionCriticalGroups(
+                            qmap, cfg, hState.mInterruptFlag, cache);
                 }
                 app.postOnMainThread(
                     [ok, curr, ledger, nNodes, split, critical, &hState] {
@@ -7,8 +7,10 @@
 #include "herder/Herder.h"
 #include "herder/HerderSCPDriver.h"
 #include "herder/PendingEnvelopes.h"
+#include "herder/QuorumIntersectionChecker.h"
 #include "herder/TransactionQueue.h"
 #include "herder/Upgrades.h"
+#include "util/HashOfHash.h"
 #include "util/Timer.h"
 #include "util/XDROperators.h"
 #include <deque>
@@ -64,6 +66,8 @@ class HerderImpl : public Herder
     recvTransaction(TransactionFrameBasePtr tx) override;
 
     EnvelopeStatus recvSCPEnvelope(SCPEnvelope const& envelope) override;
+    void recvUnverifiedSCPEnvelope(SCPEnvelope const& envelope,
+                                   EnvelopeCallback done) override;
     EnvelopeStatus recvSCPEnvelope(SCPEnvelope const& envelope,
                                    const SCPQuorumSet& qset,
                                    TxSetFrame txset) override;
@@ -144,6 +148,37 @@ class HerderImpl : public Herder
 
     void processSCPQueueUpToIndex(uint64 slotIndex);
 
+    // recvSCPEnvelope, past the signature check
+    EnvelopeStatus recvVerifiedSCPEnvelope(SCPEnvelope const& envelope);
+
+    // Envelopes received by recvUnverifiedSCPEnvelope, deduplicated by
+    // envelope hash: all the callbacks of an envelope get its status.
+    struct EnvelopeBatch
+    {
+        std::vector<SCPEnvelope> mEnvelopes;
+        std::vector<std::vector<EnvelopeCallback>> mCallbacks;
+        std::unordered_map<Hash, size_t> mIndex;
+
+        // adds `done` to the callbacks of the envelope with hash `h`, if
+        // there is one
+        bool addCallback(Hash const& h, EnvelopeCallback& done);
+    };
+    // envelopes waiting for the batch in flight to be verified
+    EnvelopeBatch mUnverifiedEnvelopes;
+    // envelopes whose signatures are being verified on a worker thread
+    EnvelopeBatch mVerifyingEnvelopes;
+    // the batch in flight only holds a weak reference to this, so its result
+    // is dropped if the herder is destroyed before it arrives
+    std::shared_ptr<HerderImpl*> mVerifyingHandle{
+        std::make_shared<HerderImpl*>(this)};
+
+    // sends the waiting envelopes to a worker thread to be verified, unless a
+    // batch is already in flight
+    void maybeVerifySCPEnvelopes();
+    // receives the batch in flight, `valid` holding the result of each
+    // signature check
+    void finishVerifyingSCPEnvelopes(std::vector<bool> const& valid);
+
     TransactionQueue mTransactionQueue;
 
     void
@@ -203,6 +238,8 @@ class HerderImpl : public Herder
         // envelope signature verification
         medida::Meter& mEnvelopeValidSig;
         medida::Meter& mEnvelopeInvalidSig;
+        // envelopes received again while waiting for verification
+        medida::Meter& mEnvelopeDuplicate;
 
         SCPMetrics(Application& app);
     };
@@ -225,6 +262,10 @@ class HerderImpl : public Herder
         std::pair<std::vector<PublicKey>, std::vector<PublicKey>>
             mPotentialSplit{};
         std::set<std::set<PublicKey>> mIntersectionCriticalNodes{};
+        // Per-SCC results of the last analysis, so the next one re-analyzes
+        // only the parts of the quorum map that changed.
+        std::shared_ptr<QuorumIntersectionChecker::SCCCache> mSCCCache{
+            std::make_shared<QuorumIntersectionChecker::SCCCache>()};
 
         bool
         hasAnyResults() const
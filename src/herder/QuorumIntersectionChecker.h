@@ -6,7 +6,9 @@
 
 #include "herder/QuorumTracker.h"
 #include <atomic>
+#include <map>
 #include <memory>
+#include <mutex>
 
 namespace diamnet
 {
@@ -16,15 +18,48 @@ class Config;
 class QuorumIntersectionChecker
 {
   public:
+    // Results of the analysis of each strongly connected component of the
+    // quorum graph, keyed by the component's nodes and their quorum sets. A
+    // check given the cache of an earlier check only re-analyzes the
+    // components that changed since.
+    class SCCCache
+    {
+      public:
+        struct Result
+        {
+            bool mHasQuorum{false};
+            // Set once the component has been scanned for disjoint quorums.
+            bool mScanned{false};
+            bool mEnjoysQuorumIntersection{false};
+            std::pair<std::vector<PublicKey>, std::vector<PublicKey>>
+                mPotentialSplit;
+        };
+
+        // Drops every result not used since the previous call, so the cache
+        // only holds on to results of the most recent run of checks.
+        void startRun();
+
+        bool get(Hash const& key, Result& result);
+        void put(Hash const& key, Result const& result);
+
+        size_t size();
+
+      private:
+        std::mutex mMutex;
+        std::map<Hash, Result> mCurrent;
+        std::map<Hash, Result> mPrevious;
+    };
+
     static std::shared_ptr<QuorumIntersectionChecker>
     create(diamnet::QuorumTracker::QuorumMap const& qmap,
            diamnet::Config const& cfg, std::atomic<bool>& interruptFlag,
-           bool quiet = false);
+           bool quiet = false, std::shared_ptr<SCCCache> cache = nullptr);
 
     static std::set<std::set<PublicKey>>
     getIntersectionCriticalGroups(diamnet::QuorumTracker::QuorumMap const& qmap,
                                   diamnet::Config const& cfg,
-                                  std::atomic<bool>& interruptFlag);
+                                  std::atomic<bool>& interruptFlag,
+                                  std::shared_ptr<SCCCache> cache = nullptr);
 
     virtual ~QuorumIntersectionChecker(){};
     virtual bool networkEnjoysQuorumIntersection() const = 0;
@@ -5,8 +5,13 @@
 #include "QuorumIntersectionCheckerImpl.h"
 #include "QuorumIntersectionChecker.h"
 
+#include "crypto/SHA.h"
 #include "util/Logging.h"
 #include "util/Math.h"
+#include <xdrpp/marshal.h>
+
+#include <chrono>
+#include <thread>
 
 namespace
 {
@@ -136,7 +141,7 @@ TarjanSCCCalculator::scc(size_t i)
 size_t
 MinQuorumEnumerator::pickSplitNode() const
 {
-    std::vector<size_t>& inDegrees = mQic.mInDegrees;
+    std::vector<size_t>& inDegrees = mThread.mInDegrees;
     inDegrees.assign(mQic.mGraph.size(), 0);
     assert(!mRemaining.empty());
     size_t maxNode = mRemaining.max();
@@ -159,7 +164,8 @@ MinQuorumEnumerator::pickSplitNode() const
                     // currDegree same as existing max: replace it
                     // only probabilistically.
                     maxCount++;
-                    if (rand_uniform<size_t>(0, maxCount) == 0)
+                    if (std::uniform_int_distribution<size_t>(0, maxCount)(
+                            mThread.mRandom) == 0)
                     {
                         // Not switching max element with max degree.
                         continue;
@@ -187,12 +193,15 @@ MinQuorumEnumerator::maxCommit() const
 
 MinQuorumEnumerator::MinQuorumEnumerator(
     BitSet const& committed, BitSet const& remaining, BitSet const& scanSCC,
-    QuorumIntersectionCheckerImpl const& qic)
+    QuorumIntersectionCheckerImpl const& qic, MinQuorumSearch& search,
+    MinQuorumSearchThread& thread)
     : mCommitted(committed)
     , mRemaining(remaining)
     , mPerimeter(committed | remaining)
     , mScanSCC(scanSCC)
     , mQic(qic)
+    , mSearch(search)
+    , mThread(thread)
 {
 }
 
@@ -204,12 +213,19 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
         throw QuorumIntersectionChecker::InterruptedException();
     }
 
-    mQic.mStats.mCallsStarted++;
+    // Another thread found a disjoint quorum (or failed): nothing left to do.
+    if (mSearch.stopped())
+    {
+        return false;
+    }
+
+    auto& stats = mThread.mStats;
+    stats.mCallsStarted++;
 
     // Emit a progress meter every million calls.
-    if ((mQic.mStats.mCallsStarted & 0xfffff) == 0)
+    if ((stats.mCallsStarted & 0xfffff) == 0)
     {
-        mQic.mStats.log();
+        stats.log();
     }
     if (mQic.mLogTrace)
     {
@@ -223,7 +239,7 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
     // min-quorum they find (if they find any).
     if (mCommitted.count() > maxCommit())
     {
-        mQic.mStats.mEarlyExit1s++;
+        stats.mEarlyExit1s++;
         if (mQic.mLogTrace)
         {
             CLOG(TRACE, "SCP") << "early exit 1, with committed=" << mCommitted;
@@ -240,9 +256,10 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
     {
         CLOG(TRACE, "SCP") << "checking for quorum in committed=" << mCommitted;
     }
-    if (auto committedQuorum = mQic.contractToMaximalQuorum(mCommitted))
+    if (auto committedQuorum =
+            mQic.contractToMaximalQuorum(mCommitted, stats))
     {
-        if (mQic.isMinimalQuorum(committedQuorum))
+        if (mQic.isMinimalQuorum(committedQuorum, stats))
         {
             // Found a min-quorum. Examine it to see if
             // there's a disjoint quorum.
@@ -251,7 +268,7 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
                 CLOG(TRACE, "SCP")
                     << "early exit 3.1: minimal quorum=" << committedQuorum;
             }
-            mQic.mStats.mEarlyExit31s++;
+            stats.mEarlyExit31s++;
             return hasDisjointQuorum(committedQuorum);
         }
         if (mQic.mLogTrace)
@@ -259,7 +276,7 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
             CLOG(TRACE, "SCP")
                 << "early exit 3.2: non-minimal quorum=" << committedQuorum;
         }
-        mQic.mStats.mEarlyExit32s++;
+        stats.mEarlyExit32s++;
         return false;
     }
 
@@ -270,7 +287,7 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
     {
         CLOG(TRACE, "SCP") << "checking for quorum in perimeter=" << mPerimeter;
     }
-    if (auto extensionQuorum = mQic.contractToMaximalQuorum(mPerimeter))
+    if (auto extensionQuorum = mQic.contractToMaximalQuorum(mPerimeter, stats))
     {
         if (!(mCommitted <= extensionQuorum))
         {
@@ -281,7 +298,7 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
                     << " in perimeter=" << mPerimeter
                     << " does not extend committed=" << mCommitted;
             }
-            mQic.mStats.mEarlyExit22s++;
+            stats.mEarlyExit22s++;
             return false;
         }
     }
@@ -293,14 +310,14 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
                 << "early exit 2.1: no extension quorum in perimeter="
                 << mPerimeter;
         }
-        mQic.mStats.mEarlyExit21s++;
+        stats.mEarlyExit21s++;
         return false;
     }
 
     // Principal termination condition: stop when remainder is empty.
     if (!mRemaining)
     {
-        mQic.mStats.mTerminations++;
+        stats.mTerminations++;
         if (mQic.mLogTrace)
         {
             CLOG(TRACE, "SCP") << "remainder exhausted";
@@ -315,9 +332,16 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
         CLOG(TRACE, "SCP") << "recursing into subproblems, split=" << split;
     }
     mRemaining.unset(split);
+
+    // Defer the second subproblem while we work on the first, so that an idle
+    // thread can steal it in the meantime.
+    BitSet committedWithSplit(mCommitted);
+    committedWithSplit.set(split);
+    uint64_t deferred = mSearch.defer(mThread, committedWithSplit, mRemaining);
+
     MinQuorumEnumerator childExcludingSplit(mCommitted, mRemaining, mScanSCC,
-                                            mQic);
-    mQic.mStats.mFirstRecursionsTaken++;
+                                            mQic, mSearch, mThread);
+    stats.mFirstRecursionsTaken++;
     if (childExcludingSplit.anyMinQuorumHasDisjointQuorum())
     {
         if (mQic.mLogTrace)
@@ -327,23 +351,178 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
         }
         return true;
     }
-    mCommitted.set(split);
-    MinQuorumEnumerator childIncludingSplit(mCommitted, mRemaining, mScanSCC,
-                                            mQic);
-    mQic.mStats.mSecondRecursionsTaken++;
+    if (!mSearch.reclaim(mThread, deferred))
+    {
+        if (mQic.mLogTrace)
+        {
+            CLOG(TRACE, "SCP")
+                << "second subproblem stolen, including split=" << split;
+        }
+        return false;
+    }
+    MinQuorumEnumerator childIncludingSplit(
+        committedWithSplit, mRemaining, mScanSCC, mQic, mSearch, mThread);
+    stats.mSecondRecursionsTaken++;
     return childIncludingSplit.anyMinQuorumHasDisjointQuorum();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Implementation of MinQuorumSearch
+////////////////////////////////////////////////////////////////////////////////
+
+MinQuorumSearch::MinQuorumSearch(BitSet const& scanSCC,
+                                 QuorumIntersectionCheckerImpl const& qic,
+                                 size_t threads)
+    : mScanSCC(scanSCC), mQic(qic)
+{
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+    {
+        auto t = std::make_unique<MinQuorumSearchThread>();
+        t->mRandom.seed(static_cast<std::default_random_engine::result_type>(
+            gRandomEngine()));
+        // For the progress meter.
+        t->mStats.mTotalNodes = qic.mStats.mTotalNodes;
+        t->mStats.mNumSCCs = qic.mStats.mNumSCCs;
+        t->mStats.mScanSCCSize = qic.mStats.mScanSCCSize;
+        mThreads.emplace_back(std::move(t));
+    }
+}
+
+uint64_t
+MinQuorumSearch::defer(MinQuorumSearchThread& thread, BitSet const& committed,
+                       BitSet const& remaining)
+{
+    uint64_t id = mNextId++;
+    ++mOutstanding;
+    std::lock_guard<std::mutex> lock(thread.mQueueMutex);
+    thread.mQueue.emplace_back(MinQuorumSubproblem{committed, remaining, id});
+    return id;
+}
+
+bool
+MinQuorumSearch::reclaim(MinQuorumSearchThread& thread, uint64_t id)
+{
+    // Everything deferred after this subproblem was deferred deeper in the
+    // recursion, and has been reclaimed or stolen by now, so the subproblem is
+    // either at the back of the queue or gone.
+    std::lock_guard<std::mutex> lock(thread.mQueueMutex);
+    if (thread.mQueue.empty() || thread.mQueue.back().mId != id)
+    {
+        return false;
+    }
+    thread.mQueue.pop_back();
+    --mOutstanding;
+    return true;
+}
+
+bool
+MinQuorumSearch::takeSubproblem(size_t thread, MinQuorumSubproblem& sp)
+{
+    for (size_t i = 0; i < mThreads.size(); ++i)
+    {
+        auto& victim = *mThreads.at((thread + i) % mThreads.size());
+        std::lock_guard<std::mutex> lock(victim.mQueueMutex);
+        if (!victim.mQueue.empty())
+        {
+            sp = std::move(victim.mQueue.front());
+            victim.mQueue.pop_front();
+            if (i != 0)
+            {
+                mThreads.at(thread)->mStats.mSubproblemsStolen++;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+MinQuorumSearch::runThread(size_t thread)
+{
+    try
+    {
+        auto& self = *mThreads.at(thread);
+        while (!mStop && mOutstanding != 0)
+        {
+            if (mQic.mInterruptFlag)
+            {
+                throw QuorumIntersectionChecker::InterruptedException();
+            }
+            MinQuorumSubproblem sp;
+            if (!takeSubproblem(thread, sp))
+            {
+                // Others are busy with subproblems they haven't split yet.
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+            MinQuorumEnumerator mqe(sp.mCommitted, sp.mRemaining, mScanSCC,
+                                    mQic, *this, self);
+            mqe.anyMinQuorumHasDisjointQuorum();
+            --mOutstanding;
+        }
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(mErrorMutex);
+        if (!mError)
+        {
+            mError = std::current_exception();
+        }
+        mStop = true;
+    }
+}
+
+void
+MinQuorumSearch::noteFoundDisjointQuorums(BitSet const& nodes,
+                                          BitSet const& disj)
+{
+    if (!mFound.exchange(true))
+    {
+        mQic.noteFoundDisjointQuorums(nodes, disj);
+    }
+    mStop = true;
+}
+
+bool
+MinQuorumSearch::anyMinQuorumHasDisjointQuorum()
+{
+    defer(*mThreads.at(0), BitSet(), mScanSCC);
+
+    // The calling thread is the first search thread.
+    std::vector<std::thread> others;
+    for (size_t i = 1; i < mThreads.size(); ++i)
+    {
+        others.emplace_back([this, i]() { runThread(i); });
+    }
+    runThread(0);
+    for (auto& t : others)
+    {
+        t.join();
+    }
+
+    for (auto const& t : mThreads)
+    {
+        mQic.mStats.addSearchStats(t->mStats);
+    }
+    if (mError)
+    {
+        std::rethrow_exception(mError);
+    }
+    return mFound;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation of QuorumIntersectionChecker
 ////////////////////////////////////////////////////////////////////////////////
 
 QuorumIntersectionCheckerImpl::QuorumIntersectionCheckerImpl(
     QuorumTracker::QuorumMap const& qmap, Config const& cfg,
-    std::atomic<bool>& interruptFlag, bool quiet)
+    std::atomic<bool>& interruptFlag, bool quiet,
+    std::shared_ptr<SCCCache> cache)
     : mCfg(cfg)
     , mLogTrace(Logging::logTrace("SCP"))
     , mQuiet(quiet)
+    , mCache(cache)
     , mTSC(mGraph)
     , mInterruptFlag(interruptFlag)
 {
@@ -364,7 +543,7 @@ QuorumIntersectionCheckerImpl::getMaxQuorumsFound() const
 }
 
 void
-QuorumIntersectionCheckerImpl::Stats::log() const
+QuorumIntersectionStats::log() const
 {
     CLOG(DEBUG, "SCP") << "Quorum intersection checker stats:";
     size_t exits = (mEarlyExit1s + mEarlyExit21s + mEarlyExit22s +
@@ -374,8 +553,9 @@ QuorumIntersectionCheckerImpl::Stats::log() const
                        << ", MaxQs:" << mMaxQuorumsSeen
                        << ", MinQs:" << mMinQuorumsSeen
                        << ", Calls:" << mCallsStarted
+                       << ", Stolen:" << mSubproblemsStolen
                        << ", Terms:" << mTerminations << ", Exits:" << exits
-                       << "]";
+                       << ", CachedSCCs:" << mCachedSCCs << "]";
     CLOG(DEBUG, "SCP") << "Detailed exit stats:";
     CLOG(DEBUG, "SCP") << "[X1:" << mEarlyExit1s << ", X2.1:" << mEarlyExit21s
                        << ", X2.2:" << mEarlyExit22s
@@ -383,6 +563,23 @@ QuorumIntersectionCheckerImpl::Stats::log() const
                        << ", X3.2:" << mEarlyExit32s << "]";
 }
 
+void
+QuorumIntersectionStats::addSearchStats(QuorumIntersectionStats const& other)
+{
+    mCallsStarted += other.mCallsStarted;
+    mFirstRecursionsTaken += other.mFirstRecursionsTaken;
+    mSecondRecursionsTaken += other.mSecondRecursionsTaken;
+    mSubproblemsStolen += other.mSubproblemsStolen;
+    mMaxQuorumsSeen += other.mMaxQuorumsSeen;
+    mMinQuorumsSeen += other.mMinQuorumsSeen;
+    mTerminations += other.mTerminations;
+    mEarlyExit1s += other.mEarlyExit1s;
+    mEarlyExit21s += other.mEarlyExit21s;
+    mEarlyExit22s += other.mEarlyExit22s;
+    mEarlyExit31s += other.mEarlyExit31s;
+    mEarlyExit32s += other.mEarlyExit32s;
+}
+
 // This function is the innermost call in the checker and must be as fast
 // as possible. We spend almost all of our time in here.
 bool
@@ -462,13 +659,21 @@ QuorumIntersectionCheckerImpl::containsQuorumSliceForNode(BitSet const& bs,
 }
 
 bool
-QuorumIntersectionCheckerImpl::isAQuorum(BitSet const& nodes) const
+QuorumIntersectionCheckerImpl::isAQuorum(BitSet const& nodes,
+                                         QuorumIntersectionStats& stats) const
 {
-    return (bool)contractToMaximalQuorum(nodes);
+    return (bool)contractToMaximalQuorum(nodes, stats);
 }
 
 BitSet
 QuorumIntersectionCheckerImpl::contractToMaximalQuorum(BitSet nodes) const
+{
+    return contractToMaximalQuorum(nodes, mStats);
+}
+
+BitSet
+QuorumIntersectionCheckerImpl::contractToMaximalQuorum(
+    BitSet nodes, QuorumIntersectionStats& stats) const
 {
     // Find greatest fixpoint of f(X) = {n ∈ X | containsQuorumSliceForNode(X,
     // n)}
@@ -505,7 +710,7 @@ QuorumIntersectionCheckerImpl::contractToMaximalQuorum(BitSet nodes) const
             }
             if (filtered)
             {
-                ++mStats.mMaxQuorumsSeen;
+                ++stats.mMaxQuorumsSeen;
             }
             return filtered;
         }
@@ -514,12 +719,13 @@ QuorumIntersectionCheckerImpl::contractToMaximalQuorum(BitSet nodes) const
 }
 
 bool
-QuorumIntersectionCheckerImpl::isMinimalQuorum(BitSet const& nodes) const
+QuorumIntersectionCheckerImpl::isMinimalQuorum(
+    BitSet const& nodes, QuorumIntersectionStats& stats) const
 {
 #ifndef NDEBUG
     // We should only be called with a quorum, such that contracting to its
     // maximum doesn't do anything. This is a slightly expensive check.
-    assert(contractToMaximalQuorum(nodes) == nodes);
+    assert(contractToMaximalQuorum(nodes, stats) == nodes);
 #endif
 
     BitSet minQ = nodes;
@@ -531,7 +737,7 @@ QuorumIntersectionCheckerImpl::isMinimalQuorum(BitSet const& nodes) const
     for (size_t i = 0; nodes.nextSet(i); ++i)
     {
         minQ.unset(i);
-        if (isAQuorum(minQ))
+        if (isAQuorum(minQ, stats))
         {
             // There's a subquorum with i removed: nodes isn't a minq.
             return false;
@@ -541,7 +747,7 @@ QuorumIntersectionCheckerImpl::isMinimalQuorum(BitSet const& nodes) const
     }
     // Tried every possible one-node-less subset, found no subquorums: this one
     // is minimal.
-    mStats.mMinQuorumsSeen++;
+    stats.mMinQuorumsSeen++;
     return true;
 }
 
@@ -576,10 +782,11 @@ QuorumIntersectionCheckerImpl::noteFoundDisjointQuorums(
 bool
 MinQuorumEnumerator::hasDisjointQuorum(BitSet const& nodes) const
 {
-    BitSet disj = mQic.contractToMaximalQuorum(mScanSCC - nodes);
+    BitSet disj =
+        mQic.contractToMaximalQuorum(mScanSCC - nodes, mThread.mStats);
     if (disj)
     {
-        mQic.noteFoundDisjointQuorums(nodes, disj);
+        mSearch.noteFoundDisjointQuorums(nodes, disj);
     }
     else
     {
@@ -649,6 +856,7 @@ QuorumIntersectionCheckerImpl::buildGraph(QuorumTracker::QuorumMap const& qmap)
     mPubKeyBitNums.clear();
     mBitNumPubKeys.clear();
     mGraph.clear();
+    mQSetHashes.clear();
 
     for (auto const& pair : qmap)
     {
@@ -676,6 +884,11 @@ QuorumIntersectionCheckerImpl::buildGraph(QuorumTracker::QuorumMap const& qmap)
             auto qb = convertSCPQuorumSet(*(pair.second.mQuorumSet));
             qb.log();
             mGraph.emplace_back(qb);
+            if (mCache)
+            {
+                mQSetHashes.emplace_back(
+                    xdrSha256(*(pair.second.mQuorumSet)));
+            }
         }
     }
     mStats.mTotalNodes = mPubKeyBitNums.size();
@@ -688,6 +901,43 @@ QuorumIntersectionCheckerImpl::buildSCCs()
     mStats.mNumSCCs = mTSC.mSCCs.size();
 }
 
+Hash
+QuorumIntersectionCheckerImpl::getSCCKey(BitSet const& scc) const
+{
+    // Bit numbers depend on the order of the quorum map, so key by public key.
+    std::map<PublicKey, size_t> nodes;
+    for (size_t i = 0; scc.nextSet(i); ++i)
+    {
+        nodes.emplace(mBitNumPubKeys.at(i), i);
+    }
+    SHA256 hasher;
+    for (auto const& pair : nodes)
+    {
+        hasher.add(xdr::xdr_to_opaque(pair.first));
+        hasher.add(mQSetHashes.at(pair.second));
+    }
+    return hasher.finish();
+}
+
+bool
+QuorumIntersectionCheckerImpl::sccHasQuorum(BitSet const& scc) const
+{
+    if (!mCache)
+    {
+        return (bool)contractToMaximalQuorum(scc);
+    }
+    SCCCache::Result result;
+    Hash key = getSCCKey(scc);
+    if (mCache->get(key, result))
+    {
+        mStats.mCachedSCCs++;
+        return result.mHasQuorum;
+    }
+    result.mHasQuorum = (bool)contractToMaximalQuorum(scc);
+    mCache->put(key, result);
+    return result.mHasQuorum;
+}
+
 std::string
 QuorumIntersectionCheckerImpl::nodeName(size_t node) const
 {
@@ -712,7 +962,7 @@ QuorumIntersectionCheckerImpl::networkEnjoysQuorumIntersection() const
     BitSet scanSCC;
     for (auto const& scc : mTSC.mSCCs)
     {
-        if (auto q = contractToMaximalQuorum(scc))
+        if (sccHasQuorum(scc))
         {
             if (scanSCC.empty())
             {
@@ -721,7 +971,6 @@ QuorumIntersectionCheckerImpl::networkEnjoysQuorumIntersection() const
                 scanSCC = scc;
                 mStats.mScanSCCSize = scanSCC.count();
                 CLOG(DEBUG, "SCP") << "Found scan SCC: " << scc;
-                CLOG(DEBUG, "SCP") << "Containing quorum: " << q;
                 for (size_t i = 0; scanSCC.nextSet(i); ++i)
                 {
                     CLOG(DEBUG, "SCP") << "SCC node to scan: " << nodeName(i);
@@ -729,6 +978,7 @@ QuorumIntersectionCheckerImpl::networkEnjoysQuorumIntersection() const
             }
             else
             {
+                auto q = contractToMaximalQuorum(scc);
                 CLOG(DEBUG, "SCP") << "Found extra SCC: " << scc;
                 CLOG(DEBUG, "SCP") << "Containing quorum: " << q;
                 noteFoundDisjointQuorums(contractToMaximalQuorum(scanSCC), q);
@@ -760,13 +1010,58 @@ QuorumIntersectionCheckerImpl::networkEnjoysQuorumIntersection() const
     }
 
     // Second stage: scan the scan-SCC powerset, potentially expensive.
+    // If the scan-SCC is unchanged since an earlier check, so is the outcome.
     if (!foundDisjoint)
     {
-        BitSet committed;
-        BitSet remaining = scanSCC;
-        MinQuorumEnumerator mqe(committed, remaining, scanSCC, *this);
-        foundDisjoint = mqe.anyMinQuorumHasDisjointQuorum();
-        mStats.log();
+        SCCCache::Result result;
+        Hash key;
+        if (mCache)
+        {
+            key = getSCCKey(scanSCC);
+            mCache->get(key, result);
+        }
+        if (result.mScanned)
+        {
+            CLOG(DEBUG, "SCP") << "Reusing earlier scan of unchanged SCC";
+            foundDisjoint = !result.mEnjoysQuorumIntersection;
+            if (foundDisjoint)
+            {
+                mPotentialSplit = result.mPotentialSplit;
+                if (!mQuiet)
+                {
+                    std::ostringstream err;
+                    err << "Found potential disjoint quorums (unchanged): ";
+                    for (auto const& k : mPotentialSplit.first)
+                    {
+                        err << mCfg.toShortString(k) << ' ';
+                    }
+                    err << "vs.";
+                    for (auto const& k : mPotentialSplit.second)
+                    {
+                        err << ' ' << mCfg.toShortString(k);
+                    }
+                    CLOG(ERROR, "SCP") << err.str();
+                }
+            }
+        }
+        else
+        {
+            MinQuorumSearch search(scanSCC, *this,
+                                   mCfg.QUORUM_INTERSECTION_CHECKER_THREADS);
+            foundDisjoint = search.anyMinQuorumHasDisjointQuorum();
+            mStats.log();
+            if (mCache)
+            {
+                result.mHasQuorum = true;
+                result.mScanned = true;
+                result.mEnjoysQuorumIntersection = !foundDisjoint;
+                if (foundDisjoint)
+                {
+                    result.mPotentialSplit = mPotentialSplit;
+                }
+                mCache->put(key, result);
+            }
+        }
     }
     return !foundDisjoint;
 }
@@ -843,19 +1138,63 @@ groupString(Config const& cfg, std::set<PublicKey> const& group)
 
 namespace diamnet
 {
+void
+QuorumIntersectionChecker::SCCCache::startRun()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mPrevious = std::move(mCurrent);
+    mCurrent.clear();
+}
+
+bool
+QuorumIntersectionChecker::SCCCache::get(Hash const& key, Result& result)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto i = mCurrent.find(key);
+    if (i != mCurrent.end())
+    {
+        result = i->second;
+        return true;
+    }
+    i = mPrevious.find(key);
+    if (i != mPrevious.end())
+    {
+        result = i->second;
+        mCurrent.emplace(key, result);
+        return true;
+    }
+    return false;
+}
+
+void
+QuorumIntersectionChecker::SCCCache::put(Hash const& key,
+                                         Result const& result)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCurrent[key] = result;
+}
+
+size_t
+QuorumIntersectionChecker::SCCCache::size()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mCurrent.size();
+}
+
 std::shared_ptr<QuorumIntersectionChecker>
 QuorumIntersectionChecker::create(QuorumTracker::QuorumMap const& qmap,
                                   Config const& cfg,
-                                  std::atomic<bool>& interruptFlag, bool quiet)
+                                  std::atomic<bool>& interruptFlag, bool quiet,
+                                  std::shared_ptr<SCCCache> cache)
 {
     return std::make_shared<QuorumIntersectionCheckerImpl>(
-        qmap, cfg, interruptFlag, quiet);
+        qmap, cfg, interruptFlag, quiet, cache);
 }
 
 std::set<std::set<PublicKey>>
 QuorumIntersectionChecker::getIntersectionCriticalGroups(
     diamnet::QuorumTracker::QuorumMap const& qmap, diamnet::Config const& cfg,
-    std::atomic<bool>& interruptFlag)
+    std::atomic<bool>& interruptFlag, std::shared_ptr<SCCCache> cache)
 {
     // We're going to search for "intersection-critical" groups, by considering
     // each SCPQuorumSet S that (a) has no innerSets of its own and (b) occurs
@@ -943,7 +1282,7 @@ QuorumIntersectionChecker::getIntersectionCriticalGroups(
         // Check to see if this modified config is vulnerable to splitting.
         auto checker =
             QuorumIntersectionChecker::create(test_qmap, cfg, interruptFlag,
-                                              /*quiet=*/true);
+                                              /*quiet=*/true, cache);
         if (checker->networkEnjoysQuorumIntersection())
         {
             CLOG(DEBUG, "SCP") << "group is not intersection-critical: "
@@ -336,6 +336,16 @@
 //        that has quorums in it, rather than the powerset of all the nodes in
 //        the graph. This typically excludes lots of nodes.
 //
+// It also means that both the question of whether an SCC has quorums and the
+// outcome of the enumeration of its powerset depend only on the nodes of the
+// SCC and their qsets: everything the search looks at is a subset of the
+// SCC, and nodes outside a set don't count towards any threshold, whether
+// they're in another SCC or not in the graph at all. So the results for an
+// SCC can be cached, keyed by its nodes and their qsets, and reused by a
+// later check of a quorum map that changed only in other SCCs -- which is
+// the usual case, when some node at the edge of the network changes its
+// qset or a validator rotates its key.
+//
 //
 // Coda: micro-optimizations
 // =========================
@@ -347,6 +357,22 @@
 // elsewhere in diamnet-core so there's a little work up front converting
 // representations.
 //
+//
+// Coda: parallelism
+// =================
+//
+// The two recursive calls of the enumeration are independent of each other,
+// so the search tree can be explored by several threads at once. Each thread
+// works depth-first on its own branch of the tree and, at every split, puts
+// the second subproblem on its own queue before descending into the first.
+// If the thread gets back to that subproblem before anyone else took it, it
+// simply carries on with it as the sequential recursion would; meanwhile,
+// threads that have run out of work steal the oldest -- that is, closest to
+// the root and so likely largest -- subproblems from the other threads'
+// queues. Finding one pair of disjoint quorums anywhere ends the search for
+// all threads. Besides the queues and that flag, the threads share nothing
+// but the (read-only) graph: each has its own stats and scratch space.
+//
 // Remaining details of the implementation are noted as we go, but the above
 // explanation ought to give you a good idea what you're looking at.
 
@@ -356,6 +382,11 @@
 #include "xdr/Diamnet-SCP.h"
 #include "xdr/Diamnet-types.h"
 
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <random>
+
 namespace
 {
 
@@ -411,6 +442,58 @@ struct TarjanSCCCalculator
     void scc(size_t i);
 };
 
+struct QuorumIntersectionStats
+{
+    size_t mTotalNodes = {0};
+    size_t mNumSCCs = {0};
+    size_t mScanSCCSize = {0};
+    size_t mCallsStarted = {0};
+    size_t mFirstRecursionsTaken = {0};
+    size_t mSecondRecursionsTaken = {0};
+    size_t mSubproblemsStolen = {0};
+    size_t mMaxQuorumsSeen = {0};
+    size_t mMinQuorumsSeen = {0};
+    size_t mTerminations = {0};
+    size_t mEarlyExit1s = {0};
+    size_t mEarlyExit21s = {0};
+    size_t mEarlyExit22s = {0};
+    size_t mEarlyExit31s = {0};
+    size_t mEarlyExit32s = {0};
+    size_t mCachedSCCs = {0};
+    void log() const;
+
+    // Adds in the search counters of a single search thread.
+    void addSearchStats(QuorumIntersectionStats const& other);
+};
+
+// A subproblem of the search: the arguments of one MinQuorumEnumerator.
+struct MinQuorumSubproblem
+{
+    BitSet mCommitted;
+    BitSet mRemaining;
+    uint64_t mId;
+};
+
+// State owned by a single thread of a MinQuorumSearch.
+struct MinQuorumSearchThread
+{
+    QuorumIntersectionStats mStats;
+
+    // A temporary structure that's reused very often within the
+    // MinQuorumEnumerators of this thread, but never reentrantly, so we
+    // allocate it once here to avoid hammering on malloc.
+    std::vector<size_t> mInDegrees;
+
+    std::default_random_engine mRandom;
+
+    // Subproblems this thread has deferred: it takes them back from the back,
+    // other threads steal them from the front.
+    std::mutex mQueueMutex;
+    std::deque<MinQuorumSubproblem> mQueue;
+};
+
+class MinQuorumSearch;
+
 // A MinQuorumEnumerator is responsible to scanning the powerset of the SCC
 // we're considering, in a recursive bottom-up order, with a lot of early exits
 // described above. Each instance of MinQuorumEnumerator represents one call in
@@ -440,9 +523,13 @@ class MinQuorumEnumerator
     // the overall SCC we're considering subsets of.
     BitSet const& mScanSCC;
 
-    // Checker that owns us, contains state of stats, graph, etc.
+    // Checker that owns us, contains the graph, etc.
     QuorumIntersectionCheckerImpl const& mQic;
 
+    // Search we're part of, and the thread of it we're running on.
+    MinQuorumSearch& mSearch;
+    MinQuorumSearchThread& mThread;
+
     // Select the next node in mRemaining to split recursive cases between.
     size_t pickSplitNode() const;
 
@@ -452,12 +539,64 @@ class MinQuorumEnumerator
   public:
     MinQuorumEnumerator(BitSet const& committed, BitSet const& remaining,
                         BitSet const& scanSCC,
-                        QuorumIntersectionCheckerImpl const& qic);
+                        QuorumIntersectionCheckerImpl const& qic,
+                        MinQuorumSearch& search, MinQuorumSearchThread& thread);
 
     bool hasDisjointQuorum(BitSet const& nodes) const;
     bool anyMinQuorumHasDisjointQuorum();
 };
 
+// A MinQuorumSearch runs the MinQuorumEnumerators for a scan SCC on a number
+// of threads, which share subproblems by work-stealing as described above.
+class MinQuorumSearch
+{
+    BitSet const& mScanSCC;
+    QuorumIntersectionCheckerImpl const& mQic;
+    std::vector<std::unique_ptr<MinQuorumSearchThread>> mThreads;
+
+    // Subproblems deferred or in progress on their own; the search is over
+    // when there are none left.
+    std::atomic<size_t> mOutstanding{0};
+    std::atomic<uint64_t> mNextId{0};
+
+    // Set when a disjoint quorum is found or a thread fails, to stop all the
+    // threads.
+    std::atomic<bool> mStop{false};
+    std::atomic<bool> mFound{false};
+    std::mutex mErrorMutex;
+    std::exception_ptr mError;
+
+    bool takeSubproblem(size_t thread, MinQuorumSubproblem& sp);
+    void runThread(size_t thread);
+
+  public:
+    MinQuorumSearch(BitSet const& scanSCC,
+                    QuorumIntersectionCheckerImpl const& qic, size_t threads);
+
+    // Runs the search to completion, returning true if some min-quorum has a
+    // disjoint quorum, after adding the threads' stats to the checker's.
+    // Rethrows any exception (such as InterruptedException) of a thread.
+    bool anyMinQuorumHasDisjointQuorum();
+
+    bool
+    stopped() const
+    {
+        return mStop;
+    }
+
+    // Records the first pair of disjoint quorums found, and stops the search.
+    void noteFoundDisjointQuorums(BitSet const& nodes, BitSet const& disj);
+
+    // Puts a subproblem on the thread's queue, returning an id to reclaim it
+    // by.
+    uint64_t defer(MinQuorumSearchThread& thread, BitSet const& committed,
+                   BitSet const& remaining);
+
+    // Takes a deferred subproblem back off the thread's queue, returning false
+    // if another thread has stolen it (and so is responsible for it).
+    bool reclaim(MinQuorumSearchThread& thread, uint64_t id);
+};
+
 // Quorum intersection checking is done by establishing a root
 // QuorumIntersectionChecker on a given QuorumMap. The QuorumIntersectionChecker
 // builds a QGraph of the nodes, uses TarjanSCCCalculator to calculate its SCCs,
@@ -467,29 +606,11 @@ class QuorumIntersectionCheckerImpl : public diamnet::QuorumIntersectionChecker
 
     diamnet::Config const& mCfg;
 
-    struct Stats
-    {
-        size_t mTotalNodes = {0};
-        size_t mNumSCCs = {0};
-        size_t mScanSCCSize = {0};
-        size_t mCallsStarted = {0};
-        size_t mFirstRecursionsTaken = {0};
-        size_t mSecondRecursionsTaken = {0};
-        size_t mMaxQuorumsSeen = {0};
-        size_t mMinQuorumsSeen = {0};
-        size_t mTerminations = {0};
-        size_t mEarlyExit1s = {0};
-        size_t mEarlyExit21s = {0};
-        size_t mEarlyExit22s = {0};
-        size_t mEarlyExit31s = {0};
-        size_t mEarlyExit32s = {0};
-        void log() const;
-    };
-
     // We use our own stats and a local cached flag to control tracing because
     // using the global metrics and log-partition lookups at a fine grain
-    // actually becomes problematic CPU-wise.
-    mutable Stats mStats;
+    // actually becomes problematic CPU-wise. The search threads each count in
+    // their own stats, which are added in here when the search is done.
+    mutable QuorumIntersectionStats mStats;
     bool mLogTrace;
 
     // When run as a subroutine of criticality-checking, we inhibit
@@ -508,11 +629,11 @@ class QuorumIntersectionCheckerImpl : public diamnet::QuorumIntersectionChecker
     std::unordered_map<diamnet::PublicKey, size_t> mPubKeyBitNums;
     QGraph mGraph;
 
-    // This is a temporary structure that's reused very often within the
-    // MinQuorumEnumerators, but never reentrantly / simultaneously. So we
-    // allocate it once here and let the MQEs use it to avoid hammering
-    // on malloc.
-    mutable std::vector<size_t> mInDegrees;
+    // Results of earlier checks, if any, and the hash of the qset of each
+    // graph node, which together with the node's key identifies what the
+    // results for an SCC depend on.
+    std::shared_ptr<SCCCache> mCache;
+    std::vector<diamnet::Hash> mQSetHashes;
 
     // This just calculates SCCs, from which we extract the first one found with
     // a quorum, which (assuming no other SCCs have quorums) we'll use for the
@@ -526,23 +647,30 @@ class QuorumIntersectionCheckerImpl : public diamnet::QuorumIntersectionChecker
     QBitSet convertSCPQuorumSet(diamnet::SCPQuorumSet const& sqs);
     void buildGraph(diamnet::QuorumTracker::QuorumMap const& qmap);
     void buildSCCs();
+    diamnet::Hash getSCCKey(BitSet const& scc) const;
+    bool sccHasQuorum(BitSet const& scc) const;
 
     bool containsQuorumSlice(BitSet const& bs, QBitSet const& qbs) const;
     bool containsQuorumSliceForNode(BitSet const& bs, size_t node) const;
+    BitSet contractToMaximalQuorum(BitSet nodes,
+                                   QuorumIntersectionStats& stats) const;
     BitSet contractToMaximalQuorum(BitSet nodes) const;
-    bool isAQuorum(BitSet const& nodes) const;
-    bool isMinimalQuorum(BitSet const& nodes) const;
+    bool isAQuorum(BitSet const& nodes, QuorumIntersectionStats& stats) const;
+    bool isMinimalQuorum(BitSet const& nodes,
+                         QuorumIntersectionStats& stats) const;
     void noteFoundDisjointQuorums(BitSet const& nodes,
                                   BitSet const& disj) const;
     std::string nodeName(size_t node) const;
 
     friend class MinQuorumEnumerator;
+    friend class MinQuorumSearch;
 
   public:
     QuorumIntersectionCheckerImpl(diamnet::QuorumTracker::QuorumMap const& qmap,
                                   diamnet::Config const& cfg,
                                   std::atomic<bool>& interruptFlag,
-                                  bool quiet = false);
+                                  bool quiet = false,
+                                  std::shared_ptr<SCCCache> cache = nullptr);
     bool networkEnjoysQuorumIntersection() const override;
 
     std::pair<std::vector<diamnet::PublicKey>, std::vector<diamnet::PublicKey>>
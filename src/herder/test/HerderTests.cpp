@@ -1289,6 +1289,63 @@ testSCPDriver(uint32 protocolVersion, uint32_t maxTxSize, size_t expectedOps,
         REQUIRE(sv.txSetHash == txSetL2->getContentsHash());
     }
 
+    SECTION("verify envelope signatures in batches")
+    {
+        auto& herder = static_cast<HerderImpl&>(app->getHerder());
+        auto& validSig = app->getMetrics().NewMeter(
+            {"scp", "envelope", "validsig"}, "envelope");
+        auto& invalidSig = app->getMetrics().NewMeter(
+            {"scp", "envelope", "invalidsig"}, "envelope");
+        auto& duplicate = app->getMetrics().NewMeter(
+            {"scp", "envelope", "duplicate"}, "envelope");
+        auto valid0 = validSig.count();
+        auto invalid0 = invalidSig.count();
+        auto duplicate0 = duplicate.count();
+
+        TxSetFramePtr txSet0 = makeTransactions(lcl.hash, 0, 1, 100);
+        auto p = makeTxPair(herder, txSet0, app->timeNow() + 1, true);
+        auto good = makeEnvelope(herder, p, {},
+                                 herder.getCurrentLedgerSeq() + 1, true);
+        auto bad = good;
+        bad.signature.back() ^= 1;
+
+        std::vector<Herder::EnvelopeStatus> goodRes, badRes;
+        auto recv = [&](SCPEnvelope const& e,
+                        std::vector<Herder::EnvelopeStatus>& res) {
+            herder.recvUnverifiedSCPEnvelope(
+                e, [&res](Herder::EnvelopeStatus s) { res.emplace_back(s); });
+        };
+        for (int i = 0; i < 3; ++i)
+        {
+            recv(good, goodRes);
+            recv(bad, badRes);
+        }
+        // nothing is received before its signature is verified
+        REQUIRE(goodRes.empty());
+        REQUIRE(badRes.empty());
+
+        while (goodRes.size() < 3 || badRes.size() < 3)
+        {
+            clock.crank(true);
+        }
+        REQUIRE(goodRes == std::vector<Herder::EnvelopeStatus>(
+                               3, Herder::ENVELOPE_STATUS_FETCHING));
+        REQUIRE(badRes == std::vector<Herder::EnvelopeStatus>(
+                              3, Herder::ENVELOPE_STATUS_DISCARDED));
+        REQUIRE(validSig.count() == valid0 + 1);
+        REQUIRE(invalidSig.count() == invalid0 + 1);
+        REQUIRE(duplicate.count() == duplicate0 + 4);
+
+        // once verified, a copy is checked again and found already received
+        recv(good, goodRes);
+        while (goodRes.size() < 4)
+        {
+            clock.crank(true);
+        }
+        REQUIRE(goodRes.back() == Herder::ENVELOPE_STATUS_FETCHING);
+        REQUIRE(validSig.count() == valid0 + 2);
+    }
+
     SECTION("validateValue signatures")
     {
         auto& herder = static_cast<HerderImpl&>(app->getHerder());
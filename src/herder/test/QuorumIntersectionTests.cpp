@@ -782,6 +782,82 @@ TEST_CASE("quorum intersection 6-org 3-node fully-connected",
     REQUIRE(qic->networkEnjoysQuorumIntersection());
 }
 
+TEST_CASE("quorum intersection search threads",
+          "[herder][quorumintersection]")
+{
+    // Two triangles of orgs joined by a single pair of orgs: one SCC, but
+    // each triangle's outer pair of orgs is a quorum by itself.
+    auto orgs = generateOrgs(6, {3});
+    auto split = interconnectOrgsBidir(
+        orgs, {{0, 1}, {0, 2}, {1, 2}, {2, 3}, {3, 4}, {3, 5}, {4, 5}});
+    auto full =
+        interconnectOrgs(orgs, [](size_t i, size_t j) { return true; });
+    Config cfg(getTestConfig());
+    cfg = configureShortNames(cfg, orgs);
+    std::atomic<bool> flag{false};
+
+    for (int threads : {1, 2, 8})
+    {
+        cfg.QUORUM_INTERSECTION_CHECKER_THREADS = threads;
+        auto qic = QuorumIntersectionChecker::create(full, cfg, flag);
+        REQUIRE(qic->networkEnjoysQuorumIntersection());
+        REQUIRE(qic->getMaxQuorumsFound() != 0);
+
+        qic = QuorumIntersectionChecker::create(split, cfg, flag);
+        REQUIRE(!qic->networkEnjoysQuorumIntersection());
+        auto potentialSplit = qic->getPotentialSplit();
+        REQUIRE(!potentialSplit.first.empty());
+        REQUIRE(!potentialSplit.second.empty());
+    }
+}
+
+TEST_CASE("quorum intersection reuses results of unchanged SCCs",
+          "[herder][quorumintersection]")
+{
+    auto orgs = generateOrgs(6, {3});
+    auto qm = interconnectOrgs(orgs, [](size_t i, size_t j) { return true; });
+    Config cfg(getTestConfig());
+    cfg = configureShortNames(cfg, orgs);
+    std::atomic<bool> flag{false};
+    auto cache = std::make_shared<QuorumIntersectionChecker::SCCCache>();
+
+    // A node watching the network, outside of its only SCC with quorums.
+    PublicKey watcher = SecretKey::pseudoRandomForTesting().getPublicKey();
+    qm[watcher] = QuorumTracker::NodeInfo{
+        make_shared<QS>(1, VK({orgs.at(0).at(0)}), VQ{}), 0};
+
+    cache->startRun();
+    auto qic = QuorumIntersectionChecker::create(qm, cfg, flag, false, cache);
+    REQUIRE(qic->networkEnjoysQuorumIntersection());
+    REQUIRE(qic->getMaxQuorumsFound() != 0);
+
+    // Changing the watcher's qset leaves the scan SCC as it was.
+    qm[watcher] = QuorumTracker::NodeInfo{
+        make_shared<QS>(1, VK({orgs.at(1).at(0)}), VQ{}), 0};
+    cache->startRun();
+    qic = QuorumIntersectionChecker::create(qm, cfg, flag, false, cache);
+    REQUIRE(qic->networkEnjoysQuorumIntersection());
+    REQUIRE(qic->getMaxQuorumsFound() == 0);
+
+    // Splitting the network changes the scan SCC, which is scanned anew, and
+    // the potential split is remembered along with the result.
+    auto split = interconnectOrgsBidir(
+        orgs, {{0, 1}, {0, 2}, {1, 2}, {2, 3}, {3, 4}, {3, 5}, {4, 5}});
+    split[watcher] = qm[watcher];
+    for (size_t i = 0; i < 2; ++i)
+    {
+        cache->startRun();
+        qic = QuorumIntersectionChecker::create(split, cfg, flag, false, cache);
+        REQUIRE(!qic->networkEnjoysQuorumIntersection());
+        REQUIRE((qic->getMaxQuorumsFound() != 0) == (i == 0));
+        REQUIRE(!qic->getPotentialSplit().first.empty());
+        REQUIRE(!qic->getPotentialSplit().second.empty());
+    }
+
+    // Results not used by the last run are dropped.
+    REQUIRE(cache->size() == 2);
+}
+
 TEST_CASE("quorum intersection scaling test",
           "[herder][quorumintersectionbench][!hide]")
 {
@@ -13,6 +13,7 @@
 #include "crypto/Hex.h"
 #include "crypto/SHA.h"
 #include "history/HistoryManager.h"
+#include "history/HistoryTransport.h"
 #include "main/Application.h"
 #include "main/DiamnetCoreVersion.h"
 #include "process/ProcessManager.h"
@@ -24,6 +25,7 @@
 #include <cereal/archives/json.hpp>
 #include <cereal/cereal.hpp>
 #include <cereal/types/vector.hpp>
+#include <algorithm>
 #include <chrono>
 #include <fstream>
 #include <future>
@@ -398,6 +400,16 @@ HistoryArchive::HistoryArchive(Application& app,
     , mFailureMeter(app.getMetrics().NewMeter(
           {"history-archive", config.mName, "failure"}, "event"))
 {
+    if (!mConfig.mURL.empty())
+    {
+        mTransport = HistoryTransport::create(app, mConfig.mURL);
+        if (!mTransport)
+        {
+            CLOG(WARNING, "History")
+                << "Archive '" << mConfig.mName << "' url " << mConfig.mURL
+                << " has no in-process transport, using its commands";
+        }
+    }
 }
 
 HistoryArchive::~HistoryArchive()
@@ -422,6 +434,24 @@ HistoryArchive::hasMkdirCmd() const
     return !mConfig.mMkdirCmd.empty();
 }
 
+bool
+HistoryArchive::canGet() const
+{
+    return hasGetCmd() || mTransport;
+}
+
+bool
+HistoryArchive::canPut() const
+{
+    return hasPutCmd() || (mTransport && mTransport->canPut());
+}
+
+std::shared_ptr<HistoryTransport>
+HistoryArchive::getTransport() const
+{
+    return mTransport;
+}
+
 std::string const&
 HistoryArchive::getName() const
 {
@@ -477,4 +507,148 @@ HistoryArchive::getFailureCount() const
 {
     return mFailureMeter.count();
 }
+
+// The buckets an archive holding the state is guaranteed to have, as in
+// HistoryArchiveState::differingBuckets: of each level, curr, snap and the
+// output of a resolved merge. The empty bucket is never uploaded.
+static std::vector<std::string>
+publishedBuckets(HistoryArchiveState const& state)
+{
+    std::vector<std::string> ret;
+    uint256 zero;
+    auto zeroHex = binToHex(zero);
+    for (auto const& level : state.currentBuckets)
+    {
+        std::vector<std::string> bs{level.curr, level.snap};
+        if (level.next.hasOutputHash())
+        {
+            bs.emplace_back(level.next.getOutputHash());
+        }
+        for (auto const& b : bs)
+        {
+            if (b != zeroHex)
+            {
+                ret.emplace_back(b);
+            }
+        }
+    }
+    return ret;
+}
+
+bool
+HistoryArchive::knowsUploadedBuckets() const
+{
+    return mUploadedBucketsKnown;
+}
+
+void
+HistoryArchive::seedUploadedBuckets(HistoryArchiveState const& remote)
+{
+    for (auto const& b : publishedBuckets(remote))
+    {
+        auto& bucket = mUploadedBuckets[b];
+        bucket.mLedger = std::max(bucket.mLedger, remote.currentLedger);
+        bucket.mUploaded = true;
+    }
+    mUploadedBucketsKnown = true;
+}
+
+std::vector<std::string>
+HistoryArchive::claimBucketsToUpload(HistoryArchiveState const& state)
+{
+    ZoneScoped;
+    assert(mUploadedBucketsKnown);
+    std::vector<std::string> ret;
+    for (auto const& b : publishedBuckets(state))
+    {
+        auto res = mUploadedBuckets.emplace(
+            b, UploadedBucket{state.currentLedger, false});
+        if (res.second)
+        {
+            ret.emplace_back(b);
+        }
+        else
+        {
+            res.first->second.mLedger =
+                std::max(res.first->second.mLedger, state.currentLedger);
+        }
+    }
+    return ret;
+}
+
+void
+HistoryArchive::markBucketsUploaded(std::vector<std::string> const& hashes)
+{
+    for (auto const& b : hashes)
+    {
+        auto it = mUploadedBuckets.find(b);
+        if (it != mUploadedBuckets.end())
+        {
+            it->second.mUploaded = true;
+        }
+    }
+}
+
+void
+HistoryArchive::releaseBuckets(std::vector<std::string> const& hashes)
+{
+    for (auto const& b : hashes)
+    {
+        auto it = mUploadedBuckets.find(b);
+        if (it != mUploadedBuckets.end() && !it->second.mUploaded)
+        {
+            mUploadedBuckets.erase(it);
+        }
+    }
+}
+
+bool
+HistoryArchive::hasClaimedBuckets(HistoryArchiveState const& state) const
+{
+    for (auto const& b : publishedBuckets(state))
+    {
+        if (mUploadedBuckets.find(b) == mUploadedBuckets.end())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+HistoryArchive::hasUploadedBuckets(HistoryArchiveState const& state) const
+{
+    for (auto const& b : publishedBuckets(state))
+    {
+        auto it = mUploadedBuckets.find(b);
+        if (it == mUploadedBuckets.end() || !it->second.mUploaded)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+HistoryArchive::pruneUploadedBuckets(HistoryArchiveState const& published)
+{
+    ZoneScoped;
+    for (auto const& b : publishedBuckets(published))
+    {
+        auto& bucket = mUploadedBuckets[b];
+        bucket.mLedger = std::max(bucket.mLedger, published.currentLedger);
+        bucket.mUploaded = true;
+    }
+    for (auto it = mUploadedBuckets.begin(); it != mUploadedBuckets.end();)
+    {
+        if (it->second.mLedger < published.currentLedger)
+        {
+            it = mUploadedBuckets.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
 }
@@ -9,6 +9,7 @@
 #include "xdr/Diamnet-types.h"
 
 #include <cereal/cereal.hpp>
+#include <map>
 #include <memory>
 #include <string>
 #include <system_error>
@@ -29,6 +30,7 @@ namespace diamnet
 class Application;
 class BucketList;
 class Bucket;
+class HistoryTransport;
 
 struct HistoryStateBucket
 {
@@ -160,6 +162,15 @@ class HistoryArchive : public std::enable_shared_from_this<HistoryArchive>
     bool hasMkdirCmd() const;
     std::string const& getName() const;
 
+    // True if files can be read (written) through the archive's commands or
+    // its in-process transport.
+    bool canGet() const;
+    bool canPut() const;
+
+    // In-process transport for the archive's url, or nullptr if it has none
+    // (or none supported), in which case its commands are used.
+    std::shared_ptr<HistoryTransport> getTransport() const;
+
     std::string getFileCmd(std::string const& remote,
                            std::string const& local) const;
     std::string putFileCmd(std::string const& local,
@@ -172,9 +183,55 @@ class HistoryArchive : public std::enable_shared_from_this<HistoryArchive>
     uint64_t getSuccessCount() const;
     uint64_t getFailureCount() const;
 
+    // Publishing keeps a record of the buckets this node knows the archive
+    // to have, or to be uploading to it, so it needs neither fetch the
+    // archive's state for every checkpoint nor upload a bucket twice when
+    // several checkpoints are published at once. The record is seeded from
+    // the archive's state the first time this node publishes to it.
+    bool knowsUploadedBuckets() const;
+    void seedUploadedBuckets(HistoryArchiveState const& remote);
+
+    // Returns the buckets of a state to be published that are not in the
+    // record, and records them as claimed: being uploaded by the caller.
+    std::vector<std::string>
+    claimBucketsToUpload(HistoryArchiveState const& state);
+
+    // Records claimed buckets as uploaded, once their files are in the
+    // archive.
+    void markBucketsUploaded(std::vector<std::string> const& hashes);
+
+    // Forgets buckets claimed by a publish that failed to upload them;
+    // buckets already uploaded are kept.
+    void releaseBuckets(std::vector<std::string> const& hashes);
+
+    // True if every bucket of a state is in the record (claimed or
+    // uploaded). A publish whose buckets were released by another, failed,
+    // publish must claim them again before it can complete.
+    bool hasClaimedBuckets(HistoryArchiveState const& state) const;
+
+    // True if every bucket of a state is recorded as uploaded, so the state
+    // can be written to the archive.
+    bool hasUploadedBuckets(HistoryArchiveState const& state) const;
+
+    // Once a state is published, forgets the buckets only referenced by
+    // states older than it.
+    void pruneUploadedBuckets(HistoryArchiveState const& published);
+
   private:
     HistoryArchiveConfiguration mConfig;
+    std::shared_ptr<HistoryTransport> mTransport;
     medida::Meter& mSuccessMeter;
     medida::Meter& mFailureMeter;
+
+    struct UploadedBucket
+    {
+        // most recent checkpoint whose state references the bucket
+        uint32_t mLedger{0};
+        // false while the bucket is only claimed
+        bool mUploaded{false};
+    };
+
+    bool mUploadedBucketsKnown{false};
+    std::map<std::string, UploadedBucket> mUploadedBuckets;
 };
 }
@@ -35,9 +35,9 @@ HistoryArchiveManager::checkSensibleConfig() const
 
     for (auto const& archive : mArchives)
     {
-        if (archive->hasGetCmd())
+        if (archive->canGet())
         {
-            if (archive->hasPutCmd())
+            if (archive->canPut())
             {
                 readWriteArchives.push_back(archive->getName());
             }
@@ -48,7 +48,7 @@ HistoryArchiveManager::checkSensibleConfig() const
         }
         else
         {
-            if (archive->hasPutCmd())
+            if (archive->canPut())
             {
                 writeOnlyArchives.push_back(archive->getName());
             }
@@ -65,7 +65,7 @@ HistoryArchiveManager::checkSensibleConfig() const
     {
         CLOG(FATAL, "History")
             << "Archive '" << a
-            << "' has no 'get' or 'put' command, will not function";
+            << "' has no 'get' or 'put' command or url, will not function";
         badArchives = true;
     }
 
@@ -122,7 +122,7 @@ HistoryArchiveManager::selectRandomReadableHistoryArchive() const
     std::copy_if(std::begin(mArchives), std::end(mArchives),
                  std::back_inserter(archives),
                  [](std::shared_ptr<HistoryArchive> const& x) {
-                     return x->hasGetCmd() && !x->hasPutCmd();
+                     return x->canGet() && !x->canPut();
                  });
 
     // If we have none of those, accept those with get+put
@@ -131,7 +131,7 @@ HistoryArchiveManager::selectRandomReadableHistoryArchive() const
         std::copy_if(std::begin(mArchives), std::end(mArchives),
                      std::back_inserter(archives),
                      [](std::shared_ptr<HistoryArchive> const& x) {
-                         return x->hasGetCmd();
+                         return x->canGet();
                      });
     }
 
@@ -207,7 +207,7 @@ HistoryArchiveManager::hasAnyWritableHistoryArchive() const
 {
     return std::any_of(std::begin(mArchives), std::end(mArchives),
                        [](std::shared_ptr<HistoryArchive> const& x) {
-                           return x->hasGetCmd() && x->hasPutCmd();
+                           return x->canGet() && x->canPut();
                        });
 }
 
@@ -228,7 +228,7 @@ HistoryArchiveManager::getWritableHistoryArchives() const
     std::copy_if(std::begin(mArchives), std::end(mArchives),
                  std::back_inserter(result),
                  [](std::shared_ptr<HistoryArchive> const& x) {
-                     return x->hasGetCmd() && x->hasPutCmd();
+                     return x->canGet() && x->canPut();
                  });
     return result;
 }
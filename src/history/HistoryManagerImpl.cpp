@@ -68,7 +68,6 @@ HistoryManager::create(Application& app)
 HistoryManagerImpl::HistoryManagerImpl(Application& app)
     : mApp(app)
     , mWorkDir(nullptr)
-    , mPublishWork(nullptr)
     , mPublishSuccess(
           app.getMetrics().NewMeter({"history", "publish", "success"}, "event"))
     , mPublishFailure(
@@ -99,13 +98,17 @@ void
 HistoryManagerImpl::logAndUpdatePublishStatus()
 {
     std::stringstream stateStr;
-    if (mPublishWork)
+    if (!mPublishWorks.empty())
     {
         auto qlen = publishQueueLength();
         stateStr << "Publishing " << qlen << " queued checkpoints"
                  << " [" << getMinLedgerQueuedToPublish() << "-"
                  << getMaxLedgerQueuedToPublish() << "]"
-                 << ": " << mPublishWork->getStatus();
+                 << ": " << mPublishWorks.begin()->second->getStatus();
+        if (mPublishWorks.size() > 1)
+        {
+            stateStr << " (and " << mPublishWorks.size() - 1 << " more)";
+        }
 
         auto current = stateStr.str();
         auto existing = mApp.getStatusManager().getStatusMessage(
@@ -260,7 +263,7 @@ void
 HistoryManagerImpl::takeSnapshotAndPublish(HistoryArchiveState const& has)
 {
     ZoneScoped;
-    if (mPublishWork)
+    if (mPublishWorks.find(has.currentLedger) != mPublishWorks.end())
     {
         return;
     }
@@ -291,8 +294,12 @@ HistoryManagerImpl::takeSnapshotAndPublish(HistoryArchiveState const& has)
     //
     // NB: if WorkScheduler is aborting this returns nullptr, but that
     // which means we don't "really" start publishing.
-    mPublishWork = mApp.getWorkScheduler().scheduleWork<PublishWork>(
+    auto work = mApp.getWorkScheduler().scheduleWork<PublishWork>(
         snap, seq, allBucketsFromHAS);
+    if (work)
+    {
+        mPublishWorks.emplace(ledgerSeq, work);
+    }
 }
 
 size_t
@@ -308,24 +315,49 @@ HistoryManagerImpl::publishQueuedHistory()
 #endif
 
     ZoneScoped;
-    std::string state;
+    // Publish the oldest queued checkpoints, up to MAX_CONCURRENT_PUBLISHES
+    // at once; see PutSnapshotFilesWork for how they are kept in order.
+    uint32_t maxPublishes = mApp.getConfig().MAX_CONCURRENT_PUBLISHES;
+    if (mPublishWorks.size() >= maxPublishes)
+    {
+        return 0;
+    }
 
+    uint32_t ledger;
+    std::string state;
+    std::vector<HistoryArchiveState> toPublish;
     auto prep = mApp.getDatabase().getPreparedStatement(
-        "SELECT state FROM publishqueue"
-        " ORDER BY ledger ASC LIMIT 1;");
+        "SELECT ledger, state FROM publishqueue"
+        " ORDER BY ledger ASC LIMIT :lim;");
     auto& st = prep.statement();
     soci::indicator stateIndicator;
+    st.exchange(soci::into(ledger));
     st.exchange(soci::into(state, stateIndicator));
+    st.exchange(soci::use(maxPublishes));
     st.define_and_bind();
     st.execute(true);
-    if (st.got_data() && stateIndicator == soci::indicator::i_ok)
+    while (st.got_data())
     {
-        HistoryArchiveState has;
-        has.fromString(state);
+        if (stateIndicator == soci::indicator::i_ok &&
+            mPublishWorks.find(ledger) == mPublishWorks.end())
+        {
+            toPublish.emplace_back();
+            toPublish.back().fromString(state);
+        }
+        st.fetch();
+    }
+
+    size_t started = 0;
+    for (auto const& has : toPublish)
+    {
+        if (mPublishWorks.size() >= maxPublishes)
+        {
+            break;
+        }
         takeSnapshotAndPublish(has);
-        return 1;
+        started += mPublishWorks.count(has.currentLedger);
     }
-    return 0;
+    return started;
 }
 
 std::vector<HistoryArchiveState>
@@ -435,7 +467,7 @@ HistoryManagerImpl::historyPublished(
     {
         this->mPublishFailure.Mark();
     }
-    mPublishWork.reset();
+    mPublishWorks.erase(ledgerSeq);
     mApp.postOnMainThread([this]() { this->publishQueuedHistory(); },
                           "HistoryManagerImpl: publishQueuedHistory");
 }
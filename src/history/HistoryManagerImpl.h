@@ -8,6 +8,7 @@
 #include "history/HistoryManager.h"
 #include "util/TmpDir.h"
 #include "work/Work.h"
+#include <map>
 #include <memory>
 
 namespace medida
@@ -25,7 +26,8 @@ class HistoryManagerImpl : public HistoryManager
 {
     Application& mApp;
     std::unique_ptr<TmpDir> mWorkDir;
-    std::shared_ptr<BasicWork> mPublishWork;
+    // Publishes in progress, by checkpoint ledger
+    std::map<uint32_t, std::shared_ptr<BasicWork>> mPublishWorks;
 
     PublishQueueBuckets mPublishQueueBuckets;
     bool mPublishQueueBucketsFilled{false};
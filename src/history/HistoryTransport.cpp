@@ -0,0 +1,1335 @@
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+// ASIO is somewhat particular about when it gets included -- it wants to be the
+// first to include <windows.h> -- so we try to include it before everything
+// else.
+#include "util/asio.h"
+#include "history/HistoryTransport.h"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "util/Fs.h"
+#include "util/Logging.h"
+#include "util/Timer.h"
+#include <Tracy.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace diamnet
+{
+
+// A connection that makes no progress for this long fails its transfer.
+static std::chrono::seconds const HTTP_TRANSFER_TIMEOUT(60);
+
+// Longest header line or chunk-size line accepted from a server.
+static size_t const HTTP_MAX_LINE = 8192;
+
+// Reading a response stops while this much of its body is waiting to be
+// written, until the disk (or whatever the sink does) catches up.
+static size_t const HTTP_MAX_QUEUED_BODY = 8 * 1024 * 1024;
+
+// Redirects followed for one file before giving up.
+static size_t const HTTP_MAX_REDIRECTS = 5;
+
+static std::string
+toLower(std::string s)
+{
+    std::transform(s.begin(), s.end(), s.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return s;
+}
+
+namespace
+{
+class FileSink : public HistoryFileSink
+{
+    std::string const mLocal;
+    std::string const mTmp;
+    std::ofstream mOut;
+    bool mCommitted{false};
+
+    void
+    open()
+    {
+        if (!mOut.is_open())
+        {
+            mOut.open(mTmp, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!mOut)
+            {
+                throw std::runtime_error("Error opening file " + mTmp);
+            }
+            mOut.exceptions(std::ios::failbit | std::ios::badbit);
+        }
+    }
+
+  public:
+    // A transfer cancelled while still writing in the background can't
+    // clobber the file of a later transfer, as each writes a file of its own.
+    explicit FileSink(std::string const& local)
+        : mLocal(local), mTmp(local + ".tmp-" + std::to_string(++sTmpFiles))
+    {
+    }
+
+    ~FileSink() override
+    {
+        if (!mCommitted)
+        {
+            // a failed write leaves the stream failed, and close() must not
+            // throw out of a destructor
+            mOut.exceptions(std::ios::goodbit);
+            mOut.close();
+            std::remove(mTmp.c_str());
+        }
+    }
+
+    void
+    write(char const* data, size_t n) override
+    {
+        open();
+        mOut.write(data, n);
+    }
+
+    asio::error_code
+    finish() override
+    {
+        try
+        {
+            open();
+            mOut.close();
+        }
+        catch (std::exception& e)
+        {
+            CLOG(DEBUG, "History") << "Failed to write " << mTmp << ": "
+                                   << e.what();
+            return std::make_error_code(std::errc::io_error);
+        }
+        return asio::error_code();
+    }
+
+    asio::error_code
+    commit() override
+    {
+#ifdef _WIN32
+        std::remove(mLocal.c_str());
+#endif
+        if (std::rename(mTmp.c_str(), mLocal.c_str()) != 0)
+        {
+            return std::make_error_code(std::errc::io_error);
+        }
+        mCommitted = true;
+        return asio::error_code();
+    }
+
+    static std::atomic<uint64_t> sTmpFiles;
+};
+
+std::atomic<uint64_t> FileSink::sTmpFiles{0};
+}
+
+std::shared_ptr<HistoryFileSink>
+HistoryFileSink::toFile(std::string const& local)
+{
+    return std::make_shared<FileSink>(local);
+}
+
+std::shared_ptr<HistoryTransfer>
+HistoryTransport::getFile(std::string const& remote, std::string const& local,
+                          Callback cb)
+{
+    return getFile(remote, HistoryFileSink::toFile(local), std::move(cb));
+}
+
+class FileHistoryTransport : public HistoryTransport
+{
+    struct Transfer : public HistoryTransfer
+    {
+        // read by the background thread doing the copy
+        std::atomic<bool> mCancelled{false};
+
+        void
+        cancel() override
+        {
+            mCancelled = true;
+        }
+    };
+
+    Application& mApp;
+    std::string const mDir;
+
+    std::string
+    remotePath(std::string const& remote) const
+    {
+        return mDir + "/" + remote;
+    }
+
+    static asio::error_code readFile(std::string const& from,
+                                     HistoryFileSink& sink,
+                                     std::atomic<bool> const& cancelled);
+
+    std::shared_ptr<HistoryTransfer>
+    copy(std::string const& from, std::shared_ptr<HistoryFileSink> sink,
+         Callback cb);
+
+  public:
+    FileHistoryTransport(Application& app, std::string const& dir)
+        : mApp(app), mDir(dir)
+    {
+    }
+
+    using HistoryTransport::getFile;
+
+    std::shared_ptr<HistoryTransfer>
+    getFile(std::string const& remote, std::shared_ptr<HistoryFileSink> sink,
+            Callback cb) override
+    {
+        return copy(remotePath(remote), std::move(sink), std::move(cb));
+    }
+
+    bool
+    canPut() const override
+    {
+        return true;
+    }
+
+    std::shared_ptr<HistoryTransfer>
+    putFile(std::string const& local, std::string const& remote,
+            Callback cb) override
+    {
+        return copy(local, HistoryFileSink::toFile(remotePath(remote)),
+                    std::move(cb));
+    }
+
+    std::shared_ptr<HistoryTransfer> makeDir(std::string const& remoteDir,
+                                             Callback cb) override;
+};
+
+asio::error_code
+FileHistoryTransport::readFile(std::string const& from, HistoryFileSink& sink,
+                               std::atomic<bool> const& cancelled)
+{
+    ZoneScoped;
+    std::ifstream in(from, std::ios::in | std::ios::binary);
+    if (!in)
+    {
+        return std::make_error_code(std::errc::no_such_file_or_directory);
+    }
+    try
+    {
+        in.exceptions(std::ios::badbit);
+        std::vector<char> buf(fs::readbufsz());
+        while (in)
+        {
+            if (cancelled)
+            {
+                return std::make_error_code(std::errc::operation_canceled);
+            }
+            in.read(buf.data(), buf.size());
+            if (in.gcount() > 0)
+            {
+                sink.write(buf.data(), static_cast<size_t>(in.gcount()));
+            }
+        }
+    }
+    catch (std::exception& e)
+    {
+        CLOG(DEBUG, "History") << "Failed to copy " << from << ": "
+                               << e.what();
+        return std::make_error_code(std::errc::io_error);
+    }
+    return sink.finish();
+}
+
+std::shared_ptr<HistoryTransfer>
+FileHistoryTransport::copy(std::string const& from,
+                           std::shared_ptr<HistoryFileSink> sink, Callback cb)
+{
+    auto transfer = std::make_shared<Transfer>();
+    auto& app = mApp;
+    mApp.postOnBackgroundThread(
+        [&app, transfer, from, sink, cb]() {
+            auto ec = readFile(from, *sink, transfer->mCancelled);
+            app.postOnMainThread(
+                [transfer, from, sink, cb, ec]() mutable {
+                    if (transfer->mCancelled)
+                    {
+                        return;
+                    }
+                    if (!ec)
+                    {
+                        ec = sink->commit();
+                    }
+                    if (ec)
+                    {
+                        CLOG(DEBUG, "History") << "Failed to copy " << from
+                                               << ": " << ec.message();
+                    }
+                    cb(ec);
+                },
+                "FileHistoryTransport: copied");
+        },
+        "FileHistoryTransport: copy");
+    return transfer;
+}
+
+std::shared_ptr<HistoryTransfer>
+FileHistoryTransport::makeDir(std::string const& remoteDir, Callback cb)
+{
+    auto transfer = std::make_shared<Transfer>();
+    auto dir = remotePath(remoteDir);
+    // cheap enough to do here, but the callback still has to be posted
+    asio::error_code ec;
+    if (!fs::exists(dir) && !fs::mkpath(dir))
+    {
+        ec = std::make_error_code(std::errc::io_error);
+    }
+    mApp.postOnMainThread(
+        [transfer, cb, ec]() {
+            if (!transfer->mCancelled)
+            {
+                cb(ec);
+            }
+        },
+        "FileHistoryTransport: made dir");
+    return transfer;
+}
+
+// Hands the body of a response, read on the main thread, to its sink on
+// background threads: pieces are queued and written in order by at most one
+// job at a time. Once a write fails, the rest of the body is dropped.
+class SinkWriter : public std::enable_shared_from_this<SinkWriter>
+{
+    Application& mApp;
+    std::shared_ptr<HistoryFileSink> const mSink;
+    std::mutex mMutex;
+    std::deque<std::string> mQueue;
+    size_t mQueued{0};
+    bool mWriting{false};
+    bool mCancelled{false};
+    asio::error_code mEc;
+    std::function<void(asio::error_code)> mDone;
+    std::function<void()> mDrained;
+
+    void schedule();
+    void run();
+
+  public:
+    SinkWriter(Application& app, std::shared_ptr<HistoryFileSink> sink)
+        : mApp(app), mSink(std::move(sink))
+    {
+    }
+
+    // The following are called on the main thread.
+
+    void write(char const* data, size_t n);
+
+    // If more than HTTP_MAX_QUEUED_BODY is waiting to be written, returns
+    // true and posts f to the main thread once it no longer is.
+    bool waitIfFull(std::function<void()> f);
+
+    // After the last write: finishes the sink, and posts done to the main
+    // thread with the result of the writes and of finishing.
+    void end(std::function<void(asio::error_code)> done);
+
+    // Drops whatever wasn't written yet. Only a pending waitIfFull is still
+    // called back, so that its caller can notice the cancellation.
+    void cancel();
+};
+
+void
+SinkWriter::write(char const* data, size_t n)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mCancelled || mEc)
+    {
+        return;
+    }
+    mQueue.emplace_back(data, n);
+    mQueued += n;
+    schedule();
+}
+
+bool
+SinkWriter::waitIfFull(std::function<void()> f)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mQueued <= HTTP_MAX_QUEUED_BODY)
+    {
+        return false;
+    }
+    mDrained = std::move(f);
+    return true;
+}
+
+void
+SinkWriter::end(std::function<void(asio::error_code)> done)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mCancelled)
+    {
+        return;
+    }
+    mDone = std::move(done);
+    schedule();
+}
+
+void
+SinkWriter::cancel()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCancelled = true;
+    mQueue.clear();
+    mQueued = 0;
+    mDone = nullptr;
+    if (mDrained)
+    {
+        mApp.postOnMainThread(std::move(mDrained),
+                              "HttpHistoryTransport: drained");
+        mDrained = nullptr;
+    }
+}
+
+// with mMutex held
+void
+SinkWriter::schedule()
+{
+    if (!mWriting)
+    {
+        mWriting = true;
+        auto self = shared_from_this();
+        mApp.postOnBackgroundThread([self]() { self->run(); },
+                                    "HttpHistoryTransport: write");
+    }
+}
+
+void
+SinkWriter::run()
+{
+    ZoneScoped;
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mCancelled && !mQueue.empty())
+    {
+        auto data = std::move(mQueue.front());
+        mQueue.pop_front();
+        if (!mEc)
+        {
+            lock.unlock();
+            asio::error_code ec;
+            try
+            {
+                mSink->write(data.data(), data.size());
+            }
+            catch (std::exception& e)
+            {
+                CLOG(DEBUG, "History") << "Failed to write download: "
+                                       << e.what();
+                ec = std::make_error_code(std::errc::io_error);
+            }
+            lock.lock();
+            mEc = mEc ? mEc : ec;
+        }
+        mQueued -= std::min(mQueued, data.size());
+        if (mDrained && mQueued <= HTTP_MAX_QUEUED_BODY)
+        {
+            mApp.postOnMainThread(std::move(mDrained),
+                                  "HttpHistoryTransport: drained");
+            mDrained = nullptr;
+        }
+    }
+    if (!mCancelled && mDone)
+    {
+        auto done = std::move(mDone);
+        mDone = nullptr;
+        auto ec = mEc;
+        lock.unlock();
+        if (!ec)
+        {
+            ec = mSink->finish();
+        }
+        mApp.postOnMainThread([done, ec]() { done(ec); },
+                              "HttpHistoryTransport: written");
+        lock.lock();
+    }
+    mWriting = false;
+    // anything queued while finishing (nothing, for a well-behaved caller)
+    // is picked up by another job
+    if (!mCancelled && (!mQueue.empty() || mDone))
+    {
+        schedule();
+    }
+}
+
+class HttpHistoryTransport
+    : public HistoryTransport,
+      public std::enable_shared_from_this<HttpHistoryTransport>
+{
+    struct Transfer;
+    class Connection;
+
+    Application& mApp;
+    std::string const mHost;
+    std::string const mPort;
+    // value of the Host header, host[:port] as in the url
+    std::string const mHostHeader;
+    std::string const mPath;
+    size_t const mMaxConnections;
+
+    // connections busy with a transfer, and idle ones kept alive for reuse
+    size_t mBusy{0};
+    std::vector<std::shared_ptr<Connection>> mIdle;
+    std::deque<std::shared_ptr<Transfer>> mQueue;
+
+    void dispatch();
+    void release(std::shared_ptr<Connection> conn, bool reusable);
+    void enqueue(std::shared_ptr<Transfer> transfer);
+    void redirect(std::shared_ptr<Transfer> transfer,
+                  std::string const& location);
+
+  public:
+    // url without its scheme: host[:port][/path]; returns nullptr if it is
+    // malformed.
+    static std::shared_ptr<HttpHistoryTransport>
+    create(Application& app, std::string const& url);
+
+    HttpHistoryTransport(Application& app, std::string const& host,
+                         std::string const& port,
+                         std::string const& hostHeader,
+                         std::string const& path)
+        : mApp(app)
+        , mHost(host)
+        , mPort(port)
+        , mHostHeader(hostHeader)
+        , mPath(path)
+        , mMaxConnections(static_cast<size_t>(
+              std::max(1, app.getConfig().MAX_HISTORY_ARCHIVE_CONNECTIONS)))
+    {
+    }
+
+    using HistoryTransport::getFile;
+
+    std::shared_ptr<HistoryTransfer>
+    getFile(std::string const& remote, std::shared_ptr<HistoryFileSink> sink,
+            Callback cb) override;
+
+    bool
+    canPut() const override
+    {
+        return false;
+    }
+
+    std::shared_ptr<HistoryTransfer>
+    putFile(std::string const& local, std::string const& remote,
+            Callback cb) override
+    {
+        throw std::runtime_error("http history archives can't be written");
+    }
+
+    std::shared_ptr<HistoryTransfer>
+    makeDir(std::string const& remoteDir, Callback cb) override
+    {
+        throw std::runtime_error("http history archives can't be written");
+    }
+};
+
+struct HttpHistoryTransport::Transfer : public HistoryTransfer
+{
+    std::string mTarget;
+    std::shared_ptr<HistoryFileSink> const mSink;
+    Callback const mCallback;
+    size_t const mRedirects;
+    // set once the response headers are read
+    std::shared_ptr<SinkWriter> mWriter;
+    bool mCancelled{false};
+    // whether the request was already resent after finding a kept-alive
+    // connection closed by the server
+    bool mRetried{false};
+    std::weak_ptr<Connection> mConnection;
+    // the transfer this one was redirected to on another server, and its
+    // transport
+    std::shared_ptr<HistoryTransfer> mRedirected;
+    std::shared_ptr<HttpHistoryTransport> mRedirectTransport;
+
+    Transfer(std::string const& target, std::shared_ptr<HistoryFileSink> sink,
+             Callback cb, size_t redirects = 0)
+        : mTarget(target)
+        , mSink(std::move(sink))
+        , mCallback(std::move(cb))
+        , mRedirects(redirects)
+    {
+    }
+
+    void cancel() override;
+};
+
+// One keep-alive connection, running one transfer at a time. Every step of a
+// transfer is an asynchronous operation on the main thread, and exactly one
+// is pending while the connection is busy; its handler either moves the
+// transfer on or ends it (completing, failing or abandoning a cancelled
+// transfer) and hands the connection back to the transport.
+class HttpHistoryTransport::Connection
+    : public std::enable_shared_from_this<Connection>
+{
+    enum class Body
+    {
+        LENGTH,
+        CHUNKED,
+        UNTIL_EOF
+    };
+    enum class ChunkState
+    {
+        SIZE,
+        DATA,
+        DATA_END,
+        TRAILER
+    };
+
+    Application& mApp;
+    std::weak_ptr<HttpHistoryTransport> mTransport;
+    std::string const mHost;
+    std::string const mPort;
+    asio::ip::tcp::resolver mResolver;
+    asio::ip::tcp::socket mSocket;
+    VirtualTimer mTimer;
+    asio::streambuf mBuf;
+    std::string mRequest;
+    bool mConnected{false};
+    bool mTimedOut{false};
+    size_t mResponses{0};
+    std::shared_ptr<Transfer> mTransfer;
+
+    // the response being read
+    bool mKeepAlive{true};
+    Body mBody{Body::UNTIL_EOF};
+    ChunkState mChunkState{ChunkState::SIZE};
+    size_t mRemaining{0};
+
+    void armTimer();
+    bool abandonIfCancelled();
+    void connect();
+    void sendRequest();
+    void readHeaders();
+    void onHeaders(size_t n);
+    void readBody();
+    bool consumeBody();
+    bool takeLine(std::string& line);
+    void writeBody(size_t n);
+    void complete();
+    void redirect(std::string const& location);
+    void fail(asio::error_code ec);
+    void retryOrFail(asio::error_code ec);
+    void finish(bool reusable, asio::error_code ec, bool notify);
+
+  public:
+    Connection(Application& app, std::weak_ptr<HttpHistoryTransport> transport,
+               std::string const& host, std::string const& port)
+        : mApp(app)
+        , mTransport(transport)
+        , mHost(host)
+        , mPort(port)
+        , mResolver(app.getClock().getIOContext())
+        , mSocket(app.getClock().getIOContext())
+        , mTimer(app)
+    {
+    }
+
+    void start(std::shared_ptr<Transfer> transfer,
+               std::string const& hostHeader);
+    void close();
+};
+
+void
+HttpHistoryTransport::Transfer::cancel()
+{
+    mCancelled = true;
+    if (mWriter)
+    {
+        mWriter->cancel();
+    }
+    if (mRedirected)
+    {
+        mRedirected->cancel();
+    }
+    auto conn = mConnection.lock();
+    if (conn)
+    {
+        // the pending operation's handler abandons the transfer
+        conn->close();
+    }
+}
+
+std::shared_ptr<HistoryTransfer>
+HttpHistoryTransport::getFile(std::string const& remote,
+                              std::shared_ptr<HistoryFileSink> sink,
+                              Callback cb)
+{
+    auto transfer = std::make_shared<Transfer>(mPath + "/" + remote,
+                                               std::move(sink), std::move(cb));
+    enqueue(transfer);
+    return transfer;
+}
+
+void
+HttpHistoryTransport::enqueue(std::shared_ptr<Transfer> transfer)
+{
+    mQueue.emplace_back(transfer);
+    dispatch();
+}
+
+void
+HttpHistoryTransport::redirect(std::shared_ptr<Transfer> transfer,
+                               std::string const& location)
+{
+    CLOG(DEBUG, "History") << "GET " << transfer->mTarget << " from "
+                           << mHost << " redirected to " << location;
+    if (transfer->mRedirects >= HTTP_MAX_REDIRECTS)
+    {
+        transfer->mCallback(std::make_error_code(std::errc::too_many_links));
+        return;
+    }
+
+    // an absolute path on this server, or an http url
+    std::string hostPort, target;
+    auto sep = location.find("://");
+    if (!location.empty() && location[0] == '/')
+    {
+        hostPort = mHostHeader;
+        target = location;
+    }
+    else if (sep != std::string::npos &&
+             toLower(location.substr(0, sep)) == "http")
+    {
+        auto rest = location.substr(sep + 3);
+        auto slash = rest.find('/');
+        hostPort = rest.substr(0, slash);
+        target = slash == std::string::npos ? "/" : rest.substr(slash);
+    }
+    else
+    {
+        transfer->mCallback(
+            std::make_error_code(std::errc::protocol_not_supported));
+        return;
+    }
+
+    auto next = std::make_shared<Transfer>(target, transfer->mSink,
+                                           transfer->mCallback,
+                                           transfer->mRedirects + 1);
+    if (toLower(hostPort) == toLower(mHostHeader))
+    {
+        // keeps the transfer returned by getFile cancellable
+        transfer->mRedirected = next;
+        enqueue(next);
+        return;
+    }
+
+    auto other = create(mApp, hostPort);
+    if (!other)
+    {
+        transfer->mCallback(std::make_error_code(std::errc::protocol_error));
+        return;
+    }
+    transfer->mRedirected = next;
+    transfer->mRedirectTransport = other;
+    other->enqueue(next);
+}
+
+void
+HttpHistoryTransport::dispatch()
+{
+    while (!mQueue.empty())
+    {
+        auto transfer = mQueue.front();
+        if (transfer->mCancelled)
+        {
+            mQueue.pop_front();
+            continue;
+        }
+        std::shared_ptr<Connection> conn;
+        if (!mIdle.empty())
+        {
+            conn = mIdle.back();
+            mIdle.pop_back();
+        }
+        else if (mBusy < mMaxConnections)
+        {
+            conn = std::make_shared<Connection>(mApp, shared_from_this(), mHost,
+                                                mPort);
+        }
+        else
+        {
+            break;
+        }
+        mQueue.pop_front();
+        ++mBusy;
+        conn->start(transfer, mHostHeader);
+    }
+}
+
+void
+HttpHistoryTransport::release(std::shared_ptr<Connection> conn, bool reusable)
+{
+    assert(mBusy > 0);
+    --mBusy;
+    if (reusable)
+    {
+        mIdle.emplace_back(conn);
+    }
+    dispatch();
+}
+
+void
+HttpHistoryTransport::Connection::start(std::shared_ptr<Transfer> transfer,
+                                        std::string const& hostHeader)
+{
+    mTransfer = transfer;
+    mTransfer->mConnection = shared_from_this();
+    mRequest = "GET " + mTransfer->mTarget + " HTTP/1.1\r\nHost: " +
+               hostHeader + "\r\nAccept: */*\r\n\r\n";
+    if (mConnected)
+    {
+        sendRequest();
+    }
+    else
+    {
+        connect();
+    }
+}
+
+void
+HttpHistoryTransport::Connection::close()
+{
+    asio::error_code ec;
+    mResolver.cancel();
+    mSocket.close(ec);
+    mConnected = false;
+}
+
+void
+HttpHistoryTransport::Connection::armTimer()
+{
+    std::weak_ptr<Connection> weak = shared_from_this();
+    mTimedOut = false;
+    mTimer.expires_from_now(HTTP_TRANSFER_TIMEOUT);
+    mTimer.async_wait(
+        [weak]() {
+            auto self = weak.lock();
+            if (self)
+            {
+                self->mTimedOut = true;
+                self->close();
+            }
+        },
+        VirtualTimer::onFailureNoop);
+}
+
+bool
+HttpHistoryTransport::Connection::abandonIfCancelled()
+{
+    if (!mTransfer->mCancelled)
+    {
+        return false;
+    }
+    close();
+    finish(false, asio::error_code(), false);
+    return true;
+}
+
+void
+HttpHistoryTransport::Connection::connect()
+{
+    armTimer();
+    auto self = shared_from_this();
+    mResolver.async_resolve(
+        mHost, mPort,
+        [self](asio::error_code const& ec,
+               asio::ip::tcp::resolver::results_type results) {
+            if (self->abandonIfCancelled())
+            {
+                return;
+            }
+            if (ec)
+            {
+                self->fail(ec);
+                return;
+            }
+            asio::async_connect(
+                self->mSocket, results,
+                [self](asio::error_code const& ec,
+                       asio::ip::tcp::endpoint const&) {
+                    if (self->abandonIfCancelled())
+                    {
+                        return;
+                    }
+                    if (ec)
+                    {
+                        self->fail(ec);
+                        return;
+                    }
+                    self->mConnected = true;
+                    self->mResponses = 0;
+                    self->sendRequest();
+                });
+        });
+}
+
+void
+HttpHistoryTransport::Connection::sendRequest()
+{
+    armTimer();
+    auto self = shared_from_this();
+    asio::async_write(mSocket, asio::buffer(mRequest),
+                      [self](asio::error_code const& ec, size_t) {
+                          if (self->abandonIfCancelled())
+                          {
+                              return;
+                          }
+                          if (ec)
+                          {
+                              self->retryOrFail(ec);
+                              return;
+                          }
+                          self->readHeaders();
+                      });
+}
+
+void
+HttpHistoryTransport::Connection::readHeaders()
+{
+    armTimer();
+    auto self = shared_from_this();
+    asio::async_read_until(mSocket, mBuf, "\r\n\r\n",
+                           [self](asio::error_code const& ec, size_t n) {
+                               if (self->abandonIfCancelled())
+                               {
+                                   return;
+                               }
+                               if (ec)
+                               {
+                                   self->retryOrFail(ec);
+                                   return;
+                               }
+                               self->onHeaders(n);
+                           });
+}
+
+void
+HttpHistoryTransport::Connection::onHeaders(size_t n)
+{
+    auto data = mBuf.data();
+    std::string headers(asio::buffers_begin(data),
+                        asio::buffers_begin(data) + n);
+    mBuf.consume(n);
+
+    std::istringstream in(headers);
+    std::string version, line;
+    unsigned int status = 0;
+    in >> version >> status;
+    std::getline(in, line);
+    if (!in || version.compare(0, 5, "HTTP/") != 0)
+    {
+        fail(std::make_error_code(std::errc::protocol_error));
+        return;
+    }
+
+    mKeepAlive = version != "HTTP/1.0";
+    mBody = Body::UNTIL_EOF;
+    mChunkState = ChunkState::SIZE;
+    mRemaining = 0;
+    std::string location;
+    try
+    {
+        while (std::getline(in, line) && line != "\r")
+        {
+            auto colon = line.find(':');
+            if (colon == std::string::npos)
+            {
+                continue;
+            }
+            auto name = toLower(line.substr(0, colon));
+            auto rawValue = line.substr(colon + 1);
+            rawValue.erase(0, rawValue.find_first_not_of(" \t"));
+            rawValue.erase(rawValue.find_last_not_of(" \t\r") + 1);
+            auto value = toLower(rawValue);
+            if (name == "location")
+            {
+                location = rawValue;
+            }
+            else if (name == "content-length" && mBody != Body::CHUNKED)
+            {
+                mBody = Body::LENGTH;
+                mRemaining = std::stoull(value);
+            }
+            else if (name == "transfer-encoding" &&
+                     value.find("chunked") != std::string::npos)
+            {
+                mBody = Body::CHUNKED;
+            }
+            else if (name == "connection")
+            {
+                if (value == "close")
+                {
+                    mKeepAlive = false;
+                }
+                else if (value == "keep-alive")
+                {
+                    mKeepAlive = true;
+                }
+            }
+        }
+    }
+    catch (std::exception&)
+    {
+        fail(std::make_error_code(std::errc::protocol_error));
+        return;
+    }
+    ++mResponses;
+
+    if ((status == 301 || status == 302 || status == 303 || status == 307 ||
+         status == 308) &&
+        !location.empty())
+    {
+        redirect(location);
+        return;
+    }
+
+    if (status != 200)
+    {
+        CLOG(DEBUG, "History") << "GET " << mTransfer->mTarget << " from "
+                               << mHost << " returned status " << status;
+        // not worth reading the body to keep the connection
+        fail(std::make_error_code(status == 404
+                                      ? std::errc::no_such_file_or_directory
+                                      : std::errc::protocol_error));
+        return;
+    }
+
+    mTransfer->mWriter = std::make_shared<SinkWriter>(mApp, mTransfer->mSink);
+    readBody();
+}
+
+bool
+HttpHistoryTransport::Connection::takeLine(std::string& line)
+{
+    auto data = mBuf.data();
+    auto begin = asio::buffers_begin(data);
+    auto end = asio::buffers_end(data);
+    char const crlf[] = "\r\n";
+    auto eol = std::search(begin, end, crlf, crlf + 2);
+    if (eol == end)
+    {
+        if (mBuf.size() > HTTP_MAX_LINE)
+        {
+            throw std::runtime_error("line too long");
+        }
+        return false;
+    }
+    line.assign(begin, eol);
+    mBuf.consume(line.size() + 2);
+    return true;
+}
+
+void
+HttpHistoryTransport::Connection::writeBody(size_t n)
+{
+    mTransfer->mWriter->write(static_cast<char const*>(mBuf.data().data()),
+                              n);
+    mBuf.consume(n);
+}
+
+// Writes out as much of the body as has been read; returns true once all of
+// it has.
+bool
+HttpHistoryTransport::Connection::consumeBody()
+{
+    switch (mBody)
+    {
+    case Body::UNTIL_EOF:
+        writeBody(mBuf.size());
+        return false;
+    case Body::LENGTH:
+    {
+        auto n = std::min(mRemaining, mBuf.size());
+        writeBody(n);
+        mRemaining -= n;
+        return mRemaining == 0;
+    }
+    case Body::CHUNKED:
+        break;
+    }
+
+    std::string line;
+    while (true)
+    {
+        switch (mChunkState)
+        {
+        case ChunkState::SIZE:
+            if (!takeLine(line))
+            {
+                return false;
+            }
+            // chunk extensions follow a ';'
+            mRemaining = std::stoull(line.substr(0, line.find(';')), nullptr,
+                                     16);
+            mChunkState =
+                mRemaining == 0 ? ChunkState::TRAILER : ChunkState::DATA;
+            break;
+        case ChunkState::DATA:
+        {
+            if (mBuf.size() == 0)
+            {
+                return false;
+            }
+            auto n = std::min(mRemaining, mBuf.size());
+            writeBody(n);
+            mRemaining -= n;
+            if (mRemaining == 0)
+            {
+                mChunkState = ChunkState::DATA_END;
+            }
+            break;
+        }
+        case ChunkState::DATA_END:
+            if (!takeLine(line))
+            {
+                return false;
+            }
+            if (!line.empty())
+            {
+                throw std::runtime_error("malformed chunk");
+            }
+            mChunkState = ChunkState::SIZE;
+            break;
+        case ChunkState::TRAILER:
+            if (!takeLine(line))
+            {
+                return false;
+            }
+            if (line.empty())
+            {
+                return true;
+            }
+            break;
+        }
+    }
+}
+
+void
+HttpHistoryTransport::Connection::readBody()
+{
+    bool done = false;
+    try
+    {
+        done = consumeBody();
+    }
+    catch (std::exception&)
+    {
+        fail(std::make_error_code(std::errc::protocol_error));
+        return;
+    }
+    if (done)
+    {
+        complete();
+        return;
+    }
+
+    auto self = shared_from_this();
+    if (mTransfer->mWriter->waitIfFull([self]() {
+            if (!self->abandonIfCancelled())
+            {
+                self->readBody();
+            }
+        }))
+    {
+        // not the server's fault if the writes are slow
+        mTimer.cancel();
+        return;
+    }
+
+    armTimer();
+    asio::async_read(mSocket, mBuf, asio::transfer_at_least(1),
+                     [self](asio::error_code const& ec, size_t) {
+                         if (self->abandonIfCancelled())
+                         {
+                             return;
+                         }
+                         if (ec == asio::error::eof &&
+                             self->mBody == Body::UNTIL_EOF)
+                         {
+                             self->mKeepAlive = false;
+                             self->complete();
+                         }
+                         else if (ec)
+                         {
+                             self->fail(ec);
+                         }
+                         else
+                         {
+                             self->readBody();
+                         }
+                     });
+}
+
+void
+HttpHistoryTransport::Connection::complete()
+{
+    bool reusable = mKeepAlive && mBody != Body::UNTIL_EOF;
+    if (!reusable)
+    {
+        close();
+    }
+    // the connection is free for the next transfer while the body is still
+    // being written
+    auto transfer = mTransfer;
+    finish(reusable, asio::error_code(), false);
+    transfer->mWriter->end([transfer](asio::error_code ec) {
+        if (transfer->mCancelled)
+        {
+            return;
+        }
+        if (!ec)
+        {
+            ec = transfer->mSink->commit();
+        }
+        transfer->mCallback(ec);
+    });
+}
+
+void
+HttpHistoryTransport::Connection::redirect(std::string const& location)
+{
+    // not worth reading the body to keep the connection
+    close();
+    mBuf.consume(mBuf.size());
+    auto transfer = mTransfer;
+    finish(false, asio::error_code(), false);
+    auto transport = mTransport.lock();
+    if (transport)
+    {
+        transport->redirect(transfer, location);
+    }
+}
+
+void
+HttpHistoryTransport::Connection::retryOrFail(asio::error_code ec)
+{
+    // A server may close a kept-alive connection at any time; if it did so
+    // before answering, resend the request once on a new connection.
+    if (mResponses > 0 && mBuf.size() == 0 && !mTransfer->mRetried &&
+        !mTimedOut)
+    {
+        CLOG(DEBUG, "History") << "Reconnecting to " << mHost
+                               << " after: " << ec.message();
+        mTransfer->mRetried = true;
+        close();
+        connect();
+        return;
+    }
+    fail(ec);
+}
+
+void
+HttpHistoryTransport::Connection::fail(asio::error_code ec)
+{
+    if (mTimedOut)
+    {
+        ec = std::make_error_code(std::errc::timed_out);
+    }
+    CLOG(DEBUG, "History") << "Failed to GET " << mTransfer->mTarget
+                           << " from " << mHost << ": " << ec.message();
+    close();
+    mBuf.consume(mBuf.size());
+    if (mTransfer->mWriter)
+    {
+        mTransfer->mWriter->cancel();
+    }
+    finish(false, ec, true);
+}
+
+void
+HttpHistoryTransport::Connection::finish(bool reusable, asio::error_code ec,
+                                         bool notify)
+{
+    mTimer.cancel();
+    auto transfer = std::move(mTransfer);
+    transfer->mConnection.reset();
+    auto transport = mTransport.lock();
+    if (transport)
+    {
+        transport->release(shared_from_this(), reusable);
+    }
+    if (notify)
+    {
+        transfer->mCallback(ec);
+    }
+}
+
+std::shared_ptr<HttpHistoryTransport>
+HttpHistoryTransport::create(Application& app, std::string const& url)
+{
+    auto slash = url.find('/');
+    auto hostPort = url.substr(0, slash);
+    auto path = slash == std::string::npos ? "" : url.substr(slash);
+    std::string host = hostPort;
+    std::string port = "80";
+    // [v6 address]:port or host:port
+    auto close = hostPort.find(']');
+    auto colon = hostPort.rfind(':');
+    if (!hostPort.empty() && hostPort[0] == '[' && close != std::string::npos)
+    {
+        host = hostPort.substr(1, close - 1);
+        if (colon != std::string::npos && colon > close)
+        {
+            port = hostPort.substr(colon + 1);
+        }
+    }
+    else if (colon != std::string::npos)
+    {
+        host = hostPort.substr(0, colon);
+        port = hostPort.substr(colon + 1);
+    }
+    if (host.empty() || port.empty())
+    {
+        return nullptr;
+    }
+    return std::make_shared<HttpHistoryTransport>(app, host, port, hostPort,
+                                                  path);
+}
+
+std::shared_ptr<HistoryTransport>
+HistoryTransport::create(Application& app, std::string const& url)
+{
+    auto sep = url.find("://");
+    if (sep == std::string::npos)
+    {
+        return nullptr;
+    }
+    auto scheme = toLower(url.substr(0, sep));
+    auto rest = url.substr(sep + 3);
+    while (!rest.empty() && rest.back() == '/')
+    {
+        rest.pop_back();
+    }
+
+    if (scheme == "file")
+    {
+        return std::make_shared<FileHistoryTransport>(app, rest);
+    }
+    if (scheme == "http")
+    {
+        auto transport = HttpHistoryTransport::create(app, rest);
+        if (!transport)
+        {
+            throw std::invalid_argument("Invalid history archive url: " + url);
+        }
+        return transport;
+    }
+    return nullptr;
+}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <system_error>
+
+namespace asio
+{
+typedef std::error_code error_code;
+}
+
+/*
+In-process transport for the files of a history archive configured with a
+`url`, used instead of running the archive's get / put / mkdir commands as one
+subprocess per file.
+
+An http://host[:port]/path archive is read over a pool of at most
+MAX_HISTORY_ARCHIVE_CONNECTIONS HTTP/1.1 keep-alive connections, served from
+the main thread's io_context; requests beyond that wait for a connection to
+be free. Catchup downloads tens of thousands of small files, so not paying
+for a process and a fresh connection per file is most of the cost of a
+download. Response bodies are read on the main thread but handed to their
+sink on background threads, so the main thread never waits on the disk.
+Redirects to another http url are followed. Writing over http isn't
+supported.
+
+A file://path archive is read and written by copying files on a background
+thread, creating directories as needed.
+
+Other schemes (https, s3, ...) are left to the archive's commands.
+*/
+
+namespace diamnet
+{
+class Application;
+
+class HistoryTransfer : NonMovableOrCopyable
+{
+  public:
+    virtual ~HistoryTransfer() = default;
+
+    // Once cancelled, a transfer's callback is never called and nothing
+    // more is written to its destination.
+    virtual void cancel() = 0;
+};
+
+// Where the contents of a file read from an archive go, so that a download
+// can be processed as it arrives instead of being read back once written.
+class HistoryFileSink : NonMovableOrCopyable
+{
+  public:
+    virtual ~HistoryFileSink() = default;
+
+    // Called on background threads, one call at a time and in order: write
+    // for each piece of the file, then finish after the last one. write may
+    // throw, and finish return an error, to fail the transfer.
+    virtual void write(char const* data, size_t n) = 0;
+    virtual asio::error_code finish() = 0;
+
+    // Called on the main thread once the whole file was written and finished
+    // without error, unless the transfer was cancelled meanwhile; returns the
+    // result of the transfer. A sink destroyed without being committed
+    // removes whatever it wrote.
+    virtual asio::error_code commit() = 0;
+
+    // Writes to a temporary file, renamed to `local` on commit.
+    static std::shared_ptr<HistoryFileSink> toFile(std::string const& local);
+};
+
+class HistoryTransport : NonMovableOrCopyable
+{
+  public:
+    using Callback = std::function<void(asio::error_code const&)>;
+
+    // Returns nullptr if the scheme of url isn't one of the above.
+    static std::shared_ptr<HistoryTransport> create(Application& app,
+                                                    std::string const& url);
+
+    virtual ~HistoryTransport() = default;
+
+    // Remote names are relative to the archive's url. Callbacks run on the
+    // main thread, never before the call that started the transfer returns.
+    virtual std::shared_ptr<HistoryTransfer>
+    getFile(std::string const& remote, std::shared_ptr<HistoryFileSink> sink,
+            Callback cb) = 0;
+    std::shared_ptr<HistoryTransfer> getFile(std::string const& remote,
+                                             std::string const& local,
+                                             Callback cb);
+
+    virtual bool canPut() const = 0;
+    virtual std::shared_ptr<HistoryTransfer>
+    putFile(std::string const& local, std::string const& remote,
+            Callback cb) = 0;
+    virtual std::shared_ptr<HistoryTransfer>
+    makeDir(std::string const& remoteDir, Callback cb) = 0;
+};
+}
@@ -12,6 +12,7 @@
 #include "history/FileTransferInfo.h"
 #include "history/HistoryArchive.h"
 #include "history/HistoryManager.h"
+#include "history/TxHistorySegments.h"
 #include "ledger/LedgerHeaderUtils.h"
 #include "main/Application.h"
 #include "main/Config.h"
@@ -61,7 +62,8 @@ StateSnapshot::writeHistoryBlocks() const
     // headers, one TransactionHistoryEntry (which contain txSets),
     // one TransactionHistoryResultEntry containing transaction set results and
     // one (optional) SCPHistoryEntry containing the SCP messages used to close.
-    // All files are streamed out of the database, entry-by-entry.
+    // All files are streamed out of the database, entry-by-entry, except for
+    // the transaction ones when they are kept in TxHistorySegments.
     size_t nbSCPMessages;
     uint32_t begin, count;
     size_t nHeaders;
@@ -84,8 +86,12 @@ StateSnapshot::writeHistoryBlocks() const
         nHeaders = LedgerHeaderUtils::copyToStream(mApp.getDatabase(), sess,
                                                    begin, count, ledgerOut);
         size_t nTxs =
-            copyTransactionsToStream(mApp.getNetworkID(), mApp.getDatabase(),
-                                     sess, begin, count, txOut, txResultOut);
+            TxHistorySegments::isEnabled(mApp.getConfig())
+                ? TxHistorySegments::copyTransactionsToStream(
+                      mApp, begin, count, txOut, txResultOut)
+                : copyTransactionsToStream(mApp.getNetworkID(),
+                                           mApp.getDatabase(), sess, begin,
+                                           count, txOut, txResultOut);
         CLOG(DEBUG, "History") << "Wrote " << nHeaders << " ledger headers to "
                                << mLedgerSnapFile->localPath_nogz();
         CLOG(DEBUG, "History")
@@ -131,6 +137,12 @@ StateSnapshot::writeHistoryBlocks() const
 
 std::vector<std::shared_ptr<FileTransferInfo>>
 StateSnapshot::differingHASFiles(HistoryArchiveState const& other)
+{
+    return filesWithBuckets(mLocalState.differingBuckets(other));
+}
+
+std::vector<std::shared_ptr<FileTransferInfo>>
+StateSnapshot::filesWithBuckets(std::vector<std::string> const& bucketHashes)
 {
     ZoneScoped;
     std::vector<std::shared_ptr<FileTransferInfo>> files{};
@@ -146,7 +158,7 @@ StateSnapshot::differingHASFiles(HistoryArchiveState const& other)
     addIfExists(mTransactionResultSnapFile);
     addIfExists(mSCPHistorySnapFile);
 
-    for (auto const& hash : mLocalState.differingBuckets(other))
+    for (auto const& hash : bucketHashes)
     {
         auto b = mApp.getBucketManager().getBucketByHash(hexToBin256(hash));
         assert(b);
@@ -31,5 +31,8 @@ struct StateSnapshot : public std::enable_shared_from_this<StateSnapshot>
     bool writeHistoryBlocks() const;
     std::vector<std::shared_ptr<FileTransferInfo>>
     differingHASFiles(HistoryArchiveState const& other);
+    // The checkpoint files of the snapshot, and the given buckets.
+    std::vector<std::shared_ptr<FileTransferInfo>>
+    filesWithBuckets(std::vector<std::string> const& bucketHashes);
 };
 }
@@ -0,0 +1,551 @@
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "history/TxHistorySegments.h"
+#include "herder/TxSetFrame.h"
+#include "history/HistoryManager.h"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "util/Fs.h"
+#include "util/GlobalChecks.h"
+#include "util/GzipStream.h"
+#include "util/Logging.h"
+#include <Tracy.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace diamnet
+{
+
+static std::string const SEGMENT_TYPE = "txhistory";
+static std::string const SEGMENT_SUFFIX = "xdr.gz";
+
+static uint32_t
+ledgerSeqOf(LedgerCloseMeta const& lcm)
+{
+    return lcm.v0().ledgerHeader.header.ledgerSeq;
+}
+
+// Appends lcm to a segment as a gzip member of its own holding a single XDR
+// record, so that every record ends on a member boundary and a crash can only
+// tear the last one. Returns the size of the member.
+static size_t
+writeRecord(XDROutputFileStream& out, LedgerCloseMeta const& lcm)
+{
+    auto body = xdr::xdr_to_opaque(lcm);
+    uint32_t sz = static_cast<uint32_t>(body.size());
+    char mark[4] = {static_cast<char>(((sz >> 24) & 0xFF) | 0x80),
+                    static_cast<char>((sz >> 16) & 0xFF),
+                    static_cast<char>((sz >> 8) & 0xFF),
+                    static_cast<char>(sz & 0xFF)};
+
+    std::string member;
+    auto collect = [&](char const* data, size_t n) { member.append(data, n); };
+    GzipStream gz;
+    gz.write(mark, sizeof(mark), collect);
+    gz.write(reinterpret_cast<char const*>(body.data()), body.size(), collect);
+    gz.finish(collect);
+    out.writeBytes(member.data(), member.size());
+    return member.size();
+}
+
+// The index of a segment is a gzip member of its own as well, that
+// decompresses to nothing: the table is carried in the extra field of its
+// header, as a subfield "TX" holding, for each ledger, its sequence number and
+// the offset of its record in the segment (4 and 8 bytes, big-endian), then
+// the number of ledgers (4 bytes). The member ends with an empty deflate block
+// and the trailer of empty data, so a reader finds the number of ledgers, then
+// the start of the member, at a fixed distance from the end of the segment.
+static std::string const INDEX_EMPTY_BLOCK("\x03\x00", 2);
+static size_t const INDEX_ENTRY_SIZE = 12;
+// header, XLEN, subfield id and length, count, empty block, trailer
+static size_t const INDEX_OVERHEAD = 10 + 2 + 2 + 2 + 4 + 2 + 8;
+
+static void
+putBE(std::string& out, uint64_t v, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; --i)
+    {
+        out += static_cast<char>((v >> (8 * i)) & 0xFF);
+    }
+}
+
+static uint64_t
+getBE(char const* p, int bytes)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i)
+    {
+        v = (v << 8) | static_cast<unsigned char>(p[i]);
+    }
+    return v;
+}
+
+static std::string
+indexHeader(size_t count)
+{
+    auto dataLen = count * INDEX_ENTRY_SIZE + 4;
+    auto xlen = dataLen + 4;
+    // magic, deflate, FEXTRA, no mtime, no extra flags, unix
+    std::string res("\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\x03", 10);
+    res += static_cast<char>(xlen & 0xFF);
+    res += static_cast<char>((xlen >> 8) & 0xFF);
+    res += "TX";
+    res += static_cast<char>(dataLen & 0xFF);
+    res += static_cast<char>((dataLen >> 8) & 0xFF);
+    return res;
+}
+
+static std::string
+indexMember(std::map<uint32_t, uint64_t> const& offsets)
+{
+    // XLEN is 16 bits
+    releaseAssert(offsets.size() * INDEX_ENTRY_SIZE + 8 <= UINT16_MAX);
+    auto res = indexHeader(offsets.size());
+    for (auto const& o : offsets)
+    {
+        putBE(res, o.first, 4);
+        putBE(res, o.second, 8);
+    }
+    putBE(res, offsets.size(), 4);
+    res += INDEX_EMPTY_BLOCK;
+    res += gzipTrailer(0, 0);
+    return res;
+}
+
+// Reads the index at the end of the segment at path into index, in ledger
+// order. Returns false if the segment doesn't end with one, as while its
+// checkpoint is still being closed.
+static bool
+readIndex(std::string const& path,
+          std::vector<std::pair<uint32_t, uint64_t>>& index)
+{
+    ZoneScoped;
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+    {
+        return false;
+    }
+    auto size = static_cast<uint64_t>(in.tellg());
+    auto const tailSize = 4 + INDEX_EMPTY_BLOCK.size() + 8;
+    if (size < INDEX_OVERHEAD)
+    {
+        return false;
+    }
+    std::string tail(tailSize, '\0');
+    in.seekg(size - tailSize);
+    in.read(&tail[0], tailSize);
+    if (!in || tail.substr(4) != INDEX_EMPTY_BLOCK + gzipTrailer(0, 0))
+    {
+        return false;
+    }
+    auto count = getBE(tail.data(), 4);
+    auto memberSize = INDEX_OVERHEAD + count * INDEX_ENTRY_SIZE;
+    if (memberSize > size)
+    {
+        return false;
+    }
+    auto memberStart = size - memberSize;
+    auto header = indexHeader(count);
+    std::string member(memberSize - tailSize, '\0');
+    in.seekg(memberStart);
+    in.read(&member[0], member.size());
+    if (!in || member.compare(0, header.size(), header) != 0)
+    {
+        return false;
+    }
+    index.clear();
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto p = member.data() + header.size() + i * INDEX_ENTRY_SIZE;
+        auto seq = static_cast<uint32_t>(getBE(p, 4));
+        auto offset = getBE(p + 4, 8);
+        if (offset >= memberStart ||
+            (!index.empty() && index.back().first >= seq))
+        {
+            return false;
+        }
+        index.emplace_back(seq, offset);
+    }
+    return true;
+}
+
+static bool
+isSegmentName(std::string const& name)
+{
+    // txhistory-<8 hex digits>.xdr.gz
+    auto prefix = SEGMENT_TYPE + "-";
+    auto suffix = "." + SEGMENT_SUFFIX;
+    return name.size() == prefix.size() + 8 + suffix.size() &&
+           name.compare(0, prefix.size(), prefix) == 0 &&
+           name.compare(name.size() - suffix.size(), suffix.size(), suffix) ==
+               0;
+}
+
+static uint32_t
+checkpointOfSegment(std::string const& name)
+{
+    return static_cast<uint32_t>(
+        std::stoul(name.substr(SEGMENT_TYPE.size() + 1, 8), nullptr, 16));
+}
+
+bool
+TxHistorySegments::isEnabled(Config const& cfg)
+{
+    return cfg.MODE_STORES_HISTORY && !cfg.TX_HISTORY_SEGMENT_PATH.empty();
+}
+
+TxHistorySegments::TxHistorySegments(Application& app)
+    : mApp(app), mDir(app.getConfig().TX_HISTORY_SEGMENT_PATH)
+{
+    if (!fs::exists(mDir) && !fs::mkpath(mDir))
+    {
+        throw std::runtime_error(
+            "Unable to create transaction history segment directory: " + mDir);
+    }
+}
+
+std::string
+TxHistorySegments::segmentPath(Application& app, uint32_t checkpoint)
+{
+    return app.getConfig().TX_HISTORY_SEGMENT_PATH + "/" +
+           fs::baseName(SEGMENT_TYPE, fs::hexStr(checkpoint), SEGMENT_SUFFIX);
+}
+
+bool
+TxHistorySegments::forEachRecord(
+    std::string const& path, uint64_t from,
+    std::function<bool(LedgerCloseMeta const&)> f)
+{
+    ZoneScoped;
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        throw std::runtime_error("Unable to open " + path);
+    }
+    in.seekg(from);
+
+    // Hold each record back until the next one shows it wasn't superseded by
+    // a second close of the same ledger.
+    LedgerCloseMeta prev, next;
+    bool havePrev = false;
+    bool more = true;
+    std::string records;
+    auto decode = [&]() {
+        size_t pos = 0;
+        while (more && records.size() - pos >= 4)
+        {
+            auto const* p =
+                reinterpret_cast<unsigned char const*>(records.data() + pos);
+            uint32_t sz = (static_cast<uint32_t>(p[0] & 0x7F) << 24) |
+                          (static_cast<uint32_t>(p[1]) << 16) |
+                          (static_cast<uint32_t>(p[2]) << 8) |
+                          static_cast<uint32_t>(p[3]);
+            if (records.size() - pos - 4 < sz)
+            {
+                break;
+            }
+            xdr::xdr_get g(records.data() + pos + 4,
+                           records.data() + pos + 4 + sz);
+            xdr::xdr_argpack_archive(g, next);
+            pos += 4 + sz;
+            if (havePrev && ledgerSeqOf(prev) < ledgerSeqOf(next))
+            {
+                more = f(prev);
+            }
+            std::swap(prev, next);
+            havePrev = true;
+        }
+        records.erase(0, pos);
+    };
+
+    GunzipStream gunzip;
+    bool complete = true;
+    try
+    {
+        std::vector<char> buf(fs::readbufsz());
+        while (in && more)
+        {
+            in.read(buf.data(), buf.size());
+            gunzip.write(buf.data(), static_cast<size_t>(in.gcount()),
+                         [&](char const* data, size_t n) {
+                             records.append(data, n);
+                         });
+            decode();
+        }
+        // a torn member leaves the stream short of its trailer, and possibly
+        // part of a record behind
+        complete = gunzip.atEnd() && records.empty();
+    }
+    catch (std::runtime_error&)
+    {
+        // corrupt member or record, xdr_runtime_error included
+        complete = false;
+    }
+    if (havePrev && more)
+    {
+        f(prev);
+    }
+    return complete;
+}
+
+void
+TxHistorySegments::openSegment(uint32_t checkpoint)
+{
+    ZoneScoped;
+    if (mOut && !mIndexed)
+    {
+        // appends moved on: the segment is as complete as it will get
+        auto index = indexMember(mOffsets);
+        mOut->writeBytes(index.data(), index.size());
+        mOut->flush();
+    }
+    mOut.reset();
+    mCheckpoint = 0;
+    mOffsets.clear();
+    mSize = 0;
+    mIndexed = false;
+
+    auto path = segmentPath(mApp, checkpoint);
+    bool doFsync = !mApp.getConfig().DISABLE_XDR_FSYNC;
+    auto& ctx = mApp.getClock().getIOContext();
+
+    // A segment reopened (after a restart) is rewritten with the last record
+    // of each ledger, so that the offsets of its records are known again for
+    // its index; that also cuts off a torn record and any index written
+    // before the restart.
+    std::vector<LedgerCloseMeta> kept;
+    if (fs::exists(path))
+    {
+        bool complete =
+            forEachRecord(path, 0, [&](LedgerCloseMeta const& lcm) {
+                kept.push_back(lcm);
+                return true;
+            });
+        if (!complete)
+        {
+            CLOG(WARNING, "History")
+                << "Discarding torn record at the end of " << path;
+        }
+        auto tmp = path + ".tmp";
+        std::remove(tmp.c_str());
+        {
+            XDROutputFileStream out(ctx, doFsync);
+            out.open(tmp);
+            for (auto const& lcm : kept)
+            {
+                mOffsets[ledgerSeqOf(lcm)] = mSize;
+                mSize += writeRecord(out, lcm);
+            }
+        }
+        if (!fs::durableRename(tmp, path, mDir))
+        {
+            throw std::runtime_error("Failed to rename " + tmp + " to " +
+                                     path);
+        }
+    }
+
+    auto out = std::make_unique<XDROutputFileStream>(ctx, doFsync);
+    out->open(path);
+#ifdef _WIN32
+    // fs::openFileToWrite truncates existing files on windows.
+    for (auto const& lcm : kept)
+    {
+        writeRecord(*out, lcm);
+    }
+#endif
+    mOut = std::move(out);
+    mCheckpoint = checkpoint;
+}
+
+void
+TxHistorySegments::append(LedgerCloseMeta const& lcm)
+{
+    ZoneScoped;
+    auto seq = ledgerSeqOf(lcm);
+    auto checkpoint = mApp.getHistoryManager().checkpointContainingLedger(seq);
+    if (!mOut || checkpoint != mCheckpoint)
+    {
+        openSegment(checkpoint);
+    }
+    // readers drop the records of ledgers closed again after this one
+    mOffsets.erase(mOffsets.lower_bound(seq), mOffsets.end());
+    mOffsets[seq] = mSize;
+    mSize += writeRecord(*mOut, lcm);
+    mIndexed = false;
+    if (seq == checkpoint)
+    {
+        auto index = indexMember(mOffsets);
+        mOut->writeBytes(index.data(), index.size());
+        mSize += index.size();
+        mIndexed = true;
+    }
+    mOut->flush();
+    if (!mApp.getConfig().DISABLE_XDR_FSYNC)
+    {
+        fs::flushFileChanges(mOut->getHandle());
+    }
+}
+
+void
+TxHistorySegments::load(Application& app, uint32_t begin, uint32_t count,
+                        std::function<void(LedgerCloseMeta const&)> f)
+{
+    ZoneScoped;
+    if (count == 0)
+    {
+        return;
+    }
+    auto& hm = app.getHistoryManager();
+    uint32_t end = begin + count;
+    uint32_t last = hm.checkpointContainingLedger(end - 1);
+    for (uint32_t checkpoint = hm.checkpointContainingLedger(begin);
+         checkpoint <= last; checkpoint += hm.getCheckpointFrequency())
+    {
+        auto path = segmentPath(app, checkpoint);
+        if (!fs::exists(path))
+        {
+            continue;
+        }
+        // seek to the first ledger wanted, if the segment is indexed
+        uint64_t from = 0;
+        std::vector<std::pair<uint32_t, uint64_t>> index;
+        if (readIndex(path, index))
+        {
+            auto it = std::lower_bound(
+                index.begin(), index.end(), std::make_pair(begin, uint64_t(0)));
+            if (it == index.end())
+            {
+                continue;
+            }
+            from = it->second;
+        }
+        forEachRecord(path, from, [&](LedgerCloseMeta const& lcm) {
+            auto seq = ledgerSeqOf(lcm);
+            if (seq >= end)
+            {
+                return false;
+            }
+            if (seq >= begin)
+            {
+                f(lcm);
+            }
+            return true;
+        });
+    }
+}
+
+size_t
+TxHistorySegments::copyTransactionsToStream(Application& app, uint32_t begin,
+                                            uint32_t count,
+                                            XDROutputFileStream& txOut,
+                                            XDROutputFileStream& txResultOut)
+{
+    ZoneScoped;
+    size_t n = 0;
+    load(app, begin, count, [&](LedgerCloseMeta const& lcm) {
+        auto const& meta = lcm.v0();
+        if (meta.txProcessing.empty())
+        {
+            return;
+        }
+        auto ledgerSeq = ledgerSeqOf(lcm);
+
+        TxSetFrame txSet(app.getNetworkID(), meta.txSet);
+        txSet.previousLedgerHash() =
+            meta.ledgerHeader.header.previousLedgerHash;
+        txSet.sortForHash();
+        TransactionHistoryEntry hist;
+        hist.ledgerSeq = ledgerSeq;
+        txSet.toXDR(hist.txSet);
+        txOut.writeOne(hist);
+
+        TransactionHistoryResultEntry results;
+        results.ledgerSeq = ledgerSeq;
+        results.txResultSet.results.reserve(meta.txProcessing.size());
+        for (auto const& trm : meta.txProcessing)
+        {
+            results.txResultSet.results.emplace_back(trm.result);
+        }
+        txResultOut.writeOne(results);
+
+        n += meta.txProcessing.size();
+    });
+    return n;
+}
+
+TransactionResultSet
+TxHistorySegments::getTransactionHistoryResults(Application& app,
+                                                uint32_t ledgerSeq)
+{
+    ZoneScoped;
+    TransactionResultSet res;
+    load(app, ledgerSeq, 1, [&](LedgerCloseMeta const& lcm) {
+        res.results.clear();
+        for (auto const& trm : lcm.v0().txProcessing)
+        {
+            res.results.emplace_back(trm.result);
+        }
+    });
+    return res;
+}
+
+void
+TxHistorySegments::deleteOldSegments(Application& app, uint32_t ledgerSeq,
+                                     uint32_t count)
+{
+    ZoneScoped;
+    auto const& dir = app.getConfig().TX_HISTORY_SEGMENT_PATH;
+    if (dir.empty() || !fs::exists(dir))
+    {
+        return;
+    }
+    std::vector<uint32_t> old;
+    for (auto const& name : fs::findfiles(dir, isSegmentName))
+    {
+        auto checkpoint = checkpointOfSegment(name);
+        if (checkpoint <= ledgerSeq)
+        {
+            old.emplace_back(checkpoint);
+        }
+    }
+    // as deleteOldEntriesHelper, oldest first, but a whole segment at least
+    auto freq = app.getHistoryManager().getCheckpointFrequency();
+    size_t maxSegments = std::max<size_t>(1, (count + freq - 1) / freq);
+    std::sort(old.begin(), old.end());
+    old.resize(std::min(old.size(), maxSegments));
+    for (auto checkpoint : old)
+    {
+        auto path = segmentPath(app, checkpoint);
+        std::remove(path.c_str());
+    }
+}
+
+void
+TxHistorySegments::dropAll(Application& app)
+{
+    ZoneScoped;
+    auto const& dir = app.getConfig().TX_HISTORY_SEGMENT_PATH;
+    if (dir.empty() || !fs::exists(dir))
+    {
+        return;
+    }
+    // also remove anything left over from an interrupted truncation
+    auto segments = fs::findfiles(dir, [](std::string const& name) {
+        std::string const tmp = ".tmp";
+        if (name.size() > tmp.size() &&
+            name.compare(name.size() - tmp.size(), tmp.size(), tmp) == 0)
+        {
+            return isSegmentName(name.substr(0, name.size() - tmp.size()));
+        }
+        return isSegmentName(name);
+    });
+    for (auto const& name : segments)
+    {
+        std::remove((dir + "/" + name).c_str());
+    }
+}
+}
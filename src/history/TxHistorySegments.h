@@ -0,0 +1,105 @@
+#pragma once
+
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include "util/XDRStream.h"
+#include "xdr/Diamnet-ledger.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+/*
+File-based store for the transaction history of a node, used instead of the
+txhistory and txfeehistory tables when TX_HISTORY_SEGMENT_PATH is set.
+
+The history of every closed ledger is appended, as a single binary XDR
+LedgerCloseMeta record, to the segment of the checkpoint containing it:
+<TX_HISTORY_SEGMENT_PATH>/txhistory-<checkpoint hex>.xdr.gz. Each record is
+compressed as a gzip member of its own, so a segment decompresses (with
+`gzip -d` as well) to a plain stream of XDR records. A segment therefore
+holds the envelopes, results, fee changes and meta of up to one checkpoint's
+worth of ledgers, indexed by ledger sequence number: the file name selects the
+checkpoint and records are ordered by ledger within it. Once the last ledger
+of its checkpoint is appended (or appends move on to a later segment), a
+segment ends with an index of the offset of each ledger's record, in a gzip
+member that decompresses to nothing, so readers seek to the ledgers they want
+instead of decompressing the segment from its start.
+
+Records are appended (and synced) before the ledger commits. If the node
+crashes between the two, the ledger is closed again after restart and its
+record appended a second time; readers always keep the last record of a
+ledger. A segment reopened after a restart is rewritten with the last record
+of each ledger, which cuts off a record torn by a crash.
+
+Publishing reads the segment of the checkpoint being published and streams
+the transaction and result history files out of it, without going through
+the database.
+*/
+
+namespace diamnet
+{
+class Application;
+class Config;
+
+class TxHistorySegments : NonMovableOrCopyable
+{
+    Application& mApp;
+    std::string const mDir;
+    // checkpoint of the segment mOut appends to, 0 if none is open
+    uint32_t mCheckpoint{0};
+    std::unique_ptr<XDROutputFileStream> mOut;
+    // offset in the open segment of the record of each ledger, its size, and
+    // whether its index has been written since the last record
+    std::map<uint32_t, uint64_t> mOffsets;
+    uint64_t mSize{0};
+    bool mIndexed{false};
+
+    void openSegment(uint32_t checkpoint);
+
+    static std::string segmentPath(Application& app, uint32_t checkpoint);
+
+    // Calls f on the last record of each ledger in the segment at path, in
+    // ledger order, from the record at offset from on and until f returns
+    // false. Returns false if the segment ends with a torn record.
+    static bool
+    forEachRecord(std::string const& path, uint64_t from,
+                  std::function<bool(LedgerCloseMeta const&)> f);
+
+  public:
+    // True if the configuration stores transaction history in segments
+    // rather than in the database.
+    static bool isEnabled(Config const& cfg);
+
+    explicit TxHistorySegments(Application& app);
+
+    // Appends the history of a ledger that is about to commit.
+    void append(LedgerCloseMeta const& lcm);
+
+    // Calls f on the history of every ledger in [begin, begin + count) found
+    // in the segments, in ledger order.
+    static void load(Application& app, uint32_t begin, uint32_t count,
+                     std::function<void(LedgerCloseMeta const&)> f);
+
+    // Same output as the SQL copyTransactionsToStream.
+    static size_t copyTransactionsToStream(Application& app, uint32_t begin,
+                                           uint32_t count,
+                                           XDROutputFileStream& txOut,
+                                           XDROutputFileStream& txResultOut);
+
+    // Same output as the SQL getTransactionHistoryResults.
+    static TransactionResultSet
+    getTransactionHistoryResults(Application& app, uint32_t ledgerSeq);
+
+    // Deletes the oldest segments holding only ledgers <= ledgerSeq, as many
+    // as needed to hold count ledgers but at least one.
+    static void deleteOldSegments(Application& app, uint32_t ledgerSeq,
+                                  uint32_t count);
+
+    // Deletes every segment.
+    static void dropAll(Application& app);
+};
+}
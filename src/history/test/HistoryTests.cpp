@@ -4,15 +4,23 @@
 
 #include "bucket/BucketManager.h"
 #include "bucket/BucketTests.h"
+#include "catchup/DownloadApplyTxsWork.h"
 #include "catchup/test/CatchupWorkTests.h"
+#include "crypto/Hex.h"
+#include "crypto/Random.h"
+#include "crypto/SHA.h"
+#include "database/Database.h"
 #include "history/FileTransferInfo.h"
 #include "history/HistoryArchiveManager.h"
 #include "history/HistoryManager.h"
+#include "history/HistoryTransport.h"
+#include "history/TxHistorySegments.h"
 #include "history/test/HistoryTestsUtils.h"
 #include "historywork/GetHistoryArchiveStateWork.h"
 #include "historywork/GunzipFileWork.h"
 #include "historywork/GzipFileWork.h"
 #include "historywork/PutHistoryArchiveStateWork.h"
+#include "ledger/CheckpointRange.h"
 #include "ledger/LedgerManager.h"
 #include "main/ExternalQueue.h"
 #include "main/PersistentState.h"
@@ -21,16 +29,23 @@
 #include "test/TestUtils.h"
 #include "test/TxTests.h"
 #include "test/test.h"
+#include "transactions/TransactionSQL.h"
 #include "util/Fs.h"
+#include "util/GzipStream.h"
 #include "util/Logging.h"
+#include "util/XDRStream.h"
 #include "work/WorkScheduler.h"
 
 #include "historywork/BatchDownloadWork.h"
+#include "historywork/DecompressVerifyFileWork.h"
 #include "historywork/DownloadBucketsWork.h"
 #include "historywork/DownloadVerifyTxResultsWork.h"
+#include "historywork/GetRemoteFileWork.h"
 #include "historywork/VerifyTxResultsWork.h"
 #include <fmt/format.h>
 #include <lib/catch.hpp>
+#include <medida/meter.h>
+#include <medida/metrics_registry.h>
 
 using namespace diamnet;
 using namespace historytestutils;
@@ -103,6 +118,175 @@ TEST_CASE("HistoryManager compress", "[history]")
     REQUIRE(!fs::exists(compressed));
 }
 
+TEST_CASE("HistoryManager parallel compress", "[history]")
+{
+    CatchupSimulation catchupSimulation{};
+    auto& app = catchupSimulation.getApp();
+    REQUIRE(app.getConfig().GZIP_PARALLEL_BLOCKS > 1);
+
+    // Large enough to take a few rounds of blocks, not a multiple of the
+    // block size, and compressible across block boundaries.
+    std::string contents;
+    auto size = GzipFileWork::PARALLEL_BLOCK_SIZE *
+                    (2 * app.getConfig().GZIP_PARALLEL_BLOCKS + 1) +
+                12345;
+    while (contents.size() < size)
+    {
+        contents += fmt::format("line {} of compressible text\n",
+                                contents.size() % 7919);
+    }
+    contents.resize(size);
+
+    std::string fname = app.getHistoryManager().localFilename("bigfile");
+    {
+        std::ofstream out(fname, std::ofstream::binary);
+        out.write(contents.data(), contents.size());
+    }
+    std::string compressed = fname + ".gz";
+    auto& wm = app.getWorkScheduler();
+    auto g = wm.executeWork<GzipFileWork>(fname, true);
+    REQUIRE(g->getState() == BasicWork::State::WORK_SUCCESS);
+    REQUIRE(fs::exists(fname));
+    REQUIRE(fs::size(compressed) < contents.size());
+
+    std::string gz;
+    {
+        std::ifstream in(compressed, std::ifstream::binary);
+        gz.assign(std::istreambuf_iterator<char>(in),
+                  std::istreambuf_iterator<char>());
+    }
+    std::string out;
+    GunzipStream gunzip;
+    gunzip.write(gz.data(), gz.size(),
+                 [&](char const* data, size_t n) { out.append(data, n); });
+    REQUIRE(gunzip.atEnd());
+    REQUIRE(out == contents);
+
+    std::remove(fname.c_str());
+    auto u = wm.executeWork<GunzipFileWork>(compressed);
+    REQUIRE(u->getState() == BasicWork::State::WORK_SUCCESS);
+    REQUIRE(!fs::exists(compressed));
+    REQUIRE(fs::size(fname) == contents.size());
+}
+
+TEST_CASE("HistoryManager decompress and verify", "[history]")
+{
+    CatchupSimulation catchupSimulation{};
+    auto& app = catchupSimulation.getApp();
+    auto& wm = app.getWorkScheduler();
+
+    std::string fname =
+        app.getHistoryManager().localFilename("verifyme.xdr");
+    {
+        XDROutputFileStream out(app.getClock().getIOContext(), true);
+        out.open(fname);
+        for (uint32_t i = 1; i <= 100; ++i)
+        {
+            LedgerHeaderHistoryEntry lhhe;
+            lhhe.header.ledgerSeq = i;
+            out.writeOne(lhhe);
+        }
+    }
+    std::string contents;
+    {
+        std::ifstream in(fname, std::ifstream::binary);
+        contents.assign(std::istreambuf_iterator<char>(in),
+                        std::istreambuf_iterator<char>());
+    }
+    auto hash = sha256(contents);
+    std::string compressed = fname + ".gz";
+    auto g = wm.executeWork<GzipFileWork>(fname, true);
+    REQUIRE(g->getState() == BasicWork::State::WORK_SUCCESS);
+    std::string decompressed = fname + ".out";
+
+    SECTION("matching hash")
+    {
+        auto u = wm.executeWork<DecompressVerifyFileWork>(
+            compressed, decompressed, make_optional<uint256>(hash));
+        REQUIRE(u->getState() == BasicWork::State::WORK_SUCCESS);
+        REQUIRE(!fs::exists(compressed));
+        auto& verifiedBytes = app.getMetrics().NewMeter(
+            {"history", "decompress-verify", "bytes"}, "byte");
+        REQUIRE(verifiedBytes.count() == contents.size());
+        std::ifstream in(decompressed, std::ifstream::binary);
+        std::string out((std::istreambuf_iterator<char>(in)),
+                        std::istreambuf_iterator<char>());
+        REQUIRE(out == contents);
+    }
+    SECTION("mismatched hash")
+    {
+        auto u = wm.executeWork<DecompressVerifyFileWork>(
+            compressed, decompressed, make_optional<uint256>(sha256("x")));
+        REQUIRE(u->getState() == BasicWork::State::WORK_FAILURE);
+        REQUIRE(!fs::exists(decompressed));
+    }
+    SECTION("truncated XDR record")
+    {
+        {
+            std::ofstream out(fname, std::ofstream::binary |
+                                         std::ofstream::trunc);
+            out.write(contents.data(), contents.size() - 1);
+        }
+        std::remove(compressed.c_str());
+        g = wm.executeWork<GzipFileWork>(fname, true);
+        REQUIRE(g->getState() == BasicWork::State::WORK_SUCCESS);
+        auto u = wm.executeWork<DecompressVerifyFileWork>(compressed,
+                                                          decompressed);
+        REQUIRE(u->getState() == BasicWork::State::WORK_FAILURE);
+    }
+    SECTION("truncated gzip data")
+    {
+        auto size = fs::size(compressed);
+        std::string gz;
+        {
+            std::ifstream in(compressed, std::ifstream::binary);
+            gz.assign(std::istreambuf_iterator<char>(in),
+                      std::istreambuf_iterator<char>());
+        }
+        {
+            std::ofstream out(compressed, std::ofstream::binary |
+                                              std::ofstream::trunc);
+            out.write(gz.data(), size - 10);
+        }
+        auto u = wm.executeWork<DecompressVerifyFileWork>(compressed,
+                                                          decompressed);
+        REQUIRE(u->getState() == BasicWork::State::WORK_FAILURE);
+    }
+    SECTION("as it is downloaded")
+    {
+        auto slash = compressed.rfind('/');
+        auto transport = HistoryTransport::create(
+            app, "file://" + compressed.substr(0, slash));
+        REQUIRE(transport);
+        auto get = [&](uint256 const& h) {
+            bool done = false;
+            asio::error_code result;
+            auto transfer = transport->getFile(
+                compressed.substr(slash + 1),
+                DecompressVerifyFileWork::makeSink(
+                    app, compressed, decompressed, make_optional<uint256>(h)),
+                [&](asio::error_code const& ec) {
+                    done = true;
+                    result = ec;
+                });
+            while (!done)
+            {
+                app.getClock().crank(true);
+            }
+            return result;
+        };
+
+        REQUIRE(get(sha256("x")));
+        REQUIRE(!fs::exists(decompressed));
+
+        REQUIRE(!get(hash));
+        std::ifstream in(decompressed, std::ifstream::binary);
+        std::string out((std::istreambuf_iterator<char>(in)),
+                        std::istreambuf_iterator<char>());
+        REQUIRE(out == contents);
+    }
+}
+
 TEST_CASE("HistoryArchiveState get_put", "[history]")
 {
     CatchupSimulation catchupSimulation{};
@@ -320,6 +504,79 @@ TEST_CASE("Ledger chain verification", "[ledgerheaderverification]")
     }
 }
 
+TEST_CASE("Ledger chain verification scans checkpoints in parallel",
+          "[ledgerheaderverification]")
+{
+    Config cfg(getTestConfig(0));
+    cfg.WORKER_THREADS = 4;
+    VirtualClock clock;
+    auto cg = std::make_shared<TmpDirHistoryConfigurator>();
+    cg->configure(cfg, true);
+    Application::pointer app = createTestApplication(clock, cfg);
+    REQUIRE(app->getHistoryArchiveManager().initializeHistoryArchive(
+        cg->getArchiveDirName()));
+
+    auto tmpDir = app->getTmpDirManager().tmpDir("tmp-chain-test");
+    auto& wm = app->getWorkScheduler();
+    auto& hm = app->getHistoryManager();
+    auto& verifiedMeter = app->getMetrics().NewMeter(
+        {"history", "verify-ledger", "success"}, "event");
+
+    // More checkpoints than worker threads, all of them full
+    auto freq = hm.getCheckpointFrequency();
+    auto ledgerRange = LedgerRange::inclusive(2 * freq - 1, 12 * freq - 1);
+    CheckpointRange checkpointRange{ledgerRange, hm};
+    auto ledgerChainGenerator = TestLedgerChainGenerator{
+        *app,
+        app->getHistoryArchiveManager().getHistoryArchive(
+            cg->getArchiveDirName()),
+        checkpointRange, tmpDir};
+
+    LedgerHeaderHistoryEntry lcl, last;
+    std::tie(lcl, last) = ledgerChainGenerator.makeLedgerChainFiles(
+        HistoryManager::VERIFY_STATUS_OK);
+
+    // Returns the final state of the work and the number of ledgers it
+    // reported as verified
+    auto verify = [&]() {
+        auto lclPair = LedgerNumHashPair(lcl.header.ledgerSeq,
+                                         make_optional<Hash>(lcl.hash));
+        std::promise<LedgerNumHashPair> ledgerRangeEndPromise;
+        ledgerRangeEndPromise.set_value(LedgerNumHashPair(
+            last.header.ledgerSeq, make_optional<Hash>(last.hash)));
+        auto before = verifiedMeter.count();
+        auto w = wm.executeWork<VerifyLedgerChainWork>(
+            tmpDir, ledgerRange, lclPair,
+            ledgerRangeEndPromise.get_future().share());
+        return std::make_pair(w->getState(), verifiedMeter.count() - before);
+    };
+    auto removeCheckpoint = [&](uint32_t checkpoint) {
+        FileTransferInfo ft(tmpDir, HISTORY_FILE_TYPE_LEDGER, checkpoint);
+        std::remove(ft.localPath_nogz().c_str());
+    };
+
+    SECTION("every ledger verified once")
+    {
+        auto res = verify();
+        REQUIRE(res.first == BasicWork::State::WORK_SUCCESS);
+        REQUIRE(res.second == checkpointRange.mCount * freq);
+    }
+    SECTION("lowest checkpoint fails after all others are linked")
+    {
+        removeCheckpoint(checkpointRange.mFirst);
+        auto res = verify();
+        REQUIRE(res.first == BasicWork::State::WORK_FAILURE);
+        REQUIRE(res.second == (checkpointRange.mCount - 1) * freq);
+    }
+    SECTION("highest checkpoint fails before lower scans are linked")
+    {
+        removeCheckpoint(last.header.ledgerSeq);
+        auto res = verify();
+        REQUIRE(res.first == BasicWork::State::WORK_FAILURE);
+        REQUIRE(res.second == 0);
+    }
+}
+
 TEST_CASE("Tx results verification", "[batching][resultsverification]")
 {
     CatchupSimulation catchupSimulation{};
@@ -340,6 +597,14 @@ TEST_CASE("Tx results verification", "[batching][resultsverification]")
         auto verify =
             wm.executeWork<DownloadVerifyTxResultsWork>(range, tmpDir);
         REQUIRE(verify->getState() == BasicWork::State::WORK_SUCCESS);
+
+        auto& metrics = catchupSimulation.getApp().getMetrics();
+        auto& success = metrics.NewMeter(
+            {"history", "verify-tx-results", "success"}, "event");
+        auto& ledgers = metrics.NewMeter(
+            {"history", "verify-tx-results", "ledgers"}, "ledger");
+        REQUIRE(success.count() == range.mCount);
+        REQUIRE(ledgers.count() == checkpointLedger);
     }
     SECTION("header file missing")
     {
@@ -458,6 +723,764 @@ TEST_CASE("History catchup with extra validation", "[history][publish]")
     REQUIRE(catchupSimulation.catchupOffline(app, checkpointLedger, true));
 }
 
+TEST_CASE("History publish from transaction history segments",
+          "[history][publish]")
+{
+    CatchupSimulation catchupSimulation{
+        VirtualClock::VIRTUAL_TIME,
+        std::make_shared<TxHistorySegmentsHistoryConfigurator>()};
+    auto& app = catchupSimulation.getApp();
+    REQUIRE(TxHistorySegments::isEnabled(app.getConfig()));
+
+    auto checkpointLedger = catchupSimulation.getLastCheckpointLedger(2);
+    catchupSimulation.ensureOfflineCatchupPossible(checkpointLedger);
+
+    int rows = -1;
+    app.getDatabase().getSession() << "SELECT COUNT(*) FROM txhistory",
+        soci::into(rows);
+    REQUIRE(rows == 0);
+
+    // Replaying the published transactions stores the same results in the
+    // database of a node that doesn't use segments.
+    auto catchupApp = catchupSimulation.createCatchupApplication(
+        std::numeric_limits<uint32_t>::max(), Config::TESTDB_ON_DISK_SQLITE,
+        "app");
+    REQUIRE(!TxHistorySegments::isEnabled(catchupApp->getConfig()));
+    REQUIRE(catchupSimulation.catchupOffline(catchupApp, checkpointLedger));
+
+    size_t txs = 0;
+    for (uint32_t seq = 2; seq <= checkpointLedger; ++seq)
+    {
+        auto published =
+            TxHistorySegments::getTransactionHistoryResults(app, seq);
+        auto replayed =
+            getTransactionHistoryResults(catchupApp->getDatabase(), seq);
+        REQUIRE(published == replayed);
+        txs += published.results.size();
+    }
+    REQUIRE(txs > 0);
+}
+
+TEST_CASE("History publish through file url", "[history][publish]")
+{
+    CatchupSimulation catchupSimulation{
+        VirtualClock::VIRTUAL_TIME,
+        std::make_shared<FileURLHistoryConfigurator>()};
+    auto& app = catchupSimulation.getApp();
+    auto archive =
+        app.getHistoryArchiveManager().getWritableHistoryArchives().at(0);
+    REQUIRE(!archive->hasPutCmd());
+    REQUIRE(archive->getTransport());
+
+    auto checkpointLedger = catchupSimulation.getLastCheckpointLedger(2);
+    catchupSimulation.ensureOfflineCatchupPossible(checkpointLedger);
+
+    auto catchupApp = catchupSimulation.createCatchupApplication(
+        std::numeric_limits<uint32_t>::max(), Config::TESTDB_ON_DISK_SQLITE,
+        "app");
+    REQUIRE(catchupSimulation.catchupOffline(catchupApp, checkpointLedger));
+}
+
+TEST_CASE("History archive record of uploaded buckets", "[history][publish]")
+{
+    CatchupSimulation catchupSimulation{};
+    auto archive = catchupSimulation.getApp()
+                       .getHistoryArchiveManager()
+                       .getWritableHistoryArchives()
+                       .at(0);
+    auto hashOf = [](std::string const& s) { return binToHex(sha256(s)); };
+    auto makeState = [&](uint32_t ledger, std::string const& curr,
+                         std::string const& snap) {
+        HistoryArchiveState has;
+        has.currentLedger = ledger;
+        has.currentBuckets[0].curr = hashOf(curr);
+        has.currentBuckets[0].snap = hashOf(snap);
+        return has;
+    };
+    using Hashes = std::vector<std::string>;
+
+    REQUIRE(!archive->knowsUploadedBuckets());
+    archive->seedUploadedBuckets(makeState(63, "a", "b"));
+    REQUIRE(archive->knowsUploadedBuckets());
+
+    // Only buckets not in the archive are claimed, and only once
+    auto s1 = makeState(127, "a", "c");
+    auto s2 = makeState(191, "c", "d");
+    REQUIRE(archive->claimBucketsToUpload(s1) == Hashes{hashOf("c")});
+    REQUIRE(archive->claimBucketsToUpload(s2) == Hashes{hashOf("d")});
+
+    // A state is only written once all its buckets are uploaded, whoever
+    // claimed them
+    REQUIRE(archive->hasClaimedBuckets(s1));
+    REQUIRE(!archive->hasUploadedBuckets(s1));
+    archive->markBucketsUploaded({hashOf("d")});
+    REQUIRE(!archive->hasUploadedBuckets(s2));
+
+    SECTION("failed upload is claimed again")
+    {
+        archive->releaseBuckets({hashOf("c")});
+        REQUIRE(!archive->hasClaimedBuckets(s1));
+        REQUIRE(!archive->hasClaimedBuckets(s2));
+        REQUIRE(archive->claimBucketsToUpload(s1) == Hashes{hashOf("c")});
+        archive->markBucketsUploaded({hashOf("c")});
+        REQUIRE(archive->hasUploadedBuckets(s1));
+        REQUIRE(archive->hasUploadedBuckets(s2));
+    }
+    SECTION("uploaded buckets are not released")
+    {
+        archive->releaseBuckets({hashOf("c"), hashOf("d")});
+        REQUIRE(archive->claimBucketsToUpload(s2) == Hashes{hashOf("c")});
+    }
+    SECTION("buckets of older states are forgotten")
+    {
+        archive->pruneUploadedBuckets(s1);
+        // "b" is only referenced by the seed state; "c" and "d" are kept
+        // for the publish of s2 still in progress
+        REQUIRE(archive->claimBucketsToUpload(makeState(255, "b", "d")) ==
+                Hashes{hashOf("b")});
+        REQUIRE(archive->claimBucketsToUpload(makeState(319, "c", "a")) ==
+                Hashes{});
+    }
+}
+
+TEST_CASE("History concurrent publish with a failed upload",
+          "[history][publish]")
+{
+    auto configurator = std::make_shared<TmpDirHistoryConfigurator>();
+    CatchupSimulation catchupSimulation{VirtualClock::VIRTUAL_TIME,
+                                        configurator};
+    auto& app = catchupSimulation.getApp();
+    auto& hm = app.getHistoryManager();
+    auto archive =
+        app.getHistoryArchiveManager().getWritableHistoryArchives().at(0);
+    auto archiveDir = configurator->getArchiveDirName();
+
+    // Every state in the archive must only refer to buckets it has
+    auto checkArchive = [&]() {
+        auto stateFile = [&](uint32_t ledger) {
+            return archiveDir + "/" + HistoryArchiveState::remoteName(ledger);
+        };
+        for (uint32_t i = 1; i <= 2; ++i)
+        {
+            auto ledger = catchupSimulation.getLastCheckpointLedger(i);
+            if (!fs::exists(stateFile(ledger)))
+            {
+                continue;
+            }
+            HistoryArchiveState has;
+            has.load(stateFile(ledger));
+            for (auto const& b : has.differingBuckets(HistoryArchiveState{}))
+            {
+                REQUIRE(fs::exists(archiveDir + "/" +
+                                   fs::remoteName("bucket", b, "xdr.gz")));
+            }
+        }
+    };
+
+    // Queue two checkpoints, to be published at once
+    hm.setPublicationEnabled(false);
+    catchupSimulation.ensureLedgerAvailable(
+        catchupSimulation.getLastCheckpointLedger(2) + 1);
+    hm.setPublicationEnabled(true);
+    auto queued = hm.getPublishQueueStates();
+    REQUIRE(queued.size() == 2);
+    auto const& first = queued[0].currentLedger < queued[1].currentLedger
+                            ? queued[0]
+                            : queued[1];
+
+    // Another publish claims the buckets of the first checkpoint, as if it
+    // had started first, so the publishes under test upload none of them
+    archive->seedUploadedBuckets(HistoryArchiveState{});
+    auto claimed = archive->claimBucketsToUpload(first);
+    REQUIRE(!claimed.empty());
+
+    REQUIRE(hm.publishQueuedHistory() == 2);
+    testutil::crankFor(app.getClock(), std::chrono::seconds(10));
+    checkArchive();
+    REQUIRE(!fs::exists(archiveDir + "/" +
+                        HistoryArchiveState::remoteName(first.currentLedger)));
+    REQUIRE(hm.getPublishSuccessCount() == 0);
+
+    // The other publish fails to upload them
+    archive->releaseBuckets(claimed);
+    while (hm.getPublishSuccessCount() < 2)
+    {
+        app.getClock().crank(true);
+        checkArchive();
+    }
+    REQUIRE(hm.getPublishFailureCount() > 0);
+    REQUIRE(archive->hasUploadedBuckets(first));
+    checkArchive();
+
+    auto catchupApp = catchupSimulation.createCatchupApplication(
+        std::numeric_limits<uint32_t>::max(), Config::TESTDB_ON_DISK_SQLITE,
+        "app");
+    REQUIRE(catchupSimulation.catchupOffline(
+        catchupApp, catchupSimulation.getLastCheckpointLedger(2)));
+}
+
+TEST_CASE("History file url transport", "[history]")
+{
+    TmpDirManager tdm(std::string("fileurl-") + binToHex(randomBytes(8)));
+    auto archiveDir = tdm.tmpDir("archive");
+    auto localDir = tdm.tmpDir("local");
+    VirtualClock clock;
+    auto app = createTestApplication(clock, getTestConfig());
+    auto transport =
+        HistoryTransport::create(*app, "file://" + archiveDir.getName());
+    REQUIRE(transport);
+    REQUIRE(transport->canPut());
+
+    auto waitFor = [&](std::function<std::shared_ptr<HistoryTransfer>(
+                           HistoryTransport::Callback)>
+                           start) {
+        bool done = false;
+        asio::error_code result;
+        auto transfer = start([&](asio::error_code const& ec) {
+            done = true;
+            result = ec;
+        });
+        REQUIRE(!done);
+        while (!done)
+        {
+            clock.crank(true);
+        }
+        return result;
+    };
+
+    auto src = localDir.getName() + "/src.txt";
+    {
+        std::ofstream out(src);
+        out << "some history";
+    }
+    REQUIRE(!waitFor([&](HistoryTransport::Callback cb) {
+        return transport->makeDir("a/b", cb);
+    }));
+    REQUIRE(!waitFor([&](HistoryTransport::Callback cb) {
+        return transport->putFile(src, "a/b/file.txt", cb);
+    }));
+    REQUIRE(fs::exists(archiveDir.getName() + "/a/b/file.txt"));
+
+    auto dst = localDir.getName() + "/dst.txt";
+    REQUIRE(!waitFor([&](HistoryTransport::Callback cb) {
+        return transport->getFile("a/b/file.txt", dst, cb);
+    }));
+    std::ifstream in(dst);
+    std::string contents((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+    REQUIRE(contents == "some history");
+
+    auto ec = waitFor([&](HistoryTransport::Callback cb) {
+        return transport->getFile("a/b/missing.txt", dst + ".2", cb);
+    });
+    REQUIRE(ec == std::errc::no_such_file_or_directory);
+    REQUIRE(!fs::exists(dst + ".2"));
+
+    // cancelled transfers never call back
+    bool called = false;
+    auto transfer = transport->getFile(
+        "a/b/file.txt", localDir.getName() + "/cancelled.txt",
+        [&](asio::error_code const&) { called = true; });
+    transfer->cancel();
+    while (clock.crank(false) > 0)
+    {
+    }
+    REQUIRE(!called);
+
+    // unsupported schemes are left to the commands
+    REQUIRE(!HistoryTransport::create(*app, "https://example.com/archive"));
+}
+
+namespace
+{
+size_t const TEST_HTTP_CHUNK_SIZE = 5;
+
+// Answers requests from a table of canned responses by path, or of bodies it
+// sends with a Content-Length or, in chunked mode, in chunks; anything else is
+// a 404. Each connection is closed after one response unless in keep-alive
+// mode, and the server keeps count of the connections it accepted.
+class TestHttpServer
+{
+    struct Session : std::enable_shared_from_this<Session>
+    {
+        // nullptr once the server is gone
+        TestHttpServer* mServer;
+        asio::ip::tcp::socket mSocket;
+        asio::streambuf mBuf;
+        std::string mResponse;
+        size_t mServed{0};
+        bool mWaiting{false};
+        bool mClosed{false};
+
+        Session(TestHttpServer& server, asio::io_context& ctx)
+            : mServer(&server), mSocket(ctx)
+        {
+        }
+
+        void
+        close()
+        {
+            asio::error_code ignored;
+            mSocket.shutdown(asio::ip::tcp::socket::shutdown_both, ignored);
+            mSocket.close(ignored);
+            if (!mClosed && mServer)
+            {
+                --mServer->mOpen;
+            }
+            mClosed = true;
+        }
+
+        void
+        readRequest()
+        {
+            auto self = shared_from_this();
+            mWaiting = true;
+            asio::async_read_until(
+                mSocket, mBuf, "\r\n\r\n",
+                [self](asio::error_code const& ec, size_t n) {
+                    self->mWaiting = false;
+                    if (!self->mServer)
+                    {
+                        return;
+                    }
+                    if (ec)
+                    {
+                        self->close();
+                        return;
+                    }
+                    auto data = self->mBuf.data();
+                    std::istringstream in(
+                        std::string(asio::buffers_begin(data),
+                                    asio::buffers_begin(data) + n));
+                    self->mBuf.consume(n);
+                    std::string method, path;
+                    in >> method >> path;
+                    ++self->mServer->mRequests;
+                    self->mResponse = self->mServer->respond(path);
+                    asio::async_write(
+                        self->mSocket, asio::buffer(self->mResponse),
+                        [self](asio::error_code const& ec, size_t) {
+                            if (!self->mServer)
+                            {
+                                return;
+                            }
+                            ++self->mServed;
+                            if (ec || !self->mServer->mKeepAlive)
+                            {
+                                self->close();
+                                return;
+                            }
+                            self->readRequest();
+                        });
+                });
+        }
+    };
+
+    asio::io_context& mCtx;
+    asio::ip::tcp::acceptor mAcceptor;
+    std::vector<std::weak_ptr<Session>> mSessions;
+
+    void
+    accept()
+    {
+        auto session = std::make_shared<Session>(*this, mCtx);
+        mAcceptor.async_accept(session->mSocket,
+                               [this, session](asio::error_code const& ec) {
+                                   if (ec)
+                                   {
+                                       return;
+                                   }
+                                   ++mConnections;
+                                   ++mOpen;
+                                   mMaxOpen = std::max(mMaxOpen, mOpen);
+                                   mSessions.emplace_back(session);
+                                   session->readRequest();
+                                   accept();
+                               });
+    }
+
+    std::string
+    respond(std::string const& path)
+    {
+        auto it = mResponses.find(path);
+        if (it != mResponses.end())
+        {
+            return it->second;
+        }
+        auto body = mBodies.find(path);
+        if (body == mBodies.end())
+        {
+            return "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        }
+        if (!mChunked)
+        {
+            return fmt::format(
+                "HTTP/1.1 200 OK\r\nContent-Length: {}\r\n\r\n{}",
+                body->second.size(), body->second);
+        }
+        std::string res =
+            "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n";
+        for (size_t pos = 0; pos < body->second.size();
+             pos += TEST_HTTP_CHUNK_SIZE)
+        {
+            auto chunk = body->second.substr(pos, TEST_HTTP_CHUNK_SIZE);
+            res += fmt::format("{:x}\r\n{}\r\n", chunk.size(), chunk);
+        }
+        return res + "0\r\n\r\n";
+    }
+
+  public:
+    std::map<std::string, std::string> mResponses;
+    std::map<std::string, std::string> mBodies;
+    bool mKeepAlive{false};
+    bool mChunked{false};
+    size_t mRequests{0};
+    // connections accepted, open now, and open at once at most
+    size_t mConnections{0};
+    size_t mOpen{0};
+    size_t mMaxOpen{0};
+
+    explicit TestHttpServer(asio::io_context& ctx)
+        : mCtx(ctx)
+        , mAcceptor(ctx, asio::ip::tcp::endpoint(
+                             asio::ip::address_v4::loopback(), 0))
+    {
+        accept();
+    }
+
+    ~TestHttpServer()
+    {
+        asio::error_code ignored;
+        mAcceptor.close(ignored);
+        for (auto const& weak : mSessions)
+        {
+            auto session = weak.lock();
+            if (session)
+            {
+                session->close();
+                session->mServer = nullptr;
+            }
+        }
+    }
+
+    unsigned short
+    port() const
+    {
+        return mAcceptor.local_endpoint().port();
+    }
+
+    // Closes the kept-alive connections waiting for a next request, as
+    // servers do after some idle time; returns how many.
+    size_t
+    closeIdle()
+    {
+        size_t n = 0;
+        for (auto const& weak : mSessions)
+        {
+            auto session = weak.lock();
+            if (session && session->mWaiting && session->mServed > 0 &&
+                !session->mClosed)
+            {
+                session->close();
+                ++n;
+            }
+        }
+        return n;
+    }
+};
+}
+
+TEST_CASE("History http url transport", "[history]")
+{
+    TmpDirManager tdm(std::string("httpurl-") + binToHex(randomBytes(8)));
+    auto archiveDir = tdm.tmpDir("archive");
+    auto localDir = tdm.tmpDir("local");
+    VirtualClock clock(VirtualClock::REAL_TIME);
+    size_t const maxConnections = 2;
+    auto cfg = getTestConfig();
+    cfg.MAX_HISTORY_ARCHIVE_CONNECTIONS = static_cast<int>(maxConnections);
+    auto app = createTestApplication(clock, cfg);
+    TestHttpServer server(clock.getIOContext());
+    auto hostPort = fmt::format("127.0.0.1:{}", server.port());
+
+    std::string body = "some history";
+    server.mBodies["/archive/file.txt"] = body;
+    server.mResponses["/archive/moved.txt"] =
+        "HTTP/1.1 302 Found\r\nLocation: /archive/file.txt\r\n"
+        "Content-Length: 0\r\n\r\n";
+    server.mResponses["/archive/away.txt"] = fmt::format(
+        "HTTP/1.1 301 Moved Permanently\r\n"
+        "Location: http://localhost:{}/archive/file.txt\r\n"
+        "Content-Length: 0\r\n\r\n",
+        server.port());
+    server.mResponses["/archive/loop.txt"] =
+        "HTTP/1.1 307 Temporary Redirect\r\nLocation: /archive/loop.txt\r\n"
+        "Content-Length: 0\r\n\r\n";
+
+    auto transport =
+        HistoryTransport::create(*app, "http://" + hostPort + "/archive");
+    REQUIRE(transport);
+    REQUIRE(!transport->canPut());
+
+    auto get = [&](std::string const& remote, std::string const& local) {
+        bool done = false;
+        asio::error_code result;
+        auto transfer = transport->getFile(
+            remote, local, [&](asio::error_code const& ec) {
+                done = true;
+                result = ec;
+            });
+        while (!done)
+        {
+            clock.crank(true);
+        }
+        return result;
+    };
+    auto contents = [](std::string const& path) {
+        std::ifstream in(path);
+        return std::string((std::istreambuf_iterator<char>(in)),
+                           std::istreambuf_iterator<char>());
+    };
+
+    auto dst = localDir.getName() + "/dst.txt";
+    REQUIRE(!get("file.txt", dst));
+    REQUIRE(contents(dst) == body);
+
+    SECTION("redirects are followed")
+    {
+        REQUIRE(!get("moved.txt", dst + ".moved"));
+        REQUIRE(contents(dst + ".moved") == body);
+        REQUIRE(!get("away.txt", dst + ".away"));
+        REQUIRE(contents(dst + ".away") == body);
+        REQUIRE(get("loop.txt", dst + ".loop") ==
+                std::errc::too_many_links);
+        REQUIRE(!fs::exists(dst + ".loop"));
+    }
+    SECTION("missing files fail")
+    {
+        REQUIRE(get("missing.txt", dst + ".missing") ==
+                std::errc::no_such_file_or_directory);
+        REQUIRE(!fs::exists(dst + ".missing"));
+    }
+    SECTION("a failed transfer falls back to the get command")
+    {
+        {
+            std::ofstream out(archiveDir.getName() + "/only-on-disk.txt");
+            out << body;
+        }
+        std::string name = "fallback";
+        auto archive = std::make_shared<HistoryArchive>(
+            *app, HistoryArchiveConfiguration{
+                      name, "cp " + archiveDir.getName() + "/{0} {1}", "", "",
+                      "http://" + hostPort + "/archive"});
+        REQUIRE(archive->getTransport());
+        auto requests = server.mRequests;
+        auto work = app->getWorkScheduler().executeWork<GetRemoteFileWork>(
+            "only-on-disk.txt", dst + ".fallback", archive,
+            BasicWork::RETRY_NEVER);
+        REQUIRE(work->getState() == BasicWork::State::WORK_SUCCESS);
+        REQUIRE(server.mRequests == requests + 1);
+        REQUIRE(contents(dst + ".fallback") == body);
+    }
+    SECTION("kept-alive connections are reused, up to the pool bound")
+    {
+        server.mKeepAlive = true;
+        server.mChunked = true;
+        REQUIRE(body.size() > TEST_HTTP_CHUNK_SIZE);
+        auto pooled =
+            HistoryTransport::create(*app, "http://" + hostPort + "/archive");
+        auto connections = server.mConnections;
+        auto requests = server.mRequests;
+        server.mMaxOpen = server.mOpen;
+
+        size_t const n = 8;
+        size_t done = 0;
+        std::vector<std::shared_ptr<HistoryTransfer>> transfers;
+        for (size_t i = 0; i < n; ++i)
+        {
+            transfers.emplace_back(pooled->getFile(
+                "file.txt", dst + ".pooled" + std::to_string(i),
+                [&](asio::error_code const& ec) {
+                    REQUIRE(!ec);
+                    ++done;
+                }));
+        }
+        while (done < n)
+        {
+            clock.crank(true);
+        }
+        for (size_t i = 0; i < n; ++i)
+        {
+            REQUIRE(contents(dst + ".pooled" + std::to_string(i)) == body);
+        }
+        REQUIRE(server.mRequests == requests + n);
+        REQUIRE(server.mConnections == connections + maxConnections);
+        REQUIRE(server.mMaxOpen <= maxConnections);
+
+        // The server drops the idle connections; the next transfer finds
+        // its connection closed and resends the request on a new one.
+        REQUIRE(server.closeIdle() == maxConnections);
+        bool reconnected = false;
+        auto transfer = pooled->getFile(
+            "file.txt", dst + ".reconnected", [&](asio::error_code const& ec) {
+                REQUIRE(!ec);
+                reconnected = true;
+            });
+        while (!reconnected)
+        {
+            clock.crank(true);
+        }
+        REQUIRE(contents(dst + ".reconnected") == body);
+        REQUIRE(server.mRequests == requests + n + 1);
+        REQUIRE(server.mConnections == connections + maxConnections + 1);
+    }
+}
+
+TEST_CASE("Transaction history segments discard torn records", "[history]")
+{
+    TmpDirManager tdm(std::string("txhistory-") + binToHex(randomBytes(8)));
+    auto dir = tdm.tmpDir("segments");
+    VirtualClock clock;
+    auto cfg = getTestConfig();
+    cfg.TX_HISTORY_SEGMENT_PATH = dir.getName();
+    auto app = createTestApplication(clock, cfg);
+    app->start();
+
+    auto root = TestAccount::createRoot(*app);
+    auto a1 =
+        root.create("a1", app->getLedgerManager().getLastMinBalance(2) * 10);
+    closeLedgerOn(*app, 2, 1, 1, 2016, {a1.tx({payment(root, 100)})});
+    closeLedgerOn(*app, 3, 2, 1, 2016, {root.tx({payment(a1, 100)})});
+
+    auto results = TxHistorySegments::getTransactionHistoryResults(*app, 3);
+    REQUIRE(results.results.size() == 1);
+
+    // As left by a crash in the middle of appending the next record.
+    auto checkpoint = app->getHistoryManager().checkpointContainingLedger(3);
+    auto path = dir.getName() + "/" +
+                fs::baseName("txhistory", fs::hexStr(checkpoint), "xdr.gz");
+    REQUIRE(fs::exists(path));
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out.write("\x1f\x8b\x08\x00torn", 8);
+    }
+    REQUIRE(TxHistorySegments::getTransactionHistoryResults(*app, 3) ==
+            results);
+
+    // After a restart, ledger 3 is closed again; the copy appended then
+    // supersedes the first one.
+    LedgerCloseMeta lcm;
+    TxHistorySegments::load(*app, 3, 1,
+                            [&](LedgerCloseMeta const& m) { lcm = m; });
+    lcm.v0().txProcessing.clear();
+    TxHistorySegments segments(*app);
+    segments.append(lcm);
+
+    REQUIRE(TxHistorySegments::getTransactionHistoryResults(*app, 2)
+                .results.size() == 1);
+    REQUIRE(TxHistorySegments::getTransactionHistoryResults(*app, 3)
+                .results.empty());
+
+    // and the torn record is gone
+    std::string xdr;
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::string gz((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+        GunzipStream gunzip;
+        gunzip.write(gz.data(), gz.size(), [&](char const* data, size_t n) {
+            xdr.append(data, n);
+        });
+        REQUIRE(gunzip.atEnd());
+    }
+    size_t records = 0;
+    for (size_t pos = 0; pos < xdr.size(); ++records)
+    {
+        auto const* p = reinterpret_cast<unsigned char const*>(&xdr[pos]);
+        pos += 4 + ((static_cast<size_t>(p[0] & 0x7F) << 24) |
+                    (static_cast<size_t>(p[1]) << 16) |
+                    (static_cast<size_t>(p[2]) << 8) | p[3]);
+    }
+    REQUIRE(records == 3);
+
+    TxHistorySegments::deleteOldSegments(*app, checkpoint, 1);
+    REQUIRE(!fs::exists(path));
+}
+
+TEST_CASE("Transaction history segments are indexed by ledger", "[history]")
+{
+    TmpDirManager tdm(std::string("txhistory-") + binToHex(randomBytes(8)));
+    auto dir = tdm.tmpDir("segments");
+    VirtualClock clock;
+    auto cfg = getTestConfig();
+    cfg.TX_HISTORY_SEGMENT_PATH = dir.getName();
+    auto app = createTestApplication(clock, cfg);
+    app->start();
+
+    auto& hm = app->getHistoryManager();
+    auto freq = hm.getCheckpointFrequency();
+    auto first = hm.checkpointContainingLedger(1);
+    auto last = first + 3 * freq;
+    for (uint32_t seq = 2; seq <= last + 2; ++seq)
+    {
+        closeLedgerOn(*app, seq, 1, 1, 2016);
+    }
+    auto path = [&](uint32_t checkpoint) {
+        return dir.getName() + "/" +
+               fs::baseName("txhistory", fs::hexStr(checkpoint), "xdr.gz");
+    };
+    for (auto checkpoint = first; checkpoint <= last + freq;
+         checkpoint += freq)
+    {
+        REQUIRE(fs::exists(path(checkpoint)));
+    }
+
+    // The index decompresses to nothing.
+    {
+        std::ifstream in(path(first), std::ios::binary);
+        std::string gz((std::istreambuf_iterator<char>(in)),
+                       std::istreambuf_iterator<char>());
+        GunzipStream gunzip;
+        size_t n = 0;
+        gunzip.write(gz.data(), gz.size(),
+                     [&](char const*, size_t k) { n += k; });
+        REQUIRE(gunzip.atEnd());
+        REQUIRE(n > 0);
+    }
+
+    auto loaded = [&](uint32_t begin, uint32_t count) {
+        std::vector<uint32_t> seqs;
+        TxHistorySegments::load(*app, begin, count,
+                                [&](LedgerCloseMeta const& lcm) {
+                                    seqs.emplace_back(
+                                        lcm.v0().ledgerHeader.header.ledgerSeq);
+                                });
+        return seqs;
+    };
+    REQUIRE(loaded(first - 1, 2) == std::vector<uint32_t>{first - 1, first});
+
+    // Readers of a complete segment seek to the ledgers they want: a corrupt
+    // first record only hides its own ledger.
+    {
+        std::fstream f(path(first),
+                       std::ios::binary | std::ios::in | std::ios::out);
+        f.seekp(0);
+        f.put('\0');
+    }
+    REQUIRE(loaded(first - 1, 2) == std::vector<uint32_t>{first - 1, first});
+    REQUIRE(loaded(2, 1).empty());
+
+    // Old segments go oldest first, as many as count ledgers fill.
+    TxHistorySegments::deleteOldSegments(*app, first + freq, 1);
+    REQUIRE(!fs::exists(path(first)));
+    REQUIRE(fs::exists(path(first + freq)));
+    TxHistorySegments::deleteOldSegments(*app, first + 2 * freq, freq + 1);
+    REQUIRE(!fs::exists(path(first + freq)));
+    REQUIRE(!fs::exists(path(first + 2 * freq)));
+    REQUIRE(fs::exists(path(last)));
+    REQUIRE(fs::exists(path(last + freq)));
+}
+
 TEST_CASE("Publish works correctly post shadow removal", "[history]")
 {
     // Given a HAS, verify that appropriate levels have "next" cleared, while
@@ -747,6 +1770,114 @@ TEST_CASE("History prefix catchup", "[history][catchup]")
     REQUIRE(b->getLedgerManager().getLastClosedLedgerNum() == 2 * freq + 7);
 }
 
+TEST_CASE("Catchup downloads transactions ahead of apply in a bounded window",
+          "[history][catchup]")
+{
+    CatchupSimulation catchupSimulation{};
+    auto checkpointLedger = catchupSimulation.getLastCheckpointLedger(5);
+    catchupSimulation.ensureOfflineCatchupPossible(checkpointLedger);
+
+    VirtualClock clock(VirtualClock::REAL_TIME);
+    auto cfg = getTestConfig(1);
+    cfg.CATCHUP_LOOKAHEAD_CHECKPOINTS = 3;
+    catchupSimulation.getHistoryConfigurator().configure(cfg, false);
+    auto app = createTestApplication(clock, cfg);
+    app->start();
+
+    auto& hm = app->getHistoryManager();
+    auto& lm = app->getLedgerManager();
+    auto freq = hm.getCheckpointFrequency();
+    auto lookahead = cfg.CATCHUP_LOOKAHEAD_CHECKPOINTS;
+    auto archive = app->getHistoryArchiveManager()
+                       .selectRandomReadableHistoryArchive();
+    auto range = LedgerRange::inclusive(lm.getLastClosedLedgerNum() + 1,
+                                        checkpointLedger);
+    auto first = hm.checkpointContainingLedger(range.mFirst);
+
+    TmpDir dir(app->getTmpDirManager().tmpDir("lookahead"));
+    auto getLedgers = app->getWorkScheduler().executeWork<BatchDownloadWork>(
+        CheckpointRange{range, hm}, HISTORY_FILE_TYPE_LEDGER, dir, archive);
+    REQUIRE(getLedgers->getState() == BasicWork::State::WORK_SUCCESS);
+
+    // checkpoints whose transactions are downloaded, in full or in part
+    auto downloaded = [&]() {
+        std::vector<uint32_t> res;
+        for (auto c = first; c <= checkpointLedger; c += freq)
+        {
+            FileTransferInfo ft(dir, HISTORY_FILE_TYPE_TRANSACTIONS, c);
+            if (fs::exists(ft.localPath_nogz()) ||
+                fs::exists(ft.localPath_gz()) ||
+                fs::exists(ft.localPath_gz_tmp()))
+            {
+                res.emplace_back(c);
+            }
+        }
+        return res;
+    };
+    auto crankFor = [&](std::chrono::milliseconds d) {
+        auto end = clock.now() + d;
+        while (clock.now() < end)
+        {
+            clock.crank(false);
+        }
+    };
+
+    // The transactions of the first checkpoint are late.
+    FileTransferInfo late(dir, HISTORY_FILE_TYPE_TRANSACTIONS, first);
+    auto remote =
+        catchupSimulation.getHistoryConfigurator().getArchiveDirName() + "/" +
+        late.remoteName();
+    REQUIRE(std::rename(remote.c_str(), (remote + ".late").c_str()) == 0);
+
+    bool canApply = false;
+    auto lastApplied = lm.getLastClosedLedgerHeader();
+    auto work = app->getWorkScheduler().scheduleWork<DownloadApplyTxsWork>(
+        dir, range, lastApplied, false, archive, [&]() { return canApply; });
+
+    // Only the window ahead of the first checkpoint is downloaded, and
+    // nothing is applied before it may be.
+    std::vector<uint32_t> window;
+    for (uint32_t i = 1; i < lookahead; ++i)
+    {
+        window.emplace_back(first + i * freq);
+    }
+    while (downloaded() != window)
+    {
+        REQUIRE(downloaded().size() < lookahead);
+        clock.crank(false);
+    }
+    crankFor(std::chrono::milliseconds(500));
+    REQUIRE(downloaded() == window);
+    REQUIRE(lm.getLastClosedLedgerNum() < range.mFirst);
+
+    // Later checkpoints aren't applied before the first one.
+    canApply = true;
+    crankFor(std::chrono::milliseconds(500));
+    REQUIRE(lm.getLastClosedLedgerNum() < range.mFirst);
+
+    // Once it arrives, checkpoints are applied in order, the window slides
+    // and the transactions of each checkpoint are removed once it's applied.
+    REQUIRE(std::rename((remote + ".late").c_str(), remote.c_str()) == 0);
+    auto lcl = lm.getLastClosedLedgerNum();
+    while (work->getState() == BasicWork::State::WORK_RUNNING ||
+           work->getState() == BasicWork::State::WORK_WAITING)
+    {
+        clock.crank(false);
+        REQUIRE(lm.getLastClosedLedgerNum() >= lcl);
+        lcl = lm.getLastClosedLedgerNum();
+        auto files = downloaded();
+        REQUIRE(files.size() <= lookahead);
+        for (auto c : files)
+        {
+            REQUIRE(c >= lcl);
+        }
+    }
+    REQUIRE(work->getState() == BasicWork::State::WORK_SUCCESS);
+    REQUIRE(lm.getLastClosedLedgerNum() == checkpointLedger);
+    REQUIRE(lastApplied.header.ledgerSeq == checkpointLedger);
+    REQUIRE(downloaded().empty());
+}
+
 TEST_CASE("Catchup post-shadow-removal works", "[history]")
 {
     uint32_t newProto = Bucket::FIRST_PROTOCOL_SHADOWS_REMOVED;
@@ -125,6 +125,39 @@ RealGenesisTmpDirHistoryConfigurator::configure(Config& mCfg,
     return mCfg;
 }
 
+TxHistorySegmentsHistoryConfigurator::TxHistorySegmentsHistoryConfigurator()
+    : mSegmentsName("txhistory-" + binToHex(randomBytes(8)))
+    , mSegmentsTmp(mSegmentsName)
+{
+}
+
+Config&
+TxHistorySegmentsHistoryConfigurator::configure(Config& mCfg,
+                                                bool writable) const
+{
+    TmpDirHistoryConfigurator::configure(mCfg, writable);
+    // only the publishing application stores history in segments
+    if (writable)
+    {
+        mCfg.TX_HISTORY_SEGMENT_PATH = mSegmentsName;
+    }
+    return mCfg;
+}
+
+Config&
+FileURLHistoryConfigurator::configure(Config& mCfg, bool writable) const
+{
+    TmpDirHistoryConfigurator::configure(mCfg, writable);
+    // a url makes the archive writable, so read-only nodes keep the commands
+    if (writable)
+    {
+        std::string d = getArchiveDirName();
+        mCfg.HISTORY[d] =
+            HistoryArchiveConfiguration{d, "", "", "", "file://" + d};
+    }
+    return mCfg;
+}
+
 BucketOutputIteratorForTesting::BucketOutputIteratorForTesting(
     std::string const& tmpDir, uint32_t protocolVersion, MergeCounters& mc,
     asio::io_context& ctx)
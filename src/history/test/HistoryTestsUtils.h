@@ -98,6 +98,25 @@ class RealGenesisTmpDirHistoryConfigurator : public TmpDirHistoryConfigurator
     Config& configure(Config& cfg, bool writable) const override;
 };
 
+// Publishes transaction history from TxHistorySegments.
+class TxHistorySegmentsHistoryConfigurator : public TmpDirHistoryConfigurator
+{
+    std::string mSegmentsName;
+    TmpDirManager mSegmentsTmp;
+
+  public:
+    TxHistorySegmentsHistoryConfigurator();
+
+    Config& configure(Config& cfg, bool writable) const override;
+};
+
+// Publishes through a file:// url instead of put and mkdir commands.
+class FileURLHistoryConfigurator : public TmpDirHistoryConfigurator
+{
+  public:
+    Config& configure(Config& cfg, bool writable) const override;
+};
+
 class BucketOutputIteratorForTesting : public BucketOutputIterator
 {
     const size_t NUM_ITEMS_PER_BUCKET = 5;
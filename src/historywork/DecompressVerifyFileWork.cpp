@@ -0,0 +1,329 @@
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "historywork/DecompressVerifyFileWork.h"
+#include "crypto/Hex.h"
+#include "crypto/SHA.h"
+#include "history/HistoryTransport.h"
+#include "main/Application.h"
+#include "main/ErrorMessages.h"
+#include "util/Fs.h"
+#include "util/GzipStream.h"
+#include "util/Logging.h"
+#include <fmt/format.h>
+#include <medida/meter.h>
+#include <medida/metrics_registry.h>
+
+#include <Tracy.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+namespace diamnet
+{
+
+namespace
+{
+// Follows the record marks of an XDR record stream fed in arbitrary pieces.
+class XDRFramingCheck
+{
+    uint32_t mMark{0};
+    uint32_t mMarkBytes{0};
+    uint64_t mRemaining{0};
+
+  public:
+    void
+    add(char const* data, size_t n)
+    {
+        while (n > 0)
+        {
+            if (mRemaining > 0)
+            {
+                auto skip = static_cast<size_t>(
+                    std::min<uint64_t>(mRemaining, n));
+                mRemaining -= skip;
+                data += skip;
+                n -= skip;
+                continue;
+            }
+            // 4 bytes of size, big-endian, with the high (continuation) bit
+            mMark = (mMark << 8) | static_cast<uint8_t>(*data);
+            ++data;
+            --n;
+            if (++mMarkBytes == 4)
+            {
+                mRemaining = mMark & 0x7fffffff;
+                mMark = 0;
+                mMarkBytes = 0;
+            }
+        }
+    }
+
+    // True if the stream ends at a record boundary.
+    bool
+    complete() const
+    {
+        return mMarkBytes == 0 && mRemaining == 0;
+    }
+};
+}
+
+// Inflates gzip input as it is written, checks that the output is a complete
+// stream of XDR records, hashes it if an expected hash is given, and writes it
+// to a temporary file renamed into place on commit.
+class DecompressVerifySink : public HistoryFileSink
+{
+    std::string const mName;
+    std::string const mFilename;
+    std::string const mTmp;
+    optional<uint256> const mHash;
+    medida::Meter& mVerifiedBytes;
+    GunzipStream mGunzip;
+    XDRFramingCheck mFraming;
+    SHA256 mHasher;
+    std::ofstream mOut;
+    uint64_t mBytes{0};
+    std::chrono::steady_clock::time_point mStart;
+    bool mCommitted{false};
+
+    void
+    open()
+    {
+        if (mOut.is_open())
+        {
+            return;
+        }
+        mStart = std::chrono::steady_clock::now();
+        mOut.open(mTmp, std::ofstream::binary | std::ofstream::trunc);
+        if (!mOut)
+        {
+            throw std::runtime_error(
+                fmt::format("Error opening file {}", mTmp));
+        }
+        mOut.exceptions(std::ios::failbit | std::ios::badbit);
+    }
+
+  public:
+    // A run abandoned while still writing can't clobber the file of a later
+    // one, as each writes a file of its own.
+    DecompressVerifySink(Application& app, std::string const& name,
+                         std::string const& filename, optional<uint256> hash)
+        : mName(name)
+        , mFilename(filename)
+        , mTmp(filename + ".tmp-" + std::to_string(++sTmpFiles))
+        , mHash(hash)
+        , mVerifiedBytes(app.getMetrics().NewMeter(
+              {"history", "decompress-verify", "bytes"}, "byte"))
+    {
+    }
+
+    ~DecompressVerifySink() override
+    {
+        if (!mCommitted)
+        {
+            // a failed write leaves the stream failed, and close() must not
+            // throw out of a destructor
+            mOut.exceptions(std::ios::goodbit);
+            mOut.close();
+            std::remove(mTmp.c_str());
+        }
+    }
+
+    void
+    write(char const* data, size_t n) override
+    {
+        ZoneScoped;
+        open();
+        mGunzip.write(data, n, [&](char const* out, size_t m) {
+            mBytes += m;
+            mFraming.add(out, m);
+            if (mHash)
+            {
+                mHasher.add(ByteSlice(out, m));
+            }
+            mOut.write(out, m);
+        });
+    }
+
+    asio::error_code
+    finish() override
+    {
+        ZoneScoped;
+        try
+        {
+            open();
+            mOut.close();
+            if (!mGunzip.atEnd())
+            {
+                throw std::runtime_error("truncated gzip data");
+            }
+            if (!mFraming.complete())
+            {
+                throw std::runtime_error("truncated XDR record");
+            }
+        }
+        catch (std::exception const& e)
+        {
+            CLOG(WARNING, "History")
+                << "Failed decompressing " << mName << ": " << e.what();
+            return std::make_error_code(std::errc::io_error);
+        }
+
+        if (mHash)
+        {
+            auto vHash = mHasher.finish();
+            if (vHash != *mHash)
+            {
+                CLOG(WARNING, "History")
+                    << "FAILED verifying hash for " << mName;
+                CLOG(WARNING, "History")
+                    << "expected hash: " << binToHex(*mHash);
+                CLOG(WARNING, "History")
+                    << "computed hash: " << binToHex(vHash);
+                CLOG(WARNING, "History") << POSSIBLY_CORRUPTED_HISTORY;
+                return std::make_error_code(std::errc::io_error);
+            }
+            CLOG(DEBUG, "History") << "Verified hash (" << hexAbbrev(*mHash)
+                                   << ") for " << mName;
+        }
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - mStart;
+        CLOG(DEBUG, "History") << fmt::format(
+            "Decompressed and verified {}: {:.1f} MB at {:.1f} MB/s", mName,
+            mBytes / 1e6, mBytes / 1e6 / std::max(elapsed.count(), 1e-6));
+        return asio::error_code();
+    }
+
+    asio::error_code
+    commit() override
+    {
+#ifdef _WIN32
+        std::remove(mFilename.c_str());
+#endif
+        if (std::rename(mTmp.c_str(), mFilename.c_str()) != 0)
+        {
+            CLOG(WARNING, "History")
+                << "Failed to rename " << mTmp << " to " << mFilename;
+            return std::make_error_code(std::errc::io_error);
+        }
+        mCommitted = true;
+        mVerifiedBytes.Mark(mBytes);
+        return asio::error_code();
+    }
+
+    static std::atomic<uint64_t> sTmpFiles;
+};
+
+std::atomic<uint64_t> DecompressVerifySink::sTmpFiles{0};
+
+static asio::error_code
+readInto(std::string const& filenameGz, HistoryFileSink& sink)
+{
+    ZoneScoped;
+    try
+    {
+        std::ifstream in(filenameGz, std::ifstream::binary);
+        if (!in)
+        {
+            throw std::runtime_error(
+                fmt::format("Error opening file {}", filenameGz));
+        }
+        in.exceptions(std::ios::badbit);
+        std::vector<char> buf(fs::readbufsz());
+        while (in)
+        {
+            in.read(buf.data(), buf.size());
+            sink.write(buf.data(), static_cast<size_t>(in.gcount()));
+        }
+    }
+    catch (std::exception const& e)
+    {
+        CLOG(WARNING, "History")
+            << "Failed decompressing " << filenameGz << ": " << e.what();
+        return std::make_error_code(std::errc::io_error);
+    }
+    return sink.finish();
+}
+
+std::shared_ptr<HistoryFileSink>
+DecompressVerifyFileWork::makeSink(Application& app, std::string const& name,
+                                   std::string const& filename,
+                                   optional<uint256> hash)
+{
+    return std::make_shared<DecompressVerifySink>(app, name, filename, hash);
+}
+
+DecompressVerifyFileWork::DecompressVerifyFileWork(
+    Application& app, std::string const& filenameGz,
+    std::string const& filename, optional<uint256> hash)
+    : BasicWork(app, "decompress-verify-file " + filenameGz,
+                BasicWork::RETRY_NEVER)
+    , mFilenameGz(filenameGz)
+    , mFilename(filename)
+    , mHash(hash)
+{
+}
+
+BasicWork::State
+DecompressVerifyFileWork::onRun()
+{
+    ZoneScoped;
+    if (mDone)
+    {
+        return mEc ? State::WORK_FAILURE : State::WORK_SUCCESS;
+    }
+
+    spawnDecompressor();
+    return State::WORK_WAITING;
+}
+
+void
+DecompressVerifyFileWork::onReset()
+{
+    mDone = false;
+    mEc = std::error_code();
+    ++mRun;
+    std::remove(mFilename.c_str());
+}
+
+void
+DecompressVerifyFileWork::spawnDecompressor()
+{
+    auto sink = makeSink(mApp, mFilenameGz, mFilename, mHash);
+    auto filenameGz = mFilenameGz;
+    auto run = mRun;
+    Application& app = this->mApp;
+    std::weak_ptr<DecompressVerifyFileWork> weak(
+        std::static_pointer_cast<DecompressVerifyFileWork>(shared_from_this()));
+    app.postOnBackgroundThread(
+        [&app, weak, sink, filenameGz, run]() {
+            auto ec = readInto(filenameGz, *sink);
+            app.postOnMainThread(
+                [weak, sink, run, ec]() mutable {
+                    auto self = weak.lock();
+                    if (!self || self->mRun != run)
+                    {
+                        return;
+                    }
+                    if (!ec)
+                    {
+                        ec = sink->commit();
+                    }
+                    if (!ec)
+                    {
+                        std::remove(self->mFilenameGz.c_str());
+                    }
+                    self->mEc = ec;
+                    self->mDone = true;
+                    self->wakeUp();
+                },
+                "DecompressVerifyFile: finish");
+        },
+        "DecompressVerifyFile: start in background");
+}
+}
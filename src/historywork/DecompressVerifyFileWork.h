@@ -0,0 +1,59 @@
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#pragma once
+
+#include "util/optional.h"
+#include "work/Work.h"
+#include "xdr/Diamnet-types.h"
+
+namespace diamnet
+{
+
+class HistoryFileSink;
+
+/**
+ * Decompresses a downloaded history file in a single pass on a background
+ * thread: the gzip input is inflated as it is read, and the output is checked
+ * to be a complete stream of XDR records, hashed if an expected hash is
+ * given, and written once, to a temporary file renamed into place on success.
+ * The compressed file is removed when the work succeeds.
+ *
+ * The same checks are available as a sink a transfer writes into directly, so
+ * a download is decompressed and verified as it arrives and the compressed
+ * file is never written at all.
+ */
+class DecompressVerifyFileWork : public BasicWork
+{
+    std::string const mFilenameGz;
+    std::string const mFilename;
+    optional<uint256> const mHash;
+    bool mDone{false};
+    std::error_code mEc;
+    // bumped on reset, so a result arriving from an earlier run is dropped
+    uint64_t mRun{0};
+
+    void spawnDecompressor();
+
+  public:
+    DecompressVerifyFileWork(Application& app, std::string const& filenameGz,
+                             std::string const& filename,
+                             optional<uint256> hash = nullptr);
+    ~DecompressVerifyFileWork() = default;
+
+    // A sink decompressing to `filename`, logging errors as about `name`.
+    static std::shared_ptr<HistoryFileSink>
+    makeSink(Application& app, std::string const& name,
+             std::string const& filename, optional<uint256> hash = nullptr);
+
+  protected:
+    BasicWork::State onRun() override;
+    void onReset() override;
+    bool
+    onAbort() override
+    {
+        return true;
+    };
+};
+}
@@ -8,6 +8,7 @@
 #include "history/HistoryArchive.h"
 #include "historywork/GetAndUnzipRemoteFileWork.h"
 #include "historywork/VerifyBucketWork.h"
+#include "main/Application.h"
 #include <Tracy.hpp>
 #include <fmt/format.h>
 
@@ -58,6 +59,18 @@ DownloadBucketsWork::resetIter()
     mNextBucketIter = mHashes.begin();
 }
 
+size_t
+DownloadBucketsWork::getBandwidth() const
+{
+    // Each bucket is decompressed and hashed on a worker thread once it is
+    // downloaded. Transfers are throttled on their own (by the process
+    // manager, or the archive's connection pool), so leave room for up to
+    // WORKER_THREADS buckets being verified on top of the downloads.
+    auto const& cfg = mApp.getConfig();
+    return static_cast<size_t>(cfg.MAX_CONCURRENT_SUBPROCESSES +
+                               cfg.WORKER_THREADS);
+}
+
 std::shared_ptr<BasicWork>
 DownloadBucketsWork::yieldMoreWork()
 {
@@ -69,9 +82,12 @@ DownloadBucketsWork::yieldMoreWork()
 
     auto hash = *mNextBucketIter;
     FileTransferInfo ft(mDownloadDir, HISTORY_FILE_TYPE_BUCKET, hash);
-    auto w1 = std::make_shared<GetAndUnzipRemoteFileWork>(mApp, ft, mArchive);
+    auto bucketHash = hexToBin256(hash);
+    auto w1 = std::make_shared<GetAndUnzipRemoteFileWork>(
+        mApp, ft, mArchive, make_optional<uint256>(bucketHash));
     auto w2 = std::make_shared<VerifyBucketWork>(
-        mApp, mBuckets, ft.localPath_nogz(), hexToBin256(hash));
+        mApp, mBuckets, ft.localPath_nogz(), bucketHash,
+        /*hashVerified=*/true);
     std::vector<std::shared_ptr<BasicWork>> seq{w1, w2};
     auto w3 = std::make_shared<WorkSequence>(
         mApp, "download-verify-sequence-" + hash, seq);
@@ -9,10 +9,13 @@
 #include "historywork/GetAndUnzipRemoteFileWork.h"
 #include "historywork/Progress.h"
 #include "historywork/VerifyTxResultsWork.h"
+#include "main/Application.h"
 #include "work/WorkSequence.h"
 #include <Tracy.hpp>
 #include <fmt/format.h>
 
+#include <algorithm>
+
 namespace diamnet
 {
 
@@ -52,6 +55,14 @@ DownloadVerifyTxResultsWork::resetIter()
     mCurrCheckpoint = mRange.mFirst;
 }
 
+size_t
+DownloadVerifyTxResultsWork::getBandwidth() const
+{
+    auto const& cfg = mApp.getConfig();
+    return static_cast<size_t>(
+        std::max(cfg.MAX_CONCURRENT_SUBPROCESSES, cfg.WORKER_THREADS));
+}
+
 std::shared_ptr<BasicWork>
 DownloadVerifyTxResultsWork::yieldMoreWork()
 {
@@ -17,6 +17,10 @@ namespace diamnet
 
 class HistoryArchive;
 
+// Downloads the results files of a range of checkpoints and verifies them
+// against the (already verified) ledger headers. Each checkpoint is verified
+// on a worker thread as soon as its file is downloaded; up to the larger of
+// MAX_CONCURRENT_SUBPROCESSES and WORKER_THREADS checkpoints are in flight.
 class DownloadVerifyTxResultsWork : public BatchWork
 {
     TmpDir const& mDownloadDir;
@@ -34,5 +38,6 @@ class DownloadVerifyTxResultsWork : public BatchWork
     bool hasNext() const override;
     std::shared_ptr<BasicWork> yieldMoreWork() override;
     void resetIter() override;
+    size_t getBandwidth() const override;
 };
 }
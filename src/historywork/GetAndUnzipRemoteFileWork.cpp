@@ -4,8 +4,8 @@
 
 #include "historywork/GetAndUnzipRemoteFileWork.h"
 #include "history/FileTransferInfo.h"
+#include "historywork/DecompressVerifyFileWork.h"
 #include "historywork/GetRemoteFileWork.h"
-#include "historywork/GunzipFileWork.h"
 #include "util/Logging.h"
 #include <Tracy.hpp>
 
@@ -14,11 +14,12 @@ namespace diamnet
 
 GetAndUnzipRemoteFileWork::GetAndUnzipRemoteFileWork(
     Application& app, FileTransferInfo ft,
-    std::shared_ptr<HistoryArchive> archive)
+    std::shared_ptr<HistoryArchive> archive, optional<uint256> hash)
     : Work(app, std::string("get-and-unzip-remote-file ") + ft.remoteName(),
            BasicWork::RETRY_A_LOT)
     , mFt(std::move(ft))
     , mArchive(archive)
+    , mHash(hash)
     , mDownloadStart(app.getMetrics().NewMeter(
           {"history", "download-" + mFt.getType(), "start"}, "event"))
     , mDownloadSuccess(app.getMetrics().NewMeter(
@@ -31,9 +32,9 @@ GetAndUnzipRemoteFileWork::GetAndUnzipRemoteFileWork(
 std::string
 GetAndUnzipRemoteFileWork::getStatus() const
 {
-    if (mGunzipFileWork)
+    if (mDecompressWork)
     {
-        return mGunzipFileWork->getStatus();
+        return mDecompressWork->getStatus();
     }
     else if (mGetRemoteFileWork)
     {
@@ -49,7 +50,7 @@ GetAndUnzipRemoteFileWork::doReset()
     std::remove(mFt.localPath_gz().c_str());
     std::remove(mFt.localPath_gz_tmp().c_str());
     mGetRemoteFileWork.reset();
-    mGunzipFileWork.reset();
+    mDecompressWork.reset();
 }
 
 void
@@ -71,12 +72,12 @@ BasicWork::State
 GetAndUnzipRemoteFileWork::doWork()
 {
     ZoneScoped;
-    if (mGunzipFileWork)
+    if (mDecompressWork)
     {
-        // Download completed, unzipping started
+        // Download completed, decompressing and verifying started
         assert(mGetRemoteFileWork);
         assert(mGetRemoteFileWork->getState() == State::WORK_SUCCESS);
-        auto state = mGunzipFileWork->getState();
+        auto state = mDecompressWork->getState();
         if (state == State::WORK_SUCCESS && !fs::exists(mFt.localPath_nogz()))
         {
             CLOG(ERROR, "History") << "Downloading and unzipping "
@@ -91,12 +92,19 @@ GetAndUnzipRemoteFileWork::doWork()
         auto state = mGetRemoteFileWork->getState();
         if (state == State::WORK_SUCCESS)
         {
+            if (fs::exists(mFt.localPath_nogz()))
+            {
+                // decompressed and verified as it was downloaded
+                return State::WORK_SUCCESS;
+            }
+            // fetched by a get command instead, so still compressed
             if (!validateFile())
             {
                 return State::WORK_FAILURE;
             }
-            mGunzipFileWork = addWork<GunzipFileWork>(mFt.localPath_gz(), false,
-                                                      BasicWork::RETRY_NEVER);
+            // straight from the download, in a single pass
+            mDecompressWork = addWork<DecompressVerifyFileWork>(
+                mFt.localPath_gz_tmp(), mFt.localPath_nogz(), mHash);
             return State::WORK_RUNNING;
         }
         return state;
@@ -105,9 +113,16 @@ GetAndUnzipRemoteFileWork::doWork()
     {
         CLOG(DEBUG, "History")
             << "Downloading and unzipping " << mFt.remoteName();
-        mGetRemoteFileWork =
-            addWork<GetRemoteFileWork>(mFt.remoteName(), mFt.localPath_gz_tmp(),
-                                       mArchive, BasicWork::RETRY_NEVER);
+        auto& app = mApp;
+        auto name = mFt.remoteName();
+        auto local = mFt.localPath_nogz();
+        auto hash = mHash;
+        mGetRemoteFileWork = addWork<GetRemoteFileWork>(
+            mFt.remoteName(), mFt.localPath_gz_tmp(), mArchive,
+            BasicWork::RETRY_NEVER, [&app, name, local, hash]() {
+                return DecompressVerifyFileWork::makeSink(app, name, local,
+                                                          hash);
+            });
         mDownloadStart.Mark();
         return State::WORK_RUNNING;
     }
@@ -123,35 +138,6 @@ GetAndUnzipRemoteFileWork::validateFile()
                                << mFt.remoteName() << ": .tmp file not found";
         return false;
     }
-
-    CLOG(TRACE, "History") << "Downloading and unzipping " << mFt.remoteName()
-                           << ": renaming .gz.tmp to .gz";
-    if (fs::exists(mFt.localPath_gz()) &&
-        std::remove(mFt.localPath_gz().c_str()))
-    {
-        CLOG(ERROR, "History") << "Downloading and unzipping "
-                               << mFt.remoteName() << ": failed to remove .gz";
-        return false;
-    }
-
-    if (std::rename(mFt.localPath_gz_tmp().c_str(), mFt.localPath_gz().c_str()))
-    {
-        CLOG(ERROR, "History")
-            << "Downloading and unzipping " << mFt.remoteName()
-            << ": failed to rename .gz.tmp to .gz";
-        return false;
-    }
-
-    CLOG(TRACE, "History") << "Downloading and unzipping " << mFt.remoteName()
-                           << ": renamed .gz.tmp to .gz";
-
-    if (!fs::exists(mFt.localPath_gz()))
-    {
-        CLOG(ERROR, "History") << "Downloading and unzipping "
-                               << mFt.remoteName() << ": .gz not found";
-        return false;
-    }
-
     return true;
 }
 }
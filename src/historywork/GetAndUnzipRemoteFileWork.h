@@ -5,6 +5,7 @@
 #pragma once
 
 #include "history/FileTransferInfo.h"
+#include "util/optional.h"
 #include "work/Work.h"
 #include <medida/meter.h>
 #include <medida/metrics_registry.h>
@@ -17,10 +18,11 @@ class HistoryArchive;
 class GetAndUnzipRemoteFileWork : public Work
 {
     std::shared_ptr<BasicWork> mGetRemoteFileWork;
-    std::shared_ptr<BasicWork> mGunzipFileWork;
+    std::shared_ptr<BasicWork> mDecompressWork;
 
     FileTransferInfo mFt;
     std::shared_ptr<HistoryArchive> mArchive;
+    optional<uint256> mHash;
 
     medida::Meter& mDownloadStart;
     medida::Meter& mDownloadSuccess;
@@ -31,10 +33,12 @@ class GetAndUnzipRemoteFileWork : public Work
   public:
     // Passing `nullptr` for the archive argument will cause the work to
     // select a new readable history archive at random each time it runs /
-    // retries.
+    // retries. If hash is given, the decompressed file is checked to have
+    // that hash as it is written.
     GetAndUnzipRemoteFileWork(
         Application& app, FileTransferInfo ft,
-        std::shared_ptr<HistoryArchive> archive = nullptr);
+        std::shared_ptr<HistoryArchive> archive = nullptr,
+        optional<uint256> hash = nullptr);
     ~GetAndUnzipRemoteFileWork() = default;
     std::string getStatus() const override;
 
@@ -14,17 +14,19 @@ GetRemoteFileWork::GetRemoteFileWork(Application& app,
                                      std::string const& remote,
                                      std::string const& local,
                                      std::shared_ptr<HistoryArchive> archive,
-                                     size_t maxRetries)
+                                     size_t maxRetries, SinkFactory makeSink)
     : RunCommandWork(app, std::string("get-remote-file ") + remote, maxRetries)
     , mRemote(remote)
     , mLocal(local)
     , mArchive(archive)
+    , mMakeSink(std::move(makeSink))
 {
 }
 
-CommandInfo
-GetRemoteFileWork::getCommand()
+std::shared_ptr<HistoryTransfer>
+GetRemoteFileWork::startTransfer(HistoryTransport::Callback done)
 {
+    // called first on every run, so this is where the archive is selected
     mCurrentArchive = mArchive;
     if (!mCurrentArchive)
     {
@@ -32,7 +34,20 @@ GetRemoteFileWork::getCommand()
                               .selectRandomReadableHistoryArchive();
     }
     assert(mCurrentArchive);
-    assert(mCurrentArchive->hasGetCmd());
+    assert(mCurrentArchive->canGet());
+    auto transport = mCurrentArchive->getTransport();
+    if (!transport)
+    {
+        return nullptr;
+    }
+    auto sink = mMakeSink ? mMakeSink() : HistoryFileSink::toFile(mLocal);
+    return transport->getFile(mRemote, sink, std::move(done));
+}
+
+CommandInfo
+GetRemoteFileWork::getCommand()
+{
+    assert(mCurrentArchive);
     auto cmdLine = mCurrentArchive->getFileCmd(mRemote, mLocal);
 
     return CommandInfo{cmdLine, std::string()};
@@ -41,8 +56,9 @@ GetRemoteFileWork::getCommand()
 void
 GetRemoteFileWork::onReset()
 {
-    std::remove(mLocal.c_str());
+    // cancels any transfer still writing to mLocal
     RunCommandWork::onReset();
+    std::remove(mLocal.c_str());
 }
 
 void
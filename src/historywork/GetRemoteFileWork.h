@@ -13,20 +13,30 @@ class HistoryArchive;
 
 class GetRemoteFileWork : public RunCommandWork
 {
+  public:
+    using SinkFactory = std::function<std::shared_ptr<HistoryFileSink>()>;
+
+  private:
     std::string const mRemote;
     std::string const mLocal;
     std::shared_ptr<HistoryArchive> mArchive;
     std::shared_ptr<HistoryArchive> mCurrentArchive;
+    SinkFactory const mMakeSink;
     CommandInfo getCommand() override;
+    std::shared_ptr<HistoryTransfer>
+    startTransfer(HistoryTransport::Callback done) override;
 
   public:
     // Passing `nullptr` for the archive argument will cause the work to
     // select a new readable history archive at random each time it runs /
-    // retries.
+    // retries. If makeSink is given, a transfer made in process writes into
+    // the sink it returns instead of to `local`; `local` is still written by
+    // the get command a failed transfer falls back to.
     GetRemoteFileWork(Application& app, std::string const& remote,
                       std::string const& local,
                       std::shared_ptr<HistoryArchive> archive = nullptr,
-                      size_t maxRetries = BasicWork::RETRY_A_LOT);
+                      size_t maxRetries = BasicWork::RETRY_A_LOT,
+                      SinkFactory makeSink = nullptr);
     ~GetRemoteFileWork() = default;
 
   protected:
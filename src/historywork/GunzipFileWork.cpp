@@ -3,38 +3,146 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "historywork/GunzipFileWork.h"
+#include "main/Application.h"
 #include "util/Fs.h"
+#include "util/GzipStream.h"
+#include "util/Logging.h"
+#include <Tracy.hpp>
+#include <fmt/format.h>
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
 
 namespace diamnet
 {
 
+static std::error_code
+decompressFile(std::string const& filenameGz, std::string const& tmp)
+{
+    ZoneScoped;
+    try
+    {
+        std::ifstream in(filenameGz, std::ifstream::binary);
+        if (!in)
+        {
+            throw std::runtime_error(
+                fmt::format("Error opening file {}", filenameGz));
+        }
+        in.exceptions(std::ios::badbit);
+        std::ofstream out(tmp, std::ofstream::binary | std::ofstream::trunc);
+        if (!out)
+        {
+            throw std::runtime_error(fmt::format("Error opening file {}", tmp));
+        }
+        out.exceptions(std::ios::failbit | std::ios::badbit);
+
+        GunzipStream gunzip;
+        auto sink = [&out](char const* data, size_t n) { out.write(data, n); };
+        std::vector<char> buf(64 * 1024);
+        while (in)
+        {
+            in.read(buf.data(), buf.size());
+            gunzip.write(buf.data(), static_cast<size_t>(in.gcount()), sink);
+        }
+        out.close();
+        if (!gunzip.atEnd())
+        {
+            throw std::runtime_error("truncated gzip data");
+        }
+    }
+    catch (std::exception const& e)
+    {
+        CLOG(WARNING, "History")
+            << "Failed decompressing " << filenameGz << ": " << e.what();
+        return std::make_error_code(std::errc::io_error);
+    }
+    return std::error_code();
+}
+
 GunzipFileWork::GunzipFileWork(Application& app, std::string const& filenameGz,
                                bool keepExisting, size_t maxRetries)
-    : RunCommandWork(app, std::string("gunzip-file ") + filenameGz, maxRetries)
+    : BasicWork(app, std::string("gunzip-file ") + filenameGz, maxRetries)
     , mFilenameGz(filenameGz)
+    , mFilenameNoGz(filenameGz.substr(0, filenameGz.size() - 3))
     , mKeepExisting(keepExisting)
 {
     fs::checkGzipSuffix(mFilenameGz);
 }
 
-CommandInfo
-GunzipFileWork::getCommand()
+BasicWork::State
+GunzipFileWork::onRun()
 {
-    std::string cmdLine, outFile;
-    cmdLine = "gzip -d ";
-    if (mKeepExisting)
+    ZoneScoped;
+    if (mDone)
     {
-        cmdLine += "-c ";
-        outFile = mFilenameGz.substr(0, mFilenameGz.size() - 3);
+        return mEc ? State::WORK_FAILURE : State::WORK_SUCCESS;
     }
-    cmdLine += mFilenameGz;
-    return CommandInfo{cmdLine, outFile};
+
+    spawnDecompressor();
+    return State::WORK_WAITING;
 }
 
 void
 GunzipFileWork::onReset()
 {
-    std::string filenameNoGz = mFilenameGz.substr(0, mFilenameGz.size() - 3);
-    std::remove(filenameNoGz.c_str());
+    mDone = false;
+    mEc = std::error_code();
+    ++mRun;
+    std::remove(mFilenameNoGz.c_str());
+}
+
+void
+GunzipFileWork::spawnDecompressor()
+{
+    // A run abandoned by a reset may still be writing, so every run writes a
+    // file of its own.
+    static std::atomic<uint64_t> runs{0};
+    auto tmp = mFilenameNoGz + ".tmp-" + std::to_string(++runs);
+    auto filenameGz = mFilenameGz;
+    auto run = mRun;
+    Application& app = mApp;
+    std::weak_ptr<GunzipFileWork> weak(
+        std::static_pointer_cast<GunzipFileWork>(shared_from_this()));
+    app.postOnBackgroundThread(
+        [&app, weak, filenameGz, tmp, run]() {
+            auto ec = decompressFile(filenameGz, tmp);
+            app.postOnMainThread(
+                [weak, tmp, run, ec]() mutable {
+                    auto self = weak.lock();
+                    if (!self || self->mRun != run)
+                    {
+                        std::remove(tmp.c_str());
+                        return;
+                    }
+                    if (!ec)
+                    {
+#ifdef _WIN32
+                        std::remove(self->mFilenameNoGz.c_str());
+#endif
+                        if (std::rename(tmp.c_str(),
+                                        self->mFilenameNoGz.c_str()) != 0)
+                        {
+                            CLOG(WARNING, "History")
+                                << "Failed to rename " << tmp << " to "
+                                << self->mFilenameNoGz;
+                            ec = std::make_error_code(std::errc::io_error);
+                        }
+                        else if (!self->mKeepExisting)
+                        {
+                            std::remove(self->mFilenameGz.c_str());
+                        }
+                    }
+                    if (ec)
+                    {
+                        std::remove(tmp.c_str());
+                    }
+                    self->mEc = ec;
+                    self->mDone = true;
+                    self->wakeUp();
+                },
+                "GunzipFile: finish");
+        },
+        "GunzipFile: start in background");
 }
 }
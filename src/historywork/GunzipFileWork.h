@@ -4,24 +4,41 @@
 
 #pragma once
 
-#include "historywork/RunCommandWork.h"
+#include "work/BasicWork.h"
 
 namespace diamnet
 {
 
-class GunzipFileWork : public RunCommandWork
+/**
+ * Decompresses a file in-process, on a worker thread, into a temporary file
+ * renamed to the name without .gz on success; like `gzip -d`, the input is
+ * then removed unless keepExisting is set.
+ */
+class GunzipFileWork : public BasicWork
 {
     std::string const mFilenameGz;
+    std::string const mFilenameNoGz;
     bool const mKeepExisting;
-    CommandInfo getCommand() override;
+    bool mDone{false};
+    std::error_code mEc;
+    // bumped on reset, so a result arriving from an earlier run is dropped
+    uint64_t mRun{0};
+
+    void spawnDecompressor();
 
   public:
     GunzipFileWork(Application& app, std::string const& filenameGz,
                    bool keepExisting = false,
-                   size_t maxRetries = Work::RETRY_NEVER);
+                   size_t maxRetries = BasicWork::RETRY_NEVER);
     ~GunzipFileWork() = default;
 
   protected:
+    BasicWork::State onRun() override;
     void onReset() override;
+    bool
+    onAbort() override
+    {
+        return true;
+    };
 };
 }
@@ -3,40 +3,345 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "historywork/GzipFileWork.h"
+#include "main/Application.h"
 #include "util/Fs.h"
+#include "util/Logging.h"
+#include <Tracy.hpp>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
 
 namespace diamnet
 {
 
+size_t const GzipFileWork::PARALLEL_BLOCK_SIZE = 1024 * 1024;
+
+static std::ifstream
+openInput(std::string const& filename)
+{
+    std::ifstream in(filename, std::ifstream::binary);
+    if (!in)
+    {
+        throw std::runtime_error(
+            fmt::format("Error opening file {}", filename));
+    }
+    in.exceptions(std::ios::badbit);
+    return in;
+}
+
+static std::ofstream
+openOutput(std::string const& filename, bool append)
+{
+    std::ofstream out(filename, std::ofstream::binary |
+                                    (append ? std::ofstream::app
+                                            : std::ofstream::trunc));
+    if (!out)
+    {
+        throw std::runtime_error(
+            fmt::format("Error opening file {}", filename));
+    }
+    out.exceptions(std::ios::failbit | std::ios::badbit);
+    return out;
+}
+
+static std::error_code
+compressFile(std::string const& filename, std::string const& tmp)
+{
+    ZoneScoped;
+    try
+    {
+        auto in = openInput(filename);
+        auto out = openOutput(tmp, false);
+        GzipStream gzip;
+        auto sink = [&out](char const* data, size_t n) { out.write(data, n); };
+        std::vector<char> buf(64 * 1024);
+        while (in)
+        {
+            in.read(buf.data(), buf.size());
+            gzip.write(buf.data(), static_cast<size_t>(in.gcount()), sink);
+        }
+        gzip.finish(sink);
+        out.close();
+    }
+    catch (std::exception const& e)
+    {
+        CLOG(WARNING, "History")
+            << "Failed compressing " << filename << ": " << e.what();
+        return std::make_error_code(std::errc::io_error);
+    }
+    return std::error_code();
+}
+
+// Compresses the block of input at [offset, offset + n), primed with the
+// input preceding it.
+static GzipBlock
+compressBlock(std::string const& filename, uint64_t offset, size_t n,
+              bool last)
+{
+    ZoneScoped;
+    auto dictLen = static_cast<size_t>(
+        std::min<uint64_t>(offset, GZIP_WINDOW_SIZE));
+    std::vector<char> buf(dictLen + n);
+    auto in = openInput(filename);
+    in.seekg(offset - dictLen);
+    in.read(buf.data(), buf.size());
+    if (static_cast<size_t>(in.gcount()) != buf.size())
+    {
+        throw std::runtime_error(
+            fmt::format("{} changed while being compressed", filename));
+    }
+    return gzipCompressBlock(buf.data(), dictLen, buf.data() + dictLen, n,
+                             last);
+}
+
 GzipFileWork::GzipFileWork(Application& app, std::string const& filenameNoGz,
-                           bool keepExisting)
-    : RunCommandWork(app, std::string("gzip-file ") + filenameNoGz,
-                     BasicWork::RETRY_A_LOT)
+                           bool keepExisting, size_t maxRetries)
+    : BasicWork(app, std::string("gzip-file ") + filenameNoGz, maxRetries)
     , mFilenameNoGz(filenameNoGz)
     , mKeepExisting(keepExisting)
 {
     fs::checkNoGzipSuffix(mFilenameNoGz);
 }
 
+BasicWork::State
+GzipFileWork::onRun()
+{
+    ZoneScoped;
+    if (mDone)
+    {
+        return mEc ? State::WORK_FAILURE : State::WORK_SUCCESS;
+    }
+
+    mFileSize = fs::size(mFilenameNoGz);
+    if (mApp.getConfig().GZIP_PARALLEL_BLOCKS > 1 &&
+        mFileSize >= 2 * PARALLEL_BLOCK_SIZE)
+    {
+        mTmp = newTmpFilename();
+        mNextOffset = 0;
+        mCrc = 0;
+        startRound();
+    }
+    else
+    {
+        spawnCompressor();
+    }
+    return State::WORK_WAITING;
+}
+
 void
 GzipFileWork::onReset()
 {
+    mDone = false;
+    mEc = std::error_code();
+    ++mRun;
+    if (!mTmp.empty())
+    {
+        std::remove(mTmp.c_str());
+        mTmp.clear();
+    }
+    mPending = 0;
+    mRound.clear();
     std::string filenameGz = mFilenameNoGz + ".gz";
     std::remove(filenameGz.c_str());
 }
 
-CommandInfo
-GzipFileWork::getCommand()
+std::string
+GzipFileWork::newTmpFilename() const
 {
-    std::string cmdLine = "gzip ";
-    std::string outFile;
-    if (mKeepExisting)
+    // A run abandoned by a reset may still be writing, so every run writes a
+    // file of its own.
+    static std::atomic<uint64_t> runs{0};
+    return mFilenameNoGz + ".gz.tmp-" + std::to_string(++runs);
+}
+
+void
+GzipFileWork::spawnCompressor()
+{
+    auto tmp = newTmpFilename();
+    auto filename = mFilenameNoGz;
+    auto run = mRun;
+    Application& app = mApp;
+    std::weak_ptr<GzipFileWork> weak(
+        std::static_pointer_cast<GzipFileWork>(shared_from_this()));
+    app.postOnBackgroundThread(
+        [&app, weak, filename, tmp, run]() {
+            auto ec = compressFile(filename, tmp);
+            app.postOnMainThread(
+                [weak, tmp, run, ec]() {
+                    auto self = weak.lock();
+                    if (!self || self->mRun != run)
+                    {
+                        std::remove(tmp.c_str());
+                        return;
+                    }
+                    self->finish(tmp, ec);
+                },
+                "GzipFile: finish");
+        },
+        "GzipFile: start in background");
+}
+
+void
+GzipFileWork::startRound()
+{
+    ZoneScoped;
+    auto blocks = static_cast<size_t>(mApp.getConfig().GZIP_PARALLEL_BLOCKS);
+    mRound.clear();
+    mRoundOffset = mNextOffset;
+    auto filename = mFilenameNoGz;
+    auto run = mRun;
+    Application& app = mApp;
+    std::weak_ptr<GzipFileWork> weak(
+        std::static_pointer_cast<GzipFileWork>(shared_from_this()));
+    for (size_t i = 0; i < blocks && mNextOffset < mFileSize; ++i)
     {
-        cmdLine += "-c ";
-        outFile = mFilenameNoGz + ".gz";
+        auto offset = mNextOffset;
+        auto n = static_cast<size_t>(
+            std::min<uint64_t>(PARALLEL_BLOCK_SIZE, mFileSize - offset));
+        mNextOffset += n;
+        bool last = mNextOffset == mFileSize;
+        mRound.emplace_back();
+        ++mPending;
+        app.postOnBackgroundThread(
+            [&app, weak, filename, offset, n, last, run, i]() {
+                GzipBlock block;
+                std::error_code ec;
+                try
+                {
+                    block = compressBlock(filename, offset, n, last);
+                }
+                catch (std::exception const& e)
+                {
+                    CLOG(WARNING, "History") << "Failed compressing "
+                                             << filename << ": " << e.what();
+                    ec = std::make_error_code(std::errc::io_error);
+                }
+                app.postOnMainThread(
+                    [weak, run, i, block, ec]() mutable {
+                        auto self = weak.lock();
+                        if (self && self->mRun == run)
+                        {
+                            self->onBlockCompressed(i, std::move(block), ec);
+                        }
+                    },
+                    "GzipFile: block compressed");
+            },
+            "GzipFile: compress block in background");
     }
-    cmdLine += mFilenameNoGz;
+}
 
-    return CommandInfo{cmdLine, outFile};
+void
+GzipFileWork::onBlockCompressed(size_t i, GzipBlock block, std::error_code ec)
+{
+    assert(mPending > 0);
+    --mPending;
+    mRound.at(i) = std::move(block);
+    if (ec)
+    {
+        mEc = ec;
+    }
+    if (mPending > 0)
+    {
+        return;
+    }
+    if (mEc)
+    {
+        finish(mTmp, mEc);
+        return;
+    }
+
+    // Append the round's blocks in order, with the header before the first
+    // one and the trailer after the last one.
+    bool first = mRoundOffset == 0;
+    std::string head = first ? gzipHeader() : "";
+    for (auto const& b : mRound)
+    {
+        mCrc = gzipCombineCrc(mCrc, b.mCrc, b.mSize);
+    }
+    bool last = mNextOffset == mFileSize;
+    std::string tail = last ? gzipTrailer(mCrc, mFileSize) : "";
+    auto round = std::make_shared<std::vector<GzipBlock>>(std::move(mRound));
+    mRound.clear();
+
+    auto tmp = mTmp;
+    auto run = mRun;
+    Application& app = mApp;
+    std::weak_ptr<GzipFileWork> weak(
+        std::static_pointer_cast<GzipFileWork>(shared_from_this()));
+    app.postOnBackgroundThread(
+        [&app, weak, tmp, run, first, head, tail, round, last]() {
+            ZoneScoped;
+            std::error_code ec;
+            try
+            {
+                auto out = openOutput(tmp, !first);
+                out.write(head.data(), head.size());
+                for (auto const& b : *round)
+                {
+                    out.write(b.mData.data(), b.mData.size());
+                }
+                out.write(tail.data(), tail.size());
+                out.close();
+            }
+            catch (std::exception const& e)
+            {
+                CLOG(WARNING, "History")
+                    << "Failed writing " << tmp << ": " << e.what();
+                ec = std::make_error_code(std::errc::io_error);
+            }
+            app.postOnMainThread(
+                [weak, tmp, run, ec, last]() {
+                    auto self = weak.lock();
+                    if (!self || self->mRun != run)
+                    {
+                        std::remove(tmp.c_str());
+                        return;
+                    }
+                    if (ec || last)
+                    {
+                        self->finish(tmp, ec);
+                    }
+                    else
+                    {
+                        self->startRound();
+                    }
+                },
+                "GzipFile: blocks written");
+        },
+        "GzipFile: write blocks in background");
+}
+
+void
+GzipFileWork::finish(std::string const& tmp, std::error_code ec)
+{
+    std::string filenameGz = mFilenameNoGz + ".gz";
+    if (!ec)
+    {
+#ifdef _WIN32
+        std::remove(filenameGz.c_str());
+#endif
+        if (std::rename(tmp.c_str(), filenameGz.c_str()) != 0)
+        {
+            CLOG(WARNING, "History")
+                << "Failed to rename " << tmp << " to " << filenameGz;
+            ec = std::make_error_code(std::errc::io_error);
+        }
+        else if (!mKeepExisting)
+        {
+            std::remove(mFilenameNoGz.c_str());
+        }
+    }
+    if (ec)
+    {
+        std::remove(tmp.c_str());
+    }
+    mTmp.clear();
+    mEc = ec;
+    mDone = true;
+    wakeUp();
 }
 }
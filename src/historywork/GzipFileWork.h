@@ -4,23 +4,63 @@
 
 #pragma once
 
-#include "historywork/RunCommandWork.h"
+#include "util/GzipStream.h"
+#include "work/BasicWork.h"
 
 namespace diamnet
 {
 
-class GzipFileWork : public RunCommandWork
+/**
+ * Compresses a file in-process, on worker threads, into a temporary file
+ * renamed to <file>.gz on success; like `gzip`, the input is then removed
+ * unless keepExisting is set.
+ *
+ * Small files are compressed as a single stream on one worker thread. Larger
+ * files are compressed pigz-style: GZIP_PARALLEL_BLOCKS blocks at a time are
+ * compressed on separate workers, and then appended to the output in order
+ * on another, giving the same single gzip member `gzip` would.
+ */
+class GzipFileWork : public BasicWork
 {
     std::string const mFilenameNoGz;
     bool const mKeepExisting;
-    CommandInfo getCommand() override;
+    bool mDone{false};
+    std::error_code mEc;
+    // bumped on reset, so a result arriving from an earlier run is dropped
+    uint64_t mRun{0};
+
+    // State of a parallel compression, only touched on the main thread.
+    std::string mTmp;
+    uint64_t mFileSize{0};
+    uint64_t mNextOffset{0};
+    uint64_t mRoundOffset{0};
+    size_t mPending{0};
+    std::vector<GzipBlock> mRound;
+    uint32_t mCrc{0};
+
+    std::string newTmpFilename() const;
+    void spawnCompressor();
+    void startRound();
+    void onBlockCompressed(size_t i, GzipBlock block, std::error_code ec);
+    void finish(std::string const& tmp, std::error_code ec);
 
   public:
     GzipFileWork(Application& app, std::string const& filenameNoGz,
-                 bool keepExisting = false);
+                 bool keepExisting = false,
+                 size_t maxRetries = BasicWork::RETRY_A_LOT);
     ~GzipFileWork() = default;
 
+    // Files are cut in blocks of this size for parallel compression, which is
+    // used for files of at least twice that.
+    static size_t const PARALLEL_BLOCK_SIZE;
+
   protected:
+    BasicWork::State onRun() override;
     void onReset() override;
+    bool
+    onAbort() override
+    {
+        return true;
+    };
 };
 }
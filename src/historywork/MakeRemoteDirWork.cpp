@@ -19,6 +19,17 @@ MakeRemoteDirWork::MakeRemoteDirWork(Application& app, std::string const& dir,
     assert(mArchive);
 }
 
+std::shared_ptr<HistoryTransfer>
+MakeRemoteDirWork::startTransfer(HistoryTransport::Callback done)
+{
+    auto transport = mArchive->getTransport();
+    if (!transport || !transport->canPut())
+    {
+        return nullptr;
+    }
+    return transport->makeDir(mDir, std::move(done));
+}
+
 CommandInfo
 MakeRemoteDirWork::getCommand()
 {
@@ -16,6 +16,8 @@ class MakeRemoteDirWork : public RunCommandWork
     std::string const mDir;
     std::shared_ptr<HistoryArchive> mArchive;
     CommandInfo getCommand() override;
+    std::shared_ptr<HistoryTransfer>
+    startTransfer(HistoryTransport::Callback done) override;
 
   public:
     MakeRemoteDirWork(Application& app, std::string const& dir,
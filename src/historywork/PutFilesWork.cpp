@@ -13,16 +13,14 @@
 namespace diamnet
 {
 
-PutFilesWork::PutFilesWork(Application& app,
-                           std::shared_ptr<HistoryArchive> archive,
-                           std::shared_ptr<StateSnapshot> snapshot,
-                           HistoryArchiveState const& remoteState)
+PutFilesWork::PutFilesWork(
+    Application& app, std::shared_ptr<HistoryArchive> archive,
+    std::vector<std::shared_ptr<FileTransferInfo>> files)
     // Each mkdir-and-put-file sequence will retry correctly
     : Work(app, "helper-put-files-" + archive->getName(),
            BasicWork::RETRY_NEVER)
     , mArchive(archive)
-    , mSnapshot(snapshot)
-    , mRemoteState(remoteState)
+    , mFiles(std::move(files))
 {
 }
 
@@ -32,7 +30,7 @@ PutFilesWork::doWork()
     ZoneScoped;
     if (!mChildrenSpawned)
     {
-        for (auto const& f : mSnapshot->differingHASFiles(mRemoteState))
+        for (auto const& f : mFiles)
         {
             auto mkdir = std::make_shared<MakeRemoteDirWork>(
                 mApp, f->remoteDir(), mArchive);
@@ -14,15 +14,13 @@ namespace diamnet
 class PutFilesWork : public Work
 {
     std::shared_ptr<HistoryArchive> mArchive;
-    std::shared_ptr<StateSnapshot> mSnapshot;
-    HistoryArchiveState const& mRemoteState;
+    std::vector<std::shared_ptr<FileTransferInfo>> const mFiles;
 
     bool mChildrenSpawned{false};
 
   public:
     PutFilesWork(Application& app, std::shared_ptr<HistoryArchive> archive,
-                 std::shared_ptr<StateSnapshot> snapshot,
-                 HistoryArchiveState const& remoteState);
+                 std::vector<std::shared_ptr<FileTransferInfo>> files);
     ~PutFilesWork() = default;
 
   protected:
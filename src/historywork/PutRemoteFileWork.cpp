@@ -18,7 +18,18 @@ PutRemoteFileWork::PutRemoteFileWork(Application& app, std::string const& local,
     , mArchive(archive)
 {
     assert(mArchive);
-    assert(mArchive->hasPutCmd());
+    assert(mArchive->canPut());
+}
+
+std::shared_ptr<HistoryTransfer>
+PutRemoteFileWork::startTransfer(HistoryTransport::Callback done)
+{
+    auto transport = mArchive->getTransport();
+    if (!transport || !transport->canPut())
+    {
+        return nullptr;
+    }
+    return transport->putFile(mLocal, mRemote, std::move(done));
 }
 
 CommandInfo
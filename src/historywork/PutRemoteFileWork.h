@@ -17,6 +17,8 @@ class PutRemoteFileWork : public RunCommandWork
     std::string const mRemote;
     std::shared_ptr<HistoryArchive> mArchive;
     CommandInfo getCommand() override;
+    std::shared_ptr<HistoryTransfer>
+    startTransfer(HistoryTransport::Callback done) override;
 
   public:
     PutRemoteFileWork(Application& app, std::string const& local,
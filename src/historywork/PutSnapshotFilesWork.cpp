@@ -5,12 +5,15 @@
 #include "historywork/PutSnapshotFilesWork.h"
 #include "bucket/BucketManager.h"
 #include "history/HistoryArchiveManager.h"
+#include "history/HistoryManager.h"
 #include "history/StateSnapshot.h"
 #include "historywork/GetHistoryArchiveStateWork.h"
 #include "historywork/GzipFileWork.h"
 #include "historywork/PutFilesWork.h"
 #include "historywork/PutHistoryArchiveStateWork.h"
 #include "main/Application.h"
+#include "util/Logging.h"
+#include "work/ConditionalWork.h"
 #include "work/WorkSequence.h"
 #include <Tracy.hpp>
 #include <fmt/format.h>
@@ -33,65 +36,63 @@ BasicWork::State
 PutSnapshotFilesWork::doWork()
 {
     ZoneScoped;
-    if (!mUploadSeqs.empty())
+    if (mUploadsStarted)
     {
-        return WorkUtils::getWorkStatus(mUploadSeqs);
+        markUploadedBuckets();
+        if (lostClaimedBuckets())
+        {
+            return State::WORK_FAILURE;
+        }
+        return getUploadsStatus();
     }
 
     if (!mGzipFilesWorks.empty())
     {
-        if (WorkUtils::getWorkStatus(mGzipFilesWorks) == State::WORK_SUCCESS)
+        auto status = WorkUtils::getWorkStatus(mGzipFilesWorks);
+        if (status == State::WORK_SUCCESS)
         {
-            // Step 3: ready to upload files to archives
-            for (auto const& getState : mGetStateWorks)
-            {
-                auto putSnapshotFiles = std::make_shared<PutFilesWork>(
-                    mApp, getState->getArchive(), mSnapshot,
-                    getState->getHistoryArchiveState());
-                auto putArchiveState =
-                    std::make_shared<PutHistoryArchiveStateWork>(
-                        mApp, mSnapshot->mLocalState, getState->getArchive());
-
-                std::vector<std::shared_ptr<BasicWork>> seq{putSnapshotFiles,
-                                                            putArchiveState};
-                mUploadSeqs.emplace_back(addWork<WorkSequence>(
-                    "upload-files-seq", seq, BasicWork::RETRY_NEVER));
-            }
+            // Step 4: ready to upload files to archives
+            startUploads();
             return State::WORK_RUNNING;
         }
-        else
-        {
-            return WorkUtils::getWorkStatus(mGzipFilesWorks);
-        }
+        return status;
     }
 
-    if (!mGetStateWorks.empty())
+    if (mGetStatesStarted)
     {
         std::list<std::shared_ptr<BasicWork>> works(mGetStateWorks.begin(),
                                                     mGetStateWorks.end());
         auto status = WorkUtils::getWorkStatus(works);
         if (status == State::WORK_SUCCESS)
         {
-            // Step 2: Gzip all unique files
+            // Step 2: pick the buckets each archive is missing
+            claimBuckets();
+
+            // Step 3: Gzip all unique files
             for (auto const& f : getFilesToZip())
             {
                 mGzipFilesWorks.emplace_back(addWork<GzipFileWork>(f, true));
             }
+            if (mGzipFilesWorks.empty())
+            {
+                startUploads();
+            }
             return State::WORK_RUNNING;
         }
-        else
-        {
-            return status;
-        }
+        return status;
     }
 
-    // Step 1: Get all archive states
+    // Step 1: Get the states of archives with no record of their buckets
     for (auto const& archive :
          mApp.getHistoryArchiveManager().getWritableHistoryArchives())
     {
-        mGetStateWorks.emplace_back(addWork<GetHistoryArchiveStateWork>(
-            0, archive, "publish", BasicWork::RETRY_A_FEW));
+        if (!archive->knowsUploadedBuckets())
+        {
+            mGetStateWorks.emplace_back(addWork<GetHistoryArchiveStateWork>(
+                0, archive, "publish", BasicWork::RETRY_A_FEW));
+        }
     }
+    mGetStatesStarted = true;
 
     return State::WORK_RUNNING;
 }
@@ -99,26 +100,99 @@ PutSnapshotFilesWork::doWork()
 void
 PutSnapshotFilesWork::doReset()
 {
+    releaseUnpublishedBuckets();
+    mGetStatesStarted = false;
     mGetStateWorks.clear();
+    mUploads.clear();
     mGzipFilesWorks.clear();
-    mUploadSeqs.clear();
+    mUploadsStarted = false;
 }
 
-std::unordered_set<std::string>
-PutSnapshotFilesWork::getFilesToZip()
+void
+PutSnapshotFilesWork::onSuccess()
 {
-    // Sanity check: there are states for all archives
-    if (mGetStateWorks.size() !=
-        mApp.getHistoryArchiveManager().getWritableHistoryArchives().size())
+    for (auto const& upload : mUploads)
     {
-        throw std::runtime_error("Corrupted GetHistoryArchiveStateWork");
+        upload.mArchive->pruneUploadedBuckets(mSnapshot->mLocalState);
     }
+    Work::onSuccess();
+}
 
-    std::unordered_set<std::string> filesToZip{};
+void
+PutSnapshotFilesWork::claimBuckets()
+{
+    ZoneScoped;
     for (auto const& getState : mGetStateWorks)
+    {
+        getState->getArchive()->seedUploadedBuckets(
+            getState->getHistoryArchiveState());
+    }
+
+    for (auto const& archive :
+         mApp.getHistoryArchiveManager().getWritableHistoryArchives())
+    {
+        ArchiveUpload upload;
+        upload.mArchive = archive;
+        upload.mClaimedBuckets =
+            archive->claimBucketsToUpload(mSnapshot->mLocalState);
+        mUploads.emplace_back(std::move(upload));
+    }
+}
+
+void
+PutSnapshotFilesWork::markUploadedBuckets()
+{
+    for (auto& upload : mUploads)
+    {
+        if (!upload.mMarkedUploaded && upload.mPutFiles &&
+            upload.mPutFiles->getState() == State::WORK_SUCCESS)
+        {
+            upload.mArchive->markBucketsUploaded(upload.mClaimedBuckets);
+            upload.mMarkedUploaded = true;
+        }
+    }
+}
+
+bool
+PutSnapshotFilesWork::lostClaimedBuckets() const
+{
+    // A failed publish releases the buckets it claimed; if this snapshot's
+    // state is still to be written and refers to one of them, nobody is
+    // uploading it anymore.
+    for (auto const& upload : mUploads)
+    {
+        if (upload.mUploadSeq->getState() != State::WORK_SUCCESS &&
+            !upload.mArchive->hasClaimedBuckets(mSnapshot->mLocalState))
+        {
+            CLOG(WARNING, "History")
+                << getName() << ": buckets released by a failed publish to "
+                << upload.mArchive->getName() << ", retrying";
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+PutSnapshotFilesWork::releaseUnpublishedBuckets()
+{
+    // Called on failure or abort (through doReset): buckets this work claimed
+    // but did not upload must be uploaded by whichever publish comes next
+    markUploadedBuckets();
+    for (auto const& upload : mUploads)
+    {
+        upload.mArchive->releaseBuckets(upload.mClaimedBuckets);
+    }
+}
+
+std::unordered_set<std::string>
+PutSnapshotFilesWork::getFilesToZip()
+{
+    std::unordered_set<std::string> filesToZip{};
+    for (auto const& upload : mUploads)
     {
         for (auto const& f :
-             mSnapshot->differingHASFiles(getState->getHistoryArchiveState()))
+             mSnapshot->filesWithBuckets(upload.mClaimedBuckets))
         {
             filesToZip.insert(f->localPath_nogz());
         }
@@ -127,10 +201,56 @@ PutSnapshotFilesWork::getFilesToZip()
     return filesToZip;
 }
 
+void
+PutSnapshotFilesWork::startUploads()
+{
+    ZoneScoped;
+    auto ledger = mSnapshot->mLocalState.currentLedger;
+    auto& hm = mApp.getHistoryManager();
+    for (auto& upload : mUploads)
+    {
+        auto putSnapshotFiles = std::make_shared<PutFilesWork>(
+            mApp, upload.mArchive,
+            mSnapshot->filesWithBuckets(upload.mClaimedBuckets));
+        auto putArchiveState = std::make_shared<PutHistoryArchiveStateWork>(
+            mApp, mSnapshot->mLocalState, upload.mArchive);
+        // Publish queue entries are removed in order as checkpoints are
+        // published, so this waits for all the ones before this one, and
+        // for the buckets claimed by other publishes to be uploaded.
+        auto predicate = [&hm, ledger, archive = upload.mArchive,
+                          snapshot = mSnapshot]() {
+            auto minQueued = hm.getMinLedgerQueuedToPublish();
+            return (minQueued == 0 || minQueued >= ledger) &&
+                   archive->hasUploadedBuckets(snapshot->mLocalState);
+        };
+        auto putArchiveStateInOrder = std::make_shared<ConditionalWork>(
+            mApp, "conditional-" + putArchiveState->getName(), predicate,
+            putArchiveState);
+
+        upload.mPutFiles = putSnapshotFiles;
+        std::vector<std::shared_ptr<BasicWork>> seq{putSnapshotFiles,
+                                                    putArchiveStateInOrder};
+        upload.mUploadSeq = addWork<WorkSequence>("upload-files-seq", seq,
+                                                  BasicWork::RETRY_NEVER);
+    }
+    mUploadsStarted = true;
+}
+
+BasicWork::State
+PutSnapshotFilesWork::getUploadsStatus() const
+{
+    std::list<std::shared_ptr<BasicWork>> seqs;
+    for (auto const& upload : mUploads)
+    {
+        seqs.emplace_back(upload.mUploadSeq);
+    }
+    return WorkUtils::getWorkStatus(seqs);
+}
+
 std::string
 PutSnapshotFilesWork::getStatus() const
 {
-    if (!mUploadSeqs.empty())
+    if (mUploadsStarted)
     {
         return fmt::format("{}:uploading files", getName());
     }
@@ -14,16 +14,43 @@ namespace diamnet
 struct StateSnapshot;
 class GetHistoryArchiveStateWork;
 
+// Uploads the files of a snapshot to every writable archive, then the
+// snapshot's state. Only the buckets not in an archive's record of uploaded
+// buckets (see HistoryArchive::claimBucketsToUpload) are uploaded to it; the
+// archive's state is fetched only if it has no record yet. Files of several
+// snapshots may be uploaded at once, but the state of a snapshot is only
+// written after all snapshots queued before it are published and all its
+// buckets, whichever publish claimed them, are uploaded, so an archive never
+// refers to a checkpoint or bucket that is missing. If another publish fails
+// and releases buckets this snapshot relies on, this work fails too, and
+// claims them itself when retried.
 class PutSnapshotFilesWork : public Work
 {
+    struct ArchiveUpload
+    {
+        std::shared_ptr<HistoryArchive> mArchive;
+        std::vector<std::string> mClaimedBuckets;
+        std::shared_ptr<BasicWork> mPutFiles;
+        std::shared_ptr<BasicWork> mUploadSeq;
+        bool mMarkedUploaded{false};
+    };
+
     std::shared_ptr<StateSnapshot> mSnapshot;
 
     // Keep track of each step
+    bool mGetStatesStarted{false};
     std::list<std::shared_ptr<GetHistoryArchiveStateWork>> mGetStateWorks;
+    std::vector<ArchiveUpload> mUploads;
     std::list<std::shared_ptr<BasicWork>> mGzipFilesWorks;
-    std::list<std::shared_ptr<BasicWork>> mUploadSeqs;
+    bool mUploadsStarted{false};
 
+    void claimBuckets();
     std::unordered_set<std::string> getFilesToZip();
+    void startUploads();
+    State getUploadsStatus() const;
+    void markUploadedBuckets();
+    bool lostClaimedBuckets() const;
+    void releaseUnpublishedBuckets();
 
   public:
     PutSnapshotFilesWork(Application& app,
@@ -35,5 +62,6 @@ class PutSnapshotFilesWork : public Work
   protected:
     State doWork() override;
     void doReset() override;
+    void onSuccess() override;
 };
 }
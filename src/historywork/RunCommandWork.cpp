@@ -5,6 +5,7 @@
 #include "historywork/RunCommandWork.h"
 #include "main/Application.h"
 #include "process/ProcessManager.h"
+#include "util/Logging.h"
 #include <Tracy.hpp>
 
 namespace diamnet
@@ -16,41 +17,58 @@ RunCommandWork::RunCommandWork(Application& app, std::string const& name,
 {
 }
 
+std::shared_ptr<HistoryTransfer>
+RunCommandWork::startTransfer(HistoryTransport::Callback done)
+{
+    return nullptr;
+}
+
 BasicWork::State
 RunCommandWork::onRun()
 {
     ZoneScoped;
     if (mDone)
     {
+        if (mEc && mTransfer)
+        {
+            // the command may still succeed where the transfer failed
+            mTransfer.reset();
+            auto commandInfo = getCommand();
+            if (!commandInfo.mCommand.empty())
+            {
+                CLOG(INFO, "History")
+                    << "Running command after failed transfer ("
+                    << mEc.message() << "): " << commandInfo.mCommand;
+                mDone = false;
+                mEc = asio::error_code();
+                return runCommand(commandInfo);
+            }
+        }
         return mEc ? State::WORK_FAILURE : State::WORK_SUCCESS;
     }
     else
     {
-        CommandInfo commandInfo = getCommand();
-        auto cmd = commandInfo.mCommand;
-        auto outfile = commandInfo.mOutFile;
-        if (!cmd.empty())
-        {
-            mExitEvent = mApp.getProcessManager().runProcess(cmd, outfile);
-            auto exit = mExitEvent.lock();
-            if (!exit)
+        std::weak_ptr<RunCommandWork> weak(
+            std::static_pointer_cast<RunCommandWork>(shared_from_this()));
+        mTransfer = startTransfer([weak](asio::error_code const& ec) {
+            auto self = weak.lock();
+            if (self)
             {
-                return State::WORK_FAILURE;
+                self->mEc = ec;
+                self->mDone = true;
+                self->wakeUp();
             }
-
-            std::weak_ptr<RunCommandWork> weak(
-                std::static_pointer_cast<RunCommandWork>(shared_from_this()));
-            exit->async_wait([weak](asio::error_code const& ec) {
-                auto self = weak.lock();
-                if (self)
-                {
-                    self->mEc = ec;
-                    self->mDone = true;
-                    self->wakeUp();
-                }
-            });
+        });
+        if (mTransfer)
+        {
             return State::WORK_WAITING;
         }
+
+        CommandInfo commandInfo = getCommand();
+        if (!commandInfo.mCommand.empty())
+        {
+            return runCommand(commandInfo);
+        }
         else
         {
             return State::WORK_SUCCESS;
@@ -58,18 +76,56 @@ RunCommandWork::onRun()
     }
 }
 
+BasicWork::State
+RunCommandWork::runCommand(CommandInfo const& commandInfo)
+{
+    mExitEvent = mApp.getProcessManager().runProcess(commandInfo.mCommand,
+                                                     commandInfo.mOutFile);
+    auto exit = mExitEvent.lock();
+    if (!exit)
+    {
+        return State::WORK_FAILURE;
+    }
+
+    std::weak_ptr<RunCommandWork> weak(
+        std::static_pointer_cast<RunCommandWork>(shared_from_this()));
+    exit->async_wait([weak](asio::error_code const& ec) {
+        auto self = weak.lock();
+        if (self)
+        {
+            self->mEc = ec;
+            self->mDone = true;
+            self->wakeUp();
+        }
+    });
+    return State::WORK_WAITING;
+}
+
 void
 RunCommandWork::onReset()
 {
     mDone = false;
     mEc = asio::error_code();
     mExitEvent.reset();
+    if (mTransfer)
+    {
+        mTransfer->cancel();
+        mTransfer.reset();
+    }
 }
 
 bool
 RunCommandWork::onAbort()
 {
     ZoneScoped;
+    if (mTransfer)
+    {
+        // a cancelled transfer never calls back, nothing to wait for
+        mTransfer->cancel();
+        mTransfer.reset();
+        return true;
+    }
+
     auto process = mExitEvent.lock();
     if (!process)
     {
@@ -4,6 +4,7 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "history/HistoryTransport.h"
 #include "process/ProcessManager.h"
 #include "work/Work.h"
 
@@ -20,13 +21,22 @@ struct CommandInfo
  * process spawning. This work is not scheduled while it's
  * waiting for a process to exit, and wakes up when it's ready
  * to be scheduled again.
+ *
+ * Subclasses may instead start an in-process transfer, which
+ * is waited for in the same way; the command is only run if
+ * startTransfer returns nullptr, or if the transfer fails.
  */
 class RunCommandWork : public BasicWork
 {
     bool mDone{false};
     asio::error_code mEc;
     virtual CommandInfo getCommand() = 0;
+    virtual std::shared_ptr<HistoryTransfer>
+    startTransfer(HistoryTransport::Callback done);
     std::weak_ptr<ProcessExitEvent> mExitEvent;
+    std::shared_ptr<HistoryTransfer> mTransfer;
+
+    BasicWork::State runCommand(CommandInfo const& commandInfo);
 
   public:
     RunCommandWork(Application& app, std::string const& name,
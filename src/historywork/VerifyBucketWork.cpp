@@ -16,6 +16,8 @@
 #include <medida/meter.h>
 #include <medida/metrics_registry.h>
 
+#include <algorithm>
+#include <chrono>
 #include <fstream>
 
 namespace diamnet
@@ -23,15 +25,18 @@ namespace diamnet
 
 VerifyBucketWork::VerifyBucketWork(
     Application& app, std::map<std::string, std::shared_ptr<Bucket>>& buckets,
-    std::string const& bucketFile, uint256 const& hash)
+    std::string const& bucketFile, uint256 const& hash, bool hashVerified)
     : BasicWork(app, "verify-bucket-hash-" + bucketFile, BasicWork::RETRY_NEVER)
     , mBuckets(buckets)
     , mBucketFile(bucketFile)
     , mHash(hash)
+    , mHashVerified(hashVerified)
     , mVerifyBucketSuccess(app.getMetrics().NewMeter(
           {"history", "verify-bucket", "success"}, "event"))
     , mVerifyBucketFailure(app.getMetrics().NewMeter(
           {"history", "verify-bucket", "failure"}, "event"))
+    , mVerifyBucketBytes(app.getMetrics().NewMeter(
+          {"history", "verify-bucket", "bytes"}, "byte"))
 {
 }
 
@@ -52,6 +57,13 @@ VerifyBucketWork::onRun()
         return State::WORK_SUCCESS;
     }
 
+    if (mHashVerified)
+    {
+        // checked while the file was written, only needs adopting
+        mDone = true;
+        return State::WORK_RUNNING;
+    }
+
     spawnVerifier();
     return State::WORK_WAITING;
 }
@@ -81,6 +93,8 @@ VerifyBucketWork::spawnVerifier()
         [&app, filename, weak, hash]() {
             SHA256 hasher;
             asio::error_code ec;
+            uint64_t bytes = 0;
+            auto start = std::chrono::steady_clock::now();
             try
             {
                 ZoneNamedN(verifyZone, "bucket verify", true);
@@ -96,18 +110,22 @@ VerifyBucketWork::spawnVerifier()
                         fmt::format("Error opening file {}", filename));
                 }
                 in.exceptions(std::ios::badbit);
-                char buf[4096];
+                std::vector<char> buf(fs::readbufsz());
                 while (in)
                 {
-                    in.read(buf, sizeof(buf));
-                    hasher.add(ByteSlice(buf, in.gcount()));
+                    in.read(buf.data(), buf.size());
+                    hasher.add(ByteSlice(buf.data(), in.gcount()));
+                    bytes += in.gcount();
                 }
                 uint256 vHash = hasher.finish();
                 if (vHash == hash)
                 {
-                    CLOG(DEBUG, "History")
-                        << "Verified hash (" << hexAbbrev(hash) << ") for "
-                        << filename;
+                    std::chrono::duration<double> elapsed =
+                        std::chrono::steady_clock::now() - start;
+                    CLOG(DEBUG, "History") << fmt::format(
+                        "Verified hash ({}) for {}: {:.1f} MB at {:.1f} MB/s",
+                        hexAbbrev(hash), filename, bytes / 1e6,
+                        bytes / 1e6 / std::max(elapsed.count(), 1e-6));
                 }
                 else
                 {
@@ -132,10 +150,14 @@ VerifyBucketWork::spawnVerifier()
             // main thread, since BasicWork's state is not thread-safe. This is
             // a temporary workaround, as a cleaner solution is needed.
             app.postOnMainThread(
-                [weak, ec]() {
+                [weak, ec, bytes]() {
                     auto self = weak.lock();
                     if (self)
                     {
+                        if (!ec)
+                        {
+                            self->mVerifyBucketBytes.Mark(bytes);
+                        }
                         self->mEc = ec;
                         self->mDone = true;
                         self->wakeUp();
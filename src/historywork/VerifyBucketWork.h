@@ -22,6 +22,7 @@ class VerifyBucketWork : public BasicWork
     std::map<std::string, std::shared_ptr<Bucket>>& mBuckets;
     std::string mBucketFile;
     uint256 mHash;
+    bool const mHashVerified;
     bool mDone{false};
     std::error_code mEc;
 
@@ -30,11 +31,13 @@ class VerifyBucketWork : public BasicWork
 
     medida::Meter& mVerifyBucketSuccess;
     medida::Meter& mVerifyBucketFailure;
+    medida::Meter& mVerifyBucketBytes;
 
   public:
     VerifyBucketWork(Application& app,
                      std::map<std::string, std::shared_ptr<Bucket>>& buckets,
-                     std::string const& bucketFile, uint256 const& hash);
+                     std::string const& bucketFile, uint256 const& hash,
+                     bool hashVerified = false);
     ~VerifyBucketWork() = default;
 
   protected:
@@ -4,13 +4,21 @@
 
 #include "historywork/VerifyTxResultsWork.h"
 #include "history/FileTransferInfo.h"
+#include "history/HistoryManager.h"
 #include "ledger/LedgerManager.h"
+#include "main/Application.h"
 #include "main/ErrorMessages.h"
 #include "util/FileSystemException.h"
 #include "util/Fs.h"
 #include "util/Logging.h"
+#include "util/XDRStream.h"
 #include <Tracy.hpp>
 #include <fmt/format.h>
+#include <medida/meter.h>
+#include <medida/metrics_registry.h>
+#include <medida/timer.h>
+
+#include <chrono>
 
 namespace diamnet
 {
@@ -22,18 +30,23 @@ VerifyTxResultsWork::VerifyTxResultsWork(Application& app,
                 RETRY_NEVER)
     , mDownloadDir(downloadDir)
     , mCheckpoint(checkpoint)
+    , mVerifySuccess(app.getMetrics().NewMeter(
+          {"history", "verify-tx-results", "success"}, "event"))
+    , mVerifyFailure(app.getMetrics().NewMeter(
+          {"history", "verify-tx-results", "failure"}, "event"))
+    , mVerifyLedgers(app.getMetrics().NewMeter(
+          {"history", "verify-tx-results", "ledgers"}, "ledger"))
+    , mVerifyTime(
+          app.getMetrics().NewTimer({"history", "verify-tx-results", "time"}))
 {
 }
 
 void
 VerifyTxResultsWork::onReset()
 {
-    mHdrIn.close();
-    mResIn.close();
-    mTxResultEntry = {};
     mDone = false;
     mEc = asio::error_code();
-    mLastSeenLedger = 0;
+    ++mRun;
 }
 
 BasicWork::State
@@ -44,64 +57,160 @@ VerifyTxResultsWork::onRun()
         return mEc ? State::WORK_FAILURE : State::WORK_SUCCESS;
     }
 
+    FileTransferInfo hi(mDownloadDir, HISTORY_FILE_TYPE_LEDGER, mCheckpoint);
+    FileTransferInfo ri(mDownloadDir, HISTORY_FILE_TYPE_RESULTS, mCheckpoint);
+    auto hdrPath = hi.localPath_nogz();
+    auto resPath = ri.localPath_nogz();
+    auto low =
+        mApp.getHistoryManager().firstLedgerInCheckpointContaining(mCheckpoint);
+    auto run = mRun;
+    Application& app = mApp;
     std::weak_ptr<VerifyTxResultsWork> weak(
         std::static_pointer_cast<VerifyTxResultsWork>(shared_from_this()));
-    auto verify = [ weak, checkpoint = mCheckpoint ]()
+    auto verify = [&app, weak, hdrPath, resPath, low, run,
+                   checkpoint = mCheckpoint]() {
+        ZoneScoped;
+        asio::error_code ec;
+        uint32_t ledgers = 0;
+        auto start = std::chrono::steady_clock::now();
+        auto verified = verifyTxResultsOfCheckpoint(hdrPath, resPath,
+                                                    checkpoint, low, ledgers);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        CLOG(TRACE, "History")
+            << "Transaction results verification for checkpoint "
+            << checkpoint
+            << (verified ? " successful"
+                         : (" failed: " +
+                            std::string(POSSIBLY_CORRUPTED_HISTORY)));
+        if (!verified)
+        {
+            ec = std::make_error_code(std::errc::io_error);
+        }
+
+        // Wake up call is posted back on the main thread
+        app.postOnMainThread(
+            [weak, ec, run, ledgers, elapsed]() {
+                auto self = weak.lock();
+                if (!self || self->mRun != run)
+                {
+                    return;
+                }
+                if (ec)
+                {
+                    self->mVerifyFailure.Mark();
+                }
+                else
+                {
+                    self->mVerifySuccess.Mark();
+                    self->mVerifyLedgers.Mark(ledgers);
+                    self->mVerifyTime.Update(elapsed);
+                }
+                self->mEc = ec;
+                self->mDone = true;
+                self->wakeUp();
+            },
+            "VerifyTxResults: finish");
+    };
+
+    mApp.postOnBackgroundThread(verify, "VerifyTxResults: start in background");
+    return State::WORK_WAITING;
+}
+
+namespace
+{
+// Reads the result entries of a checkpoint in order, handing out the entry
+// of each ledger (an empty one for ledgers without results).
+class TxResultReader
+{
+    XDRInputFileStream& mResIn;
+    uint32_t const mCheckpoint;
+    uint32_t const mLow;
+    TransactionHistoryResultEntry mTxResultEntry;
+    uint32_t mLastSeenLedger{0};
+
+    bool
+    readNextWithValidation()
     {
-        auto self = weak.lock();
-        if (self)
+        auto res = mResIn.readOne(mTxResultEntry);
+        if (res)
         {
-            ZoneScoped;
-            asio::error_code ec;
-            auto verified = self->verifyTxResultsOfCheckpoint();
-            CLOG(TRACE, "History")
-                << "Transaction results verification for checkpoint "
-                << checkpoint
-                << (verified ? " successful"
-                             : (" failed: " +
-                                std::string(POSSIBLY_CORRUPTED_HISTORY)));
-            if (!verified)
+            auto readLedger = mTxResultEntry.ledgerSeq;
+            if (readLedger > mCheckpoint || readLedger < mLow)
             {
-                ec = std::make_error_code(std::errc::io_error);
+                throw std::runtime_error("Results outside of checkpoint range");
             }
 
-            // Wake up call is posted back on the main thread
-            self->mApp.postOnMainThread(
-                [weak, ec]() {
-                    auto self = weak.lock();
-                    if (self)
-                    {
-                        self->mEc = ec;
-                        self->mDone = true;
-                        self->wakeUp();
-                    }
-                },
-                "VerifyTxResults: finish");
+            if (readLedger <= mLastSeenLedger)
+            {
+                throw std::runtime_error("Malformed or duplicate results: "
+                                         "ledgers must be strictly increasing");
+            }
+            mLastSeenLedger = readLedger;
         }
-    };
+        return res;
+    }
 
-    mApp.postOnBackgroundThread(verify, "VerifyTxResults: start in background");
-    return State::WORK_WAITING;
+  public:
+    TxResultReader(XDRInputFileStream& resIn, uint32_t checkpoint,
+                   uint32_t low)
+        : mResIn(resIn), mCheckpoint(checkpoint), mLow(low)
+    {
+    }
+
+    TransactionHistoryResultEntry
+    getCurrentTxResultSet(uint32_t ledger)
+    {
+        ZoneScoped;
+        TransactionHistoryResultEntry trs;
+        trs.ledgerSeq = ledger;
+
+        do
+        {
+            if (mTxResultEntry.ledgerSeq < ledger)
+            {
+                CLOG(DEBUG, "History") << "Processed tx results for ledger "
+                                       << mTxResultEntry.ledgerSeq;
+            }
+            else if (mTxResultEntry.ledgerSeq > ledger)
+            {
+                // No tx results in this ledger
+                break;
+            }
+            else
+            {
+                CLOG(DEBUG, "History")
+                    << "Loaded tx result set for ledger " << ledger;
+                trs.txResultSet = mTxResultEntry.txResultSet;
+                return trs;
+            }
+        } while (mResIn && readNextWithValidation());
+
+        return trs;
+    }
+};
 }
 
 bool
-VerifyTxResultsWork::verifyTxResultsOfCheckpoint()
+VerifyTxResultsWork::verifyTxResultsOfCheckpoint(std::string const& hdrPath,
+                                                 std::string const& resPath,
+                                                 uint32_t checkpoint,
+                                                 uint32_t low,
+                                                 uint32_t& ledgers)
 {
     ZoneScoped;
     try
     {
-        FileTransferInfo hi(mDownloadDir, HISTORY_FILE_TYPE_LEDGER,
-                            mCheckpoint);
-        FileTransferInfo ri(mDownloadDir, HISTORY_FILE_TYPE_RESULTS,
-                            mCheckpoint);
-        mHdrIn.open(hi.localPath_nogz());
-        mResIn.open(ri.localPath_nogz());
+        XDRInputFileStream hdrIn;
+        XDRInputFileStream resIn;
+        hdrIn.open(hdrPath);
+        resIn.open(resPath);
+        TxResultReader reader(resIn, checkpoint, low);
 
         LedgerHeaderHistoryEntry curr;
-        while (mHdrIn && mHdrIn.readOne(curr))
+        while (hdrIn && hdrIn.readOne(curr))
         {
             auto ledgerSeq = curr.header.ledgerSeq;
-            auto txResultEntry = getCurrentTxResultSet(ledgerSeq);
+            auto txResultEntry = reader.getCurrentTxResultSet(ledgerSeq);
             auto resultSetHash =
                 sha256(xdr::xdr_to_opaque(txResultEntry.txResultSet));
             auto genesis = ledgerSeq == LedgerManager::GENESIS_LEDGER_SEQ &&
@@ -117,6 +226,7 @@ VerifyTxResultsWork::verifyTxResultsOfCheckpoint()
                     hexAbbrev(curr.header.txSetResultHash));
                 return false;
             }
+            ++ledgers;
         }
     }
     catch (FileSystemException&)
@@ -136,58 +246,4 @@ VerifyTxResultsWork::verifyTxResultsOfCheckpoint()
 
     return true;
 }
-
-TransactionHistoryResultEntry
-VerifyTxResultsWork::getCurrentTxResultSet(uint32_t ledger)
-{
-    ZoneScoped;
-    TransactionHistoryResultEntry trs;
-    trs.ledgerSeq = ledger;
-
-    auto readNextWithValidation = [&]() {
-        auto res = mResIn.readOne(mTxResultEntry);
-        if (res)
-        {
-            auto readLedger = mTxResultEntry.ledgerSeq;
-            auto const& hm = mApp.getHistoryManager();
-
-            auto low = hm.firstLedgerInCheckpointContaining(mCheckpoint);
-            if (readLedger > mCheckpoint || readLedger < low)
-            {
-                throw std::runtime_error("Results outside of checkpoint range");
-            }
-
-            if (readLedger <= mLastSeenLedger)
-            {
-                throw std::runtime_error("Malformed or duplicate results: "
-                                         "ledgers must be strictly increasing");
-            }
-            mLastSeenLedger = readLedger;
-        }
-        return res;
-    };
-
-    do
-    {
-        if (mTxResultEntry.ledgerSeq < ledger)
-        {
-            CLOG(DEBUG, "History") << "Processed tx results for ledger "
-                                   << mTxResultEntry.ledgerSeq;
-        }
-        else if (mTxResultEntry.ledgerSeq > ledger)
-        {
-            // No tx results in this ledger
-            break;
-        }
-        else
-        {
-            CLOG(DEBUG, "History")
-                << "Loaded tx result set for ledger " << ledger;
-            trs.txResultSet = mTxResultEntry.txResultSet;
-            return trs;
-        }
-    } while (mResIn && readNextWithValidation());
-
-    return trs;
-}
 }
@@ -5,29 +5,43 @@
 #pragma once
 
 #include "util/TmpDir.h"
-#include "util/XDRStream.h"
 #include "work/BasicWork.h"
 #include "xdr/Diamnet-types.h"
 
+namespace medida
+{
+class Meter;
+class Timer;
+}
+
 namespace diamnet
 {
 /*
  * Verify transaction results for a checkpoint. This work requires
  * downloaded ledger header and transaction result files.
+ *
+ * The whole checkpoint is read and hashed on a worker thread, sharing no
+ * state with the work itself, so the checkpoints of a range are verified in
+ * parallel by as many of these as DownloadVerifyTxResultsWork runs at once.
  * */
 class VerifyTxResultsWork : public BasicWork
 {
     TmpDir const& mDownloadDir;
     uint32_t const mCheckpoint;
-    TransactionHistoryResultEntry mTxResultEntry;
-    XDRInputFileStream mHdrIn;
-    XDRInputFileStream mResIn;
     bool mDone{false};
     asio::error_code mEc;
-    uint32_t mLastSeenLedger;
+    // bumped on reset, so a result arriving from an earlier run is dropped
+    uint64_t mRun{0};
+
+    medida::Meter& mVerifySuccess;
+    medida::Meter& mVerifyFailure;
+    medida::Meter& mVerifyLedgers;
+    medida::Timer& mVerifyTime;
 
-    TransactionHistoryResultEntry getCurrentTxResultSet(uint32_t ledger);
-    bool verifyTxResultsOfCheckpoint();
+    static bool verifyTxResultsOfCheckpoint(std::string const& hdrPath,
+                                            std::string const& resPath,
+                                            uint32_t checkpoint, uint32_t low,
+                                            uint32_t& ledgers);
 
   public:
     VerifyTxResultsWork(Application& app, TmpDir const& downloadDir,
@@ -6,17 +6,87 @@
 #include "bucket/Bucket.h"
 #include "bucket/BucketInputIterator.h"
 #include "crypto/Hex.h"
+#include "database/Database.h"
 #include "invariant/InvariantManager.h"
 #include "ledger/LedgerRange.h"
 #include "ledger/LedgerTxn.h"
 #include "ledger/LedgerTxnEntry.h"
 #include "main/Application.h"
+#include "main/Config.h"
+#include "util/Math.h"
 #include "util/XDRCereal.h"
 #include <fmt/format.h>
+#include <soci.h>
+
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <map>
 
 namespace diamnet
 {
 
+namespace
+{
+// Counts the entries of each type modified within a range of ledgers, as
+// checkOnBucketApply needs to once it has gone through the bucket. With a
+// connection pool (postgres), every type is counted on a connection of its own
+// on the worker threads, while the bucket is being gone through on the main
+// thread; otherwise they are counted one after the other when asked for.
+class DatabaseCounts
+{
+    Application& mApp;
+    LedgerRange const mRange;
+    std::map<LedgerEntryType, std::shared_future<uint64_t>> mCounts;
+
+  public:
+    DatabaseCounts(Application& app, LedgerRange const& range)
+        : mApp(app), mRange(range)
+    {
+        if (!app.getDatabase().canUsePool())
+        {
+            return;
+        }
+        // The pool is created lazily and not thread-safe, so get hold of it
+        // before handing it to the workers.
+        auto& pool = app.getDatabase().getPool();
+        for (auto t : xdr::xdr_traits<LedgerEntryType>::enum_values())
+        {
+            auto type = static_cast<LedgerEntryType>(t);
+            using task_t = std::packaged_task<uint64_t()>;
+            auto task = std::make_shared<task_t>([&pool, type, range]() {
+                soci::session sess(pool);
+                return LedgerTxnRoot::countObjects(sess, type, range);
+            });
+            mCounts.emplace(type, task->get_future().share());
+            app.postOnBackgroundThread(std::bind(&task_t::operator(), task),
+                                       "BucketListIsConsistentWithDatabase");
+        }
+    }
+
+    // Waits for the counts still running when this is destroyed early, since
+    // they use the pool.
+    ~DatabaseCounts()
+    {
+        for (auto const& kv : mCounts)
+        {
+            kv.second.wait();
+        }
+    }
+
+    uint64_t
+    get(LedgerEntryType type)
+    {
+        auto it = mCounts.find(type);
+        if (it == mCounts.end())
+        {
+            return mApp.getLedgerTxnRoot().countObjects(type, mRange);
+        }
+        return it->second.get();
+    }
+};
+}
+
 static std::string
 checkAgainstDatabase(AbstractLedgerTxn& ltx, LedgerEntry const& entry)
 {
@@ -56,6 +126,34 @@ checkAgainstDatabase(AbstractLedgerTxn& ltx, LedgerKey const& key)
     return s;
 }
 
+// Loads the entries of a batch with bulk loads (into the entry cache, as far
+// as it has room), then checks them one by one.
+static std::string
+checkAgainstDatabase(AbstractLedgerTxn& ltx,
+                     std::vector<BucketEntry> const& batch)
+{
+    std::unordered_set<LedgerKey> keys;
+    keys.reserve(batch.size());
+    for (auto const& e : batch)
+    {
+        keys.emplace(e.type() == DEADENTRY ? e.deadEntry()
+                                           : LedgerEntryKey(e.liveEntry()));
+    }
+    ltx.prefetch(keys);
+
+    for (auto const& e : batch)
+    {
+        auto s = e.type() == DEADENTRY
+                     ? checkAgainstDatabase(ltx, e.deadEntry())
+                     : checkAgainstDatabase(ltx, e.liveEntry());
+        if (!s.empty())
+        {
+            return s;
+        }
+    }
+    return {};
+}
+
 std::shared_ptr<Invariant>
 BucketListIsConsistentWithDatabase::registerInvariant(Application& app)
 {
@@ -80,10 +178,19 @@ BucketListIsConsistentWithDatabase::checkOnBucketApply(
     std::shared_ptr<Bucket const> bucket, uint32_t oldestLedger,
     uint32_t newestLedger)
 {
+    auto range = LedgerRange::inclusive(oldestLedger, newestLedger);
+    DatabaseCounts counts(mApp, range);
+
+    auto const& cfg = mApp.getConfig();
+    uint32_t samplePercent = cfg.INVARIANT_BUCKET_SAMPLE_PERCENT;
+    size_t batchSize = std::max<size_t>(cfg.PREFETCH_BATCH_SIZE, 1);
+
     uint64_t nAccounts = 0, nTrustLines = 0, nOffers = 0, nData = 0,
              nClaimableBalance = 0;
     {
         LedgerTxn ltx(mApp.getLedgerTxnRoot());
+        std::vector<BucketEntry> batch;
+        batch.reserve(batchSize);
 
         bool hasPreviousEntry = false;
         BucketEntry previousEntry;
@@ -100,6 +207,11 @@ BucketListIsConsistentWithDatabase::checkOnBucketApply(
             previousEntry = e;
             hasPreviousEntry = true;
 
+            // Entries are only compared to the database if sampled; every
+            // entry is still counted, as it is cheap to.
+            bool sampled = samplePercent >= 100 ||
+                           rand_uniform<uint32_t>(0, 99) < samplePercent;
+
             if (e.type() == LIVEENTRY || e.type() == INITENTRY)
             {
                 if (e.liveEntry().lastModifiedLedgerSeq < oldestLedger)
@@ -141,49 +253,58 @@ BucketListIsConsistentWithDatabase::checkOnBucketApply(
                 default:
                     abort();
                 }
-                auto s = checkAgainstDatabase(ltx, e.liveEntry());
-                if (!s.empty())
+                if (sampled)
                 {
-                    return s;
+                    batch.emplace_back(e);
                 }
             }
-            else if (e.type() == DEADENTRY)
+            else if (e.type() == DEADENTRY && sampled)
             {
-                auto s = checkAgainstDatabase(ltx, e.deadEntry());
+                batch.emplace_back(e);
+            }
+
+            if (batch.size() == batchSize)
+            {
+                auto s = checkAgainstDatabase(ltx, batch);
                 if (!s.empty())
                 {
                     return s;
                 }
+                batch.clear();
             }
         }
+
+        auto s = checkAgainstDatabase(ltx, batch);
+        if (!s.empty())
+        {
+            return s;
+        }
     }
 
-    auto range = LedgerRange::inclusive(oldestLedger, newestLedger);
     std::string countFormat = "Incorrect {} count: Bucket = {} Database = {}";
-    auto& ltxRoot = mApp.getLedgerTxnRoot();
-    uint64_t nAccountsInDb = ltxRoot.countObjects(ACCOUNT, range);
+    uint64_t nAccountsInDb = counts.get(ACCOUNT);
     if (nAccountsInDb != nAccounts)
     {
         return fmt::format(countFormat, "Account", nAccounts, nAccountsInDb);
     }
-    uint64_t nTrustLinesInDb = ltxRoot.countObjects(TRUSTLINE, range);
+    uint64_t nTrustLinesInDb = counts.get(TRUSTLINE);
     if (nTrustLinesInDb != nTrustLines)
     {
         return fmt::format(countFormat, "TrustLine", nTrustLines,
                            nTrustLinesInDb);
     }
-    uint64_t nOffersInDb = ltxRoot.countObjects(OFFER, range);
+    uint64_t nOffersInDb = counts.get(OFFER);
     if (nOffersInDb != nOffers)
     {
         return fmt::format(countFormat, "Offer", nOffers, nOffersInDb);
     }
-    uint64_t nDataInDb = ltxRoot.countObjects(DATA, range);
+    uint64_t nDataInDb = counts.get(DATA);
     if (nDataInDb != nData)
     {
         return fmt::format(countFormat, "Data", nData, nDataInDb);
     }
     uint64_t nClaimableBalanceInDb =
-        ltxRoot.countObjects(CLAIMABLE_BALANCE, range);
+        counts.get(CLAIMABLE_BALANCE);
     if (nClaimableBalanceInDb != nClaimableBalance)
     {
         return fmt::format(countFormat, "ClaimableBalance", nClaimableBalance,
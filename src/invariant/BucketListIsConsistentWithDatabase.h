@@ -24,6 +24,13 @@ class Application;
 // database, while the third condition shows that the database does not
 // contain any entry in the appropriate ledger range other than those in
 // the bucket.
+//
+// Entries are looked up in batches of PREFETCH_BATCH_SIZE, with bulk loads,
+// and the database counts run on pooled connections while the bucket is gone
+// through. With INVARIANT_BUCKET_SAMPLE_PERCENT below 100, only that share of
+// the entries (picked at random on every apply) are compared to the database,
+// which makes the check cheap enough to leave enabled during catchup; the
+// ordering, bounds and counts are still checked in full.
 class BucketListIsConsistentWithDatabase : public Invariant
 {
   public:
@@ -44,6 +44,15 @@ class InvariantManager
                                        OperationResult const& opres,
                                        LedgerTxnDelta const& ltxDelta) = 0;
 
+    // Until checkDeferredOperations, checkOnOperationApply only queues the
+    // operation and its delta, to be checked on worker threads (if
+    // INVARIANT_CHECK_THREADS is set; otherwise checks stay synchronous).
+    virtual void deferOperationChecks() = 0;
+
+    // Waits for the queued operation checks, and stops deferring them. Their
+    // failures are handled here, in the order the operations were applied.
+    virtual void checkDeferredOperations() = 0;
+
     virtual void registerInvariant(std::shared_ptr<Invariant> invariant) = 0;
 
     virtual void enableInvariant(std::string const& name) = 0;
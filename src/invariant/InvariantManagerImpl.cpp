@@ -11,6 +11,7 @@
 #include "invariant/InvariantManagerImpl.h"
 #include "ledger/LedgerTxn.h"
 #include "main/Application.h"
+#include "main/Config.h"
 #include "main/ErrorMessages.h"
 #include "util/Logging.h"
 #include "util/XDRCereal.h"
@@ -19,7 +20,12 @@
 #include "medida/counter.h"
 #include "medida/metrics_registry.h"
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
 #include <memory>
+#include <mutex>
 #include <numeric>
 #include <regex>
 
@@ -29,12 +35,118 @@ namespace diamnet
 std::unique_ptr<InvariantManager>
 InvariantManager::create(Application& app)
 {
-    return std::make_unique<InvariantManagerImpl>(app.getMetrics());
+    return std::make_unique<InvariantManagerImpl>(app);
 }
 
-InvariantManagerImpl::InvariantManagerImpl(medida::MetricsRegistry& registry)
-    : mInvariantFailureCount(
-          registry.NewCounter({"ledger", "invariant", "failure"}))
+namespace
+{
+std::string
+operationFailureMessage(Invariant const& invariant, std::string const& result,
+                        Operation const& operation)
+{
+    return fmt::format(R"(Invariant "{}" does not hold on operation: {}{}{})",
+                       invariant.getName(), result, "\n",
+                       xdr_to_string(operation));
+}
+}
+
+// Operations are checked by whichever thread takes them from the queue: up to
+// mCheckThreads helper jobs posted on the worker threads as operations are
+// queued, and the main thread once it reaches checkDeferredOperations. Each
+// check runs every enabled invariant on one operation, so the invariants must
+// be safe to run on several operations at once.
+struct InvariantManagerImpl::DeferredChecks
+{
+    struct Check
+    {
+        size_t mIndex;
+        Operation mOperation;
+        OperationResult mResult;
+        LedgerTxnDelta mDelta;
+    };
+
+    struct Failure
+    {
+        size_t mIndex;
+        std::shared_ptr<Invariant> mInvariant;
+        std::string mMessage;
+        uint32_t mLedger;
+    };
+
+    std::vector<std::shared_ptr<Invariant>> const mInvariants;
+    std::mutex mMutex;
+    std::condition_variable mCV;
+    std::deque<Check> mQueue;
+    size_t mQueued{0};
+    size_t mRunning{0};
+    uint32_t mHelpers{0};
+    std::vector<Failure> mFailures;
+
+    explicit DeferredChecks(std::vector<std::shared_ptr<Invariant>> invariants)
+        : mInvariants(std::move(invariants))
+    {
+    }
+
+    std::vector<Failure>
+    check(Check const& c) const
+    {
+        std::vector<Failure> failures;
+        auto ledger = c.mDelta.header.current.ledgerSeq;
+        for (auto const& invariant : mInvariants)
+        {
+            std::string result;
+            try
+            {
+                result = invariant->checkOnOperationApply(
+                    c.mOperation, c.mResult, c.mDelta);
+            }
+            catch (std::exception& e)
+            {
+                result = fmt::format("exception while checking: {}", e.what());
+            }
+            if (!result.empty())
+            {
+                failures.push_back(
+                    {c.mIndex, invariant,
+                     operationFailureMessage(*invariant, result, c.mOperation),
+                     ledger});
+            }
+        }
+        return failures;
+    }
+
+    // Checks queued operations until there are none left; a helper job stops
+    // counting itself as soon as it finds the queue empty, so that the next
+    // queued operation posts a new one.
+    void
+    run(bool helper)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mQueue.empty())
+        {
+            auto c = std::move(mQueue.front());
+            mQueue.pop_front();
+            ++mRunning;
+            lock.unlock();
+            auto failures = check(c);
+            lock.lock();
+            std::move(failures.begin(), failures.end(),
+                      std::back_inserter(mFailures));
+            --mRunning;
+        }
+        if (helper)
+        {
+            --mHelpers;
+        }
+        mCV.notify_all();
+    }
+};
+
+InvariantManagerImpl::InvariantManagerImpl(Application& app)
+    : mApp(app)
+    , mInvariantFailureCount(
+          app.getMetrics().NewCounter({"ledger", "invariant", "failure"}))
+    , mCheckThreads(app.getConfig().INVARIANT_CHECK_THREADS)
 {
 }
 
@@ -106,6 +218,28 @@ InvariantManagerImpl::checkOnOperationApply(Operation const& operation,
         return;
     }
 
+    // mDeferred only changes on the main thread, between ledger applies
+    if (auto deferred = mDeferred)
+    {
+        bool post;
+        {
+            std::lock_guard<std::mutex> lock(deferred->mMutex);
+            deferred->mQueue.push_back(
+                {deferred->mQueued++, operation, opres, ltxDelta});
+            post = deferred->mHelpers < mCheckThreads;
+            if (post)
+            {
+                ++deferred->mHelpers;
+            }
+        }
+        if (post)
+        {
+            mApp.postOnBackgroundThread(
+                [deferred]() { deferred->run(true); }, "InvariantCheck");
+        }
+        return;
+    }
+
     for (auto invariant : mEnabled)
     {
         auto result =
@@ -115,11 +249,52 @@ InvariantManagerImpl::checkOnOperationApply(Operation const& operation,
             continue;
         }
 
-        auto message = fmt::format(
-            R"(Invariant "{}" does not hold on operation: {}{}{})",
-            invariant->getName(), result, "\n", xdr_to_string(operation));
-        onInvariantFailure(invariant, message,
-                           ltxDelta.header.current.ledgerSeq);
+        onInvariantFailure(
+            invariant, operationFailureMessage(*invariant, result, operation),
+            ltxDelta.header.current.ledgerSeq);
+    }
+}
+
+void
+InvariantManagerImpl::deferOperationChecks()
+{
+    // a batch left over by a close that threw is dropped; its helper jobs
+    // still hold it until they are done
+    mDeferred.reset();
+    if (mCheckThreads > 0 && !mEnabled.empty())
+    {
+        mDeferred = std::make_shared<DeferredChecks>(mEnabled);
+    }
+}
+
+void
+InvariantManagerImpl::checkDeferredOperations()
+{
+    auto deferred = std::move(mDeferred);
+    if (!deferred)
+    {
+        return;
+    }
+
+    // help the worker threads, then wait for the checks they are running
+    deferred->run(false);
+    std::vector<DeferredChecks::Failure> failures;
+    {
+        std::unique_lock<std::mutex> lock(deferred->mMutex);
+        deferred->mCV.wait(lock, [&]() {
+            return deferred->mQueue.empty() && deferred->mRunning == 0;
+        });
+        failures = std::move(deferred->mFailures);
+    }
+
+    std::stable_sort(failures.begin(), failures.end(),
+                     [](DeferredChecks::Failure const& lhs,
+                        DeferredChecks::Failure const& rhs) {
+                         return lhs.mIndex < rhs.mIndex;
+                     });
+    for (auto const& f : failures)
+    {
+        onInvariantFailure(f.mInvariant, f.mMessage, f.mLedger);
     }
 }
 
@@ -19,6 +19,7 @@ namespace diamnet
 
 class InvariantManagerImpl : public InvariantManager
 {
+    Application& mApp;
     std::map<std::string, std::shared_ptr<Invariant>> mInvariants;
     std::vector<std::shared_ptr<Invariant>> mEnabled;
     medida::Counter& mInvariantFailureCount;
@@ -30,8 +31,14 @@ class InvariantManagerImpl : public InvariantManager
     };
     std::map<std::string, InvariantFailureInformation> mFailureInformation;
 
+    // Operations queued while checks are deferred, and the helper jobs
+    // checking them; shared with those jobs, which may outlive a batch.
+    struct DeferredChecks;
+    uint32_t const mCheckThreads;
+    std::shared_ptr<DeferredChecks> mDeferred;
+
   public:
-    InvariantManagerImpl(medida::MetricsRegistry& registry);
+    InvariantManagerImpl(Application& app);
 
     virtual Json::Value getJsonInfo() override;
 
@@ -45,6 +52,10 @@ class InvariantManagerImpl : public InvariantManager
                                     uint32_t ledger, uint32_t level,
                                     bool isCurr) override;
 
+    virtual void deferOperationChecks() override;
+
+    virtual void checkDeferredOperations() override;
+
     virtual void
     registerInvariant(std::shared_ptr<Invariant> invariant) override;
 
@@ -39,9 +39,9 @@ struct BucketListGenerator
     std::unordered_set<LedgerKey> mLiveKeys;
 
   public:
-    BucketListGenerator()
+    explicit BucketListGenerator(Config const& applyCfg = getTestConfig(1))
         : mAppGenerate(createTestApplication(mClock, getTestConfig(0)))
-        , mAppApply(createTestApplication(mApplyClock, getTestConfig(1)))
+        , mAppApply(createTestApplication(mApplyClock, applyCfg))
         , mLedgerSeq(1)
     {
         auto skey = SecretKey::fromSeed(mAppGenerate->getNetworkID());
@@ -224,8 +224,11 @@ struct SelectBucketListGenerator : public BucketListGenerator
     LedgerEntryType const mType;
     std::shared_ptr<LedgerEntry> mSelected;
 
-    SelectBucketListGenerator(uint32_t selectLedger, LedgerEntryType type)
-        : mSelectLedger(selectLedger), mType(type)
+    SelectBucketListGenerator(uint32_t selectLedger, LedgerEntryType type,
+                              Config const& applyCfg = getTestConfig(1))
+        : BucketListGenerator(applyCfg)
+        , mSelectLedger(selectLedger)
+        , mType(type)
     {
     }
 
@@ -643,6 +646,53 @@ TEST_CASE("BucketListIsConsistentWithDatabase modified entries",
     }
 }
 
+TEST_CASE("BucketListIsConsistentWithDatabase sampled entries",
+          "[invariant][bucketlistconsistent]")
+{
+    Config cfg = getTestConfig(1);
+    cfg.PREFETCH_BATCH_SIZE = 7;
+
+    SECTION("succeed")
+    {
+        cfg.INVARIANT_BUCKET_SAMPLE_PERCENT = 50;
+        BucketListGenerator blg(cfg);
+        blg.generateLedgers(100);
+        REQUIRE_NOTHROW(blg.applyBuckets());
+    }
+    SECTION("modified entries are missed without sampling")
+    {
+        cfg.INVARIANT_BUCKET_SAMPLE_PERCENT = 0;
+        for (;;)
+        {
+            SelectBucketListGenerator blg(100, ACCOUNT, cfg);
+            blg.generateLedgers(100);
+            if (!blg.mSelected)
+            {
+                continue;
+            }
+            REQUIRE_NOTHROW(
+                blg.applyBuckets<ApplyBucketsWorkModifyEntry>(*blg.mSelected));
+            break;
+        }
+    }
+    SECTION("modified entries are found in small batches")
+    {
+        for (;;)
+        {
+            SelectBucketListGenerator blg(100, ACCOUNT, cfg);
+            blg.generateLedgers(100);
+            if (!blg.mSelected)
+            {
+                continue;
+            }
+            REQUIRE_THROWS_AS(
+                blg.applyBuckets<ApplyBucketsWorkModifyEntry>(*blg.mSelected),
+                InvariantDoesNotHold);
+            break;
+        }
+    }
+}
+
 TEST_CASE("BucketListIsConsistentWithDatabase bucket bounds",
           "[invariant][bucketlistconsistent][acceptance]")
 {
@@ -10,14 +10,21 @@
 #include "invariant/Invariant.h"
 #include "invariant/InvariantDoesNotHold.h"
 #include "invariant/InvariantManager.h"
+#include "ledger/LedgerCloseTiming.h"
+#include "ledger/LedgerManager.h"
 #include "ledger/LedgerTxn.h"
 #include "ledger/test/LedgerTestUtils.h"
 #include "lib/catch.hpp"
 #include "main/Application.h"
+#include "test/TestAccount.h"
 #include "test/TestUtils.h"
+#include "test/TxTests.h"
 #include "test/test.h"
 
+#include <atomic>
 #include <fmt/format.h>
+#include <medida/meter.h>
+#include <medida/metrics_registry.h>
 
 using namespace diamnet;
 
@@ -72,6 +79,31 @@ class TestInvariant : public Invariant
     int mInvariantID;
     bool mShouldFail;
 };
+
+class CountingInvariant : public Invariant
+{
+  public:
+    CountingInvariant() : Invariant(true)
+    {
+    }
+
+    virtual std::string
+    getName() const override
+    {
+        return "CountingInvariant";
+    }
+
+    virtual std::string
+    checkOnOperationApply(Operation const& operation,
+                          OperationResult const& result,
+                          LedgerTxnDelta const& ltxDelta) override
+    {
+        ++mChecked;
+        return "";
+    }
+
+    std::atomic<size_t> mChecked{0};
+};
 }
 
 using namespace InvariantTests;
@@ -214,3 +246,92 @@ TEST_CASE("onOperationApply fail succeed", "[invariant]")
             {}, res, ltx.getDelta()));
     }
 }
+
+TEST_CASE("deferred onOperationApply", "[invariant]")
+{
+    VirtualClock clock;
+    Config cfg = getTestConfig();
+    cfg.INVARIANT_CHECK_THREADS = 2;
+
+    SECTION("Fail")
+    {
+        Application::pointer app = createTestApplication(clock, cfg);
+        auto& im = app->getInvariantManager();
+        im.registerInvariant<TestInvariant>(0, true);
+        im.enableInvariant(TestInvariant::toString(0, true));
+
+        OperationResult res;
+        LedgerTxn ltx(app->getLedgerTxnRoot());
+        auto delta = ltx.getDelta();
+        im.deferOperationChecks();
+        for (int i = 0; i < 10; ++i)
+        {
+            REQUIRE_NOTHROW(im.checkOnOperationApply({}, res, delta));
+        }
+        REQUIRE_THROWS_AS(im.checkDeferredOperations(), InvariantDoesNotHold);
+
+        // checks are synchronous again
+        REQUIRE_NOTHROW(im.checkDeferredOperations());
+        REQUIRE_THROWS_AS(im.checkOnOperationApply({}, res, delta),
+                          InvariantDoesNotHold);
+    }
+    SECTION("Succeed")
+    {
+        Application::pointer app = createTestApplication(clock, cfg);
+        auto& im = app->getInvariantManager();
+        im.registerInvariant<TestInvariant>(0, false);
+        im.enableInvariant(TestInvariant::toString(0, false));
+
+        OperationResult res;
+        LedgerTxn ltx(app->getLedgerTxnRoot());
+        auto delta = ltx.getDelta();
+        im.deferOperationChecks();
+        for (int i = 0; i < 10; ++i)
+        {
+            im.checkOnOperationApply({}, res, delta);
+        }
+        REQUIRE_NOTHROW(im.checkDeferredOperations());
+    }
+    SECTION("closing ledgers")
+    {
+        // with every invariant enabled by the test configuration
+        Application::pointer app = createTestApplication(clock, cfg);
+        app->start();
+
+        auto root = TestAccount::createRoot(*app);
+        auto a1 = root.create(
+            "a1", app->getLedgerManager().getLastMinBalance(2) * 10);
+        closeLedgerOn(*app, 2, 1, 1, 2016,
+                      {a1.tx({payment(root, 100)}), root.tx({payment(a1, 1)})});
+        closeLedgerOn(*app, 3, 2, 1, 2016, {root.tx({payment(a1, 100)})});
+
+        auto closes = app->getLedgerManager().getCloseTiming().getJson();
+        REQUIRE(closes.size() >= 2);
+        REQUIRE(closes[closes.size() - 1]["phases"].isMember("invariant-wait"));
+        REQUIRE(app->getInvariantManager().getJsonInfo().empty());
+    }
+    SECTION("applying transactions in parallel")
+    {
+        cfg.PARALLEL_TX_APPLY_THREADS = 4;
+        Application::pointer app = createTestApplication(clock, cfg);
+        auto counting =
+            app->getInvariantManager().registerInvariant<CountingInvariant>();
+        app->getInvariantManager().enableInvariant("CountingInvariant");
+        app->start();
+
+        auto root = TestAccount::createRoot(*app);
+        auto balance = app->getLedgerManager().getLastMinBalance(2) * 10;
+        auto a1 = root.create("a1", balance);
+        auto a2 = root.create("a2", balance);
+        auto a3 = root.create("a3", balance);
+        auto a4 = root.create("a4", balance);
+        auto checked = counting->mChecked.load();
+        closeLedgerOn(*app, 2, 1, 1, 2016,
+                      {a1.tx({payment(a2, 100)}), a3.tx({payment(a4, 100)})});
+
+        auto& parallel = app->getMetrics().NewMeter(
+            {"ledger", "apply", "parallel"}, "ledger");
+        REQUIRE(parallel.count() == 1);
+        REQUIRE(counting->mChecked == checked + 2);
+    }
+}
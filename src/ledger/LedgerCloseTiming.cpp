@@ -0,0 +1,329 @@
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerCloseTiming.h"
+#include "ledger/LedgerTxn.h"
+#include "util/GlobalChecks.h"
+#include <medida/histogram.h>
+#include <medida/meter.h>
+#include <medida/metrics_registry.h>
+#include <medida/timer.h>
+#include <xdrpp/types.h>
+
+#include <algorithm>
+#include <cctype>
+
+namespace diamnet
+{
+
+size_t const LedgerCloseTiming::DEFAULT_KEPT;
+
+namespace
+{
+size_t
+operationTypeCount()
+{
+    auto const& values = xdr::xdr_traits<OperationType>::enum_values();
+    return static_cast<size_t>(
+               *std::max_element(values.begin(), values.end())) +
+           1;
+}
+
+double
+milliseconds(LedgerCloseTiming::Clock::duration d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+double
+milliseconds(uint64_t ns)
+{
+    return static_cast<double>(ns) / 1e6;
+}
+
+// XDR enum names as metric names: PATH_PAYMENT_STRICT_SEND becomes
+// path-payment-strict-send, and opNO_ACCOUNT becomes op-no-account.
+std::string
+metricName(char const* name)
+{
+    std::string res;
+    for (auto p = name; *p; ++p)
+    {
+        auto c = static_cast<unsigned char>(*p);
+        if (c == '_')
+        {
+            res += '-';
+        }
+        else
+        {
+            if (std::isupper(c) && p != name &&
+                std::islower(static_cast<unsigned char>(p[-1])))
+            {
+                res += '-';
+            }
+            res += static_cast<char>(std::tolower(c));
+        }
+    }
+    return res;
+}
+
+std::string
+operationTypeName(OperationType type)
+{
+    auto name = xdr::xdr_traits<OperationType>::enum_name(type);
+    return name ? name : std::to_string(static_cast<int32_t>(type));
+}
+}
+
+LedgerCloseTiming::OperationCost::OperationCost(OperationType type,
+                                                char const* result,
+                                                Clock::duration time,
+                                                uint64_t sqlLoads)
+    : mType(type)
+    , mResult(result)
+    , mTime(time)
+    , mSqlLoads(sqlLoads)
+    , mEntriesLoaded(0)
+    , mEntriesCreated(0)
+    , mEntriesModified(0)
+    , mEntriesDeleted(0)
+{
+}
+
+void
+LedgerCloseTiming::OperationCost::countEntries(LedgerTxnDelta const& delta)
+{
+    for (auto const& kv : delta.entry)
+    {
+        auto const& d = kv.second;
+        ++mEntriesLoaded;
+        if (!d.previous)
+        {
+            ++mEntriesCreated;
+        }
+        else if (!d.current)
+        {
+            ++mEntriesDeleted;
+        }
+        else if (*d.current != *d.previous)
+        {
+            ++mEntriesModified;
+        }
+    }
+}
+
+LedgerCloseTiming::Scope::Scope(LedgerCloseTiming& timing, Phase phase)
+    : mTiming(timing), mPhase(phase), mStart(Clock::now())
+{
+}
+
+LedgerCloseTiming::Scope::~Scope()
+{
+    mTiming.addPhase(mPhase, Clock::now() - mStart);
+}
+
+LedgerCloseTiming::LedgerCloseTiming(medida::MetricsRegistry& registry,
+                                     size_t kept)
+    : mRegistry(registry)
+    , mInvariantTimer(registry.NewTimer({"ledger", "close", "invariants"}))
+    , mKept(kept)
+    , mOperations(operationTypeCount())
+    , mOperationMetrics(mOperations.size())
+{
+    for (size_t i = 0; i < PHASE_COUNT; ++i)
+    {
+        mPhaseTimers[i] = &registry.NewTimer(
+            {"ledger", "close", phaseName(static_cast<Phase>(i))});
+    }
+    begin(0);
+}
+
+char const*
+LedgerCloseTiming::phaseName(Phase phase)
+{
+    switch (phase)
+    {
+    case PREFETCH:
+        return "prefetch";
+    case FEES_SEQ_NUMS:
+        return "fees-seqnums";
+    case APPLY:
+        return "apply";
+    case UPGRADES:
+        return "upgrades";
+    case BUCKETS:
+        return "buckets";
+    case META_STREAM:
+        return "meta-stream";
+    case TX_HISTORY:
+        return "tx-history";
+    case INVARIANT_WAIT:
+        return "invariant-wait";
+    case COMMIT:
+        return "commit";
+    case PUBLISH:
+        return "publish";
+    default:
+        releaseAssert(false);
+        return nullptr;
+    }
+}
+
+std::string
+LedgerCloseTiming::operationMetricName(OperationType type)
+{
+    return metricName(operationTypeName(type).c_str());
+}
+
+void
+LedgerCloseTiming::begin(uint32_t ledgerSeq)
+{
+    mLedgerSeq = ledgerSeq;
+    mStart = Clock::now();
+    mPhases.fill(Clock::duration::zero());
+    std::fill(mOperations.begin(), mOperations.end(), OperationTime{});
+    mInvariantNs = 0;
+}
+
+void
+LedgerCloseTiming::addPhase(Phase phase, Clock::duration d)
+{
+    mPhases.at(phase) += d;
+}
+
+LedgerCloseTiming::OperationMetrics&
+LedgerCloseTiming::getOperationMetrics(OperationType type)
+{
+    auto& m = mOperationMetrics.at(static_cast<size_t>(type));
+    if (!m)
+    {
+        auto name = operationMetricName(type);
+        auto histogram = [&](std::string const& m) -> medida::Histogram& {
+            return mRegistry.NewHistogram({"ledger", "operation", name, m});
+        };
+        m.reset(new OperationMetrics{
+            mRegistry.NewTimer({"ledger", "operation", name, "apply"}),
+            histogram("sql-loads"), histogram("entries-loaded"),
+            histogram("entries-created"), histogram("entries-modified"),
+            histogram("entries-deleted"),
+            {}});
+    }
+    return *m;
+}
+
+medida::Meter&
+LedgerCloseTiming::getResultMeter(OperationType type, char const* result)
+{
+    auto& results = getOperationMetrics(type).mResults;
+    auto it = results.find(result);
+    if (it == results.end())
+    {
+        auto& meter = mRegistry.NewMeter(
+            {"ledger", "operation-result", operationMetricName(type),
+             metricName(result)},
+            "operation");
+        it = results.emplace(result, &meter).first;
+    }
+    return *it->second;
+}
+
+void
+LedgerCloseTiming::addOperation(OperationCost const& cost)
+{
+    auto i = static_cast<size_t>(cost.mType);
+    if (i >= mOperations.size())
+    {
+        return;
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(cost.mTime);
+    auto& op = mOperations[i];
+    ++op.mCount;
+    op.mNs += ns.count();
+    op.mSqlLoads += cost.mSqlLoads;
+    op.mEntriesLoaded += cost.mEntriesLoaded;
+    op.mEntriesCreated += cost.mEntriesCreated;
+    op.mEntriesModified += cost.mEntriesModified;
+    op.mEntriesDeleted += cost.mEntriesDeleted;
+
+    auto& metrics = getOperationMetrics(cost.mType);
+    metrics.mApply.Update(ns);
+    metrics.mSqlLoads.Update(cost.mSqlLoads);
+    metrics.mEntriesLoaded.Update(cost.mEntriesLoaded);
+    metrics.mEntriesCreated.Update(cost.mEntriesCreated);
+    metrics.mEntriesModified.Update(cost.mEntriesModified);
+    metrics.mEntriesDeleted.Update(cost.mEntriesDeleted);
+    getResultMeter(cost.mType, cost.mResult).Mark();
+}
+
+void
+LedgerCloseTiming::addInvariants(Clock::duration d)
+{
+    mInvariantNs +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+void
+LedgerCloseTiming::end(size_t txs, size_t ops)
+{
+    auto total = Clock::now() - mStart;
+
+    Json::Value rec;
+    rec["ledger"] = mLedgerSeq;
+    rec["txs"] = static_cast<Json::UInt64>(txs);
+    rec["ops"] = static_cast<Json::UInt64>(ops);
+    rec["total_ms"] = milliseconds(total);
+
+    auto& phases = rec["phases"];
+    auto other = total;
+    for (size_t i = 0; i < PHASE_COUNT; ++i)
+    {
+        mPhaseTimers[i]->Update(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(mPhases[i]));
+        phases[phaseName(static_cast<Phase>(i))] = milliseconds(mPhases[i]);
+        other -= mPhases[i];
+    }
+    // bookkeeping between the phases
+    phases["other"] = milliseconds(std::max(other, Clock::duration::zero()));
+
+    mInvariantTimer.Update(std::chrono::nanoseconds(mInvariantNs));
+    rec["invariants_ms"] = milliseconds(mInvariantNs);
+
+    auto& operations = rec["operations"];
+    operations = Json::objectValue;
+    for (size_t i = 0; i < mOperations.size(); ++i)
+    {
+        auto const& t = mOperations[i];
+        if (t.mCount == 0)
+        {
+            continue;
+        }
+        auto& op = operations[operationTypeName(static_cast<OperationType>(i))];
+        op["count"] = static_cast<Json::UInt64>(t.mCount);
+        op["apply_ms"] = milliseconds(t.mNs);
+        op["sql_loads"] = static_cast<Json::UInt64>(t.mSqlLoads);
+        op["entries_loaded"] = static_cast<Json::UInt64>(t.mEntriesLoaded);
+        op["entries_created"] = static_cast<Json::UInt64>(t.mEntriesCreated);
+        op["entries_modified"] = static_cast<Json::UInt64>(t.mEntriesModified);
+        op["entries_deleted"] = static_cast<Json::UInt64>(t.mEntriesDeleted);
+    }
+
+    mRecords.emplace_back(std::move(rec));
+    while (mRecords.size() > mKept)
+    {
+        mRecords.pop_front();
+    }
+}
+
+Json::Value
+LedgerCloseTiming::getJson(size_t n) const
+{
+    Json::Value res = Json::arrayValue;
+    auto first = mRecords.size() - std::min(n, mRecords.size());
+    for (auto i = first; i < mRecords.size(); ++i)
+    {
+        res.append(mRecords[i]);
+    }
+    return res;
+}
+}
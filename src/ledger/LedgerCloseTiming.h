@@ -0,0 +1,163 @@
+#pragma once
+
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "lib/json/json.h"
+#include "util/NonCopyable.h"
+#include "xdr/Diamnet-transaction.h"
+#include <array>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace medida
+{
+class Histogram;
+class Meter;
+class MetricsRegistry;
+class Timer;
+}
+
+namespace diamnet
+{
+struct LedgerTxnDelta;
+
+// Where the time of each ledger close goes.
+//
+// closeLedger is split into phases, timed on the main thread; within the
+// apply phase, the time applying each type of operation and checking
+// invariants on it is also added up. Operations applied on other threads (see
+// ParallelTxApply) are only added, on the main thread, once committed.
+//
+// Every phase (and invariant checks) updates a `ledger.close.<phase>` timer,
+// and a record of each of the last few closes is kept for getJson. What each
+// operation cost is also counted in `ledger.operation.<type>.*` metrics, and
+// its result in `ledger.operation-result.<type>.<code>`, whether or not it is
+// applied as part of a ledger close.
+class LedgerCloseTiming : NonMovableOrCopyable
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    enum Phase
+    {
+        PREFETCH,
+        FEES_SEQ_NUMS,
+        APPLY,
+        UPGRADES,
+        BUCKETS,
+        META_STREAM,
+        TX_HISTORY,
+        INVARIANT_WAIT,
+        COMMIT,
+        PUBLISH,
+        PHASE_COUNT
+    };
+
+    // Adds the time of its scope to a phase of the current close.
+    class Scope : NonMovableOrCopyable
+    {
+        LedgerCloseTiming& mTiming;
+        Phase const mPhase;
+        Clock::time_point const mStart;
+
+      public:
+        Scope(LedgerCloseTiming& timing, Phase phase);
+        ~Scope();
+    };
+
+    // What applying one operation cost.
+    struct OperationCost
+    {
+        OperationType mType;
+        // see OperationFrame::getResultCodeName
+        char const* mResult;
+        Clock::duration mTime;
+        // select queries run while applying it
+        uint64_t mSqlLoads;
+        // the entries it loaded, and of those, the ones it created, modified
+        // and deleted; only counted for operations that succeeded
+        uint64_t mEntriesLoaded;
+        uint64_t mEntriesCreated;
+        uint64_t mEntriesModified;
+        uint64_t mEntriesDeleted;
+
+        OperationCost(OperationType type, char const* result,
+                      Clock::duration time, uint64_t sqlLoads);
+
+        void countEntries(LedgerTxnDelta const& delta);
+    };
+
+    explicit LedgerCloseTiming(medida::MetricsRegistry& registry,
+                               size_t kept = DEFAULT_KEPT);
+
+    // Starts timing the close of ledgerSeq.
+    void begin(uint32_t ledgerSeq);
+
+    void addPhase(Phase phase, Clock::duration d);
+    void addOperation(OperationCost const& cost);
+    void addInvariants(Clock::duration d);
+
+    // Ends the current close, updating the timers and keeping its record.
+    void end(size_t txs, size_t ops);
+
+    // The records of the last n (by default, all kept) closes, oldest first;
+    // times in milliseconds.
+    Json::Value getJson(size_t n = SIZE_MAX) const;
+
+    static char const* phaseName(Phase phase);
+    // The <type> of the `ledger.operation.<type>.*` metrics.
+    static std::string operationMetricName(OperationType type);
+
+    static size_t const DEFAULT_KEPT = 100;
+
+  private:
+    struct OperationTime
+    {
+        uint64_t mCount{0};
+        uint64_t mNs{0};
+        uint64_t mSqlLoads{0};
+        uint64_t mEntriesLoaded{0};
+        uint64_t mEntriesCreated{0};
+        uint64_t mEntriesModified{0};
+        uint64_t mEntriesDeleted{0};
+    };
+
+    struct OperationMetrics
+    {
+        medida::Timer& mApply;
+        medida::Histogram& mSqlLoads;
+        medida::Histogram& mEntriesLoaded;
+        medida::Histogram& mEntriesCreated;
+        medida::Histogram& mEntriesModified;
+        medida::Histogram& mEntriesDeleted;
+        // by result code name, which are string constants
+        std::unordered_map<char const*, medida::Meter*> mResults;
+    };
+
+    OperationMetrics& getOperationMetrics(OperationType type);
+    medida::Meter& getResultMeter(OperationType type, char const* result);
+
+    medida::MetricsRegistry& mRegistry;
+    std::array<medida::Timer*, PHASE_COUNT> mPhaseTimers;
+    medida::Timer& mInvariantTimer;
+    size_t const mKept;
+
+    uint32_t mLedgerSeq{0};
+    Clock::time_point mStart;
+    std::array<Clock::duration, PHASE_COUNT> mPhases;
+    // indexed by OperationType
+    std::vector<OperationTime> mOperations;
+    uint64_t mInvariantNs{0};
+
+    // created on first use, by OperationType
+    std::vector<std::unique_ptr<OperationMetrics>> mOperationMetrics;
+
+    std::deque<Json::Value> mRecords;
+};
+}
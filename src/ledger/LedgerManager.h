@@ -12,6 +12,7 @@ namespace diamnet
 {
 
 class LedgerCloseData;
+class LedgerCloseTiming;
 class Database;
 
 /**
@@ -160,6 +161,9 @@ class LedgerManager
 
     virtual void manuallyAdvanceLedgerHeader(LedgerHeader const& header) = 0;
 
+    // Where the time of recent ledger closes went.
+    virtual LedgerCloseTiming& getCloseTiming() = 0;
+
     virtual ~LedgerManager()
     {
     }
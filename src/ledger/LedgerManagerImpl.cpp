@@ -16,11 +16,15 @@
 #include "herder/TxSetFrame.h"
 #include "herder/Upgrades.h"
 #include "history/HistoryManager.h"
+#include "invariant/InvariantDoesNotHold.h"
+#include "invariant/InvariantManager.h"
 #include "ledger/LedgerHeaderUtils.h"
 #include "ledger/LedgerRange.h"
 #include "ledger/LedgerTxn.h"
 #include "ledger/LedgerTxnEntry.h"
 #include "ledger/LedgerTxnHeader.h"
+#include "ledger/ParallelTxApply.h"
+#include "ledger/TxHistoryWriter.h"
 #include "main/Application.h"
 #include "main/Config.h"
 #include "main/ErrorMessages.h"
@@ -33,6 +37,7 @@
 #include "util/Logging.h"
 #include "util/XDRCereal.h"
 #include "util/XDROperators.h"
+#include "util/ZoneStats.h"
 #include <fmt/format.h>
 
 #include "medida/buckets.h"
@@ -121,18 +126,32 @@ LedgerManagerImpl::LedgerManagerImpl(Application& app)
     , mPrefetchHitRate(
           app.getMetrics().NewHistogram({"ledger", "prefetch", "hit-rate"},
                                         medida::SamplingInterface::kSliding))
+    , mParallelApplySuccess(app.getMetrics().NewMeter(
+          {"ledger", "apply", "parallel"}, "ledger"))
+    , mParallelApplyFallback(app.getMetrics().NewMeter(
+          {"ledger", "apply", "parallel-fallback"}, "ledger"))
+    , mParallelApplyGroups(app.getMetrics().NewHistogram(
+          {"ledger", "apply", "parallel-groups"}))
+    , mHistoryWrite(
+          app.getMetrics().NewTimer({"ledger", "history", "write"}))
+    , mHistoryWait(app.getMetrics().NewTimer({"ledger", "history", "wait"}))
     , mLedgerClose(app.getMetrics().NewTimer({"ledger", "ledger", "close"}))
     , mLedgerAgeClosed(app.getMetrics().NewBuckets(
           {"ledger", "age", "closed"}, {5000.0, 7000.0, 10000.0, 20000.0}))
     , mLedgerAge(
           app.getMetrics().NewCounter({"ledger", "age", "current-seconds"}))
     , mLastClose(mApp.getClock().now())
+    , mCloseTiming(app.getMetrics())
     , mCatchupDuration(
           app.getMetrics().NewTimer({"ledger", "catchup", "duration"}))
     , mState(LM_BOOTING_STATE)
 
 {
     setupLedgerCloseMetaStream();
+    if (TxHistorySegments::isEnabled(mApp.getConfig()))
+    {
+        mTxHistorySegments = std::make_unique<TxHistorySegments>(mApp);
+    }
 }
 
 void
@@ -276,6 +295,7 @@ LedgerManagerImpl::loadLastKnownLedger(
             }
             CLOG(INFO, "Ledger") << "Loaded LCL header from database: "
                                  << ledgerAbbrev(*currentLedger);
+            TxHistoryWriter::recover(mApp, currentLedger->ledgerSeq);
             LedgerTxn ltx(mApp.getLedgerTxnRoot());
             ltx.loadHeader().current() = *currentLedger;
             ltx.commit();
@@ -523,6 +543,8 @@ during replays.
 void
 LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
 {
+    // ahead of the zone, so the trace includes it
+    ZoneStats::Trace zoneTrace(ledgerData.getLedgerSeq());
     ZoneScoped;
     auto ledgerTime = mLedgerClose.TimeScope();
     DBTimeExcluder qtExclude(mApp);
@@ -538,6 +560,7 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
                           << header.current().ledgerSeq;
 
     ZoneValue(static_cast<int64_t>(header.current().ledgerSeq));
+    mCloseTiming.begin(header.current().ledgerSeq);
 
     auto now = mApp.getClock().now();
     mLedgerAgeClosed.Update(now - mLastClose);
@@ -590,9 +613,10 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
     // In addition to the _canonical_ LedgerResultSet hashed into the
     // LedgerHeader, we optionally collect an even-more-fine-grained record of
     // the ledger entries modified by each tx during tx processing in a
-    // LedgerCloseMeta, for streaming to attached clients (typically: horizon).
+    // LedgerCloseMeta, for streaming to attached clients (typically: horizon)
+    // and for storing in TxHistorySegments.
     std::unique_ptr<LedgerCloseMeta> ledgerCloseMeta;
-    if (mMetaStream)
+    if (mMetaStream || mTxHistorySegments)
     {
         ledgerCloseMeta = std::make_unique<LedgerCloseMeta>();
         ledgerCloseMeta->v0().txProcessing.reserve(txSet->sizeTx());
@@ -604,14 +628,35 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
     // sorted such that sequence numbers are respected
     vector<TransactionFrameBasePtr> txs = ledgerData.getTxSet()->sortForApply();
 
+    // txhistory, txfeehistory and ledgerheaders rows are possibly written in
+    // the background while the rest of the ledger closes, see
+    // TxHistoryWriter.
+    std::unique_ptr<TxHistoryWriter> historyWriter;
+    if (!mTxHistorySegments && TxHistoryWriter::canWriteAsync(mApp))
+    {
+        historyWriter = std::make_unique<TxHistoryWriter>(
+            mApp, header.current().ledgerSeq);
+    }
+
     // first, prefetch source accounts fot txset, then charge fees
-    prefetchTxSourceIds(txs);
-    processFeesSeqNums(txs, ltx, txSet->getBaseFee(header.current()),
-                       ledgerCloseMeta);
+    {
+        LedgerCloseTiming::Scope t(mCloseTiming, LedgerCloseTiming::PREFETCH);
+        prefetchTxSourceIds(txs);
+    }
+    auto baseFee = txSet->getBaseFee(header.current());
+    {
+        LedgerCloseTiming::Scope t(mCloseTiming,
+                                   LedgerCloseTiming::FEES_SEQ_NUMS);
+        processFeesSeqNums(txs, ltx, baseFee, ledgerCloseMeta,
+                           historyWriter.get());
+    }
 
     TransactionResultSet txResultSet;
     txResultSet.results.reserve(txs.size());
-    applyTransactions(txs, ltx, txResultSet, ledgerCloseMeta);
+    auto& invariantManager = mApp.getInvariantManager();
+    invariantManager.deferOperationChecks();
+    applyTransactions(txs, ltx, baseFee, txResultSet, ledgerCloseMeta,
+                      historyWriter.get());
 
     ltx.loadHeader().current().txSetResultHash =
         sha256(xdr::xdr_to_opaque(txResultSet));
@@ -621,6 +666,7 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
     // was validated before upgrades
     for (size_t i = 0; i < sv.upgrades.size(); i++)
     {
+        LedgerCloseTiming::Scope t(mCloseTiming, LedgerCloseTiming::UPGRADES);
         LedgerUpgrade lupgrade;
         auto valid = Upgrades::isValidForApply(
             sv.upgrades[i], lupgrade, ltx.loadHeader().current(),
@@ -673,16 +719,56 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
         }
     }
 
-    ledgerClosed(ltx);
+    ledgerClosed(ltx, historyWriter.get());
+
+    // Operation invariants may be checked on worker threads while the rest of
+    // the ledger is processed; they must all hold before anything of it goes
+    // out, starting with the meta stream.
+    {
+        LedgerCloseTiming::Scope t(mCloseTiming,
+                                   LedgerCloseTiming::INVARIANT_WAIT);
+        try
+        {
+            invariantManager.checkDeferredOperations();
+        }
+        catch (InvariantDoesNotHold&)
+        {
+            printErrorAndAbort("Invariant failure while applying operations");
+        }
+    }
+
+    if (ledgerCloseMeta)
+    {
+        ledgerCloseMeta->v0().ledgerHeader = mLastClosedLedger;
+    }
 
     if (mMetaStream)
     {
+        LedgerCloseTiming::Scope t(mCloseTiming,
+                                   LedgerCloseTiming::META_STREAM);
         releaseAssert(ledgerCloseMeta);
-        ledgerCloseMeta->v0().ledgerHeader = mLastClosedLedger;
         mMetaStream->writeOne(*ledgerCloseMeta);
         mMetaStream->flush();
     }
 
+    // Like the background history transaction below, the segment record has
+    // to be durable before the ledger commits.
+    if (mTxHistorySegments)
+    {
+        LedgerCloseTiming::Scope t(mCloseTiming, LedgerCloseTiming::TX_HISTORY);
+        releaseAssert(ledgerCloseMeta);
+        mTxHistorySegments->append(*ledgerCloseMeta);
+    }
+
+    // The background history transaction must commit before the ledger
+    // does, so that a committed ledger always has its history.
+    if (historyWriter)
+    {
+        LedgerCloseTiming::Scope t(mCloseTiming, LedgerCloseTiming::TX_HISTORY);
+        auto waitTime = mHistoryWait.TimeScope();
+        mHistoryWrite.Update(historyWriter->commit());
+    }
+
     // The next 4 steps happen in a relatively non-obvious, subtle order.
     // This is unfortunate and it would be nice if we could make it not
     // be so subtle, but for the time being this is where we are.
@@ -705,14 +791,20 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
     hm.maybeQueueHistoryCheckpoint();
 
     // step 2
-    ltx.commit();
+    {
+        LedgerCloseTiming::Scope t(mCloseTiming, LedgerCloseTiming::COMMIT);
+        ltx.commit();
+    }
 
-    // step 3
-    hm.publishQueuedHistory();
-    hm.logAndUpdatePublishStatus();
+    {
+        LedgerCloseTiming::Scope t(mCloseTiming, LedgerCloseTiming::PUBLISH);
+        // step 3
+        hm.publishQueuedHistory();
+        hm.logAndUpdatePublishStatus();
 
-    // step 4
-    mApp.getBucketManager().forgetUnreferencedBuckets();
+        // step 4
+        mApp.getBucketManager().forgetUnreferencedBuckets();
+    }
 
     // Maybe sleep for parameterized amount of time in simulation mode
     auto sleepFor = std::chrono::microseconds{
@@ -727,6 +819,7 @@ LedgerManagerImpl::closeLedger(LedgerCloseData const& ledgerData)
         std::this_thread::sleep_for(sleepFor);
     }
 
+    mCloseTiming.end(txs.size(), txSet->sizeOp());
     std::chrono::duration<double> ledgerTimeSeconds = ledgerTime.Stop();
     CLOG(DEBUG, "Perf") << "Applied ledger in " << ledgerTimeSeconds.count()
                         << " seconds";
@@ -745,6 +838,7 @@ LedgerManagerImpl::deleteOldEntries(Database& db, uint32_t ledgerSeq,
     Upgrades::deleteOldEntries(db, ledgerSeq, count);
     db.clearPreparedStatementCache();
     txscope.commit();
+    TxHistorySegments::deleteOldSegments(mApp, ledgerSeq, count);
 }
 
 void
@@ -773,6 +867,12 @@ LedgerManagerImpl::manuallyAdvanceLedgerHeader(LedgerHeader const& header)
     advanceLedgerPointers(header, false);
 }
 
+LedgerCloseTiming&
+LedgerManagerImpl::getCloseTiming()
+{
+    return mCloseTiming;
+}
+
 void
 LedgerManagerImpl::setupLedgerCloseMetaStream()
 {
@@ -826,7 +926,8 @@ LedgerManagerImpl::advanceLedgerPointers(LedgerHeader const& header,
 void
 LedgerManagerImpl::processFeesSeqNums(
     std::vector<TransactionFrameBasePtr>& txs, AbstractLedgerTxn& ltxOuter,
-    int64_t baseFee, std::unique_ptr<LedgerCloseMeta> const& ledgerCloseMeta)
+    int64_t baseFee, std::unique_ptr<LedgerCloseMeta> const& ledgerCloseMeta,
+    TxHistoryWriter* historyWriter)
 {
     ZoneScoped;
     CLOG(DEBUG, "Ledger")
@@ -854,7 +955,13 @@ LedgerManagerImpl::processFeesSeqNums(
             // txs counting from 1, not 0. We preserve this for the time being
             // in case anyone depends on it.
             ++index;
-            if (mApp.getConfig().MODE_STORES_HISTORY)
+            if (historyWriter)
+            {
+                historyWriter->storeTransactionFee(tx, std::move(changes),
+                                                   index);
+            }
+            else if (mApp.getConfig().MODE_STORES_HISTORY &&
+                     !mTxHistorySegments)
             {
                 storeTransactionFee(mApp.getDatabase(), ledgerSeq, tx, changes,
                                     index);
@@ -907,8 +1014,9 @@ LedgerManagerImpl::prefetchTransactionData(
 void
 LedgerManagerImpl::applyTransactions(
     std::vector<TransactionFrameBasePtr>& txs, AbstractLedgerTxn& ltx,
-    TransactionResultSet& txResultSet,
-    std::unique_ptr<LedgerCloseMeta> const& ledgerCloseMeta)
+    int64_t baseFee, TransactionResultSet& txResultSet,
+    std::unique_ptr<LedgerCloseMeta> const& ledgerCloseMeta,
+    TxHistoryWriter* historyWriter)
 {
     ZoneNamedN(txsZone, "applyTransactions", true);
     int index = 0;
@@ -932,12 +1040,22 @@ LedgerManagerImpl::applyTransactions(
                                         numTxs, numOps);
     }
 
-    prefetchTransactionData(txs);
+    {
+        LedgerCloseTiming::Scope t(mCloseTiming, LedgerCloseTiming::PREFETCH);
+        prefetchTransactionData(txs);
+    }
+
+    std::vector<TransactionMeta> txMetas;
+    bool appliedInParallel;
+    {
+        LedgerCloseTiming::Scope t(mCloseTiming, LedgerCloseTiming::APPLY);
+        appliedInParallel =
+            applyTransactionsInParallel(txs, ltx, baseFee, txMetas);
+    }
 
     for (auto tx : txs)
     {
         ZoneNamedN(txZone, "applyTransaction", true);
-        auto txTime = mTransactionApply.TimeScope();
         TransactionMeta tm(2);
         CLOG(DEBUG, "Tx") << " tx#" << index << " = "
                           << hexAbbrev(tx->getContentsHash())
@@ -945,7 +1063,17 @@ LedgerManagerImpl::applyTransactions(
                           << " txseq=" << tx->getSeqNum() << " (@ "
                           << mApp.getConfig().toShortString(tx->getSourceID())
                           << ")";
-        tx->apply(mApp, ltx, tm);
+        if (appliedInParallel)
+        {
+            // timed into mTransactionApply by ParallelTxSetApplier
+            tm = std::move(txMetas.at(index));
+        }
+        else
+        {
+            LedgerCloseTiming::Scope t(mCloseTiming, LedgerCloseTiming::APPLY);
+            auto txTime = mTransactionApply.TimeScope();
+            tx->apply(mApp, ltx, tm);
+        }
 
         TransactionResultPair results;
         results.transactionHash = tx->getContentsHash();
@@ -975,8 +1103,14 @@ LedgerManagerImpl::applyTransactions(
         // txs counting from 1, not 0. We preserve this for the time being
         // in case anyone depends on it.
         ++index;
-        if (mApp.getConfig().MODE_STORES_HISTORY)
+        if (historyWriter)
+        {
+            historyWriter->storeTransaction(tx, std::move(tm), results, index);
+        }
+        else if (mApp.getConfig().MODE_STORES_HISTORY && !mTxHistorySegments)
         {
+            LedgerCloseTiming::Scope t(mCloseTiming,
+                                       LedgerCloseTiming::TX_HISTORY);
             auto ledgerSeq = ltx.loadHeader().current().ledgerSeq;
             storeTransaction(mApp.getDatabase(), ledgerSeq, tx, tm,
                              txResultSet);
@@ -986,6 +1120,35 @@ LedgerManagerImpl::applyTransactions(
     logTxApplyMetrics(ltx, numTxs, numOps);
 }
 
+bool
+LedgerManagerImpl::applyTransactionsInParallel(
+    std::vector<TransactionFrameBasePtr>& txs, AbstractLedgerTxn& ltx,
+    int64_t baseFee, std::vector<TransactionMeta>& txMetas)
+{
+    ZoneScoped;
+    auto threads = mApp.getConfig().PARALLEL_TX_APPLY_THREADS;
+    if (threads < 2 || txs.size() < 2)
+    {
+        return false;
+    }
+
+    ParallelTxSetApplier applier(mApp, txs, baseFee);
+    if (!applier.partition() || applier.getGroups().size() < 2)
+    {
+        return false;
+    }
+    mParallelApplyGroups.Update(
+        static_cast<int64_t>(applier.getGroups().size()));
+
+    if (!applier.apply(ltx, txMetas, threads))
+    {
+        mParallelApplyFallback.Mark();
+        return false;
+    }
+    mParallelApplySuccess.Mark();
+    return true;
+}
+
 void
 LedgerManagerImpl::logTxApplyMetrics(AbstractLedgerTxn& ltx, size_t numTxs,
                                      size_t numOps)
@@ -1003,10 +1166,15 @@ LedgerManagerImpl::logTxApplyMetrics(AbstractLedgerTxn& ltx, size_t numTxs,
 }
 
 void
-LedgerManagerImpl::storeCurrentLedger(LedgerHeader const& header)
+LedgerManagerImpl::storeCurrentLedger(LedgerHeader const& header,
+                                      TxHistoryWriter* historyWriter)
 {
     ZoneScoped;
-    if (mApp.getConfig().MODE_STORES_HISTORY)
+    if (historyWriter)
+    {
+        historyWriter->storeLedgerHeader(header);
+    }
+    else if (mApp.getConfig().MODE_STORES_HISTORY)
     {
         LedgerHeaderUtils::storeInDatabase(mApp.getDatabase(), header);
     }
@@ -1048,7 +1216,8 @@ LedgerManagerImpl::transferLedgerEntriesToBucketList(AbstractLedgerTxn& ltx,
 }
 
 void
-LedgerManagerImpl::ledgerClosed(AbstractLedgerTxn& ltx)
+LedgerManagerImpl::ledgerClosed(AbstractLedgerTxn& ltx,
+                                TxHistoryWriter* historyWriter)
 {
     ZoneScoped;
     auto ledgerSeq = ltx.loadHeader().current().ledgerSeq;
@@ -1057,11 +1226,14 @@ LedgerManagerImpl::ledgerClosed(AbstractLedgerTxn& ltx)
         "sealing ledger {} with version {}, sending to bucket list", ledgerSeq,
         ledgerVers);
 
-    transferLedgerEntriesToBucketList(ltx, ledgerSeq, ledgerVers);
+    {
+        LedgerCloseTiming::Scope t(mCloseTiming, LedgerCloseTiming::BUCKETS);
+        transferLedgerEntriesToBucketList(ltx, ledgerSeq, ledgerVers);
+    }
 
-    ltx.unsealHeader([this](LedgerHeader& lh) {
+    ltx.unsealHeader([this, historyWriter](LedgerHeader& lh) {
         mApp.getBucketManager().snapshotLedger(lh);
-        storeCurrentLedger(lh);
+        storeCurrentLedger(lh, historyWriter);
         advanceLedgerPointers(lh);
     });
 }
@@ -6,6 +6,8 @@
 #include "util/asio.h"
 
 #include "history/HistoryManager.h"
+#include "history/TxHistorySegments.h"
+#include "ledger/LedgerCloseTiming.h"
 #include "ledger/LedgerManager.h"
 #include "main/PersistentState.h"
 #include "transactions/TransactionFrame.h"
@@ -24,6 +26,7 @@ namespace medida
 class Timer;
 class Counter;
 class Histogram;
+class Meter;
 class Buckets;
 }
 
@@ -33,6 +36,7 @@ class AbstractLedgerTxn;
 class Application;
 class Database;
 class LedgerTxnHeader;
+class TxHistoryWriter;
 
 class LedgerManagerImpl : public LedgerManager
 {
@@ -41,16 +45,23 @@ class LedgerManagerImpl : public LedgerManager
   protected:
     Application& mApp;
     std::unique_ptr<XDROutputFileStream> mMetaStream;
+    std::unique_ptr<TxHistorySegments> mTxHistorySegments;
 
   private:
     medida::Timer& mTransactionApply;
     medida::Histogram& mTransactionCount;
     medida::Histogram& mOperationCount;
     medida::Histogram& mPrefetchHitRate;
+    medida::Meter& mParallelApplySuccess;
+    medida::Meter& mParallelApplyFallback;
+    medida::Histogram& mParallelApplyGroups;
+    medida::Timer& mHistoryWrite;
+    medida::Timer& mHistoryWait;
     medida::Timer& mLedgerClose;
     medida::Buckets& mLedgerAgeClosed;
     medida::Counter& mLedgerAge;
     VirtualClock::time_point mLastClose;
+    LedgerCloseTiming mCloseTiming;
 
     std::unique_ptr<VirtualClock::time_point> mStartCatchup;
     medida::Timer& mCatchupDuration;
@@ -58,16 +69,25 @@ class LedgerManagerImpl : public LedgerManager
     void
     processFeesSeqNums(std::vector<TransactionFrameBasePtr>& txs,
                        AbstractLedgerTxn& ltxOuter, int64_t baseFee,
-                       std::unique_ptr<LedgerCloseMeta> const& ledgerCloseMeta);
+                       std::unique_ptr<LedgerCloseMeta> const& ledgerCloseMeta,
+                       TxHistoryWriter* historyWriter);
 
     void
     applyTransactions(std::vector<TransactionFrameBasePtr>& txs,
-                      AbstractLedgerTxn& ltx, TransactionResultSet& txResultSet,
-                      std::unique_ptr<LedgerCloseMeta> const& ledgerCloseMeta);
+                      AbstractLedgerTxn& ltx, int64_t baseFee,
+                      TransactionResultSet& txResultSet,
+                      std::unique_ptr<LedgerCloseMeta> const& ledgerCloseMeta,
+                      TxHistoryWriter* historyWriter);
 
-    void ledgerClosed(AbstractLedgerTxn& ltx);
+    bool
+    applyTransactionsInParallel(std::vector<TransactionFrameBasePtr>& txs,
+                                AbstractLedgerTxn& ltx, int64_t baseFee,
+                                std::vector<TransactionMeta>& txMetas);
 
-    void storeCurrentLedger(LedgerHeader const& header);
+    void ledgerClosed(AbstractLedgerTxn& ltx, TxHistoryWriter* historyWriter);
+
+    void storeCurrentLedger(LedgerHeader const& header,
+                            TxHistoryWriter* historyWriter = nullptr);
     void prefetchTransactionData(std::vector<TransactionFrameBasePtr>& txs);
     void prefetchTxSourceIds(std::vector<TransactionFrameBasePtr>& txs);
     void closeLedgerIf(LedgerCloseData const& ledgerData);
@@ -127,6 +147,8 @@ class LedgerManagerImpl : public LedgerManager
 
     void manuallyAdvanceLedgerHeader(LedgerHeader const& header) override;
 
+    LedgerCloseTiming& getCloseTiming() override;
+
     void setupLedgerCloseMetaStream();
 };
 }
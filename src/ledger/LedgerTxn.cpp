@@ -2239,16 +2239,23 @@ uint64_t
 LedgerTxnRoot::Impl::countObjects(LedgerEntryType let,
                                   LedgerRange const& ledgers) const
 {
-    using namespace soci;
     throwIfChild();
+    return LedgerTxnRoot::countObjects(mDatabase.getSession(), let, ledgers);
+}
+
+uint64_t
+LedgerTxnRoot::countObjects(soci::session& sess, LedgerEntryType let,
+                            LedgerRange const& ledgers)
+{
+    using namespace soci;
 
     std::string query = "SELECT COUNT(*) FROM " +
-                        tableFromLedgerEntryType(let) +
+                        Impl::tableFromLedgerEntryType(let) +
                         " WHERE lastmodified >= :v1 AND lastmodified < :v2;";
     uint64_t count = 0;
     int first = static_cast<int>(ledgers.mFirst);
     int limit = static_cast<int>(ledgers.limit());
-    mDatabase.getSession() << query, into(count), use(first), use(limit);
+    sess << query, into(count), use(first), use(limit);
     return count;
 }
 
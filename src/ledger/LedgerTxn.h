@@ -16,6 +16,11 @@
 #include <unordered_map>
 #include <unordered_set>
 
+namespace soci
+{
+class session;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 //  Overview
 /////////////////////////////////////////////////////////////////////////////
@@ -717,6 +722,11 @@ class LedgerTxnRoot : public AbstractLedgerTxnParent
     uint64_t countObjects(LedgerEntryType let,
                           LedgerRange const& ledgers) const override;
 
+    // Same count, through another session (such as one from the database's
+    // pool, on a worker thread): only sees committed entries.
+    static uint64_t countObjects(soci::session& sess, LedgerEntryType let,
+                                 LedgerRange const& ledgers);
+
     void deleteObjectsModifiedOnOrAfterLedger(uint32_t ledger) const override;
 
     void dropAccounts() override;
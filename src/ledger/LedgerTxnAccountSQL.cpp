@@ -7,6 +7,7 @@
 #include "crypto/SignerKey.h"
 #include "database/Database.h"
 #include "database/DatabaseTypeSpecificOperation.h"
+#include "database/DatabaseUtils.h"
 #include "ledger/LedgerTxnImpl.h"
 #include "util/Decoder.h"
 #include "util/Logging.h"
@@ -18,18 +19,28 @@
 namespace diamnet
 {
 
+static void
+decodeThresholds(BinaryColumn const& col, Thresholds& thresholds)
+{
+    auto bin = col.get();
+    if (bin.size() != thresholds.size())
+    {
+        throw std::runtime_error("Invalid account thresholds in SQL");
+    }
+    std::copy(bin.begin(), bin.end(), thresholds.begin());
+}
+
 std::shared_ptr<LedgerEntry const>
 LedgerTxnRoot::Impl::loadAccount(LedgerKey const& key) const
 {
     ZoneScoped;
     std::string actIDStrKey = KeyUtils::toStrKey(key.account().accountID);
 
-    std::string inflationDest, homeDomain, thresholds, signers;
-    soci::indicator inflationDestInd, signersInd;
-    std::string extensionStr;
-    soci::indicator extensionInd;
-    std::string ledgerExtStr;
-    soci::indicator ledgerExtInd;
+    std::string inflationDest;
+    soci::indicator inflationDestInd;
+    auto& sess = mDatabase.getSession();
+    BinaryColumn homeDomain(sess), thresholds(sess), signers(sess);
+    BinaryColumn extension(sess), ledgerExt(sess);
 
     LedgerEntry le;
     le.data.type(ACCOUNT);
@@ -46,13 +57,13 @@ LedgerTxnRoot::Impl::loadAccount(LedgerKey const& key) const
     st.exchange(soci::into(account.seqNum));
     st.exchange(soci::into(account.numSubEntries));
     st.exchange(soci::into(inflationDest, inflationDestInd));
-    st.exchange(soci::into(homeDomain));
-    st.exchange(soci::into(thresholds));
+    st.exchange(homeDomain.into());
+    st.exchange(thresholds.into());
     st.exchange(soci::into(account.flags));
     st.exchange(soci::into(le.lastModifiedLedgerSeq));
-    st.exchange(soci::into(signers, signersInd));
-    st.exchange(soci::into(extensionStr, extensionInd));
-    st.exchange(soci::into(ledgerExtStr, ledgerExtInd));
+    st.exchange(signers.into());
+    st.exchange(extension.into());
+    st.exchange(ledgerExt.into());
     st.exchange(soci::use(actIDStrKey));
     st.define_and_bind();
     {
@@ -65,10 +76,10 @@ LedgerTxnRoot::Impl::loadAccount(LedgerKey const& key) const
     }
 
     account.accountID = key.account().accountID;
-    decoder::decode_b64(homeDomain, account.homeDomain);
+    auto homeDomainBin = homeDomain.get();
+    account.homeDomain.assign(homeDomainBin.begin(), homeDomainBin.end());
 
-    bn::decode_b64(thresholds.begin(), thresholds.end(),
-                   account.thresholds.begin());
+    decodeThresholds(thresholds, account.thresholds);
 
     if (inflationDestInd == soci::i_ok)
     {
@@ -76,11 +87,9 @@ LedgerTxnRoot::Impl::loadAccount(LedgerKey const& key) const
             KeyUtils::fromStrKey<PublicKey>(inflationDest);
     }
 
-    if (signersInd == soci::i_ok)
+    if (!signers.isNull())
     {
-        std::vector<uint8_t> signersOpaque;
-        decoder::decode_b64(signers, signersOpaque);
-        xdr::xdr_from_opaque(signersOpaque, account.signers);
+        decodeBinaryXDR(signers, account.signers);
         assert(std::adjacent_find(account.signers.begin(),
                                   account.signers.end(),
                                   [](Signer const& lhs, Signer const& rhs) {
@@ -88,9 +97,9 @@ LedgerTxnRoot::Impl::loadAccount(LedgerKey const& key) const
                                   }) == account.signers.end());
     }
 
-    decodeOpaqueXDR(extensionStr, extensionInd, account.ext);
+    decodeBinaryXDR(extension, account.ext);
 
-    decodeOpaqueXDR(ledgerExtStr, ledgerExtInd, le.ext);
+    decodeBinaryXDR(ledgerExt, le.ext);
 
     return std::make_shared<LedgerEntry const>(std::move(le));
 }
@@ -138,14 +147,14 @@ class BulkUpsertAccountsOperation : public DatabaseTypeSpecificOperation<void>
     std::vector<std::string> mInflationDests;
     std::vector<soci::indicator> mInflationDestInds;
     std::vector<int32_t> mFlags;
-    std::vector<std::string> mHomeDomains;
-    std::vector<std::string> mThresholds;
-    std::vector<std::string> mSigners;
+    std::vector<std::vector<uint8_t>> mHomeDomains;
+    std::vector<std::vector<uint8_t>> mThresholds;
+    std::vector<std::vector<uint8_t>> mSigners;
     std::vector<soci::indicator> mSignerInds;
     std::vector<int32_t> mLastModifieds;
-    std::vector<std::string> mExtensions;
+    std::vector<std::vector<uint8_t>> mExtensions;
     std::vector<soci::indicator> mExtensionInds;
-    std::vector<std::string> mLedgerExtensions;
+    std::vector<std::vector<uint8_t>> mLedgerExtensions;
 
   public:
     BulkUpsertAccountsOperation(Database& DB,
@@ -193,17 +202,18 @@ class BulkUpsertAccountsOperation : public DatabaseTypeSpecificOperation<void>
                 mInflationDestInds.emplace_back(soci::i_null);
             }
             mFlags.emplace_back(unsignedToSigned(account.flags));
-            mHomeDomains.emplace_back(decoder::encode_b64(account.homeDomain));
-            mThresholds.emplace_back(decoder::encode_b64(account.thresholds));
+            mHomeDomains.emplace_back(account.homeDomain.begin(),
+                                      account.homeDomain.end());
+            mThresholds.emplace_back(account.thresholds.begin(),
+                                     account.thresholds.end());
             if (account.signers.empty())
             {
-                mSigners.emplace_back("");
+                mSigners.emplace_back();
                 mSignerInds.emplace_back(soci::i_null);
             }
             else
             {
-                mSigners.emplace_back(
-                    decoder::encode_b64(xdr::xdr_to_opaque(account.signers)));
+                mSigners.emplace_back(xdr::xdr_to_opaque(account.signers));
                 mSignerInds.emplace_back(soci::i_ok);
             }
             mLastModifieds.emplace_back(
@@ -211,32 +221,26 @@ class BulkUpsertAccountsOperation : public DatabaseTypeSpecificOperation<void>
 
             if (account.ext.v() >= 1)
             {
-                mExtensions.emplace_back(
-                    decoder::encode_b64(xdr::xdr_to_opaque(account.ext)));
+                mExtensions.emplace_back(xdr::xdr_to_opaque(account.ext));
                 mExtensionInds.emplace_back(soci::i_ok);
             }
             else
             {
-                mExtensions.emplace_back("");
+                mExtensions.emplace_back();
                 mExtensionInds.emplace_back(soci::i_null);
             }
 
-            mLedgerExtensions.emplace_back(
-                decoder::encode_b64(xdr::xdr_to_opaque(le.ext)));
+            mLedgerExtensions.emplace_back(xdr::xdr_to_opaque(le.ext));
         }
     }
 
+    template <typename Backend>
     void
-    doSociGenericOperation()
+    doUpsert(Backend* backend)
     {
-        std::string sql =
-            "INSERT INTO accounts ( "
-            "accountid, balance, seqnum, numsubentries, inflationdest,"
-            "homedomain, thresholds, signers, flags, lastmodified, "
-            "extension, ledgerext "
-            ") VALUES ( "
-            ":id, :v1, :v2, :v3, :v4, :v5, :v6, :v7, :v8, :v9, :v10, :v11 "
-            ") ON CONFLICT (accountid) DO UPDATE SET "
+        DatabaseUtils::BulkUpsert upsert(
+            mDB, "accounts", "account",
+            "ON CONFLICT (accountid) DO UPDATE SET "
             "balance = excluded.balance, "
             "seqnum = excluded.seqnum, "
             "numsubentries = excluded.numsubentries, "
@@ -247,117 +251,35 @@ class BulkUpsertAccountsOperation : public DatabaseTypeSpecificOperation<void>
             "flags = excluded.flags, "
             "lastmodified = excluded.lastmodified, "
             "extension = excluded.extension, "
-            "ledgerext = excluded.ledgerext";
-        auto prep = mDB.getPreparedStatement(sql);
-        soci::statement& st = prep.statement();
-        st.exchange(soci::use(mAccountIDs));
-        st.exchange(soci::use(mBalances));
-        st.exchange(soci::use(mSeqNums));
-        st.exchange(soci::use(mSubEntryNums));
-        st.exchange(soci::use(mInflationDests, mInflationDestInds));
-        st.exchange(soci::use(mHomeDomains));
-        st.exchange(soci::use(mThresholds));
-        st.exchange(soci::use(mSigners, mSignerInds));
-        st.exchange(soci::use(mFlags));
-        st.exchange(soci::use(mLastModifieds));
-        st.exchange(soci::use(mExtensions, mExtensionInds));
-        st.exchange(soci::use(mLedgerExtensions));
-        st.define_and_bind();
-        {
-            auto timer = mDB.getUpsertTimer("account");
-            st.execute(true);
-        }
-        if (static_cast<size_t>(st.get_affected_rows()) != mAccountIDs.size())
-        {
-            throw std::runtime_error("Could not update data in SQL");
-        }
+            "ledgerext = excluded.ledgerext",
+            mAccountIDs.size());
+        upsert.addColumn("accountid", mAccountIDs);
+        upsert.addColumn("balance", mBalances);
+        upsert.addColumn("seqnum", mSeqNums);
+        upsert.addColumn("numsubentries", mSubEntryNums);
+        upsert.addColumn("inflationdest", mInflationDests,
+                         &mInflationDestInds);
+        upsert.addBinaryColumn("homedomain", mHomeDomains);
+        upsert.addBinaryColumn("thresholds", mThresholds);
+        upsert.addBinaryColumn("signers", mSigners, &mSignerInds);
+        upsert.addColumn("flags", mFlags);
+        upsert.addColumn("lastmodified", mLastModifieds);
+        upsert.addBinaryColumn("extension", mExtensions, &mExtensionInds);
+        upsert.addBinaryColumn("ledgerext", mLedgerExtensions);
+        upsert.execute(backend);
     }
 
     void
     doSqliteSpecificOperation(soci::sqlite3_session_backend* sq) override
     {
-        doSociGenericOperation();
+        doUpsert(sq);
     }
 
 #ifdef USE_POSTGRES
     void
     doPostgresSpecificOperation(soci::postgresql_session_backend* pg) override
     {
-        std::string strAccountIDs, strBalances, strSeqNums, strSubEntryNums,
-            strInflationDests, strFlags, strHomeDomains, strThresholds,
-            strSigners, strLastModifieds, strExtensions, strLedgerExtensions;
-
-        PGconn* conn = pg->conn_;
-        marshalToPGArray(conn, strAccountIDs, mAccountIDs);
-        marshalToPGArray(conn, strBalances, mBalances);
-        marshalToPGArray(conn, strSeqNums, mSeqNums);
-        marshalToPGArray(conn, strSubEntryNums, mSubEntryNums);
-        marshalToPGArray(conn, strInflationDests, mInflationDests,
-                         &mInflationDestInds);
-        marshalToPGArray(conn, strFlags, mFlags);
-        marshalToPGArray(conn, strHomeDomains, mHomeDomains);
-        marshalToPGArray(conn, strThresholds, mThresholds);
-        marshalToPGArray(conn, strSigners, mSigners, &mSignerInds);
-        marshalToPGArray(conn, strLastModifieds, mLastModifieds);
-        marshalToPGArray(conn, strExtensions, mExtensions, &mExtensionInds);
-        marshalToPGArray(conn, strLedgerExtensions, mLedgerExtensions);
-
-        std::string sql = "WITH r AS (SELECT "
-                          "unnest(:ids::TEXT[]), "
-                          "unnest(:v1::BIGINT[]), "
-                          "unnest(:v2::BIGINT[]), "
-                          "unnest(:v3::INT[]), "
-                          "unnest(:v4::TEXT[]), "
-                          "unnest(:v5::TEXT[]), "
-                          "unnest(:v6::TEXT[]), "
-                          "unnest(:v7::TEXT[]), "
-                          "unnest(:v8::INT[]), "
-                          "unnest(:v9::INT[]), "
-                          "unnest(:v10::TEXT[]), "
-                          "unnest(:v11::TEXT[]) "
-                          ")"
-                          "INSERT INTO accounts ( "
-                          "accountid, balance, seqnum, "
-                          "numsubentries, inflationdest, homedomain, "
-                          "thresholds, signers, "
-                          "flags, lastmodified, extension, "
-                          "ledgerext "
-                          ") SELECT * FROM r "
-                          "ON CONFLICT (accountid) DO UPDATE SET "
-                          "balance = excluded.balance, "
-                          "seqnum = excluded.seqnum, "
-                          "numsubentries = excluded.numsubentries, "
-                          "inflationdest = excluded.inflationdest, "
-                          "homedomain = excluded.homedomain, "
-                          "thresholds = excluded.thresholds, "
-                          "signers = excluded.signers, "
-                          "flags = excluded.flags, "
-                          "lastmodified = excluded.lastmodified, "
-                          "extension = excluded.extension, "
-                          "ledgerext = excluded.ledgerext";
-        auto prep = mDB.getPreparedStatement(sql);
-        soci::statement& st = prep.statement();
-        st.exchange(soci::use(strAccountIDs));
-        st.exchange(soci::use(strBalances));
-        st.exchange(soci::use(strSeqNums));
-        st.exchange(soci::use(strSubEntryNums));
-        st.exchange(soci::use(strInflationDests));
-        st.exchange(soci::use(strHomeDomains));
-        st.exchange(soci::use(strThresholds));
-        st.exchange(soci::use(strSigners));
-        st.exchange(soci::use(strFlags));
-        st.exchange(soci::use(strLastModifieds));
-        st.exchange(soci::use(strExtensions));
-        st.exchange(soci::use(strLedgerExtensions));
-        st.define_and_bind();
-        {
-            auto timer = mDB.getUpsertTimer("account");
-            st.execute(true);
-        }
-        if (static_cast<size_t>(st.get_affected_rows()) != mAccountIDs.size())
-        {
-            throw std::runtime_error("Could not update data in SQL");
-        }
+        doUpsert(pg);
     }
 #endif
 };
@@ -501,27 +423,27 @@ class BulkLoadAccountsOperation
     std::vector<LedgerEntry>
     executeAndFetch(soci::statement& st)
     {
-        std::string accountID, inflationDest, homeDomain, thresholds, signers;
+        std::string accountID, inflationDest;
         int64_t balance;
         uint64_t seqNum;
         uint32_t numSubEntries, flags, lastModified;
-        std::string extension;
-        soci::indicator inflationDestInd, signersInd, extensionInd;
-        std::string ledgerExtension;
-        soci::indicator ledgerExtInd;
+        soci::indicator inflationDestInd;
+        auto& sess = mDb.getSession();
+        BinaryColumn homeDomain(sess), thresholds(sess), signers(sess);
+        BinaryColumn extension(sess), ledgerExtension(sess);
 
         st.exchange(soci::into(accountID));
         st.exchange(soci::into(balance));
         st.exchange(soci::into(seqNum));
         st.exchange(soci::into(numSubEntries));
         st.exchange(soci::into(inflationDest, inflationDestInd));
-        st.exchange(soci::into(homeDomain));
-        st.exchange(soci::into(thresholds));
+        st.exchange(homeDomain.into());
+        st.exchange(thresholds.into());
         st.exchange(soci::into(flags));
         st.exchange(soci::into(lastModified));
-        st.exchange(soci::into(extension, extensionInd));
-        st.exchange(soci::into(signers, signersInd));
-        st.exchange(soci::into(ledgerExtension, ledgerExtInd));
+        st.exchange(extension.into());
+        st.exchange(signers.into());
+        st.exchange(ledgerExtension.into());
         st.define_and_bind();
         {
             auto timer = mDb.getSelectTimer("account");
@@ -547,10 +469,10 @@ class BulkLoadAccountsOperation
                     KeyUtils::fromStrKey<PublicKey>(inflationDest);
             }
 
-            decoder::decode_b64(homeDomain, ae.homeDomain);
+            auto homeDomainBin = homeDomain.get();
+            ae.homeDomain.assign(homeDomainBin.begin(), homeDomainBin.end());
 
-            bn::decode_b64(thresholds.begin(), thresholds.end(),
-                           ae.thresholds.begin());
+            decodeThresholds(thresholds, ae.thresholds);
 
             if (inflationDestInd == soci::i_ok)
             {
@@ -561,13 +483,11 @@ class BulkLoadAccountsOperation
             ae.flags = flags;
             le.lastModifiedLedgerSeq = lastModified;
 
-            decodeOpaqueXDR(extension, extensionInd, ae.ext);
+            decodeBinaryXDR(extension, ae.ext);
 
-            if (signersInd == soci::i_ok)
+            if (!signers.isNull())
             {
-                std::vector<uint8_t> signersOpaque;
-                decoder::decode_b64(signers, signersOpaque);
-                xdr::xdr_from_opaque(signersOpaque, ae.signers);
+                decodeBinaryXDR(signers, ae.signers);
                 assert(std::adjacent_find(
                            ae.signers.begin(), ae.signers.end(),
                            [](Signer const& lhs, Signer const& rhs) {
@@ -575,7 +495,7 @@ class BulkLoadAccountsOperation
                            }) == ae.signers.end());
             }
 
-            decodeOpaqueXDR(ledgerExtension, ledgerExtInd, le.ext);
+            decodeBinaryXDR(ledgerExtension, le.ext);
 
             st.fetch();
         }
@@ -2,6 +2,7 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "database/DatabaseUtils.h"
 #include "ledger/LedgerTxnImpl.h"
 #include "util/Decoder.h"
 #include "util/types.h"
@@ -16,21 +17,12 @@ toOpaqueBase64(T const& input)
     return decoder::encode_b64(xdr::xdr_to_opaque(input));
 }
 
-template <typename T>
-void
-fromOpaqueBase64(T& res, std::string const& opaqueBase64)
-{
-    std::vector<uint8_t> opaque;
-    decoder::decode_b64(opaqueBase64, opaque);
-    xdr::xdr_from_opaque(opaque, res);
-}
-
 std::shared_ptr<LedgerEntry const>
 LedgerTxnRoot::Impl::loadClaimableBalance(LedgerKey const& key) const
 {
     auto balanceID = toOpaqueBase64(key.claimableBalance().balanceID);
 
-    std::string claimableBalanceEntryStr;
+    BinaryColumn claimableBalanceEntry(mDatabase.getSession());
     LedgerEntry le;
 
     std::string sql = "SELECT ledgerentry "
@@ -38,7 +30,7 @@ LedgerTxnRoot::Impl::loadClaimableBalance(LedgerKey const& key) const
                       "WHERE balanceid= :balanceid";
     auto prep = mDatabase.getPreparedStatement(sql);
     auto& st = prep.statement();
-    st.exchange(soci::into(claimableBalanceEntryStr));
+    st.exchange(claimableBalanceEntry.into());
     st.exchange(soci::use(balanceID));
     st.define_and_bind();
     st.execute(true);
@@ -47,7 +39,7 @@ LedgerTxnRoot::Impl::loadClaimableBalance(LedgerKey const& key) const
         return nullptr;
     }
 
-    fromOpaqueBase64(le, claimableBalanceEntryStr);
+    decodeBinaryXDR(claimableBalanceEntry, le);
     assert(le.data.type() == CLAIMABLE_BALANCE);
 
     return std::make_shared<LedgerEntry const>(std::move(le));
@@ -62,10 +54,11 @@ class BulkLoadClaimableBalanceOperation
     std::vector<LedgerEntry>
     executeAndFetch(soci::statement& st)
     {
-        std::string balanceIdStr, claimableBalanceEntryStr;
+        std::string balanceIdStr;
+        BinaryColumn claimableBalanceEntry(mDb.getSession());
 
         st.exchange(soci::into(balanceIdStr));
-        st.exchange(soci::into(claimableBalanceEntryStr));
+        st.exchange(claimableBalanceEntry.into());
         st.define_and_bind();
         {
             auto timer = mDb.getSelectTimer("claimablebalance");
@@ -78,7 +71,7 @@ class BulkLoadClaimableBalanceOperation
             res.emplace_back();
             auto& le = res.back();
 
-            fromOpaqueBase64(le, claimableBalanceEntryStr);
+            decodeBinaryXDR(claimableBalanceEntry, le);
             assert(le.data.type() == CLAIMABLE_BALANCE);
 
             st.fetch();
@@ -256,7 +249,7 @@ class BulkUpsertClaimableBalanceOperation
 {
     Database& mDb;
     std::vector<std::string> mBalanceIDs;
-    std::vector<std::string> mClaimableBalanceEntrys;
+    std::vector<std::vector<uint8_t>> mClaimableBalanceEntrys;
     std::vector<int32_t> mLastModifieds;
 
     void
@@ -265,7 +258,7 @@ class BulkUpsertClaimableBalanceOperation
         assert(entry.data.type() == CLAIMABLE_BALANCE);
         mBalanceIDs.emplace_back(
             toOpaqueBase64(entry.data.claimableBalance().balanceID));
-        mClaimableBalanceEntrys.emplace_back(toOpaqueBase64(entry));
+        mClaimableBalanceEntrys.emplace_back(xdr::xdr_to_opaque(entry));
         mLastModifieds.emplace_back(
             unsignedToSigned(entry.lastModifiedLedgerSeq));
     }
@@ -282,77 +275,34 @@ class BulkUpsertClaimableBalanceOperation
         }
     }
 
+    template <typename Backend>
     void
-    doSociGenericOperation()
+    doUpsert(Backend* backend)
     {
-        std::string sql = "INSERT INTO claimablebalance "
-                          "(balanceid, ledgerentry, lastmodified) "
-                          "VALUES "
-                          "( :id, :v1, :v2 ) "
-                          "ON CONFLICT (balanceid) DO UPDATE SET "
-                          "balanceid = excluded.balanceid, ledgerentry = "
-                          "excluded.ledgerentry, lastmodified = "
-                          "excluded.lastmodified";
-
-        auto prep = mDb.getPreparedStatement(sql);
-        soci::statement& st = prep.statement();
-        st.exchange(soci::use(mBalanceIDs));
-        st.exchange(soci::use(mClaimableBalanceEntrys));
-        st.exchange(soci::use(mLastModifieds));
-        st.define_and_bind();
-        {
-            auto timer = mDb.getUpsertTimer("claimablebalance");
-            st.execute(true);
-        }
-        if (static_cast<size_t>(st.get_affected_rows()) != mBalanceIDs.size())
-        {
-            throw std::runtime_error("Could not update data in SQL");
-        }
+        DatabaseUtils::BulkUpsert upsert(
+            mDb, "claimablebalance", "claimablebalance",
+            "ON CONFLICT (balanceid) DO UPDATE SET "
+            "balanceid = excluded.balanceid, "
+            "ledgerentry = excluded.ledgerentry, "
+            "lastmodified = excluded.lastmodified",
+            mBalanceIDs.size());
+        upsert.addColumn("balanceid", mBalanceIDs);
+        upsert.addBinaryColumn("ledgerentry", mClaimableBalanceEntrys);
+        upsert.addColumn("lastmodified", mLastModifieds);
+        upsert.execute(backend);
     }
 
     void
     doSqliteSpecificOperation(soci::sqlite3_session_backend* sq) override
     {
-        doSociGenericOperation();
+        doUpsert(sq);
     }
 
 #ifdef USE_POSTGRES
     void
     doPostgresSpecificOperation(soci::postgresql_session_backend* pg) override
     {
-        std::string strBalanceIDs, strClaimableBalanceEntry, strLastModifieds;
-
-        PGconn* conn = pg->conn_;
-        marshalToPGArray(conn, strBalanceIDs, mBalanceIDs);
-        marshalToPGArray(conn, strClaimableBalanceEntry,
-                         mClaimableBalanceEntrys);
-        marshalToPGArray(conn, strLastModifieds, mLastModifieds);
-
-        std::string sql = "WITH r AS "
-                          "(SELECT unnest(:ids::TEXT[]), unnest(:v1::TEXT[]), "
-                          "unnest(:v2::INT[]))"
-                          "INSERT INTO claimablebalance "
-                          "(balanceid, ledgerentry, lastmodified) "
-                          "SELECT * FROM r "
-                          "ON CONFLICT (balanceid) DO UPDATE SET "
-                          "balanceid = excluded.balanceid, ledgerentry = "
-                          "excluded.ledgerentry, "
-                          "lastmodified = excluded.lastmodified";
-
-        auto prep = mDb.getPreparedStatement(sql);
-        soci::statement& st = prep.statement();
-        st.exchange(soci::use(strBalanceIDs));
-        st.exchange(soci::use(strClaimableBalanceEntry));
-        st.exchange(soci::use(strLastModifieds));
-        st.define_and_bind();
-        {
-            auto timer = mDb.getUpsertTimer("claimablebalance");
-            st.execute(true);
-        }
-        if (static_cast<size_t>(st.get_affected_rows()) != mBalanceIDs.size())
-        {
-            throw std::runtime_error("Could not update data in SQL");
-        }
+        doUpsert(pg);
     }
 #endif
 };
@@ -6,6 +6,7 @@
 #include "crypto/SecretKey.h"
 #include "database/Database.h"
 #include "database/DatabaseTypeSpecificOperation.h"
+#include "database/DatabaseUtils.h"
 #include "ledger/LedgerTxnImpl.h"
 #include "util/Decoder.h"
 #include "util/Logging.h"
@@ -22,12 +23,8 @@ LedgerTxnRoot::Impl::loadData(LedgerKey const& key) const
     std::string actIDStrKey = KeyUtils::toStrKey(key.data().accountID);
     std::string dataName = decoder::encode_b64(key.data().dataName);
 
-    std::string dataValue;
-    soci::indicator dataValueIndicator;
-    std::string extensionStr;
-    soci::indicator extensionInd;
-    std::string ledgerExtStr;
-    soci::indicator ledgerExtInd;
+    auto& sess = mDatabase.getSession();
+    BinaryColumn dataValue(sess), extension(sess), ledgerExt(sess);
 
     LedgerEntry le;
     le.data.type(DATA);
@@ -39,10 +36,10 @@ LedgerTxnRoot::Impl::loadData(LedgerKey const& key) const
                       "WHERE accountid= :id AND dataname= :dataname";
     auto prep = mDatabase.getPreparedStatement(sql);
     auto& st = prep.statement();
-    st.exchange(soci::into(dataValue, dataValueIndicator));
+    st.exchange(dataValue.into());
     st.exchange(soci::into(le.lastModifiedLedgerSeq));
-    st.exchange(soci::into(extensionStr, extensionInd));
-    st.exchange(soci::into(ledgerExtStr, ledgerExtInd));
+    st.exchange(extension.into());
+    st.exchange(ledgerExt.into());
     st.exchange(soci::use(actIDStrKey));
     st.exchange(soci::use(dataName));
     st.define_and_bind();
@@ -55,15 +52,16 @@ LedgerTxnRoot::Impl::loadData(LedgerKey const& key) const
     de.accountID = key.data().accountID;
     de.dataName = key.data().dataName;
 
-    if (dataValueIndicator != soci::i_ok)
+    if (dataValue.isNull())
     {
         throw std::runtime_error("bad database state");
     }
-    decoder::decode_b64(dataValue, de.dataValue);
+    auto dataValueBin = dataValue.get();
+    de.dataValue.assign(dataValueBin.begin(), dataValueBin.end());
 
-    decodeOpaqueXDR(extensionStr, extensionInd, de.ext);
+    decodeBinaryXDR(extension, de.ext);
 
-    decodeOpaqueXDR(ledgerExtStr, ledgerExtInd, le.ext);
+    decodeBinaryXDR(ledgerExt, le.ext);
 
     return std::make_shared<LedgerEntry const>(std::move(le));
 }
@@ -73,10 +71,10 @@ class BulkUpsertDataOperation : public DatabaseTypeSpecificOperation<void>
     Database& mDB;
     std::vector<std::string> mAccountIDs;
     std::vector<std::string> mDataNames;
-    std::vector<std::string> mDataValues;
+    std::vector<std::vector<uint8_t>> mDataValues;
     std::vector<int32_t> mLastModifieds;
-    std::vector<std::string> mExtensions;
-    std::vector<std::string> mLedgerExtensions;
+    std::vector<std::vector<uint8_t>> mExtensions;
+    std::vector<std::vector<uint8_t>> mLedgerExtensions;
 
     void
     accumulateEntry(LedgerEntry const& entry)
@@ -85,13 +83,11 @@ class BulkUpsertDataOperation : public DatabaseTypeSpecificOperation<void>
         DataEntry const& data = entry.data.data();
         mAccountIDs.emplace_back(KeyUtils::toStrKey(data.accountID));
         mDataNames.emplace_back(decoder::encode_b64(data.dataName));
-        mDataValues.emplace_back(decoder::encode_b64(data.dataValue));
+        mDataValues.emplace_back(data.dataValue.begin(), data.dataValue.end());
         mLastModifieds.emplace_back(
             unsignedToSigned(entry.lastModifiedLedgerSeq));
-        mExtensions.emplace_back(
-            decoder::encode_b64(xdr::xdr_to_opaque(data.ext)));
-        mLedgerExtensions.emplace_back(
-            decoder::encode_b64(xdr::xdr_to_opaque(entry.ext)));
+        mExtensions.emplace_back(xdr::xdr_to_opaque(data.ext));
+        mLedgerExtensions.emplace_back(xdr::xdr_to_opaque(entry.ext));
     }
 
   public:
@@ -118,93 +114,38 @@ class BulkUpsertDataOperation : public DatabaseTypeSpecificOperation<void>
         }
     }
 
+    template <typename Backend>
     void
-    doSociGenericOperation()
+    doUpsert(Backend* backend)
     {
-        std::string sql =
-            "INSERT INTO accountdata ( "
-            "accountid, dataname, datavalue, lastmodified, extension, "
-            "ledgerext "
-            ") VALUES ( "
-            ":id, :v1, :v2, :v3, :v4, :v5 "
-            ") ON CONFLICT (accountid, dataname) DO UPDATE SET "
+        DatabaseUtils::BulkUpsert upsert(
+            mDB, "accountdata", "data",
+            "ON CONFLICT (accountid, dataname) DO UPDATE SET "
             "datavalue = excluded.datavalue, "
             "lastmodified = excluded.lastmodified, "
             "extension = excluded.extension, "
-            "ledgerext = excluded.ledgerext";
-        auto prep = mDB.getPreparedStatement(sql);
-        soci::statement& st = prep.statement();
-        st.exchange(soci::use(mAccountIDs));
-        st.exchange(soci::use(mDataNames));
-        st.exchange(soci::use(mDataValues));
-        st.exchange(soci::use(mLastModifieds));
-        st.exchange(soci::use(mExtensions));
-        st.exchange(soci::use(mLedgerExtensions));
-        st.define_and_bind();
-        {
-            auto timer = mDB.getUpsertTimer("data");
-            st.execute(true);
-        }
-        if (static_cast<size_t>(st.get_affected_rows()) != mAccountIDs.size())
-        {
-            throw std::runtime_error("Could not update data in SQL");
-        }
+            "ledgerext = excluded.ledgerext",
+            mAccountIDs.size());
+        upsert.addColumn("accountid", mAccountIDs);
+        upsert.addColumn("dataname", mDataNames);
+        upsert.addBinaryColumn("datavalue", mDataValues);
+        upsert.addColumn("lastmodified", mLastModifieds);
+        upsert.addBinaryColumn("extension", mExtensions);
+        upsert.addBinaryColumn("ledgerext", mLedgerExtensions);
+        upsert.execute(backend);
     }
 
     void
     doSqliteSpecificOperation(soci::sqlite3_session_backend* sq) override
     {
-        doSociGenericOperation();
+        doUpsert(sq);
     }
+
 #ifdef USE_POSTGRES
     void
     doPostgresSpecificOperation(soci::postgresql_session_backend* pg) override
     {
-        std::string strAccountIDs, strDataNames, strDataValues,
-            strLastModifieds, strExtensions, strLedgerExtensions;
-
-        PGconn* conn = pg->conn_;
-        marshalToPGArray(conn, strAccountIDs, mAccountIDs);
-        marshalToPGArray(conn, strDataNames, mDataNames);
-        marshalToPGArray(conn, strDataValues, mDataValues);
-        marshalToPGArray(conn, strLastModifieds, mLastModifieds);
-        marshalToPGArray(conn, strExtensions, mExtensions);
-        marshalToPGArray(conn, strLedgerExtensions, mLedgerExtensions);
-        std::string sql =
-            "WITH r AS (SELECT "
-            "unnest(:ids::TEXT[]), "
-            "unnest(:v1::TEXT[]), "
-            "unnest(:v2::TEXT[]), "
-            "unnest(:v3::INT[]), "
-            "unnest(:v4::TEXT[]), "
-            "unnest(:v5::TEXT[]) "
-            ")"
-            "INSERT INTO accountdata ( "
-            "accountid, dataname, datavalue, lastmodified, extension, "
-            "ledgerext "
-            ") SELECT * FROM r "
-            "ON CONFLICT (accountid, dataname) DO UPDATE SET "
-            "datavalue = excluded.datavalue, "
-            "lastmodified = excluded.lastmodified, "
-            "extension = excluded.extension, "
-            "ledgerext = excluded.ledgerext";
-        auto prep = mDB.getPreparedStatement(sql);
-        soci::statement& st = prep.statement();
-        st.exchange(soci::use(strAccountIDs));
-        st.exchange(soci::use(strDataNames));
-        st.exchange(soci::use(strDataValues));
-        st.exchange(soci::use(strLastModifieds));
-        st.exchange(soci::use(strExtensions));
-        st.exchange(soci::use(strLedgerExtensions));
-        st.define_and_bind();
-        {
-            auto timer = mDB.getUpsertTimer("data");
-            st.execute(true);
-        }
-        if (static_cast<size_t>(st.get_affected_rows()) != mAccountIDs.size())
-        {
-            throw std::runtime_error("Could not update data in SQL");
-        }
+        doUpsert(pg);
     }
 #endif
 };
@@ -353,19 +294,17 @@ class BulkLoadDataOperation
     std::vector<LedgerEntry>
     executeAndFetch(soci::statement& st)
     {
-        std::string accountID, dataName, dataValue;
+        std::string accountID, dataName;
         uint32_t lastModified;
-        std::string extension;
-        soci::indicator extensionInd;
-        std::string ledgerExtension;
-        soci::indicator ledgerExtInd;
+        auto& sess = mDb.getSession();
+        BinaryColumn dataValue(sess), extension(sess), ledgerExtension(sess);
 
         st.exchange(soci::into(accountID));
         st.exchange(soci::into(dataName));
-        st.exchange(soci::into(dataValue));
+        st.exchange(dataValue.into());
         st.exchange(soci::into(lastModified));
-        st.exchange(soci::into(extension, extensionInd));
-        st.exchange(soci::into(ledgerExtension, ledgerExtInd));
+        st.exchange(extension.into());
+        st.exchange(ledgerExtension.into());
         st.define_and_bind();
         {
             auto timer = mDb.getSelectTimer("data");
@@ -382,12 +321,13 @@ class BulkLoadDataOperation
 
             de.accountID = KeyUtils::fromStrKey<PublicKey>(accountID);
             decoder::decode_b64(dataName, de.dataName);
-            decoder::decode_b64(dataValue, de.dataValue);
+            auto dataValueBin = dataValue.get();
+            de.dataValue.assign(dataValueBin.begin(), dataValueBin.end());
             le.lastModifiedLedgerSeq = lastModified;
 
-            decodeOpaqueXDR(extension, extensionInd, de.ext);
+            decodeBinaryXDR(extension, de.ext);
 
-            decodeOpaqueXDR(ledgerExtension, ledgerExtInd, le.ext);
+            decodeBinaryXDR(ledgerExtension, le.ext);
 
             st.fetch();
         }
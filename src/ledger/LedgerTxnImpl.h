@@ -68,11 +68,12 @@ class WorstBestOfferIterator::AbstractImpl
 // Helper struct to accumulate common cases that we can sift out of the
 // commit stream and perform in bulk (as single SQL statements per-type)
 // rather than making each insert/update/delete individually. This uses the
-// postgres and sqlite-supported "ON CONFLICT"-style upserts, and uses
-// soci's bulk operations where it can (i.e. for sqlite, or potentially
-// others), and manually-crafted postgres unnest([array]) calls where it
-// can't. This is not great, but it appears to be less work than
-// reorganizing the relevant parts of soci.
+// postgres and sqlite-supported "ON CONFLICT"-style upserts, written through
+// DatabaseUtils::BulkUpsert (multi-row VALUES on sqlite, COPY into a staging
+// table on postgres). Deletes use soci's bulk operations where it can (i.e.
+// for sqlite, or potentially others), and manually-crafted postgres
+// unnest([array]) calls where it can't. This is not great, but it appears to
+// be less work than reorganizing the relevant parts of soci.
 class BulkLedgerEntryChangeAccumulator
 {
 
@@ -735,8 +736,6 @@ class LedgerTxnRoot::Impl
     void bulkDeleteClaimableBalance(std::vector<EntryIterator> const& entries,
                                     LedgerTxnConsistency cons);
 
-    static std::string tableFromLedgerEntryType(LedgerEntryType let);
-
     // The entry cache maintains relatively strong invariants:
     //
     //  - It is only ever populated during a database operation, at root.
@@ -795,6 +794,8 @@ class LedgerTxnRoot::Impl
     uint64_t countObjects(LedgerEntryType let,
                           LedgerRange const& ledgers) const;
 
+    static std::string tableFromLedgerEntryType(LedgerEntryType let);
+
     // deleteObjectsModifiedOnOrAfterLedger has no exception safety guarantees.
     void deleteObjectsModifiedOnOrAfterLedger(uint32_t ledger) const;
 
@@ -6,6 +6,7 @@
 #include "crypto/SecretKey.h"
 #include "database/Database.h"
 #include "database/DatabaseTypeSpecificOperation.h"
+#include "database/DatabaseUtils.h"
 #include "ledger/LedgerTxnImpl.h"
 #include "transactions/TransactionUtils.h"
 #include "util/Decoder.h"
@@ -81,14 +82,15 @@ LedgerTxnRoot::Impl::loadBestOffers(std::deque<LedgerEntry>& offers,
                       "WHERE sellingasset = :v1 AND buyingasset = :v2 "
                       "ORDER BY price, offerid LIMIT :n";
 
-    std::string buyingAsset, sellingAsset;
-    buyingAsset = decoder::encode_b64(xdr::xdr_to_opaque(buying));
-    sellingAsset = decoder::encode_b64(xdr::xdr_to_opaque(selling));
+    BinaryColumn buyingAsset(mDatabase.getSession());
+    BinaryColumn sellingAsset(mDatabase.getSession());
+    buyingAsset.set(xdr::xdr_to_opaque(buying));
+    sellingAsset.set(xdr::xdr_to_opaque(selling));
 
     auto prep = mDatabase.getPreparedStatement(sql);
     auto& st = prep.statement();
-    st.exchange(soci::use(sellingAsset));
-    st.exchange(soci::use(buyingAsset));
+    st.exchange(sellingAsset.use());
+    st.exchange(buyingAsset.use());
     st.exchange(soci::use(numOffers));
 
     {
@@ -133,9 +135,10 @@ LedgerTxnRoot::Impl::loadBestOffers(std::deque<LedgerEntry>& offers,
         "FROM (SELECT * FROM r1 UNION ALL SELECT * FROM r2) AS res "
         "ORDER BY price, offerid LIMIT :v10";
 
-    std::string buyingAsset, sellingAsset;
-    buyingAsset = decoder::encode_b64(xdr::xdr_to_opaque(buying));
-    sellingAsset = decoder::encode_b64(xdr::xdr_to_opaque(selling));
+    BinaryColumn buyingAsset(mDatabase.getSession());
+    BinaryColumn sellingAsset(mDatabase.getSession());
+    buyingAsset.set(xdr::xdr_to_opaque(buying));
+    sellingAsset.set(xdr::xdr_to_opaque(selling));
 
     double worseThanPrice =
         (double)worseThan.price.n / (double)worseThan.price.d;
@@ -143,12 +146,12 @@ LedgerTxnRoot::Impl::loadBestOffers(std::deque<LedgerEntry>& offers,
 
     auto prep = mDatabase.getPreparedStatement(sql);
     auto& st = prep.statement();
-    st.exchange(soci::use(sellingAsset));
-    st.exchange(soci::use(buyingAsset));
+    st.exchange(sellingAsset.use());
+    st.exchange(buyingAsset.use());
     st.exchange(soci::use(worseThanPrice));
     st.exchange(soci::use(numOffers));
-    st.exchange(soci::use(sellingAsset));
-    st.exchange(soci::use(buyingAsset));
+    st.exchange(sellingAsset.use());
+    st.exchange(buyingAsset.use());
     st.exchange(soci::use(worseThanPrice));
     st.exchange(soci::use(worseThanOfferID));
     st.exchange(soci::use(numOffers));
@@ -221,13 +224,14 @@ LedgerTxnRoot::Impl::loadOffersByAccountAndAsset(AccountID const& accountID,
     {
         throw std::runtime_error("Invalid asset type");
     }
-    std::string assetStr = decoder::encode_b64(xdr::xdr_to_opaque(asset));
+    BinaryColumn assetBin(mDatabase.getSession());
+    assetBin.set(xdr::xdr_to_opaque(asset));
 
     auto prep = mDatabase.getPreparedStatement(sql);
     auto& st = prep.statement();
     st.exchange(soci::use(accountStr));
-    st.exchange(soci::use(assetStr));
-    st.exchange(soci::use(assetStr));
+    st.exchange(assetBin.use());
+    st.exchange(assetBin.use());
 
     std::vector<LedgerEntry> offers;
     {
@@ -238,12 +242,10 @@ LedgerTxnRoot::Impl::loadOffersByAccountAndAsset(AccountID const& accountID,
 }
 
 static Asset
-processAsset(std::string const& asset)
+processAsset(BinaryColumn const& asset)
 {
     Asset res;
-    std::vector<uint8_t> assetOpaque;
-    decoder::decode_b64(asset, assetOpaque);
-    xdr::xdr_from_opaque(assetOpaque, res);
+    xdr::xdr_from_opaque(asset.get(), res);
     return res;
 }
 
@@ -253,11 +255,9 @@ LedgerTxnRoot::Impl::loadOffers(StatementContext& prep,
 {
     ZoneScoped;
     std::string actIDStrKey;
-    std::string sellingAsset, buyingAsset;
-    std::string extensionStr;
-    soci::indicator extensionInd;
-    std::string ledgerExtStr;
-    soci::indicator ledgerExtInd;
+    auto& sess = mDatabase.getSession();
+    BinaryColumn sellingAsset(sess), buyingAsset(sess);
+    BinaryColumn extension(sess), ledgerExt(sess);
 
     LedgerEntry le;
     le.data.type(OFFER);
@@ -266,15 +266,15 @@ LedgerTxnRoot::Impl::loadOffers(StatementContext& prep,
     auto& st = prep.statement();
     st.exchange(soci::into(actIDStrKey));
     st.exchange(soci::into(oe.offerID));
-    st.exchange(soci::into(sellingAsset));
-    st.exchange(soci::into(buyingAsset));
+    st.exchange(sellingAsset.into());
+    st.exchange(buyingAsset.into());
     st.exchange(soci::into(oe.amount));
     st.exchange(soci::into(oe.price.n));
     st.exchange(soci::into(oe.price.d));
     st.exchange(soci::into(oe.flags));
     st.exchange(soci::into(le.lastModifiedLedgerSeq));
-    st.exchange(soci::into(extensionStr, extensionInd));
-    st.exchange(soci::into(ledgerExtStr, ledgerExtInd));
+    st.exchange(extension.into());
+    st.exchange(ledgerExt.into());
     st.define_and_bind();
     st.execute(true);
 
@@ -286,9 +286,9 @@ LedgerTxnRoot::Impl::loadOffers(StatementContext& prep,
         oe.selling = processAsset(sellingAsset);
         oe.buying = processAsset(buyingAsset);
 
-        decodeOpaqueXDR(extensionStr, extensionInd, oe.ext);
+        decodeBinaryXDR(extension, oe.ext);
 
-        decodeOpaqueXDR(ledgerExtStr, ledgerExtInd, le.ext);
+        decodeBinaryXDR(ledgerExt, le.ext);
 
         offers.emplace_back(le);
         st.fetch();
@@ -304,11 +304,9 @@ LedgerTxnRoot::Impl::loadOffers(StatementContext& prep) const
     std::vector<LedgerEntry> offers;
 
     std::string actIDStrKey;
-    std::string sellingAsset, buyingAsset;
-    std::string extensionStr;
-    soci::indicator extensionInd;
-    std::string ledgerExtStr;
-    soci::indicator ledgerExtInd;
+    auto& sess = mDatabase.getSession();
+    BinaryColumn sellingAsset(sess), buyingAsset(sess);
+    BinaryColumn extension(sess), ledgerExt(sess);
 
     LedgerEntry le;
     le.data.type(OFFER);
@@ -317,15 +315,15 @@ LedgerTxnRoot::Impl::loadOffers(StatementContext& prep) const
     auto& st = prep.statement();
     st.exchange(soci::into(actIDStrKey));
     st.exchange(soci::into(oe.offerID));
-    st.exchange(soci::into(sellingAsset));
-    st.exchange(soci::into(buyingAsset));
+    st.exchange(sellingAsset.into());
+    st.exchange(buyingAsset.into());
     st.exchange(soci::into(oe.amount));
     st.exchange(soci::into(oe.price.n));
     st.exchange(soci::into(oe.price.d));
     st.exchange(soci::into(oe.flags));
     st.exchange(soci::into(le.lastModifiedLedgerSeq));
-    st.exchange(soci::into(extensionStr, extensionInd));
-    st.exchange(soci::into(ledgerExtStr, ledgerExtInd));
+    st.exchange(extension.into());
+    st.exchange(ledgerExt.into());
     st.define_and_bind();
     st.execute(true);
 
@@ -335,9 +333,9 @@ LedgerTxnRoot::Impl::loadOffers(StatementContext& prep) const
         oe.selling = processAsset(sellingAsset);
         oe.buying = processAsset(buyingAsset);
 
-        decodeOpaqueXDR(extensionStr, extensionInd, oe.ext);
+        decodeBinaryXDR(extension, oe.ext);
 
-        decodeOpaqueXDR(ledgerExtStr, ledgerExtInd, le.ext);
+        decodeBinaryXDR(ledgerExt, le.ext);
 
         offers.emplace_back(le);
         st.fetch();
@@ -351,16 +349,16 @@ class BulkUpsertOffersOperation : public DatabaseTypeSpecificOperation<void>
     Database& mDB;
     std::vector<std::string> mSellerIDs;
     std::vector<int64_t> mOfferIDs;
-    std::vector<std::string> mSellingAssets;
-    std::vector<std::string> mBuyingAssets;
+    std::vector<std::vector<uint8_t>> mSellingAssets;
+    std::vector<std::vector<uint8_t>> mBuyingAssets;
     std::vector<int64_t> mAmounts;
     std::vector<int32_t> mPriceNs;
     std::vector<int32_t> mPriceDs;
     std::vector<double> mPrices;
     std::vector<int32_t> mFlags;
     std::vector<int32_t> mLastModifieds;
-    std::vector<std::string> mExtensions;
-    std::vector<std::string> mLedgerExtensions;
+    std::vector<std::vector<uint8_t>> mExtensions;
+    std::vector<std::vector<uint8_t>> mLedgerExtensions;
 
     void
     accumulateEntry(LedgerEntry const& entry)
@@ -371,10 +369,8 @@ class BulkUpsertOffersOperation : public DatabaseTypeSpecificOperation<void>
         mSellerIDs.emplace_back(KeyUtils::toStrKey(offer.sellerID));
         mOfferIDs.emplace_back(offer.offerID);
 
-        mSellingAssets.emplace_back(
-            decoder::encode_b64(xdr::xdr_to_opaque(offer.selling)));
-        mBuyingAssets.emplace_back(
-            decoder::encode_b64(xdr::xdr_to_opaque(offer.buying)));
+        mSellingAssets.emplace_back(xdr::xdr_to_opaque(offer.selling));
+        mBuyingAssets.emplace_back(xdr::xdr_to_opaque(offer.buying));
 
         mAmounts.emplace_back(offer.amount);
         mPriceNs.emplace_back(offer.price.n);
@@ -385,10 +381,8 @@ class BulkUpsertOffersOperation : public DatabaseTypeSpecificOperation<void>
         mFlags.emplace_back(unsignedToSigned(offer.flags));
         mLastModifieds.emplace_back(
             unsignedToSigned(entry.lastModifiedLedgerSeq));
-        mExtensions.emplace_back(
-            decoder::encode_b64(xdr::xdr_to_opaque(offer.ext)));
-        mLedgerExtensions.emplace_back(
-            decoder::encode_b64(xdr::xdr_to_opaque(entry.ext)));
+        mExtensions.emplace_back(xdr::xdr_to_opaque(offer.ext));
+        mLedgerExtensions.emplace_back(xdr::xdr_to_opaque(entry.ext));
     }
 
   public:
@@ -441,17 +435,13 @@ class BulkUpsertOffersOperation : public DatabaseTypeSpecificOperation<void>
         }
     }
 
+    template <typename Backend>
     void
-    doSociGenericOperation()
+    doUpsert(Backend* backend)
     {
-        std::string sql =
-            "INSERT INTO offers ( "
-            "sellerid, offerid, sellingasset, buyingasset, "
-            "amount, pricen, priced, price, flags, lastmodified, extension, "
-            "ledgerext "
-            ") VALUES ( "
-            ":v1, :v2, :v3, :v4, :v5, :v6, :v7, :v8, :v9, :v10, :v11, :v12 "
-            ") ON CONFLICT (offerid) DO UPDATE SET "
+        DatabaseUtils::BulkUpsert upsert(
+            mDB, "offers", "offer",
+            "ON CONFLICT (offerid) DO UPDATE SET "
             "sellerid = excluded.sellerid, "
             "sellingasset = excluded.sellingasset, "
             "buyingasset = excluded.buyingasset, "
@@ -462,118 +452,34 @@ class BulkUpsertOffersOperation : public DatabaseTypeSpecificOperation<void>
             "flags = excluded.flags, "
             "lastmodified = excluded.lastmodified, "
             "extension = excluded.extension, "
-            "ledgerext = excluded.ledgerext";
-        auto prep = mDB.getPreparedStatement(sql);
-        soci::statement& st = prep.statement();
-        st.exchange(soci::use(mSellerIDs));
-        st.exchange(soci::use(mOfferIDs));
-        st.exchange(soci::use(mSellingAssets));
-        st.exchange(soci::use(mBuyingAssets));
-        st.exchange(soci::use(mAmounts));
-        st.exchange(soci::use(mPriceNs));
-        st.exchange(soci::use(mPriceDs));
-        st.exchange(soci::use(mPrices));
-        st.exchange(soci::use(mFlags));
-        st.exchange(soci::use(mLastModifieds));
-        st.exchange(soci::use(mExtensions));
-        st.exchange(soci::use(mLedgerExtensions));
-        st.define_and_bind();
-        {
-            auto timer = mDB.getUpsertTimer("offer");
-            st.execute(true);
-        }
-        if (static_cast<size_t>(st.get_affected_rows()) != mOfferIDs.size())
-        {
-            throw std::runtime_error("Could not update data in SQL");
-        }
+            "ledgerext = excluded.ledgerext",
+            mOfferIDs.size());
+        upsert.addColumn("sellerid", mSellerIDs);
+        upsert.addColumn("offerid", mOfferIDs);
+        upsert.addBinaryColumn("sellingasset", mSellingAssets);
+        upsert.addBinaryColumn("buyingasset", mBuyingAssets);
+        upsert.addColumn("amount", mAmounts);
+        upsert.addColumn("pricen", mPriceNs);
+        upsert.addColumn("priced", mPriceDs);
+        upsert.addColumn("price", mPrices);
+        upsert.addColumn("flags", mFlags);
+        upsert.addColumn("lastmodified", mLastModifieds);
+        upsert.addBinaryColumn("extension", mExtensions);
+        upsert.addBinaryColumn("ledgerext", mLedgerExtensions);
+        upsert.execute(backend);
     }
 
     void
     doSqliteSpecificOperation(soci::sqlite3_session_backend* sq) override
     {
-        doSociGenericOperation();
+        doUpsert(sq);
     }
 
 #ifdef USE_POSTGRES
     void
     doPostgresSpecificOperation(soci::postgresql_session_backend* pg) override
     {
-
-        std::string strSellerIDs, strOfferIDs, strSellingAssets,
-            strBuyingAssets, strAmounts, strPriceNs, strPriceDs, strPrices,
-            strFlags, strLastModifieds, strExtensions, strLedgerExtensions;
-
-        PGconn* conn = pg->conn_;
-        marshalToPGArray(conn, strSellerIDs, mSellerIDs);
-        marshalToPGArray(conn, strOfferIDs, mOfferIDs);
-
-        marshalToPGArray(conn, strSellingAssets, mSellingAssets);
-        marshalToPGArray(conn, strBuyingAssets, mBuyingAssets);
-
-        marshalToPGArray(conn, strAmounts, mAmounts);
-        marshalToPGArray(conn, strPriceNs, mPriceNs);
-        marshalToPGArray(conn, strPriceDs, mPriceDs);
-        marshalToPGArray(conn, strPrices, mPrices);
-        marshalToPGArray(conn, strFlags, mFlags);
-        marshalToPGArray(conn, strLastModifieds, mLastModifieds);
-        marshalToPGArray(conn, strExtensions, mExtensions);
-        marshalToPGArray(conn, strLedgerExtensions, mLedgerExtensions);
-
-        std::string sql =
-            "WITH r AS (SELECT "
-            "unnest(:v1::TEXT[]), "
-            "unnest(:v2::BIGINT[]), "
-            "unnest(:v3::TEXT[]), "
-            "unnest(:v4::TEXT[]), "
-            "unnest(:v5::BIGINT[]), "
-            "unnest(:v6::INT[]), "
-            "unnest(:v7::INT[]), "
-            "unnest(:v8::DOUBLE PRECISION[]), "
-            "unnest(:v9::INT[]), "
-            "unnest(:v10::INT[]), "
-            "unnest(:v11::TEXT[]), "
-            "unnest(:v12::TEXT[]) "
-            ")"
-            "INSERT INTO offers ( "
-            "sellerid, offerid, sellingasset, buyingasset, "
-            "amount, pricen, priced, price, flags, lastmodified, extension, "
-            "ledgerext "
-            ") SELECT * from r "
-            "ON CONFLICT (offerid) DO UPDATE SET "
-            "sellerid = excluded.sellerid, "
-            "sellingasset = excluded.sellingasset, "
-            "buyingasset = excluded.buyingasset, "
-            "amount = excluded.amount, "
-            "pricen = excluded.pricen, "
-            "priced = excluded.priced, "
-            "price = excluded.price, "
-            "flags = excluded.flags, "
-            "lastmodified = excluded.lastmodified, "
-            "extension = excluded.extension, "
-            "ledgerext = excluded.ledgerext";
-        auto prep = mDB.getPreparedStatement(sql);
-        soci::statement& st = prep.statement();
-        st.exchange(soci::use(strSellerIDs));
-        st.exchange(soci::use(strOfferIDs));
-        st.exchange(soci::use(strSellingAssets));
-        st.exchange(soci::use(strBuyingAssets));
-        st.exchange(soci::use(strAmounts));
-        st.exchange(soci::use(strPriceNs));
-        st.exchange(soci::use(strPriceDs));
-        st.exchange(soci::use(strPrices));
-        st.exchange(soci::use(strFlags));
-        st.exchange(soci::use(strLastModifieds));
-        st.exchange(soci::use(strExtensions));
-        st.exchange(soci::use(strLedgerExtensions));
-        st.define_and_bind();
-        {
-            auto timer = mDB.getUpsertTimer("offer");
-            st.execute(true);
-        }
-        if (static_cast<size_t>(st.get_affected_rows()) != mOfferIDs.size())
-        {
-            throw std::runtime_error("Could not update data in SQL");
-        }
+        doUpsert(pg);
     }
 #endif
 };
@@ -721,27 +627,26 @@ class BulkLoadOffersOperation
     std::vector<LedgerEntry>
     executeAndFetch(soci::statement& st)
     {
-        std::string sellerID, sellingAsset, buyingAsset;
+        std::string sellerID;
         int64_t amount;
         int64_t offerID;
         uint32_t flags, lastModified;
-        std::string extension;
-        soci::indicator extensionInd;
-        std::string ledgerExtension;
-        soci::indicator ledgerExtInd;
+        auto& sess = mDb.getSession();
+        BinaryColumn sellingAsset(sess), buyingAsset(sess);
+        BinaryColumn extension(sess), ledgerExtension(sess);
         Price price;
 
         st.exchange(soci::into(sellerID));
         st.exchange(soci::into(offerID));
-        st.exchange(soci::into(sellingAsset));
-        st.exchange(soci::into(buyingAsset));
+        st.exchange(sellingAsset.into());
+        st.exchange(buyingAsset.into());
         st.exchange(soci::into(amount));
         st.exchange(soci::into(price.n));
         st.exchange(soci::into(price.d));
         st.exchange(soci::into(flags));
         st.exchange(soci::into(lastModified));
-        st.exchange(soci::into(extension, extensionInd));
-        st.exchange(soci::into(ledgerExtension, ledgerExtInd));
+        st.exchange(extension.into());
+        st.exchange(ledgerExtension.into());
         st.define_and_bind();
         {
             auto timer = mDb.getSelectTimer("offer");
@@ -769,9 +674,9 @@ class BulkLoadOffersOperation
             oe.flags = flags;
             le.lastModifiedLedgerSeq = lastModified;
 
-            decodeOpaqueXDR(extension, extensionInd, oe.ext);
+            decodeBinaryXDR(extension, oe.ext);
 
-            decodeOpaqueXDR(ledgerExtension, ledgerExtInd, le.ext);
+            decodeBinaryXDR(ledgerExtension, le.ext);
 
             st.fetch();
         }
@@ -6,6 +6,7 @@
 #include "crypto/SecretKey.h"
 #include "database/Database.h"
 #include "database/DatabaseTypeSpecificOperation.h"
+#include "database/DatabaseUtils.h"
 #include "ledger/LedgerTxnImpl.h"
 #include "ledger/NonSociRelatedException.h"
 #include "util/Decoder.h"
@@ -61,10 +62,8 @@ LedgerTxnRoot::Impl::loadTrustLine(LedgerKey const& key) const
                         accountIDStr, issuerStr, assetStr,
                         mHeader->ledgerVersion);
 
-    std::string extensionStr;
-    soci::indicator extensionInd;
-    std::string ledgerExtStr;
-    soci::indicator ledgerExtInd;
+    auto& sess = mDatabase.getSession();
+    BinaryColumn extension(sess), ledgerExt(sess);
 
     LedgerEntry le;
     le.data.type(TRUSTLINE);
@@ -80,8 +79,8 @@ LedgerTxnRoot::Impl::loadTrustLine(LedgerKey const& key) const
     st.exchange(soci::into(tl.balance));
     st.exchange(soci::into(tl.flags));
     st.exchange(soci::into(le.lastModifiedLedgerSeq));
-    st.exchange(soci::into(extensionStr, extensionInd));
-    st.exchange(soci::into(ledgerExtStr, ledgerExtInd));
+    st.exchange(extension.into());
+    st.exchange(ledgerExt.into());
     st.exchange(soci::use(accountIDStr));
     st.exchange(soci::use(issuerStr));
     st.exchange(soci::use(assetStr));
@@ -98,9 +97,9 @@ LedgerTxnRoot::Impl::loadTrustLine(LedgerKey const& key) const
     tl.accountID = key.trustLine().accountID;
     tl.asset = key.trustLine().asset;
 
-    decodeOpaqueXDR(extensionStr, extensionInd, tl.ext);
+    decodeBinaryXDR(extension, tl.ext);
 
-    decodeOpaqueXDR(ledgerExtStr, ledgerExtInd, le.ext);
+    decodeBinaryXDR(ledgerExt, le.ext);
 
     return std::make_shared<LedgerEntry>(std::move(le));
 }
@@ -116,9 +115,9 @@ class BulkUpsertTrustLinesOperation : public DatabaseTypeSpecificOperation<void>
     std::vector<int64_t> mBalances;
     std::vector<int32_t> mFlags;
     std::vector<int32_t> mLastModifieds;
-    std::vector<std::string> mExtensions;
+    std::vector<std::vector<uint8_t>> mExtensions;
     std::vector<soci::indicator> mExtensionInds;
-    std::vector<std::string> mLedgerExtensions;
+    std::vector<std::vector<uint8_t>> mLedgerExtensions;
 
   public:
     BulkUpsertTrustLinesOperation(Database& DB,
@@ -163,136 +162,58 @@ class BulkUpsertTrustLinesOperation : public DatabaseTypeSpecificOperation<void>
 
             if (tl.ext.v() >= 1)
             {
-                mExtensions.emplace_back(
-                    decoder::encode_b64(xdr::xdr_to_opaque(tl.ext)));
+                mExtensions.emplace_back(xdr::xdr_to_opaque(tl.ext));
                 mExtensionInds.emplace_back(soci::i_ok);
             }
             else
             {
-                mExtensions.emplace_back("");
+                mExtensions.emplace_back();
                 mExtensionInds.emplace_back(soci::i_null);
             }
 
-            mLedgerExtensions.emplace_back(
-                decoder::encode_b64(xdr::xdr_to_opaque(le.ext)));
+            mLedgerExtensions.emplace_back(xdr::xdr_to_opaque(le.ext));
         }
     }
 
+    template <typename Backend>
     void
-    doSociGenericOperation()
+    doUpsert(Backend* backend)
     {
-        std::string sql =
-            "INSERT INTO trustlines ( "
-            "accountid, assettype, issuer, assetcode,"
-            "tlimit, balance, flags, lastmodified, "
-            "extension, ledgerext "
-            ") VALUES ( "
-            ":id, :v1, :v2, :v3, :v4, :v5, :v6, :v7, :v8, :v9 "
-            ") ON CONFLICT (accountid, issuer, assetcode) DO UPDATE SET "
+        DatabaseUtils::BulkUpsert upsert(
+            mDB, "trustlines", "trustline",
+            "ON CONFLICT (accountid, issuer, assetcode) DO UPDATE SET "
             "assettype = excluded.assettype, "
             "tlimit = excluded.tlimit, "
             "balance = excluded.balance, "
             "flags = excluded.flags, "
             "lastmodified = excluded.lastmodified, "
             "extension = excluded.extension, "
-            "ledgerext = excluded.ledgerext";
-        auto prep = mDB.getPreparedStatement(sql);
-        soci::statement& st = prep.statement();
-        st.exchange(soci::use(mAccountIDs));
-        st.exchange(soci::use(mAssetTypes));
-        st.exchange(soci::use(mIssuers));
-        st.exchange(soci::use(mAssetCodes));
-        st.exchange(soci::use(mTlimits));
-        st.exchange(soci::use(mBalances));
-        st.exchange(soci::use(mFlags));
-        st.exchange(soci::use(mLastModifieds));
-        st.exchange(soci::use(mExtensions, mExtensionInds));
-        st.exchange(soci::use(mLedgerExtensions));
-        st.define_and_bind();
-        {
-            auto timer = mDB.getUpsertTimer("trustline");
-            st.execute(true);
-        }
-        if (static_cast<size_t>(st.get_affected_rows()) != mAccountIDs.size())
-        {
-            throw std::runtime_error("Could not update data in SQL");
-        }
+            "ledgerext = excluded.ledgerext",
+            mAccountIDs.size());
+        upsert.addColumn("accountid", mAccountIDs);
+        upsert.addColumn("assettype", mAssetTypes);
+        upsert.addColumn("issuer", mIssuers);
+        upsert.addColumn("assetcode", mAssetCodes);
+        upsert.addColumn("tlimit", mTlimits);
+        upsert.addColumn("balance", mBalances);
+        upsert.addColumn("flags", mFlags);
+        upsert.addColumn("lastmodified", mLastModifieds);
+        upsert.addBinaryColumn("extension", mExtensions, &mExtensionInds);
+        upsert.addBinaryColumn("ledgerext", mLedgerExtensions);
+        upsert.execute(backend);
     }
 
     void
     doSqliteSpecificOperation(soci::sqlite3_session_backend* sq) override
     {
-        doSociGenericOperation();
+        doUpsert(sq);
     }
 
 #ifdef USE_POSTGRES
     void
     doPostgresSpecificOperation(soci::postgresql_session_backend* pg) override
     {
-        PGconn* conn = pg->conn_;
-
-        std::string strAccountIDs, strAssetTypes, strIssuers, strAssetCodes,
-            strTlimits, strBalances, strFlags, strLastModifieds, strExtensions,
-            strLedgerExtensions;
-
-        marshalToPGArray(conn, strAccountIDs, mAccountIDs);
-        marshalToPGArray(conn, strAssetTypes, mAssetTypes);
-        marshalToPGArray(conn, strIssuers, mIssuers);
-        marshalToPGArray(conn, strAssetCodes, mAssetCodes);
-        marshalToPGArray(conn, strTlimits, mTlimits);
-        marshalToPGArray(conn, strBalances, mBalances);
-        marshalToPGArray(conn, strFlags, mFlags);
-        marshalToPGArray(conn, strLastModifieds, mLastModifieds);
-        marshalToPGArray(conn, strExtensions, mExtensions, &mExtensionInds);
-        marshalToPGArray(conn, strLedgerExtensions, mLedgerExtensions);
-
-        std::string sql =
-            "WITH r AS (SELECT "
-            "unnest(:ids::TEXT[]), "
-            "unnest(:v1::INT[]), "
-            "unnest(:v2::TEXT[]), "
-            "unnest(:v3::TEXT[]), "
-            "unnest(:v4::BIGINT[]), "
-            "unnest(:v5::BIGINT[]), "
-            "unnest(:v6::INT[]), "
-            "unnest(:v7::INT[]), "
-            "unnest(:v8::TEXT[]), "
-            "unnest(:v9::TEXT[]) "
-            ")"
-            "INSERT INTO trustlines ( "
-            "accountid, assettype, issuer, assetcode,"
-            "tlimit, balance, flags, lastmodified, "
-            "extension, ledgerext "
-            ") SELECT * from r "
-            "ON CONFLICT (accountid, issuer, assetcode) DO UPDATE SET "
-            "assettype = excluded.assettype, "
-            "tlimit = excluded.tlimit, "
-            "balance = excluded.balance, "
-            "flags = excluded.flags, "
-            "lastmodified = excluded.lastmodified, "
-            "extension = excluded.extension, "
-            "ledgerext = excluded.ledgerext";
-        auto prep = mDB.getPreparedStatement(sql);
-        soci::statement& st = prep.statement();
-        st.exchange(soci::use(strAccountIDs));
-        st.exchange(soci::use(strAssetTypes));
-        st.exchange(soci::use(strIssuers));
-        st.exchange(soci::use(strAssetCodes));
-        st.exchange(soci::use(strTlimits));
-        st.exchange(soci::use(strBalances));
-        st.exchange(soci::use(strFlags));
-        st.exchange(soci::use(strLastModifieds));
-        st.exchange(soci::use(strExtensions));
-        st.exchange(soci::use(strLedgerExtensions));
-        st.define_and_bind();
-        {
-            auto timer = mDB.getUpsertTimer("trustline");
-            st.execute(true);
-        }
-        if (static_cast<size_t>(st.get_affected_rows()) != mAccountIDs.size())
-        {
-            throw std::runtime_error("Could not update data in SQL");
-        }
+        doUpsert(pg);
     }
 #endif
 };
@@ -465,10 +386,8 @@ class BulkLoadTrustLinesOperation
         std::string accountID, assetCode, issuer;
         int64_t balance, limit;
         uint32_t assetType, flags, lastModified;
-        std::string extension;
-        soci::indicator extensionInd;
-        std::string ledgerExtension;
-        soci::indicator ledgerExtInd;
+        auto& sess = mDb.getSession();
+        BinaryColumn extension(sess), ledgerExtension(sess);
 
         st.exchange(soci::into(accountID));
         st.exchange(soci::into(assetType));
@@ -478,8 +397,8 @@ class BulkLoadTrustLinesOperation
         st.exchange(soci::into(balance));
         st.exchange(soci::into(flags));
         st.exchange(soci::into(lastModified));
-        st.exchange(soci::into(extension, extensionInd));
-        st.exchange(soci::into(ledgerExtension, ledgerExtInd));
+        st.exchange(extension.into());
+        st.exchange(ledgerExtension.into());
         st.define_and_bind();
         {
             auto timer = mDb.getSelectTimer("trust");
@@ -516,9 +435,9 @@ class BulkLoadTrustLinesOperation
             tl.flags = flags;
             le.lastModifiedLedgerSeq = lastModified;
 
-            decodeOpaqueXDR(extension, extensionInd, tl.ext);
+            decodeBinaryXDR(extension, tl.ext);
 
-            decodeOpaqueXDR(ledgerExtension, ledgerExtInd, le.ext);
+            decodeBinaryXDR(ledgerExtension, le.ext);
 
             st.fetch();
         }
@@ -0,0 +1,716 @@
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/ParallelTxApply.h"
+#include "ledger/LedgerRange.h"
+#include "invariant/InvariantDoesNotHold.h"
+#include "invariant/InvariantManager.h"
+#include "ledger/LedgerManager.h"
+#include "ledger/LedgerTxn.h"
+#include "ledger/LedgerTxnEntry.h"
+#include "ledger/LedgerTxnHeader.h"
+#include "main/Application.h"
+#include "transactions/TransactionBridge.h"
+#include "transactions/TransactionUtils.h"
+#include "util/GlobalChecks.h"
+#include "util/Logging.h"
+#include "util/XDROperators.h"
+#include "util/types.h"
+
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+#include <Tracy.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cassert>
+#include <condition_variable>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <numeric>
+#include <unordered_map>
+
+namespace diamnet
+{
+
+namespace
+{
+
+using SnapshotMap =
+    std::unordered_map<LedgerKey,
+                       std::shared_ptr<GeneralizedLedgerEntry const>>;
+
+// Root of the LedgerTxn used to apply one group. It serves the entries of the
+// group's footprint, as loaded ahead of time on the main thread, and records
+// any access outside of it instead of going to the database. Committing to it
+// only captures the final state of the written entries, which are merged into
+// the real LedgerTxn once every group is known to be conflict-free.
+class FootprintLedgerTxnRoot : public AbstractLedgerTxnParent
+{
+    LedgerHeader const mHeader;
+    SnapshotMap const mEntries;
+    std::unordered_set<LedgerKey> const& mWritable;
+    AbstractLedgerTxn* mChild{nullptr};
+    mutable bool mViolated{false};
+    std::vector<std::pair<LedgerKey,
+                          std::shared_ptr<GeneralizedLedgerEntry const>>>
+        mCommitted;
+
+    void
+    violate() const
+    {
+        mViolated = true;
+    }
+
+  public:
+    FootprintLedgerTxnRoot(LedgerHeader const& header, SnapshotMap&& entries,
+                           std::unordered_set<LedgerKey> const& writable)
+        : mHeader(header), mEntries(std::move(entries)), mWritable(writable)
+    {
+    }
+
+    bool
+    violated() const
+    {
+        return mViolated;
+    }
+
+    void
+    markViolated()
+    {
+        violate();
+    }
+
+    void
+    mergeInto(AbstractLedgerTxn& ltx) const
+    {
+        for (auto const& kv : mCommitted)
+        {
+            auto const& key = kv.first;
+            auto const& entry = kv.second;
+            auto const& previous = mEntries.at(key);
+            if (entry)
+            {
+                if (previous)
+                {
+                    ltx.load(key).currentGeneralized() = *entry;
+                }
+                else
+                {
+                    ltx.create(*entry);
+                }
+            }
+            else if (previous)
+            {
+                ltx.erase(key);
+            }
+        }
+    }
+
+    void
+    addChild(AbstractLedgerTxn& child) override
+    {
+        if (mChild)
+        {
+            throw std::runtime_error(
+                "FootprintLedgerTxnRoot already has child");
+        }
+        mChild = &child;
+    }
+
+    void
+    commitChild(EntryIterator iter, LedgerTxnConsistency cons) override
+    {
+        for (; (bool)iter; ++iter)
+        {
+            auto const& key = iter.key();
+            if (key.type() != GeneralizedLedgerEntryType::LEDGER_ENTRY ||
+                mWritable.find(key.ledgerKey()) == mWritable.end())
+            {
+                violate();
+                continue;
+            }
+            mCommitted.emplace_back(
+                key.ledgerKey(),
+                iter.entryExists()
+                    ? std::make_shared<GeneralizedLedgerEntry const>(
+                          iter.entry())
+                    : nullptr);
+        }
+
+        // Transactions that can be applied in parallel never modify the
+        // header, as concurrent modifications could not be reconciled.
+        if (!(mChild->getHeader() == mHeader))
+        {
+            violate();
+        }
+        mChild = nullptr;
+    }
+
+    void
+    rollbackChild() override
+    {
+        mChild = nullptr;
+    }
+
+    std::unordered_map<LedgerKey, LedgerEntry>
+    getAllOffers() override
+    {
+        violate();
+        return {};
+    }
+
+    std::shared_ptr<LedgerEntry const>
+    getBestOffer(Asset const& buying, Asset const& selling) override
+    {
+        violate();
+        return nullptr;
+    }
+
+    std::shared_ptr<LedgerEntry const>
+    getBestOffer(Asset const& buying, Asset const& selling,
+                 OfferDescriptor const& worseThan) override
+    {
+        violate();
+        return nullptr;
+    }
+
+    std::unordered_map<LedgerKey, LedgerEntry>
+    getOffersByAccountAndAsset(AccountID const& account,
+                               Asset const& asset) override
+    {
+        violate();
+        return {};
+    }
+
+    LedgerHeader const&
+    getHeader() const override
+    {
+        return mHeader;
+    }
+
+    std::vector<InflationWinner>
+    getInflationWinners(size_t maxWinners, int64_t minBalance) override
+    {
+        violate();
+        return {};
+    }
+
+    std::shared_ptr<GeneralizedLedgerEntry const>
+    getNewestVersion(GeneralizedLedgerKey const& key) const override
+    {
+        // Sponsorship entries only ever live inside the LedgerTxn of the
+        // transaction that creates them, so they never exist at this level.
+        if (key.type() != GeneralizedLedgerEntryType::LEDGER_ENTRY)
+        {
+            return nullptr;
+        }
+
+        auto iter = mEntries.find(key.ledgerKey());
+        if (iter == mEntries.end())
+        {
+            violate();
+            return nullptr;
+        }
+        return iter->second;
+    }
+
+    uint64_t
+    countObjects(LedgerEntryType let) const override
+    {
+        throw std::runtime_error(
+            "called countObjects on FootprintLedgerTxnRoot");
+    }
+
+    uint64_t
+    countObjects(LedgerEntryType let,
+                 LedgerRange const& ledgers) const override
+    {
+        throw std::runtime_error(
+            "called countObjects on FootprintLedgerTxnRoot");
+    }
+
+    void
+    deleteObjectsModifiedOnOrAfterLedger(uint32_t ledger) const override
+    {
+        throw std::runtime_error("called deleteObjectsModifiedOnOrAfterLedger "
+                                 "on FootprintLedgerTxnRoot");
+    }
+
+    void
+    dropAccounts() override
+    {
+        throw std::runtime_error(
+            "called dropAccounts on FootprintLedgerTxnRoot");
+    }
+
+    void
+    dropData() override
+    {
+        throw std::runtime_error("called dropData on FootprintLedgerTxnRoot");
+    }
+
+    void
+    dropOffers() override
+    {
+        throw std::runtime_error("called dropOffers on FootprintLedgerTxnRoot");
+    }
+
+    void
+    dropTrustLines() override
+    {
+        throw std::runtime_error(
+            "called dropTrustLines on FootprintLedgerTxnRoot");
+    }
+
+    void
+    dropClaimableBalances() override
+    {
+        throw std::runtime_error(
+            "called dropClaimableBalances on FootprintLedgerTxnRoot");
+    }
+
+    double
+    getPrefetchHitRate() const override
+    {
+        return 0.0;
+    }
+
+    uint32_t
+    prefetch(std::unordered_set<LedgerKey> const& keys) override
+    {
+        return 0;
+    }
+};
+
+thread_local SpeculativeApply* tSpeculativeApply = nullptr;
+
+// Makes a group's SpeculativeApply current on the thread applying it.
+class CurrentSpeculativeApply : NonMovableOrCopyable
+{
+  public:
+    explicit CurrentSpeculativeApply(SpeculativeApply& speculative)
+    {
+        assert(!tSpeculativeApply);
+        tSpeculativeApply = &speculative;
+    }
+
+    ~CurrentSpeculativeApply()
+    {
+        tSpeculativeApply = nullptr;
+    }
+};
+
+// Shared between the applying thread and the helper jobs posted to the worker
+// threads. Helper jobs may start after all groups have been claimed (or even
+// after the applier returned), in which case they find no work and exit.
+struct ParallelApplyState
+{
+    size_t const mNumGroups;
+    std::function<void(size_t)> const mApplyGroup;
+    std::atomic<size_t> mNextGroup{0};
+    std::mutex mMutex;
+    std::condition_variable mCV;
+    size_t mDone{0};
+
+    ParallelApplyState(size_t numGroups, std::function<void(size_t)> f)
+        : mNumGroups(numGroups), mApplyGroup(std::move(f))
+    {
+    }
+
+    void
+    run()
+    {
+        size_t i;
+        while ((i = mNextGroup++) < mNumGroups)
+        {
+            mApplyGroup(i);
+            std::lock_guard<std::mutex> lock(mMutex);
+            ++mDone;
+            mCV.notify_all();
+        }
+    }
+
+    void
+    waitForAll()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCV.wait(lock, [this]() { return mDone == mNumGroups; });
+    }
+};
+}
+
+SpeculativeApply*
+SpeculativeApply::current()
+{
+    return tSpeculativeApply;
+}
+
+void
+SpeculativeApply::abort()
+{
+    mAborted = true;
+}
+
+bool
+SpeculativeApply::aborted() const
+{
+    return mAborted;
+}
+
+void
+SpeculativeApply::addOperation(LedgerCloseTiming::OperationCost const& cost)
+{
+    mOperations.emplace_back(cost);
+}
+
+std::vector<LedgerCloseTiming::OperationCost> const&
+SpeculativeApply::getOperations() const
+{
+    return mOperations;
+}
+
+void
+SpeculativeApply::setTransaction(size_t tx)
+{
+    mTx = tx;
+}
+
+void
+SpeculativeApply::checkOnOperationApply(Operation const& operation,
+                                        OperationResult const& opres,
+                                        LedgerTxnDelta&& ltxDelta)
+{
+    mChecks.push_back({mTx, operation, opres, std::move(ltxDelta)});
+}
+
+std::vector<SpeculativeApply::OperationCheck>&
+SpeculativeApply::getChecks()
+{
+    return mChecks;
+}
+
+bool
+computeTxApplyFootprint(TransactionFrameBase const& tx,
+                        TxApplyFootprint& footprint)
+{
+    auto& readWrite = footprint.mReadWrite;
+    auto& readOnly = footprint.mReadOnly;
+
+    auto txSourceID = tx.getSourceID();
+    readWrite.emplace(accountKey(tx.getFeeSourceID()));
+    readWrite.emplace(accountKey(txSourceID));
+
+    for (auto const& op : txbridge::getOperations(tx.getEnvelope()))
+    {
+        auto opSourceID =
+            op.sourceAccount ? toAccountID(*op.sourceAccount) : txSourceID;
+        readWrite.emplace(accountKey(opSourceID));
+
+        switch (op.body.type())
+        {
+        case CREATE_ACCOUNT:
+            readWrite.emplace(
+                accountKey(op.body.createAccountOp().destination));
+            break;
+        case PAYMENT:
+        {
+            auto const& payment = op.body.paymentOp();
+            auto destID = toAccountID(payment.destination);
+            readWrite.emplace(accountKey(destID));
+            if (payment.asset.type() != ASSET_TYPE_NATIVE)
+            {
+                readWrite.emplace(trustlineKey(opSourceID, payment.asset));
+                readWrite.emplace(trustlineKey(destID, payment.asset));
+                readOnly.emplace(accountKey(getIssuer(payment.asset)));
+            }
+            break;
+        }
+        case MANAGE_DATA:
+            readWrite.emplace(
+                dataKey(opSourceID, op.body.manageDataOp().dataName));
+            break;
+        case BUMP_SEQUENCE:
+            break;
+        default:
+            return false;
+        }
+    }
+
+    for (auto const& key : readWrite)
+    {
+        readOnly.erase(key);
+    }
+    return true;
+}
+
+ParallelTxSetApplier::ParallelTxSetApplier(
+    Application& app, std::vector<TransactionFrameBasePtr> const& txs,
+    int64_t baseFee)
+    : mApp(app), mTxs(txs), mBaseFee(baseFee)
+{
+}
+
+bool
+ParallelTxSetApplier::partition()
+{
+    ZoneScoped;
+    mGroups.clear();
+
+    std::vector<TxApplyFootprint> footprints(mTxs.size());
+    for (size_t i = 0; i < mTxs.size(); ++i)
+    {
+        if (!computeTxApplyFootprint(*mTxs[i], footprints[i]))
+        {
+            return false;
+        }
+    }
+
+    // Union-find over transaction indices, always keeping the smallest index
+    // as the representative so groups come out ordered by first transaction.
+    std::vector<size_t> parent(mTxs.size());
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&parent](size_t i) {
+        while (parent[i] != i)
+        {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+    auto unite = [&](size_t a, size_t b) {
+        a = find(a);
+        b = find(b);
+        if (a != b)
+        {
+            parent[std::max(a, b)] = std::min(a, b);
+        }
+    };
+
+    // Transactions conflict if they write the same key, or if one writes a
+    // key the other reads. Concurrent reads do not conflict.
+    std::unordered_map<LedgerKey, size_t> writers;
+    for (size_t i = 0; i < mTxs.size(); ++i)
+    {
+        for (auto const& key : footprints[i].mReadWrite)
+        {
+            auto res = writers.emplace(key, i);
+            if (!res.second)
+            {
+                unite(i, res.first->second);
+            }
+        }
+    }
+    for (size_t i = 0; i < mTxs.size(); ++i)
+    {
+        for (auto const& key : footprints[i].mReadOnly)
+        {
+            auto iter = writers.find(key);
+            if (iter != writers.end())
+            {
+                unite(i, iter->second);
+            }
+        }
+    }
+
+    std::unordered_map<size_t, size_t> groupIndex;
+    for (size_t i = 0; i < mTxs.size(); ++i)
+    {
+        auto res = groupIndex.emplace(find(i), mGroups.size());
+        if (res.second)
+        {
+            mGroups.emplace_back();
+        }
+        auto& group = mGroups[res.first->second];
+        group.mTxs.emplace_back(i);
+        auto& fp = footprints[i];
+        group.mFootprint.mReadWrite.insert(fp.mReadWrite.begin(),
+                                           fp.mReadWrite.end());
+        group.mFootprint.mReadOnly.insert(fp.mReadOnly.begin(),
+                                          fp.mReadOnly.end());
+    }
+    for (auto& group : mGroups)
+    {
+        for (auto const& key : group.mFootprint.mReadWrite)
+        {
+            group.mFootprint.mReadOnly.erase(key);
+        }
+    }
+    return true;
+}
+
+std::vector<ParallelTxSetApplier::Group> const&
+ParallelTxSetApplier::getGroups() const
+{
+    return mGroups;
+}
+
+void
+ParallelTxSetApplier::restoreResults(LedgerHeader const& header,
+                                     std::vector<int64_t> const& feesCharged)
+{
+    for (size_t i = 0; i < mTxs.size(); ++i)
+    {
+        mTxs[i]->resetResults(header, mBaseFee, true);
+        mTxs[i]->getResult().feeCharged = feesCharged[i];
+    }
+}
+
+bool
+ParallelTxSetApplier::apply(AbstractLedgerTxn& ltx,
+                            std::vector<TransactionMeta>& txMetas,
+                            size_t threads)
+{
+    ZoneScoped;
+    LedgerHeader header = ltx.loadHeader().current();
+
+    std::vector<int64_t> feesCharged;
+    feesCharged.reserve(mTxs.size());
+    for (auto const& tx : mTxs)
+    {
+        feesCharged.emplace_back(tx->getResult().feeCharged);
+    }
+
+    // Load every footprint on this thread: groups never reach ltx or the
+    // database while applying.
+    std::vector<std::unique_ptr<FootprintLedgerTxnRoot>> roots;
+    roots.reserve(mGroups.size());
+    for (auto const& group : mGroups)
+    {
+        SnapshotMap entries;
+        for (auto const& key : group.mFootprint.mReadOnly)
+        {
+            entries.emplace(key, ltx.getNewestVersion(key));
+        }
+        for (auto const& key : group.mFootprint.mReadWrite)
+        {
+            entries.emplace(key, ltx.getNewestVersion(key));
+        }
+        roots.emplace_back(std::make_unique<FootprintLedgerTxnRoot>(
+            header, std::move(entries), group.mFootprint.mReadWrite));
+    }
+
+    std::vector<SpeculativeApply> speculative(mGroups.size());
+
+    txMetas.clear();
+    txMetas.resize(mTxs.size());
+    std::vector<std::chrono::nanoseconds> txTimes(mTxs.size());
+
+    auto applyGroup = [&](size_t i) {
+        ZoneNamedN(groupZone, "applyTransactionGroup", true);
+        auto& root = *roots[i];
+        CurrentSpeculativeApply current(speculative[i]);
+        try
+        {
+            LedgerTxn ltxGroup(root);
+            for (auto index : mGroups[i].mTxs)
+            {
+                speculative[i].setTransaction(index);
+                TransactionMeta tm(2);
+                auto start = std::chrono::steady_clock::now();
+                mTxs[index]->apply(mApp, ltxGroup, tm);
+                txTimes[index] = std::chrono::steady_clock::now() - start;
+                txMetas[index] = std::move(tm);
+                if (speculative[i].aborted())
+                {
+                    root.markViolated();
+                }
+                if (root.violated())
+                {
+                    return;
+                }
+            }
+            ltxGroup.commit();
+        }
+        catch (std::exception& e)
+        {
+            CLOG(DEBUG, "Ledger")
+                << "Exception during parallel apply: " << e.what();
+            root.markViolated();
+        }
+    };
+
+    auto state =
+        std::make_shared<ParallelApplyState>(mGroups.size(), applyGroup);
+    size_t helpers = std::min(threads, mGroups.size());
+    for (size_t i = 1; i < helpers; ++i)
+    {
+        mApp.postOnBackgroundThread([state]() { state->run(); },
+                                    "ParallelTxSetApplier");
+    }
+    state->run();
+    state->waitForAll();
+
+    if (std::any_of(roots.begin(), roots.end(),
+                    [](std::unique_ptr<FootprintLedgerTxnRoot> const& root) {
+                        return root->violated();
+                    }))
+    {
+        CLOG(DEBUG, "Ledger") << "Parallel apply conflict, falling back to "
+                                 "serial apply";
+        restoreResults(header, feesCharged);
+        txMetas.clear();
+        return false;
+    }
+
+    LedgerTxn ltxMerge(ltx);
+    for (auto const& root : roots)
+    {
+        root->mergeInto(ltxMerge);
+    }
+    ltxMerge.commit();
+
+    // only the transactions and operations of committed groups are accounted
+    // for, and checked by the invariants in the order of a serial apply
+    auto& txTimer =
+        mApp.getMetrics().NewTimer({"ledger", "transaction", "apply"});
+    for (auto const& t : txTimes)
+    {
+        txTimer.Update(t);
+    }
+    auto& opTimer =
+        mApp.getMetrics().NewTimer({"ledger", "operation", "apply"});
+    auto& closeTiming = mApp.getLedgerManager().getCloseTiming();
+    std::vector<SpeculativeApply::OperationCheck> checks;
+    for (auto& group : speculative)
+    {
+        for (auto const& cost : group.getOperations())
+        {
+            opTimer.Update(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    cost.mTime));
+            closeTiming.addOperation(cost);
+        }
+        auto& groupChecks = group.getChecks();
+        std::move(groupChecks.begin(), groupChecks.end(),
+                  std::back_inserter(checks));
+    }
+    std::stable_sort(checks.begin(), checks.end(),
+                     [](SpeculativeApply::OperationCheck const& lhs,
+                        SpeculativeApply::OperationCheck const& rhs) {
+                         return lhs.mTx < rhs.mTx;
+                     });
+    // as in TransactionFrame::applyOperations, which checks them when applying
+    // serially
+    auto& invariantManager = mApp.getInvariantManager();
+    try
+    {
+        for (auto const& c : checks)
+        {
+            auto start = LedgerCloseTiming::Clock::now();
+            invariantManager.checkOnOperationApply(c.mOperation, c.mResult,
+                                                   c.mDelta);
+            closeTiming.addInvariants(LedgerCloseTiming::Clock::now() -
+                                      start);
+        }
+    }
+    catch (InvariantDoesNotHold&)
+    {
+        printErrorAndAbort("Invariant failure while applying operations");
+    }
+    return true;
+}
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/LedgerCloseTiming.h"
+#include "ledger/LedgerHashUtils.h"
+#include "ledger/LedgerTxn.h"
+#include "transactions/TransactionFrameBase.h"
+#include "util/NonCopyable.h"
+#include "xdr/Diamnet-ledger.h"
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+/*
+Optimistic parallel application of a transaction set.
+
+The transactions of a set are partitioned into groups whose ledger key
+footprints do not conflict: no key written by one group is read or written by
+another. Every group is then applied, in the original relative order of its
+transactions, on its own LedgerTxn anchored to a private snapshot of the
+entries in its footprint. Because groups never observe each other's writes,
+the results, metadata and final ledger state are identical to those of a
+serial application of the whole set.
+
+Footprints are derived statically from the operations, so they are validated
+while applying: any access to a key outside a group's footprint (or any write
+to a key declared read-only) marks the group as conflicting. If any group
+conflicts, all speculative work is discarded and the caller must re-apply the
+set serially. Operations applied speculatively are therefore only added to the
+close timings and checked by the invariants once their group is committed.
+*/
+
+namespace diamnet
+{
+class AbstractLedgerTxn;
+class Application;
+
+struct TxApplyFootprint
+{
+    std::unordered_set<LedgerKey> mReadOnly;
+    std::unordered_set<LedgerKey> mReadWrite;
+};
+
+// Computes the keys that applying tx may touch. Returns false if tx contains
+// an operation whose footprint cannot be determined statically (for example
+// anything crossing the order book), in which case it must be applied
+// serially.
+bool computeTxApplyFootprint(TransactionFrameBase const& tx,
+                             TxApplyFootprint& footprint);
+
+// The group of transactions ParallelTxSetApplier is applying on the calling
+// thread, if any. Until the group is known to be conflict-free, its
+// transactions may fail only because they went outside of its footprint, so
+// applying them must not report anything that a serial application would not.
+class SpeculativeApply : NonMovableOrCopyable
+{
+  public:
+    struct OperationCheck
+    {
+        size_t mTx;
+        Operation mOperation;
+        OperationResult mResult;
+        LedgerTxnDelta mDelta;
+    };
+
+  private:
+    bool mAborted{false};
+    size_t mTx{0};
+    std::vector<LedgerCloseTiming::OperationCost> mOperations;
+    std::vector<OperationCheck> mChecks;
+
+  public:
+    // The group applied on the calling thread, or nullptr.
+    static SpeculativeApply* current();
+
+    // Gives up on applying the group in parallel: the set is then re-applied
+    // serially, which reports whatever went wrong.
+    void abort();
+    bool aborted() const;
+
+    // Keeps what applying an operation cost, to add it to the close timings
+    // only if the group is committed.
+    void addOperation(LedgerCloseTiming::OperationCost const& cost);
+    std::vector<LedgerCloseTiming::OperationCost> const& getOperations() const;
+
+    // Keeps an operation to be checked by the invariants only if the group is
+    // committed, as part of the transaction at index tx of the set.
+    void setTransaction(size_t tx);
+    void checkOnOperationApply(Operation const& operation,
+                               OperationResult const& opres,
+                               LedgerTxnDelta&& ltxDelta);
+    std::vector<OperationCheck>& getChecks();
+};
+
+class ParallelTxSetApplier
+{
+  public:
+    struct Group
+    {
+        // indices into the transaction vector, in apply order
+        std::vector<size_t> mTxs;
+        TxApplyFootprint mFootprint;
+    };
+
+  private:
+    Application& mApp;
+    std::vector<TransactionFrameBasePtr> const& mTxs;
+    int64_t const mBaseFee;
+    std::vector<Group> mGroups;
+
+    void restoreResults(LedgerHeader const& header,
+                        std::vector<int64_t> const& feesCharged);
+
+  public:
+    ParallelTxSetApplier(Application& app,
+                         std::vector<TransactionFrameBasePtr> const& txs,
+                         int64_t baseFee);
+
+    // Splits the transactions into non-conflicting groups. Returns false if
+    // the set contains a transaction that must be applied serially.
+    bool partition();
+
+    std::vector<Group> const& getGroups() const;
+
+    // Applies every group using up to `threads` threads (including the
+    // calling thread) and, if no group violated its footprint, commits the
+    // combined changes into ltx and fills txMetas in transaction order.
+    // Returns false if the set has to be re-applied serially; in that case
+    // ltx is left untouched and the transaction results are restored to the
+    // state left by fee processing.
+    bool apply(AbstractLedgerTxn& ltx, std::vector<TransactionMeta>& txMetas,
+               size_t threads);
+};
+}
@@ -0,0 +1,385 @@
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "ledger/TxHistoryWriter.h"
+#include "crypto/Hex.h"
+#include "crypto/SHA.h"
+#include "database/Database.h"
+#include "ledger/LedgerHeaderUtils.h"
+#include "main/Application.h"
+#include "main/Config.h"
+#include "main/PersistentState.h"
+#include "util/Decoder.h"
+#include "util/Logging.h"
+#include "xdrpp/marshal.h"
+#include <Tracy.hpp>
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace diamnet
+{
+
+size_t const TxHistoryWriter::BATCH_ROWS = 128;
+size_t const TxHistoryWriter::MAX_PENDING_ROWS = 1024;
+
+struct TxHistoryWriter::FeeRow
+{
+    std::string mTxID;
+    uint32_t mTxIndex;
+    LedgerEntryChanges mChanges;
+};
+
+struct TxHistoryWriter::TxRow
+{
+    std::string mTxID;
+    uint32_t mTxIndex;
+    TransactionEnvelope mEnvelope;
+    TransactionResultPair mResult;
+    TransactionMeta mMeta;
+};
+
+struct TxHistoryWriter::Batch
+{
+    std::vector<FeeRow> mFeeRows;
+    std::vector<TxRow> mTxRows;
+    std::vector<LedgerHeader> mHeaders;
+
+    size_t
+    size() const
+    {
+        return mFeeRows.size() + mTxRows.size() + mHeaders.size();
+    }
+};
+
+// The pooled session and background transaction of a writer, and its insert
+// statements, set up by whichever thread writes the first batch.
+struct TxHistoryWriter::Session
+{
+    soci::session mSess;
+    soci::transaction mTx;
+    uint32_t mLedgerSeq;
+    std::string mTxID, mTxBody, mTxResult, mTxMeta, mTxChanges;
+    uint32_t mTxIndex{0};
+    std::string mHash, mPrevHash, mBucketListHash, mHeaderData;
+    uint64_t mCloseTime{0};
+    soci::statement mStTx;
+    soci::statement mStFee;
+    soci::statement mStHeader;
+
+    Session(soci::connection_pool& pool, uint32_t ledgerSeq)
+        : mSess(pool)
+        , mTx(mSess)
+        , mLedgerSeq(ledgerSeq)
+        , mStTx(mSess)
+        , mStFee(mSess)
+        , mStHeader(mSess)
+    {
+        // A previous attempt at this ledger may have committed its history
+        // without the ledger itself committing.
+        mSess << "DELETE FROM txhistory WHERE ledgerseq = :seq",
+            soci::use(mLedgerSeq);
+        mSess << "DELETE FROM txfeehistory WHERE ledgerseq = :seq",
+            soci::use(mLedgerSeq);
+        mSess << "DELETE FROM ledgerheaders WHERE ledgerseq = :seq",
+            soci::use(mLedgerSeq);
+
+        mStTx = (mSess.prepare << "INSERT INTO txhistory "
+                                  "( txid, ledgerseq, txindex,  txbody, "
+                                  "txresult, txmeta) VALUES "
+                                  "(:id,  :seq,      :txindex, :txb,   "
+                                  ":txres,   :meta)",
+                 soci::use(mTxID), soci::use(mLedgerSeq),
+                 soci::use(mTxIndex), soci::use(mTxBody),
+                 soci::use(mTxResult), soci::use(mTxMeta));
+        mStFee = (mSess.prepare << "INSERT INTO txfeehistory "
+                                   "( txid, ledgerseq, txindex,  txchanges) "
+                                   "VALUES "
+                                   "(:id,  :seq,      :txindex, :txchanges)",
+                  soci::use(mTxID), soci::use(mLedgerSeq),
+                  soci::use(mTxIndex), soci::use(mTxChanges));
+        mStHeader = (mSess.prepare << "INSERT INTO ledgerheaders "
+                                      "(ledgerhash, prevhash, bucketlisthash, "
+                                      "ledgerseq, closetime, data) VALUES "
+                                      "(:h,        :ph,      :blh, "
+                                      ":seq,      :ct,       :data)",
+                     soci::use(mHash), soci::use(mPrevHash),
+                     soci::use(mBucketListHash), soci::use(mLedgerSeq),
+                     soci::use(mCloseTime), soci::use(mHeaderData));
+    }
+
+    void
+    write(Batch const& batch)
+    {
+        ZoneScoped;
+        for (auto const& row : batch.mFeeRows)
+        {
+            mTxID = row.mTxID;
+            mTxIndex = row.mTxIndex;
+            mTxChanges =
+                decoder::encode_b64(xdr::xdr_to_opaque(row.mChanges));
+            mStFee.execute(true);
+            if (mStFee.get_affected_rows() != 1)
+            {
+                throw std::runtime_error("Could not update data in SQL");
+            }
+        }
+        for (auto const& row : batch.mTxRows)
+        {
+            mTxID = row.mTxID;
+            mTxIndex = row.mTxIndex;
+            mTxBody = decoder::encode_b64(xdr::xdr_to_opaque(row.mEnvelope));
+            mTxResult = decoder::encode_b64(xdr::xdr_to_opaque(row.mResult));
+            mTxMeta = decoder::encode_b64(xdr::xdr_to_opaque(row.mMeta));
+            mStTx.execute(true);
+            if (mStTx.get_affected_rows() != 1)
+            {
+                throw std::runtime_error("Could not update data in SQL");
+            }
+        }
+        for (auto const& header : batch.mHeaders)
+        {
+            auto headerBytes(xdr::xdr_to_opaque(header));
+            mHash = binToHex(sha256(headerBytes));
+            mPrevHash = binToHex(header.previousLedgerHash);
+            mBucketListHash = binToHex(header.bucketListHash);
+            mCloseTime = header.scpValue.closeTime;
+            mHeaderData = decoder::encode_b64(headerBytes);
+            mStHeader.execute(true);
+            if (mStHeader.get_affected_rows() != 1)
+            {
+                throw std::runtime_error("Could not update data in SQL");
+            }
+        }
+    }
+};
+
+struct TxHistoryWriter::State
+{
+    soci::connection_pool& mPool;
+    uint32_t const mLedgerSeq;
+
+    // guards the queue
+    std::mutex mMutex;
+    std::deque<Batch> mBatches;
+    size_t mQueuedRows{0};
+
+    // held while writing: batches are written one at a time, in order, and
+    // guards everything below
+    std::mutex mWriteMutex;
+    std::unique_ptr<Session> mSession;
+    std::exception_ptr mError;
+    std::chrono::nanoseconds mBusy{0};
+
+    State(soci::connection_pool& pool, uint32_t ledgerSeq)
+        : mPool(pool), mLedgerSeq(ledgerSeq)
+    {
+    }
+};
+
+bool
+TxHistoryWriter::canWriteAsync(Application& app)
+{
+    auto const& cfg = app.getConfig();
+    return cfg.MODE_STORES_HISTORY && cfg.ASYNC_TX_HISTORY_WRITES &&
+           app.getDatabase().canUsePool();
+}
+
+// The pool is created lazily and not thread-safe, so get hold of it before
+// handing it to the workers.
+TxHistoryWriter::TxHistoryWriter(Application& app, uint32_t ledgerSeq)
+    : mApp(app)
+    , mState(std::make_shared<State>(app.getDatabase().getPool(), ledgerSeq))
+    , mBatch(std::make_unique<Batch>())
+{
+}
+
+TxHistoryWriter::~TxHistoryWriter()
+{
+    // Jobs still queued find nothing to write; the last one holding the
+    // state rolls the background transaction back.
+    std::lock_guard<std::mutex> lock(mState->mMutex);
+    mState->mBatches.clear();
+}
+
+bool
+TxHistoryWriter::writeBatch(State& state)
+{
+    ZoneScoped;
+    std::lock_guard<std::mutex> writing(state.mWriteMutex);
+    Batch batch;
+    {
+        std::lock_guard<std::mutex> lock(state.mMutex);
+        if (state.mBatches.empty())
+        {
+            return false;
+        }
+        batch = std::move(state.mBatches.front());
+        state.mBatches.pop_front();
+    }
+
+    if (!state.mError)
+    {
+        auto start = std::chrono::steady_clock::now();
+        try
+        {
+            if (!state.mSession)
+            {
+                state.mSession =
+                    std::make_unique<Session>(state.mPool, state.mLedgerSeq);
+            }
+            state.mSession->write(batch);
+        }
+        catch (...)
+        {
+            state.mError = std::current_exception();
+        }
+        state.mBusy += std::chrono::steady_clock::now() - start;
+    }
+
+    std::lock_guard<std::mutex> lock(state.mMutex);
+    state.mQueuedRows -= batch.size();
+    return true;
+}
+
+void
+TxHistoryWriter::flush()
+{
+    if (mBatch->size() == 0)
+    {
+        return;
+    }
+    size_t queued;
+    {
+        std::lock_guard<std::mutex> lock(mState->mMutex);
+        mState->mQueuedRows += mBatch->size();
+        mState->mBatches.emplace_back(std::move(*mBatch));
+        queued = mState->mQueuedRows;
+    }
+    mBatch = std::make_unique<Batch>();
+
+    std::weak_ptr<State> weak(mState);
+    mApp.postOnBackgroundThread(
+        [weak]() {
+            auto state = weak.lock();
+            if (state)
+            {
+                writeBatch(*state);
+            }
+        },
+        "TxHistoryWriter");
+
+    // Rather than queue without bound while the workers are busy with
+    // something else, write here.
+    if (queued > MAX_PENDING_ROWS)
+    {
+        writeBatch(*mState);
+    }
+}
+
+void
+TxHistoryWriter::storeTransactionFee(TransactionFrameBasePtr const& tx,
+                                     LedgerEntryChanges changes,
+                                     uint32_t txIndex)
+{
+    mBatch->mFeeRows.emplace_back(
+        FeeRow{binToHex(tx->getContentsHash()), txIndex, std::move(changes)});
+    if (mBatch->size() >= BATCH_ROWS)
+    {
+        flush();
+    }
+}
+
+void
+TxHistoryWriter::storeTransaction(TransactionFrameBasePtr const& tx,
+                                  TransactionMeta tm,
+                                  TransactionResultPair const& result,
+                                  uint32_t txIndex)
+{
+    mBatch->mTxRows.emplace_back(TxRow{binToHex(tx->getContentsHash()),
+                                       txIndex, tx->getEnvelope(), result,
+                                       std::move(tm)});
+    if (mBatch->size() >= BATCH_ROWS)
+    {
+        flush();
+    }
+}
+
+void
+TxHistoryWriter::storeLedgerHeader(LedgerHeader const& header)
+{
+    if (!LedgerHeaderUtils::isValid(header) ||
+        header.ledgerSeq != mState->mLedgerSeq)
+    {
+        throw std::runtime_error("invalid ledger header (insert)");
+    }
+    mBatch->mHeaders.emplace_back(header);
+    flush();
+}
+
+std::chrono::nanoseconds
+TxHistoryWriter::commit()
+{
+    ZoneScoped;
+    // Whatever no worker got to yet is written from this thread rather than
+    // waiting for one.
+    {
+        std::lock_guard<std::mutex> lock(mState->mMutex);
+        mState->mQueuedRows += mBatch->size();
+        mState->mBatches.emplace_back(std::move(*mBatch));
+    }
+    mBatch = std::make_unique<Batch>();
+    while (writeBatch(*mState))
+    {
+    }
+
+    std::lock_guard<std::mutex> writing(mState->mWriteMutex);
+    if (mState->mError)
+    {
+        std::rethrow_exception(mState->mError);
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (!mState->mSession)
+    {
+        // no rows, but the history of an earlier attempt is still deleted
+        mState->mSession =
+            std::make_unique<Session>(mState->mPool, mState->mLedgerSeq);
+    }
+    auto& session = *mState->mSession;
+    PersistentState::setState(session.mSess,
+                              PersistentState::kHistoryWrittenLedger,
+                              std::to_string(mState->mLedgerSeq));
+    session.mTx.commit();
+    return mState->mBusy + (std::chrono::steady_clock::now() - start);
+}
+
+void
+TxHistoryWriter::recover(Application& app, uint32_t lastClosedLedgerSeq)
+{
+    ZoneScoped;
+    auto& ps = app.getPersistentState();
+    auto written = ps.getState(PersistentState::kHistoryWrittenLedger);
+    if (written.empty() || std::stoul(written) <= lastClosedLedgerSeq)
+    {
+        return;
+    }
+
+    CLOG(WARNING, "Ledger")
+        << "Transaction history was written up to ledger " << written
+        << " but LCL is " << lastClosedLedgerSeq
+        << ", discarding history and headers of the uncommitted ledgers";
+    auto& sess = app.getDatabase().getSession();
+    soci::transaction txscope(sess);
+    sess << "DELETE FROM txhistory WHERE ledgerseq > :seq",
+        soci::use(lastClosedLedgerSeq);
+    sess << "DELETE FROM txfeehistory WHERE ledgerseq > :seq",
+        soci::use(lastClosedLedgerSeq);
+    sess << "DELETE FROM ledgerheaders WHERE ledgerseq > :seq",
+        soci::use(lastClosedLedgerSeq);
+    ps.setState(PersistentState::kHistoryWrittenLedger,
+                std::to_string(lastClosedLedgerSeq));
+    txscope.commit();
+}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "transactions/TransactionFrameBase.h"
+#include "util/NonCopyable.h"
+#include "xdr/Diamnet-ledger.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+
+namespace soci
+{
+class session;
+}
+
+/*
+Background writer for the txhistory and txfeehistory rows and the ledgerheaders
+row of the ledger being closed.
+
+Those rows are never read while a ledger closes, so instead of inserting them
+on the main session as each transaction is applied (and as the header is
+sealed), the main thread groups them in batches of BATCH_ROWS and posts a job
+writing each batch through a pooled (postgres) session, concurrently with the
+rest of the close: apply, upgrades, bucket list, invariants and entry table
+writes. The jobs of a writer take turns
+on its session, in a single transaction, so no worker thread is held longer
+than it takes to write one batch.
+
+If more than MAX_PENDING_ROWS rows are waiting for a worker, the main thread
+writes a batch itself before queueing more, and commit() writes whatever no
+worker got to yet before committing the background transaction, which always
+commits before the main one and records the ledger it wrote in
+PersistentState; if the node then crashes before the main transaction
+commits, recover() finds history newer than the LCL on startup and deletes
+it, so the ledger can be closed again.
+
+The writes overlap the close they belong to but don't outlive it: the lag is
+bounded at zero ledgers. Letting them trail further would leave nothing to
+replay them from after a crash (the rows only exist in memory), and the entry
+tables can't be written this way at all, since the next ledger's apply reads
+them back through LedgerTxnRoot; those stay on the main session.
+*/
+
+namespace diamnet
+{
+class Application;
+
+class TxHistoryWriter : NonMovableOrCopyable
+{
+    struct FeeRow;
+    struct TxRow;
+    struct Batch;
+    struct Session;
+    struct State;
+    Application& mApp;
+    std::shared_ptr<State> mState;
+    // the batch being filled, by the main thread only
+    std::unique_ptr<Batch> mBatch;
+
+    // Queues mBatch and posts the job writing it.
+    void flush();
+    // Writes the oldest queued batch, if any; returns false if there was
+    // none.
+    static bool writeBatch(State& state);
+
+  public:
+    static size_t const BATCH_ROWS;
+    static size_t const MAX_PENDING_ROWS;
+
+    // True if the configuration and database allow history rows to be
+    // written by a TxHistoryWriter rather than on the main session.
+    static bool canWriteAsync(Application& app);
+
+    // Writes the rows of ledgerSeq; the background transaction starts with
+    // the first batch written.
+    TxHistoryWriter(Application& app, uint32_t ledgerSeq);
+
+    // Rolls the background transaction back if commit() wasn't called.
+    ~TxHistoryWriter();
+
+    // Queue a row, with the same contents storeTransactionFee and
+    // storeTransaction would write.
+    void storeTransactionFee(TransactionFrameBasePtr const& tx,
+                             LedgerEntryChanges changes, uint32_t txIndex);
+    void storeTransaction(TransactionFrameBasePtr const& tx,
+                          TransactionMeta tm,
+                          TransactionResultPair const& result,
+                          uint32_t txIndex);
+    // Queue the header row, as LedgerHeaderUtils::storeInDatabase would write
+    // it, and post its batch right away: it's the last row of the ledger.
+    void storeLedgerHeader(LedgerHeader const& header);
+
+    // Writes every queued row and commits the background transaction.
+    // Throws if the writer failed. Returns how long was spent writing rows
+    // and committing them.
+    std::chrono::nanoseconds commit();
+
+    // Deletes history and header rows written for ledgers after
+    // lastClosedLedgerSeq by a writer whose ledger never committed.
+    static void recover(Application& app, uint32_t lastClosedLedgerSeq);
+};
+}
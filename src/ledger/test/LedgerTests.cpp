@@ -2,14 +2,29 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "ledger/LedgerCloseTiming.h"
+#include "ledger/LedgerHeaderUtils.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/LedgerTxn.h"
+#include "ledger/ParallelTxApply.h"
+#include "ledger/TxHistoryWriter.h"
 #include "main/Application.h"
+#include "main/PersistentState.h"
+#include "test/TestAccount.h"
+#include "test/TestUtils.h"
+#include "test/TxTests.h"
 #include "test/test.h"
+#include "transactions/TransactionSQL.h"
 
+#include "medida/histogram.h"
+#include "medida/meter.h"
+#include "medida/metrics_registry.h"
+#include "medida/timer.h"
+#include <fmt/format.h>
 #include <lib/catch.hpp>
 
 using namespace diamnet;
+using namespace diamnet::txtest;
 
 TEST_CASE("cannot close ledger with unsupported ledger version", "[ledger]")
 {
@@ -43,3 +58,248 @@ TEST_CASE("cannot close ledger with unsupported ledger version", "[ledger]")
     }
     REQUIRE_THROWS_AS(applyEmptyLedger(), std::runtime_error);
 }
+
+TEST_CASE("parallel apply produces the same ledger as serial apply",
+          "[ledger][parallelapply]")
+{
+    auto closeLedgerWithThreads = [](uint32_t threads,
+                                     bool includeOffer) -> Hash {
+        VirtualClock clock;
+        auto cfg = getTestConfig(0);
+        cfg.PARALLEL_TX_APPLY_THREADS = threads;
+        auto app = createTestApplication(clock, cfg);
+        app->start();
+
+        auto root = TestAccount::createRoot(*app);
+        auto balance = app->getLedgerManager().getLastMinBalance(2) * 10;
+        std::vector<TestAccount> accounts;
+        for (int i = 0; i < 8; ++i)
+        {
+            accounts.emplace_back(
+                root.create(fmt::format("account{}", i), balance));
+        }
+        auto gateway = root.create("gateway", balance);
+        auto usd = makeAsset(gateway, "USD");
+        for (auto& account : accounts)
+        {
+            account.changeTrust(usd, INT64_MAX);
+            gateway.pay(account, usd, 1000);
+        }
+
+        // Three groups of transactions sharing accounts, two of which also
+        // contain a credit payment: those only share the (read-only) issuer.
+        DataValue value;
+        value.resize(4);
+        std::vector<TransactionFrameBasePtr> txs = {
+            accounts[0].tx({payment(accounts[1], 100)}),
+            accounts[2].tx({payment(accounts[3], 100)}),
+            accounts[4].tx({payment(accounts[5], 100),
+                            manageData("key", &value)}),
+            accounts[1].tx({payment(accounts[6], 100)}),
+            accounts[6].tx({bumpSequence(0)}),
+            accounts[3].tx({payment(accounts[2], usd, 10)}),
+            accounts[7].tx({payment(accounts[4], usd, 10)})};
+        if (includeOffer)
+        {
+            txs.emplace_back(accounts[5].tx(
+                {manageOffer(0, usd, Asset{}, Price{1, 1}, 10)}));
+        }
+
+        ParallelTxSetApplier applier(*app, txs, 100);
+        REQUIRE(applier.partition() == !includeOffer);
+        if (!includeOffer)
+        {
+            REQUIRE(applier.getGroups().size() == 3);
+        }
+
+        auto& txTimer = app->getMetrics().NewTimer(
+            {"ledger", "transaction", "apply"});
+        auto timed = txTimer.count();
+        auto r = closeLedgerOn(*app, 2, 1, 1, 2016, txs);
+        REQUIRE(r.size() == txs.size());
+        REQUIRE(txTimer.count() == timed + txs.size());
+
+        auto& parallel = app->getMetrics().NewMeter(
+            {"ledger", "apply", "parallel"}, "ledger");
+        REQUIRE(parallel.count() == (threads > 1 && !includeOffer ? 1 : 0));
+
+        // every operation is accounted for once, however it was applied
+        auto rec = app->getLedgerManager().getCloseTiming().getJson(1)[0];
+        REQUIRE(rec["operations"]["PAYMENT"]["count"].asUInt() == 6);
+        REQUIRE(rec["operations"]["BUMP_SEQUENCE"]["count"].asUInt() == 1);
+        return app->getLedgerManager().getLastClosedLedgerHeader().hash;
+    };
+
+    SECTION("independent payments")
+    {
+        REQUIRE(closeLedgerWithThreads(0, false) ==
+                closeLedgerWithThreads(4, false));
+    }
+    SECTION("tx set with order book operations")
+    {
+        REQUIRE(closeLedgerWithThreads(0, true) ==
+                closeLedgerWithThreads(4, true));
+    }
+}
+
+TEST_CASE("ledger close timings", "[ledger]")
+{
+    VirtualClock clock;
+    auto app = createTestApplication(clock, getTestConfig(0));
+    app->start();
+
+    auto root = TestAccount::createRoot(*app);
+    auto balance = app->getLedgerManager().getLastMinBalance(2) * 10;
+    auto a1 = root.create("a1", balance);
+    auto a2 = root.create("a2", balance);
+
+    auto& timing = app->getLedgerManager().getCloseTiming();
+    auto before = timing.getJson().size();
+    DataValue value;
+    value.resize(4);
+    closeLedgerOn(*app, 2, 1, 1, 2016,
+                  {a1.tx({payment(a2, 100), payment(root, 100)}),
+                   a2.tx({manageData("key", &value)})});
+    closeLedgerOn(*app, 3, 2, 1, 2016);
+
+    auto records = timing.getJson();
+    REQUIRE(records.size() == before + 2);
+    auto last = timing.getJson(1);
+    REQUIRE(last.size() == 1);
+    REQUIRE(last[0]["ledger"].asUInt() == 3);
+    REQUIRE(last[0]["txs"].asUInt() == 0);
+    REQUIRE(last[0]["operations"].empty());
+
+    auto const& rec = records[records.size() - 2];
+    REQUIRE(rec["ledger"].asUInt() == 2);
+    REQUIRE(rec["txs"].asUInt() == 2);
+    REQUIRE(rec["ops"].asUInt() == 3);
+    REQUIRE(rec["operations"]["PAYMENT"]["count"].asUInt() == 2);
+    REQUIRE(rec["operations"]["MANAGE_DATA"]["count"].asUInt() == 1);
+    REQUIRE(rec["operations"].size() == 2);
+    // each payment modifies both accounts; the data entry is new
+    REQUIRE(rec["operations"]["PAYMENT"]["entries_modified"].asUInt() == 4);
+    REQUIRE(rec["operations"]["MANAGE_DATA"]["entries_created"].asUInt() ==
+            1);
+    REQUIRE(rec["operations"]["MANAGE_DATA"]["entries_deleted"].asUInt() ==
+            0);
+
+    double phases = 0;
+    for (auto const& name : rec["phases"].getMemberNames())
+    {
+        REQUIRE(rec["phases"][name].asDouble() >= 0);
+        phases += rec["phases"][name].asDouble();
+    }
+    REQUIRE(rec["phases"].size() == LedgerCloseTiming::PHASE_COUNT + 1);
+    REQUIRE(phases == Approx(rec["total_ms"].asDouble()).epsilon(0.01));
+    REQUIRE(rec["phases"]["apply"].asDouble() >=
+            rec["operations"]["PAYMENT"]["apply_ms"].asDouble());
+
+    auto& applyTimer =
+        app->getMetrics().NewTimer({"ledger", "close", "apply"});
+    REQUIRE(applyTimer.count() >= 2);
+
+    auto& paymentTimer = app->getMetrics().NewTimer(
+        {"ledger", "operation", "payment", "apply"});
+    REQUIRE(paymentTimer.count() >= 2);
+    auto& paymentSuccess = app->getMetrics().NewMeter(
+        {"ledger", "operation-result", "payment", "payment-success"},
+        "operation");
+    REQUIRE(paymentSuccess.count() >= 2);
+    auto& dataCreated = app->getMetrics().NewHistogram(
+        {"ledger", "operation", "manage-data", "entries-created"});
+    REQUIRE(dataCreated.count() == 1);
+    REQUIRE(dataCreated.max() == 1);
+}
+
+TEST_CASE("transaction history written in the background",
+          "[ledger][txhistory]")
+{
+    SECTION("history and headers of uncommitted ledgers are discarded on "
+            "recovery")
+    {
+        VirtualClock clock;
+        auto app = createTestApplication(clock, getTestConfig(0));
+        app->start();
+        auto lcl = app->getLedgerManager().getLastClosedLedgerNum();
+        auto& ps = app->getPersistentState();
+        auto& sess = app->getDatabase().getSession();
+
+        // As left by a writer that committed ledger lcl + 1 before a crash.
+        uint32_t next = lcl + 1;
+        sess << "INSERT INTO txhistory (txid, ledgerseq, txindex, txbody, "
+                "txresult, txmeta) VALUES ('id', :seq, 1, '', '', '')",
+            soci::use(next);
+        std::string hash(64, 'a');
+        sess << "INSERT INTO ledgerheaders (ledgerhash, prevhash, "
+                "bucketlisthash, ledgerseq, closetime, data) VALUES "
+                "(:h, :h, :h, :seq, 0, '')",
+            soci::use(hash), soci::use(hash), soci::use(hash),
+            soci::use(next);
+        ps.setState(PersistentState::kHistoryWrittenLedger,
+                    std::to_string(next));
+
+        TxHistoryWriter::recover(*app, lcl);
+
+        int count = -1;
+        sess << "SELECT COUNT(*) FROM txhistory WHERE ledgerseq = :seq",
+            soci::into(count), soci::use(next);
+        REQUIRE(count == 0);
+        sess << "SELECT COUNT(*) FROM ledgerheaders WHERE ledgerseq >= :seq",
+            soci::into(count), soci::use(next);
+        REQUIRE(count == 0);
+        sess << "SELECT COUNT(*) FROM ledgerheaders WHERE ledgerseq = :seq",
+            soci::into(count), soci::use(lcl);
+        REQUIRE(count == 1);
+        REQUIRE(ps.getState(PersistentState::kHistoryWrittenLedger) ==
+                std::to_string(lcl));
+    }
+
+#ifdef USE_POSTGRES
+    SECTION("same rows as writing on the main session")
+    {
+        auto closeLedgerWithHistory = [](bool async) {
+            VirtualClock clock;
+            auto cfg = getTestConfig(0, Config::TESTDB_POSTGRESQL);
+            cfg.ASYNC_TX_HISTORY_WRITES = async;
+            cfg.TESTING_UPGRADE_MAX_TX_SET_SIZE = 1000;
+            auto app = createTestApplication(clock, cfg);
+            app->start();
+            REQUIRE(TxHistoryWriter::canWriteAsync(*app) == async);
+
+            // two rows each, so a couple of batches' worth
+            auto root = TestAccount::createRoot(*app);
+            auto balance = app->getLedgerManager().getLastMinBalance(2) * 10;
+            std::vector<TestAccount> accounts;
+            for (size_t i = 0; i < TxHistoryWriter::BATCH_ROWS; ++i)
+            {
+                accounts.emplace_back(
+                    root.create(fmt::format("a{}", i), balance));
+            }
+            std::vector<TransactionFrameBasePtr> txs;
+            for (size_t i = 0; i < accounts.size(); ++i)
+            {
+                auto& to = accounts[(i + 1) % accounts.size()];
+                txs.emplace_back(accounts[i].tx({payment(to, 100 + i)}));
+            }
+            closeLedgerOn(*app, 2, 1, 1, 2016, txs);
+
+            auto& db = app->getDatabase();
+            // the header row is written by the same writer
+            auto header =
+                LedgerHeaderUtils::loadBySequence(db, db.getSession(), 2);
+            REQUIRE(header);
+            REQUIRE(*header ==
+                    app->getLedgerManager().getLastClosedLedgerHeader().header);
+            return std::make_pair(getTransactionHistoryResults(db, 2),
+                                  getTransactionFeeMeta(db, 2));
+        };
+
+        auto sync = closeLedgerWithHistory(false);
+        auto async = closeLedgerWithHistory(true);
+        REQUIRE(sync.first.results.size() == TxHistoryWriter::BATCH_ROWS);
+        REQUIRE(sync.first == async.first);
+        REQUIRE(sync.second == async.second);
+    }
+#endif
+}
@@ -2532,6 +2532,66 @@ TEST_CASE("LedgerTxnRoot prefetch", "[ledgertxn]")
 #endif
 }
 
+TEST_CASE("LedgerTxnRoot bulk upsert", "[ledgertxn]")
+{
+    auto runTest = [&](Config::TestDbMode mode) {
+        VirtualClock clock;
+        auto cfg = getTestConfig(0, mode);
+        cfg.ENTRY_CACHE_SIZE = 0;
+        auto app = createTestApplication(clock, cfg);
+        app->start();
+        auto& root = app->getLedgerTxnRoot();
+
+        // Enough entries of every type that each upsert is split across
+        // several multi-row statements on sqlite.
+        std::unordered_map<LedgerKey, LedgerEntry> entries;
+        for (auto le : LedgerTestUtils::generateValidLedgerEntries(2000))
+        {
+            le.lastModifiedLedgerSeq = 1;
+            entries[LedgerEntryKey(le)] = le;
+        }
+
+        auto commitAndCheck = [&]() {
+            {
+                LedgerTxn ltx(root);
+                for (auto const& kv : entries)
+                {
+                    ltx.createOrUpdateWithoutLoading(kv.second);
+                }
+                ltx.commit();
+            }
+            LedgerTxn ltx(root);
+            for (auto const& kv : entries)
+            {
+                auto ltxe = ltx.load(kv.first);
+                REQUIRE(ltxe);
+                REQUIRE(ltxe.current() == kv.second);
+            }
+        };
+
+        // Insert everything, then overwrite everything through the
+        // ON CONFLICT path.
+        commitAndCheck();
+        for (auto& kv : entries)
+        {
+            kv.second = generateLedgerEntryWithSameKey(kv.second);
+        }
+        commitAndCheck();
+    };
+
+    SECTION("default")
+    {
+        runTest(Config::TESTDB_DEFAULT);
+    }
+
+#ifdef USE_POSTGRES
+    SECTION("postgresql")
+    {
+        runTest(Config::TESTDB_POSTGRESQL);
+    }
+#endif
+}
+
 TEST_CASE("Create performance benchmark", "[!hide][createbench]")
 {
     auto runTest = [&](Config::TestDbMode mode, bool loading) {
@@ -2661,6 +2721,60 @@ TEST_CASE("Erase performance benchmark", "[!hide][erasebench]")
 #endif
 }
 
+TEST_CASE("Bulk upsert benchmark", "[!hide][upsertbench]")
+{
+    auto runTest = [&](Config::TestDbMode mode) {
+        VirtualClock clock;
+        Config cfg(getTestConfig(0, mode));
+        Application::pointer app = createTestApplication(clock, cfg);
+        app->start();
+        size_t n = 0xffff, batch = 0xfff;
+
+        auto entries = LedgerTestUtils::generateValidLedgerEntries(n);
+        for (size_t i = 0; i < 2; ++i)
+        {
+            // The first pass inserts, the second updates every entry.
+            for (size_t begin = 0; begin < entries.size(); begin += batch)
+            {
+                LedgerTxn ltx(app->getLedgerTxnRoot());
+                auto end = std::min(entries.size(), begin + batch);
+                for (size_t j = begin; j < end; ++j)
+                {
+                    if (i > 0)
+                    {
+                        entries[j] = generateLedgerEntryWithSameKey(entries[j]);
+                    }
+                    ltx.createOrUpdateWithoutLoading(entries[j]);
+                }
+                ltx.commit();
+            }
+        }
+
+        for (auto const& type :
+             {"account", "trustline", "offer", "data", "claimablebalance"})
+        {
+            auto& t =
+                app->getMetrics().NewTimer({"database", "upsert", type});
+            CLOG(INFO, "Ledger")
+                << "benchmark upsert " << type << ": " << t.count()
+                << " batches, mean " << t.mean() << " ms, total " << t.sum()
+                << " ms";
+        }
+    };
+
+    SECTION("sqlite")
+    {
+        runTest(Config::TESTDB_ON_DISK_SQLITE);
+    }
+
+#ifdef USE_POSTGRES
+    SECTION("postgresql")
+    {
+        runTest(Config::TESTDB_POSTGRESQL);
+    }
+#endif
+}
+
 TEST_CASE("Bulk load batch size benchmark", "[!hide][bulkbatchsizebench]")
 {
     size_t floor = 1000;
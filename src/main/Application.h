@@ -42,10 +42,12 @@ class CommandHandler;
 class WorkScheduler;
 class BanManager;
 class StatusManager;
+class SchedulerStats;
 class AbstractLedgerTxnParent;
 
 #ifdef BUILD_TESTS
 class LoadGenerator;
+enum class LoadGenMode;
 #endif
 
 class Application;
@@ -214,6 +216,9 @@ class Application
     virtual WorkScheduler& getWorkScheduler() = 0;
     virtual BanManager& getBanManager() = 0;
     virtual StatusManager& getStatusManager() = 0;
+    // Runtimes and queue delays of the actions posted to the main thread
+    // (and postThreadSafeAction), by action name.
+    virtual SchedulerStats& getSchedulerStats() = 0;
 
     // Get the worker IO service, served by background threads. Work posted to
     // this io_context will execute in parallel with the calling thread, so use
@@ -225,6 +230,13 @@ class Application
         Scheduler::ActionType type = Scheduler::ActionType::NORMAL_ACTION) = 0;
     virtual void postOnBackgroundThread(std::function<void()>&& f,
                                         std::string jobName) = 0;
+    // Like postOnMainThread, for actions that don't need the main thread:
+    // the actions of a queue still run one at a time and in order, but on
+    // ACTION_WORKER_THREADS threads of their own when there are any, rather
+    // than competing with the main thread's work.
+    virtual void postThreadSafeAction(
+        std::function<void()>&& f, std::string&& name,
+        Scheduler::ActionType type = Scheduler::ActionType::NORMAL_ACTION) = 0;
 
     // Perform actions necessary to transition from BOOTING_STATE to other
     // states. In particular: either reload or reinitialize the database, and
@@ -254,7 +266,7 @@ class Application
 #ifdef BUILD_TESTS
     // If config.ARTIFICIALLY_GENERATE_LOAD_FOR_TESTING=true, generate some load
     // against the current application.
-    virtual void generateLoad(bool isCreate, uint32_t nAccounts,
+    virtual void generateLoad(LoadGenMode mode, uint32_t nAccounts,
                               uint32_t offset, uint32_t nTxs, uint32_t txRate,
                               uint32_t batchSize,
                               std::chrono::seconds spikeInterval,
@@ -81,6 +81,7 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
           mMetrics->NewTimer({"app", "post-on-main-thread", "delay"}))
     , mPostOnBackgroundThreadDelay(
           mMetrics->NewTimer({"app", "post-on-background-thread", "delay"}))
+    , mSchedulerStats(std::make_unique<SchedulerStats>(*mMetrics))
     , mStartedOn(clock.system_now())
 {
 #ifdef SIGQUIT
@@ -130,6 +131,7 @@ ApplicationImpl::ApplicationImpl(VirtualClock& clock, Config const& cfg)
         }};
         mWorkerThreads.emplace_back(std::move(thread));
     }
+    mVirtualClock.startActionWorkers(mConfig.ACTION_WORKER_THREADS);
 }
 
 void
@@ -553,6 +555,7 @@ ApplicationImpl::joinAllThreads()
         w.join();
     }
     LOG(DEBUG) << "Joined all " << mWorkerThreads.size() << " threads";
+    mVirtualClock.stopActionWorkers();
 }
 
 std::string
@@ -750,14 +753,14 @@ ApplicationImpl::advanceToLedgerBeforeManualCloseTarget(
 
 #ifdef BUILD_TESTS
 void
-ApplicationImpl::generateLoad(bool isCreate, uint32_t nAccounts,
+ApplicationImpl::generateLoad(LoadGenMode mode, uint32_t nAccounts,
                               uint32_t offset, uint32_t nTxs, uint32_t txRate,
                               uint32_t batchSize,
                               std::chrono::seconds spikeInterval,
                               uint32_t spikeSize)
 {
     getMetrics().NewMeter({"loadgen", "run", "start"}, "run").Mark();
-    getLoadGenerator().generateLoad(isCreate, nAccounts, offset, nTxs, txRate,
+    getLoadGenerator().generateLoad(mode, nAccounts, offset, nTxs, txRate,
                                     batchSize, spikeInterval, spikeSize);
 }
 
@@ -1014,6 +1017,12 @@ ApplicationImpl::getStatusManager()
     return *mStatusManager;
 }
 
+SchedulerStats&
+ApplicationImpl::getSchedulerStats()
+{
+    return *mSchedulerStats;
+}
+
 asio::io_context&
 ApplicationImpl::getWorkerIOContext()
 {
@@ -1026,11 +1035,38 @@ ApplicationImpl::postOnMainThread(std::function<void()>&& f, std::string&& name,
 {
     LogSlowExecution isSlow{name, LogSlowExecution::Mode::MANUAL,
                             "executed after"};
-    mVirtualClock.postAction([ this, f = std::move(f), isSlow ]() {
+    auto posted = SchedulerStats::Clock::now();
+    auto action = [ this, f = std::move(f), isSlow, name, posted ]() {
         mPostOnMainThreadDelay.Update(isSlow.checkElapsedTime());
-        f();
-    },
-                             std::move(name), type);
+        runAction(name, posted, f);
+    };
+    mVirtualClock.postAction(std::move(action), std::move(name), type);
+}
+
+void
+ApplicationImpl::postThreadSafeAction(std::function<void()>&& f,
+                                      std::string&& name,
+                                      Scheduler::ActionType type)
+{
+    LogSlowExecution isSlow{name, LogSlowExecution::Mode::MANUAL,
+                            "executed after"};
+    auto posted = SchedulerStats::Clock::now();
+    auto action = [ this, f = std::move(f), isSlow, name, posted ]() {
+        isSlow.checkElapsedTime();
+        runAction(name, posted, f);
+    };
+    mVirtualClock.postAction(std::move(action), std::move(name), type, true);
+}
+
+void
+ApplicationImpl::runAction(std::string const& name,
+                           SchedulerStats::Clock::time_point posted,
+                           std::function<void()> const& f)
+{
+    auto start = SchedulerStats::Clock::now();
+    f();
+    auto end = SchedulerStats::Clock::now();
+    mSchedulerStats->recordAction(name, start - posted, end - start, end);
 }
 
 void
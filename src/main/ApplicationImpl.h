@@ -9,6 +9,7 @@
 #include "main/PersistentState.h"
 #include "medida/timer_context.h"
 #include "util/MetricResetter.h"
+#include "util/SchedulerStats.h"
 #include "util/Timer.h"
 #include "util/optional.h"
 #include "xdr/Diamnet-ledger-entries.h"
@@ -74,10 +75,14 @@ class ApplicationImpl : public Application
     virtual WorkScheduler& getWorkScheduler() override;
     virtual BanManager& getBanManager() override;
     virtual StatusManager& getStatusManager() override;
+    virtual SchedulerStats& getSchedulerStats() override;
 
     virtual asio::io_context& getWorkerIOContext() override;
     virtual void postOnMainThread(std::function<void()>&& f, std::string&& name,
                                   Scheduler::ActionType type) override;
+    virtual void postThreadSafeAction(std::function<void()>&& f,
+                                      std::string&& name,
+                                      Scheduler::ActionType type) override;
     virtual void postOnBackgroundThread(std::function<void()>&& f,
                                         std::string jobName) override;
 
@@ -99,7 +104,7 @@ class ApplicationImpl : public Application
                 optional<TimePoint> const& manualCloseTime) override;
 
 #ifdef BUILD_TESTS
-    virtual void generateLoad(bool isCreate, uint32_t nAccounts,
+    virtual void generateLoad(LoadGenMode mode, uint32_t nAccounts,
                               uint32_t offset, uint32_t nTxs, uint32_t txRate,
                               uint32_t batchSize,
                               std::chrono::seconds spikeInterval,
@@ -190,6 +195,7 @@ class ApplicationImpl : public Application
     medida::Counter& mAppStateCurrent;
     medida::Timer& mPostOnMainThreadDelay;
     medida::Timer& mPostOnBackgroundThreadDelay;
+    std::unique_ptr<SchedulerStats> mSchedulerStats;
     VirtualClock::system_time_point mStartedOn;
 
     Hash mNetworkID;
@@ -202,6 +208,11 @@ class ApplicationImpl : public Application
 
     void enableInvariantsFromConfig();
 
+    // runs an action posted to the scheduler, recording it in mSchedulerStats
+    void runAction(std::string const& name,
+                   SchedulerStats::Clock::time_point posted,
+                   std::function<void()> const& f);
+
     virtual std::unique_ptr<Herder> createHerder();
     virtual std::unique_ptr<InvariantManager> createInvariantManager();
     virtual std::unique_ptr<OverlayManager> createOverlayManager();
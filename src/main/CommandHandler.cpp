@@ -6,6 +6,7 @@
 #include "crypto/Hex.h"
 #include "crypto/KeyUtils.h"
 #include "herder/Herder.h"
+#include "ledger/LedgerCloseTiming.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/LedgerTxn.h"
 #include "ledger/LedgerTxnEntry.h"
@@ -20,7 +21,9 @@
 #include "transactions/TransactionBridge.h"
 #include "transactions/TransactionUtils.h"
 #include "util/Logging.h"
+#include "util/SchedulerStats.h"
 #include "util/StatusManager.h"
+#include "util/ZoneStats.h"
 #include <Tracy.hpp>
 #include <fmt/format.h>
 
@@ -33,6 +36,7 @@
 #include "ExternalQueue.h"
 
 #ifdef BUILD_TESTS
+#include "simulation/LoadGenerator.h"
 #include "test/TestAccount.h"
 #include "test/TxTests.h"
 #endif
@@ -98,13 +102,16 @@ CommandHandler::CommandHandler(Application& app) : mApp(app)
     }
 
     addRoute("clearmetrics", &CommandHandler::clearMetrics);
+    addRoute("closetimings", &CommandHandler::closeTimings);
     addRoute("info", &CommandHandler::info);
     addRoute("ll", &CommandHandler::ll);
     addRoute("logrotate", &CommandHandler::logRotate);
     addRoute("manualclose", &CommandHandler::manualClose);
     addRoute("metrics", &CommandHandler::metrics);
+    addRoute("schedulerstats", &CommandHandler::schedulerStats);
     addRoute("tx", &CommandHandler::tx);
     addRoute("upgrades", &CommandHandler::upgrades);
+    addRoute("zonestats", &CommandHandler::zoneStats);
 
 #ifdef BUILD_TESTS
     addRoute("generateload", &CommandHandler::generateLoad);
@@ -292,6 +299,33 @@ CommandHandler::metrics(std::string const& params, std::string& retStr)
     retStr = jr.Report();
 }
 
+void
+CommandHandler::schedulerStats(std::string const& params, std::string& retStr)
+{
+    ZoneScoped;
+    auto root = mApp.getSchedulerStats().getJson();
+    root["queue_size"] =
+        static_cast<Json::UInt64>(mApp.getClock().getActionQueueSize());
+    root["overloaded"] = mApp.getClock().actionQueueIsOverloaded();
+    retStr = root.toStyledString();
+}
+
+void
+CommandHandler::zoneStats(std::string const& params, std::string& retStr)
+{
+    ZoneScoped;
+    std::map<std::string, std::string> map;
+    http::server::server::parseParams(params, map);
+
+    retStr = ZoneStats::getJson().toStyledString();
+
+    auto clear = map.find("clear");
+    if (clear != map.end() && clear->second == "true")
+    {
+        ZoneStats::clear();
+    }
+}
+
 void
 CommandHandler::logRotate(std::string const& params, std::string& retStr)
 {
@@ -739,6 +773,20 @@ CommandHandler::clearMetrics(std::string const& params, std::string& retStr)
     retStr = fmt::format("Cleared {} metrics!", domain);
 }
 
+void
+CommandHandler::closeTimings(std::string const& params, std::string& retStr)
+{
+    ZoneScoped;
+    std::map<std::string, std::string> map;
+    http::server::server::parseParams(params, map);
+
+    size_t n = SIZE_MAX;
+    maybeParseParam(map, "n", n);
+
+    auto root = mApp.getLedgerManager().getCloseTiming().getJson(n);
+    retStr = root.toStyledString();
+}
+
 void
 CommandHandler::surveyTopology(std::string const& params, std::string& retStr)
 {
@@ -798,20 +846,9 @@ CommandHandler::generateLoad(std::string const& params, std::string& retStr)
         std::map<std::string, std::string> map;
         http::server::server::parseParams(params, map);
 
-        bool isCreate;
         maybeParseParam<std::string>(map, "mode", mode);
-        if (mode == std::string("create"))
-        {
-            isCreate = true;
-        }
-        else if (mode == std::string("pay"))
-        {
-            isCreate = false;
-        }
-        else
-        {
-            throw std::runtime_error("Unknown mode.");
-        }
+        auto loadGenMode = LoadGenerator::getMode(mode);
+        bool isCreate = loadGenMode == LoadGenMode::CREATE;
 
         maybeParseParam(map, "accounts", nAccounts);
         maybeParseParam(map, "txs", nTxs);
@@ -831,8 +868,8 @@ CommandHandler::generateLoad(std::string const& params, std::string& retStr)
             retStr = "Setting batch size to its limit of 100.";
         }
 
-        mApp.generateLoad(isCreate, nAccounts, offset, nTxs, txRate, batchSize,
-                          spikeInterval, spikeSize);
+        mApp.generateLoad(loadGenMode, nAccounts, offset, nTxs, txRate,
+                          batchSize, spikeInterval, spikeSize);
 
         retStr += fmt::format(" Generating load: {:d} {:s}, {:d} tx/s",
                               numItems, itemType, txRate);
@@ -13,6 +13,7 @@
 #include "main/DiamnetCoreVersion.h"
 #include "scp/LocalNode.h"
 #include "scp/QuorumSetUtils.h"
+#include "simulation/LoadGenerator.h"
 #include "util/Fs.h"
 #include "util/Logging.h"
 #include "util/XDROperators.h"
@@ -110,9 +111,17 @@ Config::Config() : NODE_SEED(SecretKey::random())
     MANUAL_CLOSE = false;
     CATCHUP_COMPLETE = false;
     CATCHUP_RECENT = 0;
+    CATCHUP_LOOKAHEAD_CHECKPOINTS = 16;
     AUTOMATIC_MAINTENANCE_PERIOD = std::chrono::seconds{14400};
     AUTOMATIC_MAINTENANCE_COUNT = 50000;
     ARTIFICIALLY_GENERATE_LOAD_FOR_TESTING = false;
+    LOADGEN_DEX_ASSETS = 3;
+    LOADGEN_DEX_OFFERS_PER_PAIR = 2;
+    LOADGEN_MIX = {{LoadGenMode::PAY, 50},
+                   {LoadGenMode::PATH_PAY, 20},
+                   {LoadGenMode::OFFER, 10},
+                   {LoadGenMode::CLAIMABLE_BALANCE, 10},
+                   {LoadGenMode::SPONSORSHIP, 10}};
     ARTIFICIALLY_ACCELERATE_TIME_FOR_TESTING = false;
     ARTIFICIALLY_SET_CLOSE_TIME_FOR_TESTING = 0;
     ARTIFICIALLY_PESSIMIZE_MERGES_FOR_TESTING = false;
@@ -174,14 +183,24 @@ Config::Config() : NODE_SEED(SecretKey::random())
     //
     // Worst case = 10 concurrent merges + 1 quorum intersection calculation.
     WORKER_THREADS = 11;
+    ACTION_WORKER_THREADS = 2;
     MAX_CONCURRENT_SUBPROCESSES = 16;
+    MAX_HISTORY_ARCHIVE_CONNECTIONS = 16;
+    MAX_CONCURRENT_PUBLISHES = 4;
+    GZIP_PARALLEL_BLOCKS = 4;
     NODE_IS_VALIDATOR = false;
     QUORUM_INTERSECTION_CHECKER = true;
+    QUORUM_INTERSECTION_CHECKER_THREADS = 4;
     DATABASE = SecretValue{"sqlite3://:memory:"};
 
     ENTRY_CACHE_SIZE = 100000;
     BEST_OFFERS_CACHE_SIZE = 64;
     PREFETCH_BATCH_SIZE = 1000;
+    PARALLEL_TX_APPLY_THREADS = 0;
+    INVARIANT_CHECK_THREADS = 0;
+    INVARIANT_BUCKET_SAMPLE_PERCENT = 100;
+    ASYNC_TX_HISTORY_WRITES = false;
+    TX_HISTORY_SEGMENT_PATH = "";
 
 #ifdef BUILD_TESTS
     TEST_CASES_ENABLED = false;
@@ -250,6 +269,61 @@ readInt(ConfigItem const& item, T min = std::numeric_limits<T>::min(),
     }
     return static_cast<T>(v);
 }
+
+// "mode=weight" strings, leaving out the modes of weight 0.
+std::vector<std::pair<LoadGenMode, uint32_t>>
+parseLoadGenMix(ConfigItem const& item)
+{
+    std::vector<std::pair<LoadGenMode, uint32_t>> mix;
+    std::set<LoadGenMode> seen;
+    uint64_t total = 0;
+    for (auto const& entry : readStringArray(item))
+    {
+        auto eq = entry.find('=');
+        if (eq == std::string::npos || eq + 1 == entry.size() ||
+            entry.find_first_not_of("0123456789", eq + 1) !=
+                std::string::npos ||
+            entry.size() - eq - 1 > 6)
+        {
+            throw std::invalid_argument(fmt::format(
+                "{} entry '{}' is not mode=weight", item.first, entry));
+        }
+        LoadGenMode mode;
+        try
+        {
+            mode = LoadGenerator::getMode(entry.substr(0, eq));
+        }
+        catch (std::runtime_error const&)
+        {
+            throw std::invalid_argument(fmt::format(
+                "{} entry '{}' has an unknown mode", item.first, entry));
+        }
+        if (mode == LoadGenMode::CREATE || mode == LoadGenMode::MIXED)
+        {
+            throw std::invalid_argument(
+                fmt::format("{} cannot include mode {}", item.first,
+                            LoadGenerator::getModeName(mode)));
+        }
+        if (!seen.insert(mode).second)
+        {
+            throw std::invalid_argument(
+                fmt::format("{} includes mode {} twice", item.first,
+                            LoadGenerator::getModeName(mode)));
+        }
+        auto weight = static_cast<uint32_t>(std::stoul(entry.substr(eq + 1)));
+        if (weight > 0)
+        {
+            mix.emplace_back(mode, weight);
+            total += weight;
+        }
+    }
+    if (total == 0)
+    {
+        throw std::invalid_argument(fmt::format(
+            "{} must give some mode a nonzero weight", item.first));
+    }
+    return mix;
+}
 }
 
 void
@@ -333,10 +407,11 @@ Config::loadQset(std::shared_ptr<cpptoml::table> group, SCPQuorumSet& qset,
 
 void
 Config::addHistoryArchive(std::string const& name, std::string const& get,
-                          std::string const& put, std::string const& mkdir)
+                          std::string const& put, std::string const& mkdir,
+                          std::string const& url)
 {
     auto r = HISTORY.insert(std::make_pair(
-        name, HistoryArchiveConfiguration{name, get, put, mkdir}));
+        name, HistoryArchiveConfiguration{name, get, put, mkdir, url}));
     if (!r.second)
     {
         throw std::invalid_argument(
@@ -735,10 +810,26 @@ Config::processConfig(std::shared_ptr<cpptoml::table> t)
             {
                 CATCHUP_RECENT = readInt<uint32_t>(item, 0, UINT32_MAX - 1);
             }
+            else if (item.first == "CATCHUP_LOOKAHEAD_CHECKPOINTS")
+            {
+                CATCHUP_LOOKAHEAD_CHECKPOINTS = readInt<uint32_t>(item, 1);
+            }
             else if (item.first == "ARTIFICIALLY_GENERATE_LOAD_FOR_TESTING")
             {
                 ARTIFICIALLY_GENERATE_LOAD_FOR_TESTING = readBool(item);
             }
+            else if (item.first == "LOADGEN_DEX_ASSETS")
+            {
+                LOADGEN_DEX_ASSETS = readInt<uint32_t>(item, 1, 10);
+            }
+            else if (item.first == "LOADGEN_DEX_OFFERS_PER_PAIR")
+            {
+                LOADGEN_DEX_OFFERS_PER_PAIR = readInt<uint32_t>(item, 1, 5);
+            }
+            else if (item.first == "LOADGEN_MIX")
+            {
+                LOADGEN_MIX = parseLoadGenMix(item);
+            }
             else if (item.first == "ARTIFICIALLY_ACCELERATE_TIME_FOR_TESTING")
             {
                 ARTIFICIALLY_ACCELERATE_TIME_FOR_TESTING = readBool(item);
@@ -887,10 +978,26 @@ Config::processConfig(std::shared_ptr<cpptoml::table> t)
             {
                 WORKER_THREADS = readInt<int>(item, 1, 1000);
             }
+            else if (item.first == "ACTION_WORKER_THREADS")
+            {
+                ACTION_WORKER_THREADS = readInt<int>(item, 0, 1000);
+            }
             else if (item.first == "MAX_CONCURRENT_SUBPROCESSES")
             {
                 MAX_CONCURRENT_SUBPROCESSES = readInt<int>(item, 1);
             }
+            else if (item.first == "MAX_HISTORY_ARCHIVE_CONNECTIONS")
+            {
+                MAX_HISTORY_ARCHIVE_CONNECTIONS = readInt<int>(item, 1);
+            }
+            else if (item.first == "MAX_CONCURRENT_PUBLISHES")
+            {
+                MAX_CONCURRENT_PUBLISHES = readInt<uint32_t>(item, 1);
+            }
+            else if (item.first == "GZIP_PARALLEL_BLOCKS")
+            {
+                GZIP_PARALLEL_BLOCKS = readInt<int>(item, 1, 1000);
+            }
             else if (item.first == "MINIMUM_IDLE_PERCENT")
             {
                 MINIMUM_IDLE_PERCENT = readInt<uint32_t>(item, 0, 100);
@@ -899,6 +1006,11 @@ Config::processConfig(std::shared_ptr<cpptoml::table> t)
             {
                 QUORUM_INTERSECTION_CHECKER = readBool(item);
             }
+            else if (item.first == "QUORUM_INTERSECTION_CHECKER_THREADS")
+            {
+                QUORUM_INTERSECTION_CHECKER_THREADS =
+                    readInt<int>(item, 1, 1000);
+            }
             else if (item.first == "HISTORY")
             {
                 auto hist = item.second->as_table();
@@ -913,7 +1025,7 @@ Config::processConfig(std::shared_ptr<cpptoml::table> t)
                             throw std::invalid_argument(
                                 "malformed HISTORY config block");
                         }
-                        std::string get, put, mkdir;
+                        std::string get, put, mkdir, url;
                         for (auto const& c : *tab)
                         {
                             if (c.first == "get")
@@ -928,6 +1040,10 @@ Config::processConfig(std::shared_ptr<cpptoml::table> t)
                             {
                                 mkdir = c.second->as<std::string>()->get();
                             }
+                            else if (c.first == "url")
+                            {
+                                url = c.second->as<std::string>()->get();
+                            }
                             else
                             {
                                 std::string err(
@@ -938,7 +1054,8 @@ Config::processConfig(std::shared_ptr<cpptoml::table> t)
                                 throw std::invalid_argument(err);
                             }
                         }
-                        addHistoryArchive(archive.first, get, put, mkdir);
+                        addHistoryArchive(archive.first, get, put, mkdir,
+                                          url);
                     }
                 }
                 else
@@ -958,6 +1075,15 @@ Config::processConfig(std::shared_ptr<cpptoml::table> t)
             {
                 INVARIANT_CHECKS = readStringArray(item);
             }
+            else if (item.first == "INVARIANT_CHECK_THREADS")
+            {
+                INVARIANT_CHECK_THREADS = readInt<uint32_t>(item, 0, 1000);
+            }
+            else if (item.first == "INVARIANT_BUCKET_SAMPLE_PERCENT")
+            {
+                INVARIANT_BUCKET_SAMPLE_PERCENT =
+                    readInt<uint32_t>(item, 0, 100);
+            }
             else if (item.first == "ENTRY_CACHE_SIZE")
             {
                 ENTRY_CACHE_SIZE = readInt<uint32_t>(item);
@@ -970,6 +1096,18 @@ Config::processConfig(std::shared_ptr<cpptoml::table> t)
             {
                 PREFETCH_BATCH_SIZE = readInt<uint32_t>(item);
             }
+            else if (item.first == "PARALLEL_TX_APPLY_THREADS")
+            {
+                PARALLEL_TX_APPLY_THREADS = readInt<uint32_t>(item, 0, 1000);
+            }
+            else if (item.first == "ASYNC_TX_HISTORY_WRITES")
+            {
+                ASYNC_TX_HISTORY_WRITES = readBool(item);
+            }
+            else if (item.first == "TX_HISTORY_SEGMENT_PATH")
+            {
+                TX_HISTORY_SEGMENT_PATH = readString(item);
+            }
             else if (item.first == "MAXIMUM_LEDGER_CLOSETIME_DRIFT")
             {
                 MAXIMUM_LEDGER_CLOSETIME_DRIFT = readInt<int64_t>(item, 0);
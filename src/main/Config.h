@@ -19,12 +19,17 @@
 
 namespace diamnet
 {
+enum class LoadGenMode;
+
 struct HistoryArchiveConfiguration
 {
     std::string mName;
     std::string mGetCmd;
     std::string mPutCmd;
     std::string mMkdirCmd;
+    // http:// or file:// location of the archive, transferred to and from
+    // in-process in preference to running the commands above
+    std::string mURL;
 };
 
 enum class ValidationThresholdLevels : int
@@ -71,7 +76,8 @@ class Config : public std::enable_shared_from_this<Config>
     void addValidatorName(std::string const& pubKeyStr,
                           std::string const& name);
     void addHistoryArchive(std::string const& name, std::string const& get,
-                           std::string const& put, std::string const& mkdir);
+                           std::string const& put, std::string const& mkdir,
+                           std::string const& url = "");
 
     std::string toString(ValidatorQuality q) const;
     ValidatorQuality parseQuality(std::string const& q) const;
@@ -146,6 +152,10 @@ class Config : public std::enable_shared_from_this<Config>
     // If you want, say, a week of history, set this to 120000.
     uint32_t CATCHUP_RECENT;
 
+    // Number of checkpoints replayed by catchup whose transactions may be
+    // downloaded (and on disk) ahead of the checkpoint being applied.
+    uint32_t CATCHUP_LOOKAHEAD_CHECKPOINTS;
+
     // Interval between automatic maintenance executions
     std::chrono::seconds AUTOMATIC_MAINTENANCE_PERIOD;
 
@@ -159,6 +169,17 @@ class Config : public std::enable_shared_from_this<Config>
     // production networks.
     bool ARTIFICIALLY_GENERATE_LOAD_FOR_TESTING;
 
+    // The order book of the pathpay and offer load generation modes: the
+    // number of assets issued for it, and of offers placed each way between
+    // every two of those assets and native.
+    uint32_t LOADGEN_DEX_ASSETS;
+    uint32_t LOADGEN_DEX_OFFERS_PER_PAIR;
+
+    // The modes the mixed load generation mode picks from, with their
+    // weights; a mode is picked for each transaction with a probability
+    // proportional to its weight. Configured as "mode=weight" strings.
+    std::vector<std::pair<LoadGenMode, uint32_t>> LOADGEN_MIX;
+
     // A config parameter that reduces ledger close time to 1s and checkpoint
     // frequency to every 8 ledgers. Do not ever set this in production, as it
     // will make your history archives incompatible with those of anyone else.
@@ -339,10 +360,24 @@ class Config : public std::enable_shared_from_this<Config>
 
     // thread-management config
     int WORKER_THREADS;
+    // Threads running the actions posted by postThreadSafeAction; with 0,
+    // they run on the main thread.
+    int ACTION_WORKER_THREADS;
 
     // process-management config
     int MAX_CONCURRENT_SUBPROCESSES;
 
+    // Maximum number of keep-alive connections open to each history archive
+    // read over http.
+    int MAX_HISTORY_ARCHIVE_CONNECTIONS;
+
+    // Number of queued checkpoints published at once.
+    uint32_t MAX_CONCURRENT_PUBLISHES;
+
+    // Number of blocks of a large history file compressed in parallel, on
+    // worker threads, when publishing; 1 compresses every file as one stream.
+    int GZIP_PARALLEL_BLOCKS;
+
     // SCP config
     SecretKey NODE_SEED;
     bool NODE_IS_VALIDATOR;
@@ -353,9 +388,22 @@ class Config : public std::enable_shared_from_this<Config>
     // Whether to run online quorum intersection checks.
     bool QUORUM_INTERSECTION_CHECKER;
 
+    // Number of threads a quorum intersection check spreads its search over.
+    int QUORUM_INTERSECTION_CHECKER_THREADS;
+
     // Invariants
     std::vector<std::string> INVARIANT_CHECKS;
 
+    // Number of worker-thread jobs checking invariants on the operations of a
+    // closing ledger while the main thread goes on applying them; the close
+    // waits for the checks before committing. 0 checks every operation as it
+    // is applied.
+    uint32_t INVARIANT_CHECK_THREADS;
+
+    // Percentage, between 0 and 100, of the entries of an applied bucket that
+    // BucketListIsConsistentWithDatabase compares to the database.
+    uint32_t INVARIANT_BUCKET_SAMPLE_PERCENT;
+
     std::map<std::string, std::string> VALIDATOR_NAMES;
 
     // History config
@@ -382,6 +430,21 @@ class Config : public std::enable_shared_from_this<Config>
     // the entry cache
     size_t PREFETCH_BATCH_SIZE;
 
+    // Number of threads (including the main thread) used to apply
+    // transaction sets that can be split into independent groups. 0 or 1
+    // applies every transaction serially on the main thread.
+    uint32_t PARALLEL_TX_APPLY_THREADS;
+
+    // If set, and the database offers a connection pool (postgres), the
+    // txhistory, txfeehistory and ledgerheaders rows of a closing ledger are
+    // written by a background TxHistoryWriter instead of on the main session.
+    bool ASYNC_TX_HISTORY_WRITES;
+
+    // If set, the transaction history of closed ledgers is stored in
+    // per-checkpoint segment files in this directory (see TxHistorySegments)
+    // instead of the txhistory and txfeehistory tables.
+    std::string TX_HISTORY_SEGMENT_PATH;
+
 #ifdef BUILD_TESTS
     // If set to true, the application will be aware this run is for a test
     // case.  This is used right now in the signal handler to exit() instead of
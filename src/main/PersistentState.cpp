@@ -18,7 +18,8 @@ using namespace std;
 
 std::string PersistentState::mapping[kLastEntry] = {
     "lastclosedledger", "historyarchivestate", "lastscpdata",
-    "databaseschema",   "networkpassphrase",   "ledgerupgrades"};
+    "databaseschema",   "networkpassphrase",   "ledgerupgrades",
+    "historywrittenledger"};
 
 std::string PersistentState::kSQLCreateStatement =
     "CREATE TABLE IF NOT EXISTS storestate ("
@@ -66,7 +67,20 @@ PersistentState::setState(PersistentState::Entry entry,
                           std::string const& value)
 {
     ZoneScoped;
-    updateDb(getStoreStateName(entry), value);
+    auto timer = mApp.getDatabase().getUpsertTimer("state");
+    updateDb(mApp.getDatabase().getSession(), getStoreStateName(entry), value);
+}
+
+void
+PersistentState::setState(soci::session& sess, PersistentState::Entry entry,
+                          std::string const& value)
+{
+    ZoneScoped;
+    if (entry < 0 || entry >= kLastEntry || entry == kLastSCPData)
+    {
+        throw out_of_range("unknown entry");
+    }
+    updateDb(sess, mapping[entry], value);
 }
 
 std::vector<std::string>
@@ -93,34 +107,27 @@ PersistentState::setSCPStateForSlot(uint64 slot, std::string const& value)
     ZoneScoped;
     auto slotIdx = static_cast<uint32>(
         slot % (mApp.getConfig().MAX_SLOTS_TO_REMEMBER + 1));
-    updateDb(getStoreStateName(kLastSCPData, slotIdx), value);
+    auto timer = mApp.getDatabase().getUpsertTimer("state");
+    updateDb(mApp.getDatabase().getSession(),
+             getStoreStateName(kLastSCPData, slotIdx), value);
 }
 
 void
-PersistentState::updateDb(std::string const& entry, std::string const& value)
+PersistentState::updateDb(soci::session& sess, std::string const& entry,
+                          std::string const& value)
 {
     ZoneScoped;
-    auto prep = mApp.getDatabase().getPreparedStatement(
-        "UPDATE storestate SET state = :v WHERE statename = :n;");
-
-    auto& st = prep.statement();
-    st.exchange(soci::use(value));
-    st.exchange(soci::use(entry));
-    st.define_and_bind();
-    {
-        auto timer = mApp.getDatabase().getUpdateTimer("state");
-        st.execute(true);
-    }
-
-    if (st.get_affected_rows() != 1 && getFromDb(entry).empty())
+    soci::statement st =
+        (sess.prepare << "UPDATE storestate SET state = :v WHERE statename = "
+                         ":n;",
+         soci::use(value), soci::use(entry));
+    st.execute(true);
+    if (st.get_affected_rows() != 1)
     {
-        auto timer = mApp.getDatabase().getInsertTimer("state");
-        auto prep2 = mApp.getDatabase().getPreparedStatement(
-            "INSERT INTO storestate (statename, state) VALUES (:n, :v);");
-        auto& st2 = prep2.statement();
-        st2.exchange(soci::use(entry));
-        st2.exchange(soci::use(value));
-        st2.define_and_bind();
+        soci::statement st2 =
+            (sess.prepare << "INSERT INTO storestate (statename, state) "
+                             "VALUES (:n, :v);",
+             soci::use(entry), soci::use(value));
         st2.execute(true);
         if (st2.get_affected_rows() != 1)
         {
@@ -7,6 +7,11 @@
 #include "main/Application.h"
 #include <string>
 
+namespace soci
+{
+class session;
+}
+
 namespace diamnet
 {
 
@@ -23,6 +28,7 @@ class PersistentState
         kDatabaseSchema,
         kNetworkPassphrase,
         kLedgerUpgrades,
+        kHistoryWrittenLedger,
         kLastEntry,
     };
 
@@ -31,6 +37,11 @@ class PersistentState
     std::string getState(Entry stateName);
     void setState(Entry stateName, std::string const& value);
 
+    // Sets an entry through `sess` instead of the main session, for state
+    // that has to commit together with work done on a pooled session.
+    static void setState(soci::session& sess, Entry stateName,
+                         std::string const& value);
+
     // Special methods for SCP state (multiple slots)
     std::vector<std::string> getSCPStateAllSlots();
     void setSCPStateForSlot(uint64 slot, std::string const& value);
@@ -42,7 +53,9 @@ class PersistentState
     Application& mApp;
 
     std::string getStoreStateName(Entry n, uint32 subscript = 0);
-    void updateDb(std::string const& entry, std::string const& value);
+    // Upserts an entry through `sess`, the main session or a pooled one.
+    static void updateDb(soci::session& sess, std::string const& entry,
+                         std::string const& value);
     std::string getFromDb(std::string const& entry);
 };
 }
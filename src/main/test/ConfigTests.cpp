@@ -7,6 +7,7 @@
 #include "lib/catch.hpp"
 #include "main/Config.h"
 #include "scp/QuorumSetUtils.h"
+#include "simulation/LoadGenerator.h"
 #include "test/test.h"
 #include <fmt/format.h>
 
@@ -440,3 +441,28 @@ VALIDATORS=[
         quorumSetNumber += ".1";
     }
 }
+
+TEST_CASE("load generation mix", "[config]")
+{
+    auto load = [](std::string const& mix) {
+        Config c;
+        std::stringstream ss("LOADGEN_MIX=" + mix);
+        c.load(ss);
+        return c.LOADGEN_MIX;
+    };
+
+    auto mix = load(R"(["pay=3", "offer=0", "sponsorship=1"])");
+    REQUIRE(mix.size() == 2);
+    REQUIRE(mix[0] == std::make_pair(LoadGenMode::PAY, 3u));
+    REQUIRE(mix[1] == std::make_pair(LoadGenMode::SPONSORSHIP, 1u));
+
+    REQUIRE_THROWS(load(R"(["pay"])"));
+    REQUIRE_THROWS(load(R"(["pay="])"));
+    REQUIRE_THROWS(load(R"(["pay=-1"])"));
+    REQUIRE_THROWS(load(R"(["pay=1000000"])"));
+    REQUIRE_THROWS(load(R"(["payments=1"])"));
+    REQUIRE_THROWS(load(R"(["create=1"])"));
+    REQUIRE_THROWS(load(R"(["mixed=1"])"));
+    REQUIRE_THROWS(load(R"(["pay=1", "pay=2"])"));
+    REQUIRE_THROWS(load(R"(["pay=0"])"));
+}
@@ -40,11 +40,13 @@ void
 Floodgate::clearBelow(uint32_t currentLedger)
 {
     ZoneScoped;
-    for (auto it = mFloodMap.cbegin(); it != mFloodMap.cend();)
+    auto expired = std::make_shared<std::vector<FloodRecord::pointer>>();
+    for (auto it = mFloodMap.begin(); it != mFloodMap.end();)
     {
         // give one ledger of leeway
         if (it->second->mLedgerSeq + 10 < currentLedger)
         {
+            expired->emplace_back(std::move(it->second));
             it = mFloodMap.erase(it);
         }
         else
@@ -53,6 +55,14 @@ Floodgate::clearBelow(uint32_t currentLedger)
         }
     }
     mFloodMapSize.set_count(mFloodMap.size());
+
+    // Records hold whole messages: a ledger's worth of transactions is
+    // released off the main thread, the records being ours alone by now.
+    if (!expired->empty())
+    {
+        mApp.postThreadSafeAction([expired]() { expired->clear(); },
+                                  "Floodgate: release records");
+    }
 }
 
 bool
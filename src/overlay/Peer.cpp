@@ -609,6 +609,12 @@ Peer::recvMessage(DiamnetMessage const& diamnetMsg)
         cat = "SCP";
         break;
 
+    // signatures checked off the main thread first
+    case SURVEY_REQUEST:
+    case SURVEY_RESPONSE:
+        cat = "SURVEY";
+        break;
+
     default:
         cat = "MISC";
     }
@@ -618,7 +624,7 @@ Peer::recvMessage(DiamnetMessage const& diamnetMsg)
         fmt::format("Error RecvMessage T:{} cat:{} {} @{}", diamnetMsg.type(),
                     cat, toString(), mApp.getConfig().PEER_PORT);
 
-    mApp.postOnMainThread([ err, weak, sm = DiamnetMessage(diamnetMsg) ]() {
+    auto recv = [ err, weak, sm = DiamnetMessage(diamnetMsg) ]() {
         auto self = weak.lock();
         if (self)
         {
@@ -639,8 +645,26 @@ Peer::recvMessage(DiamnetMessage const& diamnetMsg)
         {
             CLOG(TRACE, "Overlay") << err;
         }
-    },
-                          fmt::format("{} recvMessage", cat), type);
+    };
+    auto name = fmt::format("{} recvMessage", cat);
+
+    if (diamnetMsg.type() == SURVEY_REQUEST ||
+        diamnetMsg.type() == SURVEY_RESPONSE)
+    {
+        // The signature check, the costly part of handling a survey message,
+        // runs on a thread-safe queue and leaves its result in the signature
+        // cache for relayOrProcess* to find on the main thread.
+        auto& app = mApp;
+        mApp.postThreadSafeAction(
+            [&app, recv, name, type, sm = DiamnetMessage(diamnetMsg) ]() {
+                SurveyManager::checkSignature(app.getConfig(), sm);
+                auto r = recv;
+                app.postOnMainThread(std::move(r), std::string(name), type);
+            },
+            "SURVEY checkSignature");
+        return;
+    }
+    mApp.postOnMainThread(std::move(recv), std::move(name), type);
 }
 
 void
@@ -957,12 +981,16 @@ Peer::recvSCPMessage(DiamnetMessage const& msg)
     Hash msgID;
     mApp.getOverlayManager().recvFloodedMsgID(msg, shared_from_this(), msgID);
 
-    auto res = mApp.getHerder().recvSCPEnvelope(envelope);
-    if (res == Herder::ENVELOPE_STATUS_DISCARDED)
-    {
-        // the message was discarded, remove it from the floodmap as well
-        mApp.getOverlayManager().forgetFloodedMsg(msgID);
-    }
+    auto& app = mApp;
+    mApp.getHerder().recvUnverifiedSCPEnvelope(
+        envelope, [&app, msgID](Herder::EnvelopeStatus res) {
+            if (res == Herder::ENVELOPE_STATUS_DISCARDED)
+            {
+                // the message was discarded, remove it from the floodmap as
+                // well
+                app.getOverlayManager().forgetFloodedMsg(msgID);
+            }
+        });
 }
 
 void
@@ -204,6 +204,34 @@ SurveyManager::relayOrProcessRequest(DiamnetMessage const& msg,
     }
 }
 
+void
+SurveyManager::checkSignature(Config const& cfg, DiamnetMessage const& msg)
+{
+    if (msg.type() == SURVEY_REQUEST)
+    {
+        auto const& signedRequest = msg.signedSurveyRequestMessage();
+        auto const& request = signedRequest.request;
+        // skip requests relayOrProcessRequest turns down before checking
+        // (the tracked quorum is left to it, being main-thread state)
+        if (!cfg.SURVEYOR_KEYS.empty() &&
+            cfg.SURVEYOR_KEYS.count(request.surveyorPeerID) == 0)
+        {
+            return;
+        }
+        PubKeyUtils::verifySig(request.surveyorPeerID,
+                               signedRequest.requestSignature,
+                               xdr::xdr_to_opaque(request));
+    }
+    else if (msg.type() == SURVEY_RESPONSE)
+    {
+        auto const& signedResponse = msg.signedSurveyResponseMessage();
+        auto const& response = signedResponse.response;
+        PubKeyUtils::verifySig(response.surveyedPeerID,
+                               signedResponse.responseSignature,
+                               xdr::xdr_to_opaque(response));
+    }
+}
+
 void
 SurveyManager::sendTopologyRequest(NodeID const& nodeToSurvey) const
 {
@@ -14,6 +14,7 @@
 namespace diamnet
 {
 class Application;
+class Config;
 
 class SurveyManager : public std::enable_shared_from_this<SurveyManager>,
                       public NonMovableOrCopyable
@@ -38,6 +39,11 @@ class SurveyManager : public std::enable_shared_from_this<SurveyManager>,
 
     static std::string getMsgSummary(DiamnetMessage const& msg);
 
+    // Verifies the signature of a survey request or response, as
+    // relayOrProcess* would, so that they find the result in the signature
+    // cache. Touches nothing but its arguments: safe off the main thread.
+    static void checkSignature(Config const& cfg, DiamnetMessage const& msg);
+
   private:
     // topology specific methods
     void sendTopologyRequest(NodeID const& nodeToSurvey) const;
@@ -1385,8 +1385,8 @@ hasVBlockingSubsetStrictlyAheadOf(
     std::shared_ptr<LocalNode> localNode,
     std::map<NodeID, SCPEnvelopeWrapperPtr> const& map, uint32_t n)
 {
-    return LocalNode::isVBlocking(
-        localNode->getQuorumSet(), map,
+    return localNode->isVBlocking(
+        map,
         [&](SCPStatement const& st) { return statementBallotCounter(st) > n; });
 }
 
@@ -2204,10 +2204,8 @@ BallotProtocol::checkHeardFromQuorum()
     if (mCurrentBallot)
     {
         ZoneScoped;
-        if (LocalNode::isQuorum(
-                getLocalNode()->getQuorumSet(), mLatestEnvelopes,
-                std::bind(&Slot::getQuorumSetFromStatement, &mSlot, _1),
-                [&](SCPStatement const& st) {
+        if (getLocalNode()->isQuorum(
+                mLatestEnvelopes, [&](SCPStatement const& st) {
                     bool res;
                     if (st.pledges.type() == SCP_ST_PREPARE)
                     {
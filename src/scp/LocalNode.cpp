@@ -9,6 +9,7 @@
 #include "crypto/SHA.h"
 #include "lib/json/json.h"
 #include "scp/QuorumSetUtils.h"
+#include "scp/Slot.h"
 #include "util/Logging.h"
 #include "util/XDROperators.h"
 #include "util/numeric.h"
@@ -20,9 +21,21 @@
 
 namespace diamnet
 {
+// Quorum sets are small and change rarely, so this comfortably holds all the
+// quorum sets of a network.
+static size_t const COMPILED_QSET_CACHE_SIZE = 1000;
+
+// Node numbers are never reused while compiled quorum sets refer to them, so
+// we start over, to bound memory, when this many nodes have been numbered.
+static size_t const MAX_NODE_INDICES = 10000;
+
 LocalNode::LocalNode(NodeID const& nodeID, bool isValidator,
                      SCPQuorumSet const& qSet, SCP* scp)
-    : mNodeID(nodeID), mIsValidator(isValidator), mQSet(qSet), mSCP(scp)
+    : mNodeID(nodeID)
+    , mIsValidator(isValidator)
+    , mQSet(qSet)
+    , mSCP(scp)
+    , mCompiledQSets(COMPILED_QSET_CACHE_SIZE)
 {
     normalizeQSet(mQSet);
     auto const& scpDriver = mSCP->getDriver();
@@ -280,6 +293,193 @@ LocalNode::isQuorum(
     return isQuorumSlice(qSet, pNodes);
 }
 
+size_t
+LocalNode::getNodeIndex(NodeID const& nodeID)
+{
+    auto res = mNodeIndices.emplace(nodeID, mNodeIndices.size());
+    return res.first->second;
+}
+
+void
+LocalNode::maybeResetNodeIndices()
+{
+    if (mNodeIndices.size() > MAX_NODE_INDICES)
+    {
+        mNodeIndices.clear();
+        mCompiledQSets.clear();
+    }
+}
+
+LocalNode::CompiledQSet
+LocalNode::compileQSet(SCPQuorumSet const& qset)
+{
+    CompiledQSet res;
+    res.mThreshold = qset.threshold;
+    for (auto const& validator : qset.validators)
+    {
+        res.mValidators.set(getNodeIndex(validator));
+    }
+    res.mInnerSets.reserve(qset.innerSets.size());
+    for (auto const& inner : qset.innerSets)
+    {
+        res.mInnerSets.emplace_back(compileQSet(inner));
+    }
+    return res;
+}
+
+LocalNode::CompiledQSetPtr
+LocalNode::getCompiledQSet(Hash const& qSetHash, SCPQuorumSet const* qSet)
+{
+    if (mCompiledQSets.exists(qSetHash, false))
+    {
+        return mCompiledQSets.get(qSetHash);
+    }
+    SCPQuorumSetPtr fetched;
+    if (!qSet)
+    {
+        fetched = mSCP->getDriver().getQSet(qSetHash);
+        if (!fetched)
+        {
+            // not known (yet): don't remember that
+            return nullptr;
+        }
+        qSet = fetched.get();
+    }
+    auto res = std::make_shared<CompiledQSet const>(compileQSet(*qSet));
+    mCompiledQSets.put(qSetHash, res);
+    return res;
+}
+
+LocalNode::CompiledQSetPtr
+LocalNode::getCompiledQSetFromStatement(SCPStatement const& st)
+{
+    if (st.pledges.type() == SCP_ST_EXTERNALIZE)
+    {
+        // {{nodeID}}, see Slot::getQuorumSetFromStatement
+        auto res = std::make_shared<CompiledQSet>();
+        res->mThreshold = 1;
+        res->mValidators.set(getNodeIndex(st.nodeID));
+        return res;
+    }
+    return getCompiledQSet(Slot::getCompanionQuorumSetHashFromStatement(st));
+}
+
+// Sane quorum sets don't repeat validators, so counting the members of a
+// level in the set is the same as counting them one by one.
+bool
+LocalNode::isQuorumSliceInternal(CompiledQSet const& qset, BitSet const& nodes)
+{
+    if (qset.mThreshold == 0)
+    {
+        return false;
+    }
+    size_t count = nodes.intersectionCount(qset.mValidators);
+    if (count >= qset.mThreshold)
+    {
+        return true;
+    }
+    if (qset.mThreshold - count > qset.mInnerSets.size())
+    {
+        return false;
+    }
+    for (auto const& inner : qset.mInnerSets)
+    {
+        if (isQuorumSliceInternal(inner, nodes) && ++count >= qset.mThreshold)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+LocalNode::isVBlockingInternal(CompiledQSet const& qset, BitSet const& nodes)
+{
+    // There is no v-blocking set for {\empty}
+    if (qset.mThreshold == 0)
+    {
+        return false;
+    }
+
+    int leftTillBlock =
+        (int)((1 + qset.mValidators.count() + qset.mInnerSets.size()) -
+              qset.mThreshold);
+
+    int count = (int)nodes.intersectionCount(qset.mValidators);
+    if (count > 0 && count >= leftTillBlock)
+    {
+        return true;
+    }
+    for (auto const& inner : qset.mInnerSets)
+    {
+        if (isVBlockingInternal(inner, nodes) && ++count >= leftTillBlock)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+LocalNode::isVBlocking(std::map<NodeID, SCPEnvelopeWrapperPtr> const& map,
+                       std::function<bool(SCPStatement const&)> const& filter)
+{
+    ZoneScoped;
+    maybeResetNodeIndices();
+    auto qSet = getCompiledQSet(mQSetHash, &mQSet);
+    BitSet nodes;
+    for (auto const& it : map)
+    {
+        if (filter(it.second->getStatement()))
+        {
+            nodes.set(getNodeIndex(it.first));
+        }
+    }
+    return isVBlockingInternal(*qSet, nodes);
+}
+
+bool
+LocalNode::isQuorum(std::map<NodeID, SCPEnvelopeWrapperPtr> const& map,
+                    std::function<bool(SCPStatement const&)> const& filter)
+{
+    ZoneScoped;
+    maybeResetNodeIndices();
+    auto qSet = getCompiledQSet(mQSetHash, &mQSet);
+
+    // Each node's quorum set is looked up once, rather than once per round.
+    BitSet nodes;
+    std::vector<std::pair<size_t, CompiledQSetPtr>> members;
+    for (auto const& it : map)
+    {
+        auto const& st = it.second->getStatement();
+        if (filter(st))
+        {
+            size_t i = getNodeIndex(it.first);
+            nodes.set(i);
+            members.emplace_back(i, getCompiledQSetFromStatement(st));
+        }
+    }
+
+    // Remove nodes without a slice in the set until there are none left;
+    // what remains is the largest quorum within the filtered nodes.
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (auto const& m : members)
+        {
+            if (nodes.get(m.first) &&
+                (!m.second || !isQuorumSliceInternal(*m.second, nodes)))
+            {
+                nodes.unset(m.first);
+                changed = true;
+            }
+        }
+    }
+
+    return isQuorumSliceInternal(*qSet, nodes);
+}
+
 std::vector<NodeID>
 LocalNode::findClosestVBlocking(
     SCPQuorumSet const& qset,
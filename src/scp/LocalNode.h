@@ -9,7 +9,10 @@
 #include <vector>
 
 #include "scp/SCP.h"
+#include "util/BitSet.h"
 #include "util/HashOfHash.h"
+#include "util/RandomEvictionCache.h"
+#include <unordered_map>
 
 namespace diamnet
 {
@@ -30,6 +33,21 @@ class LocalNode
 
     SCP* mSCP;
 
+    // A quorum set compiled for evaluation against sets of nodes numbered by
+    // mNodeIndices: each level's validators are a BitSet of node numbers.
+    struct CompiledQSet
+    {
+        uint32 mThreshold{0};
+        BitSet mValidators;
+        std::vector<CompiledQSet> mInnerSets;
+    };
+    using CompiledQSetPtr = std::shared_ptr<CompiledQSet const>;
+
+    // Numbers of the nodes seen in statements so far, and the quorum sets
+    // statements referred to, compiled over those numbers and cached by hash.
+    std::unordered_map<NodeID, size_t> mNodeIndices;
+    RandomEvictionCache<Hash, CompiledQSetPtr> mCompiledQSets;
+
   public:
     LocalNode(NodeID const& nodeID, bool isValidator, SCPQuorumSet const& qSet,
               SCP* scp);
@@ -81,6 +99,17 @@ class LocalNode
              std::function<bool(SCPStatement const&)> const& filter =
                  [](SCPStatement const&) { return true; });
 
+    // The same as isVBlocking and isQuorum above, on this node's quorum set
+    // and with the quorum set of each statement the one
+    // Slot::getQuorumSetFromStatement gives, but evaluated on compiled quorum
+    // sets, which are cached, and BitSets of nodes.
+    bool isVBlocking(std::map<NodeID, SCPEnvelopeWrapperPtr> const& map,
+                     std::function<bool(SCPStatement const&)> const& filter =
+                         [](SCPStatement const&) { return true; });
+    bool isQuorum(std::map<NodeID, SCPEnvelopeWrapperPtr> const& map,
+                  std::function<bool(SCPStatement const&)> const& filter =
+                      [](SCPStatement const&) { return true; });
+
     // computes the distance to the set of v-blocking sets given
     // a set of nodes that agree (but can fail)
     // excluded, if set will be skipped altogether
@@ -112,5 +141,19 @@ class LocalNode
                                       std::vector<NodeID> const& nodeSet);
     static bool isVBlockingInternal(SCPQuorumSet const& qset,
                                     std::vector<NodeID> const& nodeSet);
+
+    size_t getNodeIndex(NodeID const& nodeID);
+    CompiledQSet compileQSet(SCPQuorumSet const& qset);
+    CompiledQSetPtr getCompiledQSet(Hash const& qSetHash,
+                                    SCPQuorumSet const* qSet = nullptr);
+    CompiledQSetPtr getCompiledQSetFromStatement(SCPStatement const& st);
+    // Drops node numbers, and with them compiled quorum sets, once too many
+    // nodes have been numbered.
+    void maybeResetNodeIndices();
+
+    static bool isQuorumSliceInternal(CompiledQSet const& qset,
+                                      BitSet const& nodes);
+    static bool isVBlockingInternal(CompiledQSet const& qset,
+                                    BitSet const& nodes);
 };
 }
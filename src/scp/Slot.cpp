@@ -348,7 +348,7 @@ Slot::federatedAccept(StatementPredicate voted, StatementPredicate accepted,
 {
     // Checks if the nodes that claimed to accept the statement form a
     // v-blocking set
-    if (LocalNode::isVBlocking(getLocalNode()->getQuorumSet(), envs, accepted))
+    if (getLocalNode()->isVBlocking(envs, accepted))
     {
         return true;
     }
@@ -361,10 +361,7 @@ Slot::federatedAccept(StatementPredicate voted, StatementPredicate accepted,
         return res;
     };
 
-    if (LocalNode::isQuorum(
-            getLocalNode()->getQuorumSet(), envs,
-            std::bind(&Slot::getQuorumSetFromStatement, this, _1),
-            ratifyFilter))
+    if (getLocalNode()->isQuorum(envs, ratifyFilter))
     {
         return true;
     }
@@ -376,9 +373,7 @@ bool
 Slot::federatedRatify(StatementPredicate voted,
                       std::map<NodeID, SCPEnvelopeWrapperPtr> const& envs)
 {
-    return LocalNode::isQuorum(
-        getLocalNode()->getQuorumSet(), envs,
-        std::bind(&Slot::getQuorumSetFromStatement, this, _1), voted);
+    return getLocalNode()->isQuorum(envs, voted);
 }
 
 std::shared_ptr<LocalNode>
@@ -430,4 +430,96 @@ TEST_CASE("nomination two nodes win stats", "[scp][!hide]")
         }
     }
 }
+
+TEST_CASE("compiled quorum set evaluation", "[scp]")
+{
+    SIMULATION_CREATE_NODE(0);
+    SIMULATION_CREATE_NODE(1);
+    SIMULATION_CREATE_NODE(2);
+    SIMULATION_CREATE_NODE(3);
+    SIMULATION_CREATE_NODE(4);
+    SIMULATION_CREATE_NODE(5);
+    std::vector<NodeID> nodeIDs = {v0NodeID, v1NodeID, v2NodeID,
+                                   v3NodeID, v4NodeID, v5NodeID};
+
+    // v0-v2 require three of v0, v1, v2 and any one of v3-v5; and v3-v5 the
+    // other way around
+    auto qSet0 = makeQSet(nodeIDs, 3, 3, 0);
+    qSet0.innerSets.emplace_back(makeQSet(nodeIDs, 1, 3, 3));
+    auto qSet1 = makeQSet(nodeIDs, 3, 3, 3);
+    qSet1.innerSets.emplace_back(makeQSet(nodeIDs, 1, 3, 0));
+
+    TestNominationSCP scp(v0NodeID, qSet0);
+    scp.storeQuorumSet(std::make_shared<SCPQuorumSet>(qSet0));
+    scp.storeQuorumSet(std::make_shared<SCPQuorumSet>(qSet1));
+    auto localNode = scp.mSCP.getLocalNode();
+
+    auto statementFor = [&](size_t i, SCPStatementType type) {
+        SCPEnvelope env;
+        env.statement.nodeID = nodeIDs[i];
+        env.statement.pledges.type(type);
+        auto const& qSet = i < 3 ? qSet0 : qSet1;
+        Hash h = sha256(xdr::xdr_to_opaque(qSet));
+        if (type == SCP_ST_PREPARE)
+        {
+            env.statement.pledges.prepare().quorumSetHash = h;
+        }
+        else
+        {
+            env.statement.pledges.externalize().commitQuorumSetHash = h;
+        }
+        return scp.wrapEnvelope(env);
+    };
+    auto qfun = [&](SCPStatement const& st) -> SCPQuorumSetPtr {
+        if (st.pledges.type() == SCP_ST_EXTERNALIZE)
+        {
+            return LocalNode::getSingletonQSet(st.nodeID);
+        }
+        return scp.getQSet(st.pledges.prepare().quorumSetHash);
+    };
+
+    // Every subset of the nodes, with v5 externalizing or not.
+    for (int externalize = 0; externalize < 2; ++externalize)
+    {
+        for (uint32_t subset = 0; subset < (1u << nodeIDs.size()); ++subset)
+        {
+            std::map<NodeID, SCPEnvelopeWrapperPtr> envs;
+            for (size_t i = 0; i < nodeIDs.size(); ++i)
+            {
+                if (subset & (1u << i))
+                {
+                    envs[nodeIDs[i]] = statementFor(
+                        i, externalize && i == 5 ? SCP_ST_EXTERNALIZE
+                                                 : SCP_ST_PREPARE);
+                }
+            }
+            REQUIRE(localNode->isQuorum(envs) ==
+                    LocalNode::isQuorum(qSet0, envs, qfun));
+            REQUIRE(localNode->isVBlocking(envs) ==
+                    LocalNode::isVBlocking(qSet0, envs));
+        }
+    }
+
+    // v1, v2 and v3 aren't a quorum, but v1-v4 are; v1 and v2 block v0, and
+    // so do v1 and v3-v5 but not v3-v5 alone.
+    std::map<NodeID, SCPEnvelopeWrapperPtr> envs;
+    for (size_t i : {1, 2, 3})
+    {
+        envs[nodeIDs[i]] = statementFor(i, SCP_ST_PREPARE);
+    }
+    REQUIRE(!localNode->isQuorum(envs));
+    envs[v4NodeID] = statementFor(4, SCP_ST_PREPARE);
+    REQUIRE(localNode->isQuorum(envs));
+    envs.erase(v3NodeID);
+    envs.erase(v4NodeID);
+    REQUIRE(localNode->isVBlocking(envs));
+    envs.clear();
+    for (size_t i : {3, 4, 5})
+    {
+        envs[nodeIDs[i]] = statementFor(i, SCP_ST_PREPARE);
+    }
+    REQUIRE(!localNode->isVBlocking(envs));
+    envs[v1NodeID] = statementFor(1, SCP_ST_PREPARE);
+    REQUIRE(localNode->isVBlocking(envs));
+}
 }
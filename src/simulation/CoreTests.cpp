@@ -11,6 +11,7 @@
 #include "herder/HerderImpl.h"
 #include "herder/LedgerCloseData.h"
 #include "ledger/LedgerManager.h"
+#include "ledger/LedgerTxn.h"
 #include "ledger/test/LedgerTestUtils.h"
 #include "lib/catch.hpp"
 #include "main/Application.h"
@@ -19,6 +20,7 @@
 #include "simulation/Topologies.h"
 #include "test/test.h"
 #include "transactions/TransactionFrame.h"
+#include "transactions/TransactionUtils.h"
 #include "util/Logging.h"
 #include "util/Math.h"
 #include "util/types.h"
@@ -392,7 +394,8 @@ TEST_CASE(
     auto& app = *nodes[0]; // pick a node to generate load
 
     auto& lg = app.getLoadGenerator();
-    lg.generateLoad(true, 3, 0, 0, 10, 100, std::chrono::seconds(0), 0);
+    lg.generateLoad(LoadGenMode::CREATE, 3, 0, 0, 10, 100,
+                    std::chrono::seconds(0), 0);
     try
     {
         simulation->crankUntil(
@@ -401,27 +404,126 @@ TEST_CASE(
                 // to the second node in time and the second node gets the
                 // nomination
                 return simulation->haveAllExternalized(5, 2) &&
-                       lg.checkAccountSynced(app, true).empty();
+                       lg.checkAccountSynced(app, LoadGenMode::CREATE).empty();
             },
             3 * Herder::EXP_LEDGER_TIMESPAN_SECONDS, false);
 
-        lg.generateLoad(false, 3, 0, 10, 10, 100, std::chrono::seconds(0), 0);
+        lg.generateLoad(LoadGenMode::PAY, 3, 0, 10, 10, 100,
+                        std::chrono::seconds(0), 0);
         simulation->crankUntil(
             [&]() {
                 return simulation->haveAllExternalized(8, 2) &&
-                       lg.checkAccountSynced(app, false).empty();
+                       lg.checkAccountSynced(app, LoadGenMode::PAY).empty();
             },
             2 * Herder::EXP_LEDGER_TIMESPAN_SECONDS, true);
     }
     catch (...)
     {
-        auto problems = lg.checkAccountSynced(app, false);
+        auto problems = lg.checkAccountSynced(app, LoadGenMode::PAY);
         REQUIRE(problems.empty());
     }
 
     LOG(INFO) << simulation->metricsSummary("database");
 }
 
+TEST_CASE("generate load of every mode", "[simulation][loadgen]")
+{
+    Hash networkID = sha256(getTestConfig().NETWORK_PASSPHRASE);
+    Simulation::pointer simulation =
+        Topologies::pair(Simulation::OVER_LOOPBACK, networkID);
+    simulation->startAllNodes();
+    simulation->crankUntil(
+        [&]() { return simulation->haveAllExternalized(3, 1); },
+        2 * Herder::EXP_LEDGER_TIMESPAN_SECONDS, false);
+
+    auto& app = *simulation->getNodes()[0];
+    auto& lg = app.getLoadGenerator();
+    auto& m = app.getMetrics();
+    auto& complete = m.NewMeter({"loadgen", "run", "complete"}, "run");
+    auto& failed = m.NewMeter({"loadgen", "run", "failed"}, "run");
+    auto succeeded = [&](std::string const& type) {
+        auto& meter = m.NewMeter(
+            {"ledger", "operation-result", type, type + "-success"},
+            "operation");
+        return meter.count();
+    };
+
+    auto run = [&](LoadGenMode mode, uint32_t nTxs) {
+        auto done = complete.count();
+        lg.generateLoad(mode, 10, 0, nTxs, 10, 100, std::chrono::seconds(0),
+                        0);
+        simulation->crankUntil(
+            [&]() { return complete.count() > done || failed.count() > 0; },
+            10 * Herder::EXP_LEDGER_TIMESPAN_SECONDS, false);
+        REQUIRE(failed.count() == 0);
+        REQUIRE(complete.count() == done + 1);
+    };
+
+    run(LoadGenMode::CREATE, 0);
+
+    SECTION("pathpay")
+    {
+        run(LoadGenMode::PATH_PAY, 30);
+        REQUIRE(succeeded("path-payment-strict-send") == 30);
+
+        // 2 offers each way between every two of native and 3 assets
+        auto issuerID = txtest::getAccount("LoadGenIssuer").getPublicKey();
+        LedgerTxn ltx(app.getLedgerTxnRoot());
+        auto issuer = loadAccount(ltx, issuerID);
+        REQUIRE(issuer.current().data.account().numSubEntries == 24);
+    }
+    SECTION("offer")
+    {
+        run(LoadGenMode::OFFER, 30);
+        REQUIRE(succeeded("change-trust") > 0);
+        // besides the 24 offers of the order book
+        REQUIRE(succeeded("manage-sell-offer") > 24);
+    }
+    SECTION("claimablebalance")
+    {
+        run(LoadGenMode::CLAIMABLE_BALANCE, 30);
+        REQUIRE(succeeded("create-claimable-balance") > 0);
+        REQUIRE(succeeded("claim-claimable-balance") > 0);
+    }
+    SECTION("sponsorship")
+    {
+        run(LoadGenMode::SPONSORSHIP, 30);
+        REQUIRE(succeeded("begin-sponsoring-future-reserves") > 0);
+        REQUIRE(succeeded("manage-data") > 0);
+    }
+    SECTION("mixed")
+    {
+        run(LoadGenMode::MIXED, 50);
+        auto count = [&](std::string const& mode, std::string const& name) {
+            return m.NewMeter({"loadgen", mode, name}, "txn").count();
+        };
+
+        // Each transaction of a mode has one operation counted below, but
+        // for the offer mode's trustlines; the order book's 24 offers are
+        // placed by the setup transactions, which are counted on their own:
+        // one creating the issuer and 10 offers to a transaction after that.
+        REQUIRE(count("pay", "submitted") == succeeded("payment"));
+        REQUIRE(count("pathpay", "submitted") ==
+                succeeded("path-payment-strict-send"));
+        REQUIRE(count("offer", "submitted") ==
+                succeeded("manage-sell-offer") - 24);
+        REQUIRE(count("claimablebalance", "submitted") ==
+                succeeded("create-claimable-balance") +
+                    succeeded("claim-claimable-balance"));
+        REQUIRE(count("sponsorship", "submitted") == succeeded("manage-data"));
+        REQUIRE(count("setup", "submitted") == 4);
+
+        uint64_t submitted = 0;
+        for (auto mode : {"pay", "pathpay", "offer", "claimablebalance",
+                          "sponsorship", "setup"})
+        {
+            REQUIRE(count(mode, "rejected") == 0);
+            submitted += count(mode, "submitted");
+        }
+        REQUIRE(submitted == 50 + 4);
+    }
+}
+
 Application::pointer
 newLoadTestApp(VirtualClock& clock)
 {
@@ -518,7 +620,8 @@ TEST_CASE("Accounts vs latency", "[scalability][!hide]")
     uint32_t numItems = 500000;
 
     // Create accounts
-    lg.generateLoad(true, numItems, 0, 0, 10, 100, std::chrono::seconds(0), 0);
+    lg.generateLoad(LoadGenMode::CREATE, numItems, 0, 0, 10, 100,
+                    std::chrono::seconds(0), 0);
 
     auto& complete =
         appPtr->getMetrics().NewMeter({"loadgen", "run", "complete"}, "run");
@@ -533,7 +636,7 @@ TEST_CASE("Accounts vs latency", "[scalability][!hide]")
     txtime.Clear();
 
     // Generate payment txs
-    lg.generateLoad(false, numItems, 0, numItems / 10, 10, 100,
+    lg.generateLoad(LoadGenMode::PAY, numItems, 0, numItems / 10, 10, 100,
                     std::chrono::seconds(0), 0);
     while (!io.stopped() && complete.count() == 1)
     {
@@ -568,14 +671,16 @@ netTopologyTest(std::string const& name,
         auto& app = *nodes[0];
 
         auto& lg = app.getLoadGenerator();
-        lg.generateLoad(true, 50, 0, 0, 10, 100, std::chrono::seconds(0), 0);
+        lg.generateLoad(LoadGenMode::CREATE, 50, 0, 0, 10, 100,
+                        std::chrono::seconds(0), 0);
         auto& complete =
             app.getMetrics().NewMeter({"loadgen", "run", "complete"}, "run");
 
         sim->crankUntil(
             [&]() {
                 return sim->haveAllExternalized(8, 2) &&
-                       lg.checkAccountSynced(app, true).empty() &&
+                       lg.checkAccountSynced(app, LoadGenMode::CREATE)
+                           .empty() &&
                        complete.count() == 1;
             },
             2 * Herder::EXP_LEDGER_TIMESPAN_SECONDS, true);
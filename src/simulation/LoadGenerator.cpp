@@ -4,6 +4,7 @@
 
 #include "simulation/LoadGenerator.h"
 #include "herder/Herder.h"
+#include "ledger/LedgerCloseTiming.h"
 #include "ledger/LedgerManager.h"
 #include "ledger/LedgerTxn.h"
 #include "ledger/LedgerTxnEntry.h"
@@ -25,11 +26,14 @@
 
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
+#include "medida/timer.h"
 
+#include <algorithm>
 #include <cmath>
 #include <fmt/format.h>
 #include <iomanip>
 #include <set>
+#include <sstream>
 
 namespace diamnet
 {
@@ -48,6 +52,59 @@ const uint32_t LoadGenerator::TX_SUBMIT_MAX_TRIES = 10;
 // ledger.
 const uint32_t LoadGenerator::TIMEOUT_NUM_LEDGERS = 20;
 
+// The offers of the order book are submitted in transactions of this many
+// operations, one transaction per step.
+const uint32_t LoadGenerator::ORDER_BOOK_OPS_PER_TX = 10;
+
+// Native amount sent by each path payment.
+const int64_t LoadGenerator::PATH_PAYMENT_AMOUNT = 1000;
+
+// Once an account has this many offers, OFFER only updates and deletes them.
+const size_t LoadGenerator::MAX_ACCOUNT_OFFERS = 3;
+
+namespace
+{
+// Name of the data entries of SPONSORSHIP.
+char const* const SPONSORED_DATA_NAME = "loadgen";
+
+medida::Meter&
+modeMeter(medida::MetricsRegistry& registry, LoadGenMode mode,
+          std::string const& name)
+{
+    return registry.NewMeter(
+        {"loadgen", LoadGenerator::getModeName(mode), name}, "txn");
+}
+
+medida::Meter&
+setupMeter(medida::MetricsRegistry& registry, std::string const& name)
+{
+    return registry.NewMeter({"loadgen", "setup", name}, "txn");
+}
+
+// The operations whose apply rate is reported for a mode.
+std::vector<OperationType>
+modeOperations(LoadGenMode mode)
+{
+    switch (mode)
+    {
+    case LoadGenMode::CREATE:
+        return {CREATE_ACCOUNT};
+    case LoadGenMode::PAY:
+        return {PAYMENT};
+    case LoadGenMode::PATH_PAY:
+        return {PATH_PAYMENT_STRICT_SEND};
+    case LoadGenMode::OFFER:
+        return {MANAGE_SELL_OFFER, CHANGE_TRUST};
+    case LoadGenMode::CLAIMABLE_BALANCE:
+        return {CREATE_CLAIMABLE_BALANCE, CLAIM_CLAIMABLE_BALANCE};
+    case LoadGenMode::SPONSORSHIP:
+        return {BEGIN_SPONSORING_FUTURE_RESERVES, MANAGE_DATA};
+    default:
+        return {};
+    }
+}
+}
+
 LoadGenerator::LoadGenerator(Application& app)
     : mMinBalance(0)
     , mLastSecond(0)
@@ -61,6 +118,43 @@ LoadGenerator::LoadGenerator(Application& app)
     createRootAccount();
 }
 
+char const*
+LoadGenerator::getModeName(LoadGenMode mode)
+{
+    switch (mode)
+    {
+    case LoadGenMode::CREATE:
+        return "create";
+    case LoadGenMode::PAY:
+        return "pay";
+    case LoadGenMode::PATH_PAY:
+        return "pathpay";
+    case LoadGenMode::OFFER:
+        return "offer";
+    case LoadGenMode::CLAIMABLE_BALANCE:
+        return "claimablebalance";
+    case LoadGenMode::SPONSORSHIP:
+        return "sponsorship";
+    case LoadGenMode::MIXED:
+        return "mixed";
+    }
+    throw std::runtime_error("Unknown mode.");
+}
+
+LoadGenMode
+LoadGenerator::getMode(std::string const& name)
+{
+    for (int i = 0; i <= static_cast<int>(LoadGenMode::MIXED); ++i)
+    {
+        auto mode = static_cast<LoadGenMode>(i);
+        if (name == getModeName(mode))
+        {
+            return mode;
+        }
+    }
+    throw std::runtime_error(fmt::format("Unknown mode '{}'.", name));
+}
+
 void
 LoadGenerator::createRootAccount()
 {
@@ -118,11 +212,78 @@ LoadGenerator::reset()
     mTotalSubmitted = 0;
     mWaitTillCompleteForLedgers = 0;
     mFailed = false;
+    mMix.clear();
+    mMixTotal = 0;
+    mIssuer.reset();
+    mAssets.clear();
+    mOrderBookOps.clear();
+    mOrderBookOffers = 0;
+    mOrderBookDeadline = 0;
+    mOrderBookReady = false;
+    mClaimableBalances.clear();
+}
+
+void
+LoadGenerator::startRun(LoadGenMode mode, uint32_t nAccounts)
+{
+    if (mode == LoadGenMode::MIXED)
+    {
+        // validated by Config
+        mMix = mApp.getConfig().LOADGEN_MIX;
+        mMixTotal = 0;
+        for (auto const& m : mMix)
+        {
+            mMixTotal += m.second;
+        }
+    }
+
+    // Accounts never sponsor themselves
+    auto modes = getRunModes(mode);
+    if (nAccounts < 2 && std::find(modes.begin(), modes.end(),
+                                   LoadGenMode::SPONSORSHIP) != modes.end())
+    {
+        throw std::invalid_argument(
+            "Sponsorship load needs at least 2 accounts");
+    }
+}
+
+std::vector<LoadGenMode>
+LoadGenerator::getRunModes(LoadGenMode mode) const
+{
+    if (mode != LoadGenMode::MIXED)
+    {
+        return {mode};
+    }
+    std::vector<LoadGenMode> modes;
+    for (auto const& m : mMix)
+    {
+        modes.emplace_back(m.first);
+    }
+    return modes;
+}
+
+LoadGenMode
+LoadGenerator::pickMode(LoadGenMode mode) const
+{
+    if (mode != LoadGenMode::MIXED)
+    {
+        return mode;
+    }
+    auto r = rand_uniform<uint32_t>(0, mMixTotal - 1);
+    for (auto const& m : mMix)
+    {
+        if (r < m.second)
+        {
+            return m.first;
+        }
+        r -= m.second;
+    }
+    return mMix.back().first;
 }
 
 // Schedule a callback to generateLoad() STEP_MSECS miliseconds from now.
 void
-LoadGenerator::scheduleLoadGeneration(bool isCreate, uint32_t nAccounts,
+LoadGenerator::scheduleLoadGeneration(LoadGenMode mode, uint32_t nAccounts,
                                       uint32_t offset, uint32_t nTxs,
                                       uint32_t txRate, uint32_t batchSize,
                                       std::chrono::seconds spikeInterval,
@@ -149,9 +310,9 @@ LoadGenerator::scheduleLoadGeneration(bool isCreate, uint32_t nAccounts,
     {
         mLoadTimer->expires_from_now(std::chrono::milliseconds(STEP_MSECS));
         mLoadTimer->async_wait(
-            [this, nAccounts, offset, nTxs, txRate, batchSize, isCreate,
+            [this, nAccounts, offset, nTxs, txRate, batchSize, mode,
              spikeInterval, spikeSize]() {
-                this->generateLoad(isCreate, nAccounts, offset, nTxs, txRate,
+                this->generateLoad(mode, nAccounts, offset, nTxs, txRate,
                                    batchSize, spikeInterval, spikeSize);
             },
             &VirtualTimer::onFailureNoop);
@@ -163,9 +324,9 @@ LoadGenerator::scheduleLoadGeneration(bool isCreate, uint32_t nAccounts,
             << mApp.getState();
         mLoadTimer->expires_from_now(std::chrono::seconds(10));
         mLoadTimer->async_wait(
-            [this, nAccounts, offset, nTxs, txRate, batchSize, isCreate,
+            [this, nAccounts, offset, nTxs, txRate, batchSize, mode,
              spikeInterval, spikeSize]() {
-                this->scheduleLoadGeneration(isCreate, nAccounts, offset, nTxs,
+                this->scheduleLoadGeneration(mode, nAccounts, offset, nTxs,
                                              txRate, batchSize, spikeInterval,
                                              spikeSize);
             },
@@ -178,14 +339,16 @@ LoadGenerator::scheduleLoadGeneration(bool isCreate, uint32_t nAccounts,
 // If work remains after the current step, call scheduleLoadGeneration()
 // with the remainder.
 void
-LoadGenerator::generateLoad(bool isCreate, uint32_t nAccounts, uint32_t offset,
-                            uint32_t nTxs, uint32_t txRate, uint32_t batchSize,
+LoadGenerator::generateLoad(LoadGenMode mode, uint32_t nAccounts,
+                            uint32_t offset, uint32_t nTxs, uint32_t txRate,
+                            uint32_t batchSize,
                             std::chrono::seconds spikeInterval,
                             uint32_t spikeSize)
 
 {
     if (!mStartTime)
     {
+        startRun(mode, nAccounts);
         mStartTime =
             std::make_unique<VirtualClock::time_point>(mApp.getClock().now());
     }
@@ -193,10 +356,11 @@ LoadGenerator::generateLoad(bool isCreate, uint32_t nAccounts, uint32_t offset,
     createRootAccount();
 
     // Finish if no more txs need to be created.
+    bool isCreate = mode == LoadGenMode::CREATE;
     if ((isCreate && nAccounts == 0) || (!isCreate && nTxs == 0))
     {
         // Done submitting the load, now ensure it propagates to the DB.
-        waitTillComplete(isCreate);
+        waitTillComplete(mode);
         return;
     }
 
@@ -210,13 +374,28 @@ LoadGenerator::generateLoad(bool isCreate, uint32_t nAccounts, uint32_t offset,
         batchSize = 1;
     }
 
+    uint32_t ledgerNum = mApp.getLedgerManager().getLastClosedLedgerNum() + 1;
+
+    auto modes = getRunModes(mode);
+    bool needsOrderBook =
+        std::any_of(modes.begin(), modes.end(), [](LoadGenMode m) {
+            return m == LoadGenMode::PATH_PAY || m == LoadGenMode::OFFER;
+        });
+    if (needsOrderBook && !setUpOrderBook(ledgerNum))
+    {
+        // Hold the load back until the order book is in the ledger, and
+        // only then start counting its rate.
+        *mStartTime = mApp.getClock().now();
+        scheduleLoadGeneration(mode, nAccounts, offset, nTxs, txRate,
+                               batchSize, spikeInterval, spikeSize);
+        return;
+    }
+
     auto txPerStep = getTxPerStep(txRate, spikeInterval, spikeSize);
     auto& submitTimer =
         mApp.getMetrics().NewTimer({"loadgen", "step", "submit"});
     auto submitScope = submitTimer.TimeScope();
 
-    uint32_t ledgerNum = mApp.getLedgerManager().getLastClosedLedgerNum() + 1;
-
     for (int64_t i = 0; i < txPerStep; ++i)
     {
         if (isCreate)
@@ -226,8 +405,8 @@ LoadGenerator::generateLoad(bool isCreate, uint32_t nAccounts, uint32_t offset,
         }
         else
         {
-            nTxs =
-                submitPaymentTx(nAccounts, offset, batchSize, ledgerNum, nTxs);
+            nTxs = submitTx(mode, nAccounts, offset, batchSize, ledgerNum,
+                            nTxs);
         }
 
         if (nAccounts == 0 || (!isCreate && nTxs == 0))
@@ -244,12 +423,12 @@ LoadGenerator::generateLoad(bool isCreate, uint32_t nAccounts, uint32_t offset,
     // Emit a log message once per second.
     if (now != mLastSecond)
     {
-        logProgress(submit, isCreate, nAccounts, nTxs, batchSize, txRate);
+        logProgress(submit, mode, nAccounts, nTxs, batchSize, txRate);
     }
 
     mLastSecond = now;
     mTotalSubmitted += txPerStep;
-    scheduleLoadGeneration(isCreate, nAccounts, offset, nTxs, txRate, batchSize,
+    scheduleLoadGeneration(mode, nAccounts, offset, nTxs, txRate, batchSize,
                            spikeInterval, spikeSize);
 }
 
@@ -265,7 +444,7 @@ LoadGenerator::submitCreationTx(uint32_t nAccounts, uint32_t offset,
     bool createDuplicate = false;
     int numTries = 0;
 
-    while ((status = tx.execute(mApp, true, code, batchSize)) !=
+    while ((status = tx.execute(mApp, code, batchSize)) !=
            TransactionQueue::AddResult::ADD_STATUS_PENDING)
     {
         // Ignore duplicate transactions, simply continue generating load
@@ -296,19 +475,19 @@ LoadGenerator::submitCreationTx(uint32_t nAccounts, uint32_t offset,
 }
 
 uint32_t
-LoadGenerator::submitPaymentTx(uint32_t nAccounts, uint32_t offset,
-                               uint32_t batchSize, uint32_t ledgerNum,
-                               uint32_t nTxs)
+LoadGenerator::submitTx(LoadGenMode mode, uint32_t nAccounts, uint32_t offset,
+                        uint32_t batchSize, uint32_t ledgerNum, uint32_t nTxs)
 {
     auto sourceAccountId = rand_uniform<uint64_t>(0, nAccounts - 1) + offset;
-    TxInfo tx =
-        paymentTransaction(nAccounts, offset, ledgerNum, sourceAccountId);
+    auto txMode = pickMode(mode);
+    TxInfo tx = modeTransaction(txMode, nAccounts, offset, ledgerNum,
+                                sourceAccountId);
 
     TransactionResultCode code;
     TransactionQueue::AddResult status;
     int numTries = 0;
 
-    while ((status = tx.execute(mApp, false, code, batchSize)) !=
+    while ((status = tx.execute(mApp, code, batchSize)) !=
            TransactionQueue::AddResult::ADD_STATUS_PENDING)
     {
         if (++numTries >= TX_SUBMIT_MAX_TRIES ||
@@ -321,8 +500,9 @@ LoadGenerator::submitPaymentTx(uint32_t nAccounts, uint32_t offset,
         // In case of bad seqnum, attempt refreshing it from the DB
         maybeHandleFailedTx(tx.mFrom, status, code); // Update seq num
 
-        // Regenerate a new payment tx
-        tx = paymentTransaction(nAccounts, offset, ledgerNum, sourceAccountId);
+        // Regenerate a new tx
+        tx = modeTransaction(txMode, nAccounts, offset, ledgerNum,
+                             sourceAccountId);
     }
 
     nTxs -= 1;
@@ -330,8 +510,8 @@ LoadGenerator::submitPaymentTx(uint32_t nAccounts, uint32_t offset,
 }
 
 void
-LoadGenerator::logProgress(std::chrono::nanoseconds submitTimer, bool isCreate,
-                           uint32_t nAccounts, uint32_t nTxs,
+LoadGenerator::logProgress(std::chrono::nanoseconds submitTimer,
+                           LoadGenMode mode, uint32_t nAccounts, uint32_t nTxs,
                            uint32_t batchSize, uint32_t txRate)
 {
     using namespace std::chrono;
@@ -342,7 +522,8 @@ LoadGenerator::logProgress(std::chrono::nanoseconds submitTimer, bool isCreate,
 
     auto submitSteps = duration_cast<milliseconds>(submitTimer).count();
 
-    auto remainingTxCount = isCreate ? nAccounts / batchSize : nTxs;
+    auto remainingTxCount =
+        mode == LoadGenMode::CREATE ? nAccounts / batchSize : nTxs;
     auto etaSecs =
         (uint32_t)(((double)remainingTxCount) / applyTx.one_minute_rate());
 
@@ -356,6 +537,25 @@ LoadGenerator::logProgress(std::chrono::nanoseconds submitTimer, bool isCreate,
                           << " txs."
                           << " ETA: " << etaHours << "h" << etaMins << "m";
 
+    for (auto runMode : getRunModes(mode))
+    {
+        std::ostringstream applied;
+        for (auto type : modeOperations(runMode))
+        {
+            auto name = LedgerCloseTiming::operationMetricName(type);
+            applied << ", "
+                    << m.NewTimer({"ledger", "operation", name, "apply"})
+                           .one_minute_rate()
+                    << "op " << name;
+        }
+        CLOG(INFO, "LoadGen")
+            << getModeName(runMode) << ": "
+            << modeMeter(m, runMode, "submitted").one_minute_rate()
+            << "tx submitted, "
+            << modeMeter(m, runMode, "rejected").one_minute_rate()
+            << "tx rejected" << applied.str() << " applied (1m EWMA).";
+    }
+
     CLOG(DEBUG, "LoadGen") << "Step timing: " << submitSteps << "ms submit.";
 
     TxMetrics txm(mApp.getMetrics());
@@ -368,7 +568,7 @@ LoadGenerator::creationTransaction(uint64_t startAccount, uint64_t numItems,
 {
     vector<Operation> creationOps =
         createAccounts(startAccount, numItems, ledgerNum);
-    TxInfo newTx = TxInfo{mRoot, creationOps};
+    TxInfo newTx = TxInfo{mRoot, creationOps, LoadGenMode::CREATE};
     return newTx;
 }
 
@@ -485,11 +685,329 @@ LoadGenerator::paymentTransaction(uint32_t numAccounts, uint32_t offset,
         pickAccountPair(numAccounts, offset, ledgerNum, sourceAccount);
     vector<Operation> paymentOps = {
         txtest::payment(to->getPublicKey(), amount)};
-    TxInfo tx = TxInfo{from, paymentOps};
+    TxInfo tx = TxInfo{from, paymentOps, LoadGenMode::PAY};
 
     return tx;
 }
 
+LoadGenerator::TxInfo
+LoadGenerator::pathPaymentTransaction(uint32_t numAccounts, uint32_t offset,
+                                      uint32_t ledgerNum,
+                                      uint64_t sourceAccount)
+{
+    TestAccountPtr to, from;
+    std::tie(from, to) =
+        pickAccountPair(numAccounts, offset, ledgerNum, sourceAccount);
+
+    // Native to native through one or two of the issued assets, crossing the
+    // order book both ways
+    auto numIssued = mAssets.size() - 1;
+    auto hops = rand_uniform<size_t>(1, std::min<size_t>(2, numIssued));
+    std::vector<Asset> path;
+    while (path.size() < hops)
+    {
+        auto const& asset = mAssets[rand_uniform<size_t>(1, numIssued)];
+        if (path.empty() || !(path.back() == asset))
+        {
+            path.emplace_back(asset);
+        }
+    }
+
+    vector<Operation> ops = {txtest::pathPaymentStrictSend(
+        to->getPublicKey(), mAssets[0], PATH_PAYMENT_AMOUNT, mAssets[0], 1,
+        path)};
+    return TxInfo{from, ops, LoadGenMode::PATH_PAY};
+}
+
+LoadGenerator::TxInfo
+LoadGenerator::offerTransaction(uint32_t ledgerNum, uint64_t sourceAccount)
+{
+    auto from = findAccount(sourceAccount, ledgerNum);
+    auto const& asset = mAssets[1 + sourceAccount % (mAssets.size() - 1)];
+
+    bool hasTrustLine;
+    std::vector<int64_t> offerIDs;
+    {
+        LedgerTxn ltx(mApp.getLedgerTxnRoot());
+        hasTrustLine = static_cast<bool>(
+            loadTrustLineWithoutRecord(ltx, from->getPublicKey(), asset));
+        for (auto const& offer :
+             ltx.loadOffersByAccountAndAsset(from->getPublicKey(), asset))
+        {
+            offerIDs.emplace_back(offer.current().data.offer().offerID);
+        }
+    }
+
+    vector<Operation> ops;
+    if (!hasTrustLine)
+    {
+        ops.emplace_back(txtest::changeTrust(asset, INT64_MAX));
+    }
+
+    // Sell native for twice as much or more of the asset than the order book
+    // asks, so that the offer never crosses it. Create an offer, or update or
+    // delete one of the existing ones.
+    Price price{rand_uniform<int32_t>(20, 30), 10};
+    auto amount = rand_uniform<int64_t>(1000, 10000);
+    int64_t offerID = 0;
+    if (!offerIDs.empty())
+    {
+        auto choice =
+            rand_uniform<int>(offerIDs.size() < MAX_ACCOUNT_OFFERS ? 0 : 1, 2);
+        if (choice > 0)
+        {
+            offerID = rand_element(offerIDs);
+        }
+        if (choice == 2)
+        {
+            amount = 0;
+        }
+    }
+    ops.emplace_back(
+        txtest::manageOffer(offerID, mAssets[0], asset, price, amount));
+    return TxInfo{from, ops, LoadGenMode::OFFER};
+}
+
+LoadGenerator::TxInfo
+LoadGenerator::claimableBalanceTransaction(uint32_t numAccounts,
+                                           uint32_t offset, uint32_t ledgerNum,
+                                           uint64_t sourceAccount)
+{
+    // Claim the oldest pending balance, once its transaction could have been
+    // applied. If it is not in the ledger after TIMEOUT_NUM_LEDGERS, that
+    // transaction failed and the balance is forgotten.
+    while (!mClaimableBalances.empty() &&
+           mClaimableBalances.front().mLedgerNum < ledgerNum)
+    {
+        auto pending = mClaimableBalances.front();
+        bool exists;
+        {
+            LedgerTxn ltx(mApp.getLedgerTxnRoot());
+            exists = static_cast<bool>(
+                loadClaimableBalance(ltx, pending.mBalanceID));
+        }
+        if (!exists &&
+            pending.mLedgerNum + TIMEOUT_NUM_LEDGERS >= ledgerNum)
+        {
+            break;
+        }
+        mClaimableBalances.pop_front();
+        if (exists)
+        {
+            vector<Operation> ops = {
+                txtest::claimClaimableBalance(pending.mBalanceID)};
+            return TxInfo{pending.mClaimant, ops,
+                          LoadGenMode::CLAIMABLE_BALANCE};
+        }
+    }
+
+    TestAccountPtr to, from;
+    std::tie(from, to) =
+        pickAccountPair(numAccounts, offset, ledgerNum, sourceAccount);
+
+    xdr::xvector<Claimant, 10> claimants(1);
+    claimants[0].v0().destination = to->getPublicKey();
+    claimants[0].v0().predicate.type(CLAIM_PREDICATE_UNCONDITIONAL);
+    int64_t amount = 1;
+    vector<Operation> ops = {txtest::createClaimableBalance(
+        txtest::makeNativeAsset(), amount, claimants)};
+
+    // execute uses the next sequence number of the account
+    mClaimableBalances.push_back(
+        {from->getBalanceID(0, from->getLastSequenceNumber() + 1), to,
+         ledgerNum});
+    return TxInfo{from, ops, LoadGenMode::CLAIMABLE_BALANCE};
+}
+
+LoadGenerator::TxInfo
+LoadGenerator::sponsorshipTransaction(uint32_t numAccounts, uint32_t offset,
+                                      uint32_t ledgerNum,
+                                      uint64_t sourceAccount)
+{
+    TestAccountPtr sponsor, sponsored;
+    std::tie(sponsor, sponsored) =
+        pickAccountPair(numAccounts, offset, ledgerNum, sourceAccount);
+    if (sponsored == sponsor)
+    {
+        sponsored = findAccount(
+            (sourceAccount - offset + 1) % numAccounts + offset, ledgerNum);
+    }
+
+    bool hasData;
+    {
+        LedgerTxn ltx(mApp.getLedgerTxnRoot());
+        hasData = static_cast<bool>(
+            loadData(ltx, sponsored->getPublicKey(), SPONSORED_DATA_NAME));
+    }
+
+    // The sponsored account creates its data entry, or deletes it, in the
+    // sandwich
+    DataValue value(8, static_cast<uint8_t>(ledgerNum));
+    auto sponsoredOp = [&](Operation op) {
+        op.sourceAccount.activate() =
+            toMuxedAccount(sponsored->getPublicKey());
+        return op;
+    };
+    vector<Operation> ops = {
+        txtest::beginSponsoringFutureReserves(sponsored->getPublicKey()),
+        sponsoredOp(txtest::manageData(SPONSORED_DATA_NAME,
+                                       hasData ? nullptr : &value)),
+        sponsoredOp(txtest::endSponsoringFutureReserves())};
+    return TxInfo{sponsor, ops, LoadGenMode::SPONSORSHIP, {sponsored}};
+}
+
+LoadGenerator::TxInfo
+LoadGenerator::modeTransaction(LoadGenMode mode, uint32_t numAccounts,
+                               uint32_t offset, uint32_t ledgerNum,
+                               uint64_t sourceAccount)
+{
+    switch (mode)
+    {
+    case LoadGenMode::PAY:
+        return paymentTransaction(numAccounts, offset, ledgerNum,
+                                  sourceAccount);
+    case LoadGenMode::PATH_PAY:
+        return pathPaymentTransaction(numAccounts, offset, ledgerNum,
+                                      sourceAccount);
+    case LoadGenMode::OFFER:
+        return offerTransaction(ledgerNum, sourceAccount);
+    case LoadGenMode::CLAIMABLE_BALANCE:
+        return claimableBalanceTransaction(numAccounts, offset, ledgerNum,
+                                           sourceAccount);
+    case LoadGenMode::SPONSORSHIP:
+        return sponsorshipTransaction(numAccounts, offset, ledgerNum,
+                                      sourceAccount);
+    default:
+        throw std::runtime_error(
+            fmt::format("No transactions of mode {}", getModeName(mode)));
+    }
+}
+
+bool
+LoadGenerator::setUpOrderBook(uint32_t ledgerNum)
+{
+    if (mOrderBookReady)
+    {
+        return true;
+    }
+
+    if (!mIssuer)
+    {
+        auto const& cfg = mApp.getConfig();
+        SequenceNumber sn = static_cast<SequenceNumber>(ledgerNum) << 32;
+        mIssuer = make_shared<TestAccount>(
+            mApp, txtest::getAccount("LoadGenIssuer"), sn);
+        mAssets = {txtest::makeNativeAsset()};
+        for (uint32_t i = 0; i < cfg.LOADGEN_DEX_ASSETS; ++i)
+        {
+            mAssets.emplace_back(txtest::makeAsset(mIssuer->getSecretKey(),
+                                                   fmt::format("LG{}", i)));
+        }
+
+        // Prices of at least 1.1 both ways, so that the issuer's offers never
+        // cross each other
+        mOrderBookOps.clear();
+        auto amount = mMinBalance * 10;
+        for (size_t i = 0; i < mAssets.size(); ++i)
+        {
+            for (size_t j = i + 1; j < mAssets.size(); ++j)
+            {
+                for (uint32_t k = 0; k < cfg.LOADGEN_DEX_OFFERS_PER_PAIR; ++k)
+                {
+                    Price price{static_cast<int32_t>(11 + k), 10};
+                    mOrderBookOps.emplace_back(txtest::manageOffer(
+                        0, mAssets[i], mAssets[j], price, amount));
+                    mOrderBookOps.emplace_back(txtest::manageOffer(
+                        0, mAssets[j], mAssets[i], price, amount));
+                }
+            }
+        }
+        mOrderBookOffers = static_cast<uint32_t>(mOrderBookOps.size());
+        mOrderBookDeadline = ledgerNum + TIMEOUT_NUM_LEDGERS;
+
+        // The issuer may be left from an earlier run
+        if (!loadAccount(mIssuer, mApp))
+        {
+            // Enough to sell native on every offer, and for the reserve
+            auto balance = amount * (mOrderBookOffers + 10);
+            TxInfo tx{mRoot, {txtest::createAccount(mIssuer->getPublicKey(),
+                                                    balance)}};
+            submitSetupTx(tx);
+            return false;
+        }
+    }
+
+    if (ledgerNum > mOrderBookDeadline)
+    {
+        CLOG(ERROR, "LoadGen") << "Order book was not set up in time.";
+        mFailed = true;
+        return false;
+    }
+
+    uint32_t numSubEntries;
+    {
+        LedgerTxn ltx(mApp.getLedgerTxnRoot());
+        auto issuer = loadAccountWithoutRecord(ltx, mIssuer->getPublicKey());
+        if (!issuer)
+        {
+            // Still being created
+            return false;
+        }
+        auto const& ae = issuer.current().data.account();
+        numSubEntries = ae.numSubEntries;
+        if (mOrderBookOps.size() == mOrderBookOffers)
+        {
+            mIssuer->setSequenceNumber(ae.seqNum);
+        }
+    }
+
+    if (numSubEntries >= mOrderBookOffers)
+    {
+        CLOG(INFO, "LoadGen")
+            << "Order book set up: " << numSubEntries << " offers on "
+            << mAssets.size() - 1 << " assets.";
+        mOrderBookOps.clear();
+        mOrderBookReady = true;
+        return true;
+    }
+
+    if (!mOrderBookOps.empty())
+    {
+        auto n = std::min<size_t>(ORDER_BOOK_OPS_PER_TX, mOrderBookOps.size());
+        TxInfo tx{mIssuer, vector<Operation>(mOrderBookOps.end() - n,
+                                             mOrderBookOps.end())};
+        if (submitSetupTx(tx))
+        {
+            mOrderBookOps.resize(mOrderBookOps.size() - n);
+            mOrderBookDeadline = ledgerNum + TIMEOUT_NUM_LEDGERS;
+        }
+    }
+    return false;
+}
+
+bool
+LoadGenerator::submitSetupTx(TxInfo& tx)
+{
+    tx.mSetup = true;
+    TransactionResultCode code;
+    for (uint32_t numTries = 0; numTries < TX_SUBMIT_MAX_TRIES; ++numTries)
+    {
+        auto status = tx.execute(mApp, code, 1);
+        if (status == TransactionQueue::AddResult::ADD_STATUS_PENDING)
+        {
+            return true;
+        }
+        if (status != TransactionQueue::AddResult::ADD_STATUS_ERROR)
+        {
+            break;
+        }
+        // In case of bad seqnum, attempt refreshing it from the DB
+        maybeHandleFailedTx(tx.mFrom, status, code);
+    }
+    mFailed = true;
+    return false;
+}
+
 void
 LoadGenerator::maybeHandleFailedTx(TestAccountPtr sourceAccount,
                                    TransactionQueue::AddResult status,
@@ -509,8 +1027,9 @@ LoadGenerator::maybeHandleFailedTx(TestAccountPtr sourceAccount,
 }
 
 std::vector<LoadGenerator::TestAccountPtr>
-LoadGenerator::checkAccountSynced(Application& app, bool isCreate)
+LoadGenerator::checkAccountSynced(Application& app, LoadGenMode mode)
 {
+    bool isCreate = mode == LoadGenMode::CREATE;
     std::vector<TestAccountPtr> result;
     for (auto const& acc : mAccounts)
     {
@@ -553,14 +1072,14 @@ LoadGenerator::checkAccountSynced(Application& app, bool isCreate)
 }
 
 void
-LoadGenerator::waitTillComplete(bool isCreate)
+LoadGenerator::waitTillComplete(LoadGenMode mode)
 {
     if (!mLoadTimer)
     {
         mLoadTimer = std::make_unique<VirtualTimer>(mApp.getClock());
     }
     vector<TestAccountPtr> inconsistencies;
-    inconsistencies = checkAccountSynced(mApp, isCreate);
+    inconsistencies = checkAccountSynced(mApp, mode);
 
     if (inconsistencies.empty())
     {
@@ -582,7 +1101,7 @@ LoadGenerator::waitTillComplete(bool isCreate)
         mLoadTimer->expires_from_now(
             mApp.getConfig().getExpectedLedgerCloseTime());
         mLoadTimer->async_wait(
-            [this, isCreate]() { this->waitTillComplete(isCreate); },
+            [this, mode]() { this->waitTillComplete(mode); },
             &VirtualTimer::onFailureNoop);
     }
 }
@@ -618,27 +1137,40 @@ LoadGenerator::TxMetrics::report()
 }
 
 TransactionQueue::AddResult
-LoadGenerator::TxInfo::execute(Application& app, bool isCreate,
-                               TransactionResultCode& code, int32_t batchSize)
+LoadGenerator::TxInfo::execute(Application& app, TransactionResultCode& code,
+                               int32_t batchSize)
 {
     auto seqNum = mFrom->getLastSequenceNumber();
     mFrom->setSequenceNumber(seqNum + 1);
 
     TransactionFramePtr txf =
         transactionFromOperations(app, mFrom->getSecretKey(), seqNum + 1, mOps);
+    for (auto const& signer : mSigners)
+    {
+        txf->addSignature(signer->getSecretKey());
+    }
     TxMetrics txm(app.getMetrics());
 
-    // Record tx metrics.
-    if (isCreate)
+    // Record tx metrics. Setup transactions are counted apart from the
+    // load itself.
+    if (mSetup)
     {
-        while (batchSize--)
-        {
-            txm.mAccountCreated.Mark();
-        }
+        setupMeter(app.getMetrics(), "submitted").Mark();
     }
     else
     {
-        txm.mNativePayment.Mark();
+        if (mMode == LoadGenMode::CREATE)
+        {
+            while (batchSize--)
+            {
+                txm.mAccountCreated.Mark();
+            }
+        }
+        else if (mMode == LoadGenMode::PAY)
+        {
+            txm.mNativePayment.Mark();
+        }
+        modeMeter(app.getMetrics(), mMode, "submitted").Mark();
     }
     txm.mTxnAttempted.Mark();
 
@@ -659,6 +1191,14 @@ LoadGenerator::TxInfo::execute(Application& app, bool isCreate,
             code = txf->getResultCode();
         }
         txm.mTxnRejected.Mark();
+        if (mSetup)
+        {
+            setupMeter(app.getMetrics(), "rejected").Mark();
+        }
+        else
+        {
+            modeMeter(app.getMetrics(), mMode, "rejected").Mark();
+        }
     }
     else
     {
@@ -10,6 +10,8 @@
 #include "test/TestAccount.h"
 #include "test/TxTests.h"
 #include "xdr/Diamnet-types.h"
+#include <deque>
+#include <string>
 #include <vector>
 
 namespace medida
@@ -25,12 +27,42 @@ namespace diamnet
 
 class VirtualTimer;
 
+// What the transactions of a load generation run do:
+// * CREATE creates accounts, in batches from the root account.
+// * PAY sends native payments between accounts.
+// * PATH_PAY sends native path payments to native, through one or two of the
+//   assets of an order book set up for the run (see setUpOrderBook).
+// * OFFER creates, updates and deletes offers of accounts on that order book,
+//   adding the trustline they need first.
+// * CLAIMABLE_BALANCE creates claimable balances between accounts, and has
+//   their claimant claim them once they are in the ledger.
+// * SPONSORSHIP has accounts sponsor a data entry of another account, or
+//   delete it, between begin and end sponsoring future reserves operations.
+// * MIXED picks one of the modes above but CREATE for every transaction,
+//   weighted as configured by LOADGEN_MIX.
+enum class LoadGenMode
+{
+    CREATE,
+    PAY,
+    PATH_PAY,
+    OFFER,
+    CLAIMABLE_BALANCE,
+    SPONSORSHIP,
+    MIXED
+};
+
 class LoadGenerator
 {
   public:
     using TestAccountPtr = std::shared_ptr<TestAccount>;
     LoadGenerator(Application& app);
 
+    // The mode names of the generateload command, which are also used in the
+    // `loadgen.<mode>.*` metrics.
+    static char const* getModeName(LoadGenMode mode);
+    // Throws if name is not a mode name.
+    static LoadGenMode getMode(std::string const& name);
+
     // Generate one "step" worth of load (assuming 1 step per STEP_MSECS) at a
     // given target number of accounts and txs, and a given target tx/s rate.
     // If work remains after the current step, call scheduleLoadGeneration()
@@ -40,14 +72,14 @@ class LoadGenerator
     //                Set this to 0 if no spikes are needed.
     // spikeSize: The number of transactions a spike injects on top of the
     // steady rate.
-    void generateLoad(bool isCreate, uint32_t nAccounts, uint32_t offset,
+    void generateLoad(LoadGenMode mode, uint32_t nAccounts, uint32_t offset,
                       uint32_t nTxs, uint32_t txRate, uint32_t batchSize,
                       std::chrono::seconds spikeInterval, uint32_t spikeSize);
 
     // Verify cached accounts are properly reflected in the database
     // return any accounts that are inconsistent.
     std::vector<TestAccountPtr> checkAccountSynced(Application& app,
-                                                   bool isCreate);
+                                                   LoadGenMode mode);
 
   private:
     struct TxMetrics
@@ -66,6 +98,14 @@ class LoadGenerator
     {
         TestAccountPtr mFrom;
         std::vector<Operation> mOps;
+        // The mode the transaction is counted under, unless it is setting up
+        // the run.
+        LoadGenMode mMode;
+        // Other accounts that are the source of some of the operations, and
+        // so sign the transaction as well.
+        std::vector<TestAccountPtr> mSigners;
+        // Set by submitSetupTx: counted in the `loadgen.setup.*` metrics.
+        bool mSetup{false};
         // There are a few scenarios where tx submission might fail:
         // * ADD_STATUS_DUPLICATE, should be just a no-op and not count toward
         // total tx goal.
@@ -76,14 +116,26 @@ class LoadGenerator
         // re-submit. Any other code points to a loadgen misconfigurations, as
         // transactions must have valid (pre-generated) source accounts,
         // sufficient balances etc.
-        TransactionQueue::AddResult execute(Application& app, bool isCreate,
+        TransactionQueue::AddResult execute(Application& app,
                                             TransactionResultCode& code,
                                             int32_t batchSize);
     };
 
+    // A claimable balance submitted for creation, to be claimed once its
+    // transaction had the time to be applied.
+    struct PendingClaimableBalance
+    {
+        ClaimableBalanceID mBalanceID;
+        TestAccountPtr mClaimant;
+        uint32_t mLedgerNum;
+    };
+
     static const uint32_t STEP_MSECS;
     static const uint32_t TX_SUBMIT_MAX_TRIES;
     static const uint32_t TIMEOUT_NUM_LEDGERS;
+    static const uint32_t ORDER_BOOK_OPS_PER_TX;
+    static const int64_t PATH_PAYMENT_AMOUNT;
+    static const size_t MAX_ACCOUNT_OFFERS;
 
     std::unique_ptr<VirtualTimer> mLoadTimer;
     int64 mMinBalance;
@@ -97,6 +149,22 @@ class LoadGenerator
     // Accounts cache
     std::map<uint64_t, TestAccountPtr> mAccounts;
 
+    // The modes MIXED picks from, with their weights, and their total.
+    std::vector<std::pair<LoadGenMode, uint32_t>> mMix;
+    uint32_t mMixTotal{0};
+
+    // The order book of PATH_PAY and OFFER: the issuer of its assets and the
+    // assets (native first), the offers still to submit and the number of
+    // offers it has, and the ledger by which it must be set up.
+    TestAccountPtr mIssuer;
+    std::vector<Asset> mAssets;
+    std::vector<Operation> mOrderBookOps;
+    uint32_t mOrderBookOffers{0};
+    uint32_t mOrderBookDeadline{0};
+    bool mOrderBookReady{false};
+
+    std::deque<PendingClaimableBalance> mClaimableBalances;
+
     medida::Meter& mLoadgenComplete;
     medida::Meter& mLoadgenFail;
 
@@ -109,12 +177,25 @@ class LoadGenerator
                          uint32_t spikeSize);
 
     // Schedule a callback to generateLoad() STEP_MSECS miliseconds from now.
-    void scheduleLoadGeneration(bool isCreate, uint32_t nAccounts,
+    void scheduleLoadGeneration(LoadGenMode mode, uint32_t nAccounts,
                                 uint32_t offset, uint32_t nTxs, uint32_t txRate,
                                 uint32_t batchSize,
                                 std::chrono::seconds spikeInterval,
                                 uint32_t spikeSize);
 
+    // Checks the run can be generated, setting up mMix for MIXED.
+    void startRun(LoadGenMode mode, uint32_t nAccounts);
+    // The modes the transactions of a run are counted under.
+    std::vector<LoadGenMode> getRunModes(LoadGenMode mode) const;
+    LoadGenMode pickMode(LoadGenMode mode) const;
+
+    // Creates the order book issuer, has it place LOADGEN_DEX_OFFERS_PER_PAIR
+    // offers each way between every two of native and LOADGEN_DEX_ASSETS
+    // assets it issues, and waits for them to be in the ledger; returns true
+    // once they are.
+    bool setUpOrderBook(uint32_t ledgerNum);
+    bool submitSetupTx(TxInfo& tx);
+
     std::vector<Operation> createAccounts(uint64_t i, uint64_t batchSize,
                                           uint32_t ledgerNum);
     bool loadAccount(TestAccount& account, Application& app);
@@ -128,21 +209,32 @@ class LoadGenerator
                                              uint32_t offset,
                                              uint32_t ledgerNum,
                                              uint64_t sourceAccount);
+    TxInfo pathPaymentTransaction(uint32_t numAccounts, uint32_t offset,
+                                  uint32_t ledgerNum, uint64_t sourceAccount);
+    TxInfo offerTransaction(uint32_t ledgerNum, uint64_t sourceAccount);
+    TxInfo claimableBalanceTransaction(uint32_t numAccounts, uint32_t offset,
+                                       uint32_t ledgerNum,
+                                       uint64_t sourceAccount);
+    TxInfo sponsorshipTransaction(uint32_t numAccounts, uint32_t offset,
+                                  uint32_t ledgerNum, uint64_t sourceAccount);
+    // A transaction of mode, which is neither CREATE nor MIXED.
+    TxInfo modeTransaction(LoadGenMode mode, uint32_t numAccounts,
+                           uint32_t offset, uint32_t ledgerNum,
+                           uint64_t sourceAccount);
     void maybeHandleFailedTx(TestAccountPtr sourceAccount,
                              TransactionQueue::AddResult status,
                              TransactionResultCode code);
     TxInfo creationTransaction(uint64_t startAccount, uint64_t numItems,
                                uint32_t ledgerNum);
-    void logProgress(std::chrono::nanoseconds submitTimer, bool isCreate,
+    void logProgress(std::chrono::nanoseconds submitTimer, LoadGenMode mode,
                      uint32_t nAccounts, uint32_t nTxs, uint32_t batchSize,
                      uint32_t txRate);
 
     uint32_t submitCreationTx(uint32_t nAccounts, uint32_t offset,
                               uint32_t batchSize, uint32_t ledgerNum);
-    uint32_t submitPaymentTx(uint32_t nAccounts, uint32_t offset,
-                             uint32_t batchSize, uint32_t ledgerNum,
-                             uint32_t nTxs);
-    void waitTillComplete(bool isCreate);
+    uint32_t submitTx(LoadGenMode mode, uint32_t nAccounts, uint32_t offset,
+                      uint32_t batchSize, uint32_t ledgerNum, uint32_t nTxs);
+    void waitTillComplete(LoadGenMode mode);
 
     void updateMinBalance();
 };
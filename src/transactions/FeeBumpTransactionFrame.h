@@ -41,10 +41,6 @@ class FeeBumpTransactionFrame : public TransactionFrameBase
 
     void removeOneTimeSignerKeyFromFeeSource(AbstractLedgerTxn& ltx) const;
 
-  protected:
-    void resetResults(LedgerHeader const& header, int64_t baseFee,
-                      bool applying);
-
   public:
     FeeBumpTransactionFrame(Hash const& networkID,
                             TransactionEnvelope const& envelope);
@@ -56,6 +52,9 @@ class FeeBumpTransactionFrame : public TransactionFrameBase
 
     virtual ~FeeBumpTransactionFrame(){};
 
+    void resetResults(LedgerHeader const& header, int64_t baseFee,
+                      bool applying) override;
+
     bool apply(Application& app, AbstractLedgerTxn& ltx,
                TransactionMeta& meta) override;
 
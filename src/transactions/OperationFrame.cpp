@@ -195,6 +195,67 @@ OperationFrame::getResultCode() const
     return mResult.code();
 }
 
+template <typename T>
+static char const*
+resultCodeName(T code)
+{
+    auto name = xdr::xdr_traits<T>::enum_name(code);
+    return name ? name : "unknown";
+}
+
+char const*
+OperationFrame::getResultCodeName() const
+{
+    if (mResult.code() != opINNER)
+    {
+        return resultCodeName(mResult.code());
+    }
+    auto const& tr = mResult.tr();
+    switch (tr.type())
+    {
+    case CREATE_ACCOUNT:
+        return resultCodeName(tr.createAccountResult().code());
+    case PAYMENT:
+        return resultCodeName(tr.paymentResult().code());
+    case PATH_PAYMENT_STRICT_RECEIVE:
+        return resultCodeName(tr.pathPaymentStrictReceiveResult().code());
+    case MANAGE_SELL_OFFER:
+        return resultCodeName(tr.manageSellOfferResult().code());
+    case CREATE_PASSIVE_SELL_OFFER:
+        return resultCodeName(tr.createPassiveSellOfferResult().code());
+    case SET_OPTIONS:
+        return resultCodeName(tr.setOptionsResult().code());
+    case CHANGE_TRUST:
+        return resultCodeName(tr.changeTrustResult().code());
+    case ALLOW_TRUST:
+        return resultCodeName(tr.allowTrustResult().code());
+    case ACCOUNT_MERGE:
+        return resultCodeName(tr.accountMergeResult().code());
+    case INFLATION:
+        return resultCodeName(tr.inflationResult().code());
+    case MANAGE_DATA:
+        return resultCodeName(tr.manageDataResult().code());
+    case BUMP_SEQUENCE:
+        return resultCodeName(tr.bumpSeqResult().code());
+    case MANAGE_BUY_OFFER:
+        return resultCodeName(tr.manageBuyOfferResult().code());
+    case PATH_PAYMENT_STRICT_SEND:
+        return resultCodeName(tr.pathPaymentStrictSendResult().code());
+    case CREATE_CLAIMABLE_BALANCE:
+        return resultCodeName(tr.createClaimableBalanceResult().code());
+    case CLAIM_CLAIMABLE_BALANCE:
+        return resultCodeName(tr.claimClaimableBalanceResult().code());
+    case BEGIN_SPONSORING_FUTURE_RESERVES:
+        return resultCodeName(tr.beginSponsoringFutureReservesResult().code());
+    case END_SPONSORING_FUTURE_RESERVES:
+        return resultCodeName(tr.endSponsoringFutureReservesResult().code());
+    case REVOKE_SPONSORSHIP:
+        return resultCodeName(tr.revokeSponsorshipResult().code());
+    default:
+        return "unknown";
+    }
+}
+
 // called when determining if we should accept this operation.
 // called when determining if we should flood
 // make sure sig is correct
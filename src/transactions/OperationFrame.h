@@ -76,6 +76,10 @@ class OperationFrame
         return mResult;
     }
     OperationResultCode getResultCode() const;
+    // Name of the result code of the operation: the code of its own result
+    // (such as PAYMENT_UNDERFUNDED) if it ran, or else the outer code (such as
+    // opNO_ACCOUNT).
+    char const* getResultCodeName() const;
 
     bool checkValid(SignatureChecker& signatureChecker,
                     AbstractLedgerTxn& ltxOuter, bool forApply);
@@ -85,6 +85,23 @@ getOperations(TransactionEnvelope& env)
     }
 }
 
+xdr::xvector<Operation, MAX_OPS_PER_TX> const&
+getOperations(TransactionEnvelope const& env)
+{
+    switch (env.type())
+    {
+    case ENVELOPE_TYPE_TX_V0:
+        return env.v0().tx.operations;
+    case ENVELOPE_TYPE_TX:
+        return env.v1().tx.operations;
+    case ENVELOPE_TYPE_TX_FEE_BUMP:
+        assert(env.feeBump().tx.innerTx.type() == ENVELOPE_TYPE_TX);
+        return env.feeBump().tx.innerTx.v1().tx.operations;
+    default:
+        abort();
+    }
+}
+
 #ifdef BUILD_TESTS
 xdr::xvector<DecoratedSignature, 20>&
 getSignatures(TransactionFramePtr tx)
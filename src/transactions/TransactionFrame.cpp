@@ -14,10 +14,13 @@
 #include "herder/TxSetFrame.h"
 #include "invariant/InvariantDoesNotHold.h"
 #include "invariant/InvariantManager.h"
+#include "ledger/LedgerCloseTiming.h"
 #include "ledger/LedgerHeaderUtils.h"
+#include "ledger/LedgerManager.h"
 #include "ledger/LedgerTxn.h"
 #include "ledger/LedgerTxnEntry.h"
 #include "ledger/LedgerTxnHeader.h"
+#include "ledger/ParallelTxApply.h"
 #include "main/Application.h"
 #include "transactions/SignatureChecker.h"
 #include "transactions/SignatureUtils.h"
@@ -37,6 +40,7 @@
 
 #include "medida/meter.h"
 #include "medida/metrics_registry.h"
+#include "medida/timer.h"
 
 #include <algorithm>
 #include <numeric>
@@ -724,6 +728,9 @@ TransactionFrame::applyOperations(SignatureChecker& signatureChecker,
                                   TransactionMeta& outerMeta)
 {
     ZoneScoped;
+    // when applying speculatively, an exception most likely comes from going
+    // outside of the group's footprint: the serial re-apply reports it if not
+    auto speculative = SpeculativeApply::current();
     try
     {
         bool success = true;
@@ -737,11 +744,23 @@ TransactionFrame::applyOperations(SignatureChecker& signatureChecker,
 
         auto& opTimer =
             app.getMetrics().NewTimer({"ledger", "operation", "apply"});
+        auto& closeTiming = app.getLedgerManager().getCloseTiming();
         for (auto& op : mOperations)
         {
-            auto time = opTimer.TimeScope();
+            // a speculative apply only times the operations it commits
+            std::unique_ptr<medida::TimerContext> time;
+            if (!speculative)
+            {
+                time = std::make_unique<medida::TimerContext>(opTimer);
+            }
             LedgerTxn ltxOp(ltxTx);
+            auto sqlLoads = Database::getThreadSelectCount();
+            auto start = LedgerCloseTiming::Clock::now();
             bool txRes = op->apply(signatureChecker, ltxOp);
+            auto applied = LedgerCloseTiming::Clock::now();
+            LedgerCloseTiming::OperationCost cost(
+                op->getOperation().body.type(), op->getResultCodeName(),
+                applied - start, Database::getThreadSelectCount() - sqlLoads);
 
             if (!txRes)
             {
@@ -749,8 +768,28 @@ TransactionFrame::applyOperations(SignatureChecker& signatureChecker,
             }
             if (success)
             {
-                app.getInvariantManager().checkOnOperationApply(
-                    op->getOperation(), op->getResult(), ltxOp.getDelta());
+                auto delta = ltxOp.getDelta();
+                cost.countEntries(delta);
+                if (speculative)
+                {
+                    speculative->checkOnOperationApply(
+                        op->getOperation(), op->getResult(), std::move(delta));
+                }
+                else
+                {
+                    app.getInvariantManager().checkOnOperationApply(
+                        op->getOperation(), op->getResult(), delta);
+                    closeTiming.addInvariants(
+                        LedgerCloseTiming::Clock::now() - applied);
+                }
+            }
+            if (speculative)
+            {
+                speculative->addOperation(cost);
+            }
+            else
+            {
+                closeTiming.addOperation(cost);
             }
 
             if (txRes || ledgerVersion < 14)
@@ -819,22 +858,36 @@ TransactionFrame::applyOperations(SignatureChecker& signatureChecker,
     }
     catch (std::exception& e)
     {
-        CLOG(ERROR, "Tx") << "Exception while applying operations (txHash= "
-                          << xdr_to_string(getFullHash()) << "): " << e.what();
+        if (!speculative)
+        {
+            CLOG(ERROR, "Tx")
+                << "Exception while applying operations (txHash= "
+                << xdr_to_string(getFullHash()) << "): " << e.what();
+        }
     }
     catch (...)
     {
-        CLOG(ERROR, "Tx")
-            << "Unknown exception while applying operations (txHash= "
-            << xdr_to_string(getFullHash()) << ")";
+        if (!speculative)
+        {
+            CLOG(ERROR, "Tx")
+                << "Unknown exception while applying operations (txHash= "
+                << xdr_to_string(getFullHash()) << ")";
+        }
     }
 
     // This is only reachable if an exception is thrown
     getResult().result.code(txINTERNAL_ERROR);
 
-    auto& internalErrorCounter = app.getMetrics().NewCounter(
-        {"ledger", "transaction", "internal-error"});
-    internalErrorCounter.inc();
+    if (speculative)
+    {
+        speculative->abort();
+    }
+    else
+    {
+        auto& internalErrorCounter = app.getMetrics().NewCounter(
+            {"ledger", "transaction", "internal-error"});
+        internalErrorCounter.inc();
+    }
 
     // operations and txChangesAfter should already be empty at this point
     outerMeta.v2().operations.clear();
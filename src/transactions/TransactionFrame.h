@@ -146,7 +146,7 @@ class TransactionFrame : public TransactionFrameBase
     }
 
     void resetResults(LedgerHeader const& header, int64_t baseFee,
-                      bool applying);
+                      bool applying) override;
 
     TransactionEnvelope const& getEnvelope() const override;
     TransactionEnvelope& getEnvelope();
@@ -58,6 +58,12 @@ class TransactionFrameBase
 
     virtual void processFeeSeqNum(AbstractLedgerTxn& ltx, int64_t baseFee) = 0;
 
+    // Rebind fresh results for all operations, discarding the effects of any
+    // previous apply. feeCharged is recomputed from baseFee, so callers that
+    // need to preserve the fee charged by processFeeSeqNum must restore it.
+    virtual void resetResults(LedgerHeader const& header, int64_t baseFee,
+                              bool applying) = 0;
+
     virtual DiamnetMessage toDiamnetMessage() const = 0;
 };
 }
@@ -23,6 +23,15 @@ bufsz()
     return 0x40000;
 }
 
+// History files and buckets are read sequentially, to be decompressed and
+// hashed, in pieces of this size: a large buffer keeps the worker busy
+// inflating and hashing rather than waiting on reads.
+inline constexpr size_t
+readbufsz()
+{
+    return 0x100000;
+}
+
 // Platform-specific synchronous stream type.
 #ifdef _WIN32
 using stream_t = asio::windows::stream_handle;
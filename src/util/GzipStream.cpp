@@ -0,0 +1,242 @@
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/GzipStream.h"
+#include <Tracy.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+#include <string>
+#include <zlib.h>
+
+namespace diamnet
+{
+
+static size_t const GZIP_OUTPUT_CHUNK = 256 * 1024;
+
+static std::runtime_error
+zlibError(z_stream const& zs, std::string const& what)
+{
+    return std::runtime_error(what + (zs.msg ? std::string(": ") + zs.msg
+                                             : std::string()));
+}
+
+GunzipStream::GunzipStream()
+    : mStream(std::make_unique<z_stream>()), mOut(GZIP_OUTPUT_CHUNK)
+{
+    // 16 + MAX_WBITS: expect a gzip header and trailer
+    if (inflateInit2(mStream.get(), 16 + MAX_WBITS) != Z_OK)
+    {
+        throw zlibError(*mStream, "failed to initialize zlib");
+    }
+}
+
+GunzipStream::~GunzipStream()
+{
+    inflateEnd(mStream.get());
+}
+
+void
+GunzipStream::write(char const* data, size_t n, Output const& out)
+{
+    ZoneScoped;
+    auto& zs = *mStream;
+    while (n > 0)
+    {
+        auto chunk = std::min<size_t>(n, UINT_MAX);
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        zs.avail_in = static_cast<uInt>(chunk);
+        data += chunk;
+        n -= chunk;
+
+        bool more = true;
+        while (more)
+        {
+            if (mAtEnd)
+            {
+                // another gzip member follows
+                if (inflateReset(&zs) != Z_OK)
+                {
+                    throw zlibError(zs, "failed to reset zlib");
+                }
+                mAtEnd = false;
+            }
+            zs.next_out = mOut.data();
+            zs.avail_out = static_cast<uInt>(mOut.size());
+            int res = inflate(&zs, Z_NO_FLUSH);
+            if (res != Z_OK && res != Z_STREAM_END && res != Z_BUF_ERROR)
+            {
+                throw zlibError(zs, "corrupt gzip data");
+            }
+            size_t produced = mOut.size() - zs.avail_out;
+            if (produced > 0)
+            {
+                out(reinterpret_cast<char const*>(mOut.data()), produced);
+            }
+            if (res == Z_STREAM_END)
+            {
+                mAtEnd = true;
+                more = zs.avail_in > 0;
+            }
+            else
+            {
+                // stop when all input is consumed and no output is pending
+                more = (zs.avail_in > 0 || zs.avail_out == 0) &&
+                       !(res == Z_BUF_ERROR && produced == 0);
+            }
+        }
+    }
+}
+
+GzipStream::GzipStream(int level)
+    : mStream(std::make_unique<z_stream>()), mOut(GZIP_OUTPUT_CHUNK)
+{
+    // 16 + MAX_WBITS: write a gzip header and trailer
+    if (deflateInit2(mStream.get(), level, Z_DEFLATED, 16 + MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        throw zlibError(*mStream, "failed to initialize zlib");
+    }
+}
+
+GzipStream::~GzipStream()
+{
+    deflateEnd(mStream.get());
+}
+
+void
+GzipStream::deflateAll(int flush, Output const& out)
+{
+    auto& zs = *mStream;
+    int res;
+    do
+    {
+        zs.next_out = mOut.data();
+        zs.avail_out = static_cast<uInt>(mOut.size());
+        res = deflate(&zs, flush);
+        if (res == Z_STREAM_ERROR)
+        {
+            throw zlibError(zs, "failed to compress");
+        }
+        size_t produced = mOut.size() - zs.avail_out;
+        if (produced > 0)
+        {
+            out(reinterpret_cast<char const*>(mOut.data()), produced);
+        }
+    } while (flush == Z_FINISH ? res != Z_STREAM_END
+                               : (zs.avail_in > 0 || zs.avail_out == 0));
+}
+
+void
+GzipStream::write(char const* data, size_t n, Output const& out)
+{
+    ZoneScoped;
+    auto& zs = *mStream;
+    while (n > 0)
+    {
+        auto chunk = std::min<size_t>(n, UINT_MAX);
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        zs.avail_in = static_cast<uInt>(chunk);
+        data += chunk;
+        n -= chunk;
+        deflateAll(Z_NO_FLUSH, out);
+    }
+}
+
+void
+GzipStream::finish(Output const& out)
+{
+    ZoneScoped;
+    mStream->next_in = nullptr;
+    mStream->avail_in = 0;
+    deflateAll(Z_FINISH, out);
+}
+
+GzipBlock
+gzipCompressBlock(char const* dict, size_t dictLen, char const* data,
+                  size_t n, bool last, int level)
+{
+    ZoneScoped;
+    GzipBlock block;
+    block.mSize = n;
+    z_stream zs{};
+    // -MAX_WBITS: raw deflate data, without header or trailer
+    if (deflateInit2(&zs, level, Z_DEFLATED, -MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        throw zlibError(zs, "failed to initialize zlib");
+    }
+    std::unique_ptr<z_stream, int (*)(z_stream*)> guard(&zs, deflateEnd);
+
+    if (dictLen > 0 &&
+        deflateSetDictionary(&zs, reinterpret_cast<Bytef const*>(dict),
+                             static_cast<uInt>(dictLen)) != Z_OK)
+    {
+        throw zlibError(zs, "failed to set dictionary");
+    }
+
+    // Z_SYNC_FLUSH ends the block on a byte boundary without marking it the
+    // last one, so the next block's data can simply follow it.
+    int flush = last ? Z_FINISH : Z_SYNC_FLUSH;
+    std::vector<unsigned char> buf(GZIP_OUTPUT_CHUNK);
+    while (true)
+    {
+        auto chunk = std::min<size_t>(n, UINT_MAX);
+        block.mCrc = crc32(block.mCrc, reinterpret_cast<Bytef const*>(data),
+                           static_cast<uInt>(chunk));
+        zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        zs.avail_in = static_cast<uInt>(chunk);
+        data += chunk;
+        n -= chunk;
+        int f = n > 0 ? Z_NO_FLUSH : flush;
+        int res;
+        do
+        {
+            zs.next_out = buf.data();
+            zs.avail_out = static_cast<uInt>(buf.size());
+            res = deflate(&zs, f);
+            if (res == Z_STREAM_ERROR)
+            {
+                throw zlibError(zs, "failed to compress");
+            }
+            block.mData.append(reinterpret_cast<char const*>(buf.data()),
+                               buf.size() - zs.avail_out);
+        } while (f == Z_FINISH ? res != Z_STREAM_END
+                               : (zs.avail_in > 0 || zs.avail_out == 0));
+        if (n == 0)
+        {
+            break;
+        }
+    }
+    return block;
+}
+
+std::string
+gzipHeader()
+{
+    // magic, deflate, no flags, no mtime, no extra flags, unix
+    return std::string("\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\x03", 10);
+}
+
+std::string
+gzipTrailer(uint32_t crc, uint64_t size)
+{
+    std::string res(8, '\0');
+    auto isize = static_cast<uint32_t>(size);
+    for (int i = 0; i < 4; ++i)
+    {
+        res[i] = static_cast<char>((crc >> (8 * i)) & 0xff);
+        res[4 + i] = static_cast<char>((isize >> (8 * i)) & 0xff);
+    }
+    return res;
+}
+
+uint32_t
+gzipCombineCrc(uint32_t crc1, uint32_t crc2, uint64_t size2)
+{
+    return static_cast<uint32_t>(
+        crc32_combine(crc1, crc2, static_cast<z_off_t>(size2)));
+}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/NonCopyable.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct z_stream_s;
+
+namespace diamnet
+{
+
+// Incremental gzip decompressor: input is fed in as it is read and output is
+// handed to a callback as it is produced, so a file can be decompressed and
+// processed in a single pass without an intermediate copy. Like `gzip -d`,
+// accepts a concatenation of gzip members.
+class GunzipStream : NonMovableOrCopyable
+{
+    std::unique_ptr<z_stream_s> mStream;
+    std::vector<unsigned char> mOut;
+    bool mAtEnd{false};
+
+  public:
+    using Output = std::function<void(char const*, size_t)>;
+
+    GunzipStream();
+    ~GunzipStream();
+
+    // Decompresses n bytes of input, calling out on each piece of output.
+    // Throws std::runtime_error on corrupt input.
+    void write(char const* data, size_t n, Output const& out);
+
+    // True if the input so far ends at the end of a gzip member; checked
+    // after the last write to detect truncated input.
+    bool
+    atEnd() const
+    {
+        return mAtEnd;
+    }
+};
+
+// Incremental gzip compressor producing a single gzip member, the
+// counterpart of GunzipStream.
+class GzipStream : NonMovableOrCopyable
+{
+    std::unique_ptr<z_stream_s> mStream;
+    std::vector<unsigned char> mOut;
+
+    void deflateAll(int flush, GunzipStream::Output const& out);
+
+  public:
+    using Output = GunzipStream::Output;
+
+    explicit GzipStream(int level = GZIP_DEFAULT_LEVEL);
+    ~GzipStream();
+
+    // Compresses n bytes of input, calling out on each piece of output.
+    void write(char const* data, size_t n, Output const& out);
+
+    // Flushes the remaining output and the gzip trailer.
+    void finish(Output const& out);
+
+    // zlib's default, the same as gzip's
+    static int const GZIP_DEFAULT_LEVEL = -1;
+};
+
+// A gzip member can also be compressed pigz-style, in blocks that are
+// independent of each other and so can be compressed in parallel: each block
+// is raw deflate data primed with (up to) GZIP_WINDOW_SIZE bytes of the input
+// preceding it, ending on a byte boundary, and the member is gzipHeader(),
+// the blocks in order, then gzipTrailer() of the combined CRC and size.
+size_t const GZIP_WINDOW_SIZE = 32 * 1024;
+
+struct GzipBlock
+{
+    std::string mData;
+    uint32_t mCrc{0};
+    uint64_t mSize{0};
+};
+
+GzipBlock gzipCompressBlock(char const* dict, size_t dictLen, char const* data,
+                            size_t n, bool last,
+                            int level = GzipStream::GZIP_DEFAULT_LEVEL);
+std::string gzipHeader();
+std::string gzipTrailer(uint32_t crc, uint64_t size);
+// CRC of the concatenation of two pieces of input, from the CRC of each.
+uint32_t gzipCombineCrc(uint32_t crc1, uint32_t crc2, uint64_t size2);
+}
@@ -6,6 +6,7 @@
 #include "lib/util/finally.h"
 #include "util/Timer.h"
 #include <Tracy.hpp>
+#include <algorithm>
 #include <cassert>
 
 namespace diamnet
@@ -27,6 +28,7 @@ class Scheduler::ActionQueue
 
     std::string mName;
     ActionType mType;
+    bool mThreadSafe;
     nsecs mTotalService{0};
     std::chrono::steady_clock::time_point mLastService;
     std::deque<Element> mActions;
@@ -39,10 +41,11 @@ class Scheduler::ActionQueue
     std::list<Qptr>::iterator mIdlePosition;
 
   public:
-    ActionQueue(std::string const& name, ActionType type,
+    ActionQueue(std::string const& name, ActionType type, bool threadSafe,
                 std::list<Qptr>& idleList)
         : mName(name)
         , mType(type)
+        , mThreadSafe(threadSafe)
         , mLastService(std::chrono::steady_clock::time_point::max())
         , mIdleList(idleList)
         , mIdlePosition(mIdleList.end())
@@ -85,6 +88,12 @@ class Scheduler::ActionQueue
         return mType;
     }
 
+    bool
+    isThreadSafe() const
+    {
+        return mThreadSafe;
+    }
+
     nsecs
     totalService() const
     {
@@ -140,23 +149,21 @@ class Scheduler::ActionQueue
         mActions.emplace_back(std::move(elt));
     }
 
-    void
-    runNext(VirtualClock& clock, nsecs minTotalService)
+    Action
+    takeNext()
     {
-        ZoneScoped;
-        ZoneText(mName.c_str(), mName.size());
-        auto before = clock.now();
         Action action = std::move(mActions.front().mAction);
         mActions.pop_front();
+        return action;
+    }
 
-        auto fini = gsl::finally([&]() {
-            auto after = clock.now();
-            nsecs duration = std::chrono::duration_cast<nsecs>(after - before);
-            mTotalService = std::max(mTotalService + duration, minTotalService);
-            mLastService = after;
-        });
-
-        action();
+    void
+    noteService(VirtualClock::time_point before,
+                VirtualClock::time_point after, nsecs minTotalService)
+    {
+        nsecs duration = std::chrono::duration_cast<nsecs>(after - before);
+        mTotalService = std::max(mTotalService + duration, minTotalService);
+        mLastService = after;
     }
 };
 
@@ -165,12 +172,108 @@ Scheduler::Scheduler(VirtualClock& clock,
     : mRunnableActionQueues([](Qptr a, Qptr b) -> bool {
         return a->totalService() > b->totalService();
     })
+    , mRunnableThreadSafeActionQueues([](Qptr a, Qptr b) -> bool {
+        return a->totalService() > b->totalService();
+    })
     , mClock(clock)
     , mLatencyWindow(latencyWindow)
 {
     setOverloaded(false);
 }
 
+Scheduler::~Scheduler()
+{
+    joinWorkers();
+}
+
+void
+Scheduler::startWorkers(size_t n)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    assert(!mStoppingWorkers);
+    ++mWorkerUsers;
+    while (mWorkers.size() < n)
+    {
+        mWorkers.emplace_back([this]() { runWorker(); });
+    }
+}
+
+void
+Scheduler::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        assert(mWorkerUsers > 0);
+        if (--mWorkerUsers > 0)
+        {
+            return;
+        }
+    }
+    joinWorkers();
+}
+
+void
+Scheduler::joinWorkers()
+{
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mWorkerUsers = 0;
+        mStoppingWorkers = true;
+        workers = std::move(mWorkers);
+        mWorkers.clear();
+    }
+    mThreadSafeActionQueueRunnable.notify_all();
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStoppingWorkers = false;
+    while (!mRunnableThreadSafeActionQueues.empty())
+    {
+        mRunnableActionQueues.push(mRunnableThreadSafeActionQueues.top());
+        mRunnableThreadSafeActionQueues.pop();
+    }
+}
+
+void
+Scheduler::runWorker()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true)
+    {
+        mThreadSafeActionQueueRunnable.wait(lock, [this]() {
+            return mStoppingWorkers ||
+                   !mRunnableThreadSafeActionQueues.empty();
+        });
+        if (mStoppingWorkers)
+        {
+            return;
+        }
+        auto q = mRunnableThreadSafeActionQueues.top();
+        mRunnableThreadSafeActionQueues.pop();
+        runQueue(q, lock, true);
+    }
+}
+
+void
+Scheduler::makeRunnable(Qptr q)
+{
+    // mWorkers is emptied as soon as workers start stopping, so a queue
+    // requeued by a stopping worker goes back to the main thread
+    if (q->isThreadSafe() && !mWorkers.empty())
+    {
+        mRunnableThreadSafeActionQueues.push(q);
+        mThreadSafeActionQueueRunnable.notify_one();
+    }
+    else
+    {
+        mRunnableActionQueues.push(q);
+    }
+}
+
 void
 Scheduler::trimSingleActionQueue(Qptr q, VirtualClock::time_point now)
 {
@@ -209,16 +312,20 @@ Scheduler::setOverloaded(bool overloaded)
 }
 
 void
-Scheduler::enqueue(std::string&& name, Action&& action, ActionType type)
+Scheduler::enqueue(std::string&& name, Action&& action, ActionType type,
+                   bool threadSafe)
 {
+    std::lock_guard<std::mutex> lock(mMutex);
     auto key = std::make_pair(name, type);
     auto qi = mAllActionQueues.find(key);
+    bool runnable = false;
     if (qi == mAllActionQueues.end())
     {
         mStats.mQueuesActivatedFromFresh++;
-        auto q = std::make_shared<ActionQueue>(name, type, mIdleActionQueues);
+        auto q = std::make_shared<ActionQueue>(name, type, threadSafe,
+                                               mIdleActionQueues);
         qi = mAllActionQueues.emplace(key, q).first;
-        mRunnableActionQueues.push(qi->second);
+        runnable = true;
     }
     else
     {
@@ -227,86 +334,112 @@ Scheduler::enqueue(std::string&& name, Action&& action, ActionType type)
             assert(qi->second->isEmpty());
             mStats.mQueuesActivatedFromIdle++;
             qi->second->removeFromIdleList();
-            mRunnableActionQueues.push(qi->second);
+            runnable = true;
         }
     }
     mStats.mActionsEnqueued++;
     qi->second->enqueue(mClock, std::move(action));
     mSize += 1;
+    if (runnable)
+    {
+        makeRunnable(qi->second);
+    }
 }
 
 size_t
 Scheduler::runOne()
 {
-    auto start = mClock.now();
-    trimIdleActionQueues(start);
+    std::unique_lock<std::mutex> lock(mMutex);
+    trimIdleActionQueues(mClock.now());
     if (mRunnableActionQueues.empty())
     {
-        assert(mSize == 0);
+        assert(mSize == 0 || !mWorkers.empty());
         return 0;
     }
     else
     {
         auto q = mRunnableActionQueues.top();
         mRunnableActionQueues.pop();
-        trimSingleActionQueue(q, start);
+        runQueue(q, lock, false);
+        return 1;
+    }
+}
 
-        auto putQueueBackInIdleOrActive = gsl::finally([&]() {
-            auto now = mClock.now();
-            if (q->isOverloaded(mLatencyWindow, now))
-            {
-                if (mOverloadedStart ==
-                    std::chrono::steady_clock::time_point::max())
-                {
-                    setOverloaded(true);
-                }
-            }
-            else if (mOverloadedStart <
-                     std::chrono::steady_clock::time_point::max())
-            {
-                // see if we're not overloaded anymore
-                bool overloaded = std::any_of(
-                    mAllActionQueues.begin(), mAllActionQueues.end(),
-                    [&](std::pair<std::pair<std::string, ActionType>,
-                                  Qptr> const& qp) {
-                        return qp.second->isOverloaded(mLatencyWindow, now);
-                    });
-                if (!overloaded)
-                {
-                    setOverloaded(false);
-                }
-            }
-            if (q->isEmpty())
+void
+Scheduler::runQueue(Qptr q, std::unique_lock<std::mutex>& lock, bool onWorker)
+{
+    trimSingleActionQueue(q, mClock.now());
+
+    auto putQueueBackInIdleOrActive = gsl::finally([&]() {
+        auto now = mClock.now();
+        if (q->isOverloaded(mLatencyWindow, now))
+        {
+            if (mOverloadedStart ==
+                std::chrono::steady_clock::time_point::max())
             {
-                mStats.mQueuesSuspended++;
-                q->addToIdleList();
+                setOverloaded(true);
             }
-            else
+        }
+        else if (mOverloadedStart <
+                 std::chrono::steady_clock::time_point::max())
+        {
+            // see if we're not overloaded anymore
+            bool overloaded = std::any_of(
+                mAllActionQueues.begin(), mAllActionQueues.end(),
+                [&](std::pair<std::pair<std::string, ActionType>, Qptr> const&
+                        qp) {
+                    return qp.second->isOverloaded(mLatencyWindow, now);
+                });
+            if (!overloaded)
             {
-                mRunnableActionQueues.push(q);
+                setOverloaded(false);
             }
-        });
+        }
+        if (q->isEmpty())
+        {
+            mStats.mQueuesSuspended++;
+            q->addToIdleList();
+        }
+        else
+        {
+            makeRunnable(q);
+        }
+    });
 
-        if (!q->isEmpty())
+    if (!q->isEmpty())
+    {
+        // We pass along a "minimum service time" floor that the service
+        // time of the queue will be incremented to, at minimum.
+        auto minTotalService = mMaxTotalService - mLatencyWindow;
+        mSize -= 1;
+        mStats.mActionsDequeued++;
+        if (onWorker)
         {
-            // We pass along a "minimum service time" floor that the service
-            // time of the queue will be incremented to, at minimum.
-            auto minTotalService = mMaxTotalService - mLatencyWindow;
-            mSize -= 1;
-            mStats.mActionsDequeued++;
-            auto updateMaxTotalService = gsl::finally([&]() {
-                mMaxTotalService =
-                    std::max(q->totalService(), mMaxTotalService);
-            });
-            q->runNext(mClock, minTotalService);
+            mStats.mActionsDequeuedOnWorkers++;
         }
-        return 1;
+        Action action = q->takeNext();
+
+        // Other queues are scheduled while the action runs, but not q: it's
+        // in neither the runnable sets nor the idle list until it's put back.
+        lock.unlock();
+        auto before = mClock.now();
+        auto relock = gsl::finally([&]() {
+            auto after = mClock.now();
+            lock.lock();
+            q->noteService(before, after, minTotalService);
+            mMaxTotalService = std::max(q->totalService(), mMaxTotalService);
+        });
+
+        ZoneScoped;
+        ZoneText(q->name().c_str(), q->name().size());
+        action();
     }
 }
 
 std::chrono::seconds
 Scheduler::getOverloadedDuration() const
 {
+    std::lock_guard<std::mutex> lock(mMutex);
     auto now = mClock.now();
     std::chrono::seconds res;
     if (now > mOverloadedStart)
@@ -327,6 +460,7 @@ Scheduler::getOverloadedDuration() const
 std::shared_ptr<Scheduler::ActionQueue>
 Scheduler::getExistingQueue(std::string const& name, ActionType type) const
 {
+    std::lock_guard<std::mutex> lock(mMutex);
     auto qi = mAllActionQueues.find(std::make_pair(name, type));
     if (qi == mAllActionQueues.end())
     {
@@ -339,6 +473,7 @@ std::string const&
 Scheduler::nextQueueToRun() const
 {
     static std::string empty;
+    std::lock_guard<std::mutex> lock(mMutex);
     if (mRunnableActionQueues.empty())
     {
         return empty;
@@ -5,13 +5,17 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include <chrono>
+#include <condition_variable>
 #include <functional>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <set>
 #include <string>
+#include <thread>
+#include <vector>
 
 // This class implements a multi-queue scheduler for "actions" (deferred-work
 // callbacks that some subsystem wants to run "soon" on the main thread),
@@ -99,6 +103,17 @@
 //
 //   - We record the enqueue time and "droppability" of an action, to allow us
 //     to measure load level and perform load shedding.
+//
+// Finally, not every action needs the main thread: a queue can be marked
+// thread-safe when it's created, and once the scheduler has been given worker
+// threads (startWorkers) its actions run on them instead, in parallel with the
+// main thread and with each other. Worker-run queues are scheduled just like
+// the others -- by least attained service, one action of a queue at a time
+// and in order, with the same latency window for load shedding -- only from a
+// runnable set of their own, so that they never delay the main thread's
+// actions. Without workers, thread-safe queues run on the main thread like any
+// other. Several users (applications sharing a clock) may ask for workers;
+// they're stopped when the last one is done with them.
 
 namespace diamnet
 {
@@ -119,6 +134,7 @@ class Scheduler
     {
         size_t mActionsEnqueued{0};
         size_t mActionsDequeued{0};
+        size_t mActionsDequeuedOnWorkers{0};
         size_t mActionsDroppedDueToOverload{0};
         size_t mQueuesActivatedFromFresh{0};
         size_t mQueuesActivatedFromIdle{0};
@@ -135,10 +151,24 @@ class Scheduler
     // Stores the Runnable ActionQueues, with top() being the ActionQueue with
     // the least total service time. An ActionQueue is "runnable" if it is
     // nonempty; empty ActionQueues are considered "idle" and are tracked
-    // in the mIdleActionQueues member below.
-    std::priority_queue<Qptr, std::vector<Qptr>,
-                        std::function<bool(Qptr, Qptr)>>
-        mRunnableActionQueues;
+    // in the mIdleActionQueues member below. An ActionQueue that is running an
+    // action is in neither, which keeps its actions serial.
+    using RunnableQueues =
+        std::priority_queue<Qptr, std::vector<Qptr>,
+                            std::function<bool(Qptr, Qptr)>>;
+    RunnableQueues mRunnableActionQueues;
+
+    // The runnable thread-safe ActionQueues, when there are workers to run
+    // them.
+    RunnableQueues mRunnableThreadSafeActionQueues;
+
+    // Guards all the state of the scheduler; released while an action runs.
+    mutable std::mutex mMutex;
+    std::condition_variable mThreadSafeActionQueueRunnable;
+    std::vector<std::thread> mWorkers;
+    bool mStoppingWorkers{false};
+    // startWorkers calls not yet matched by a stopWorkers call
+    size_t mWorkerUsers{0};
 
     Stats mStats;
 
@@ -187,6 +217,14 @@ class Scheduler
                                std::chrono::steady_clock::time_point now);
     void trimIdleActionQueues(std::chrono::steady_clock::time_point now);
 
+    // Adds q to the runnable set it's run from.
+    void makeRunnable(Qptr q);
+    // Runs 0 or 1 action from q, a runnable queue just taken out of its set,
+    // then puts q back into it (or the idle list).
+    void runQueue(Qptr q, std::unique_lock<std::mutex>& lock, bool onWorker);
+    void runWorker();
+    void joinWorkers();
+
     // List of ActionQueues that are currently idle. Idle ActionQueues maintain
     // a list<Qptr>::iterator pointing to their own position in this list, which
     // can be used to make them runnable at any time. Idled ActionQueues are
@@ -203,13 +241,25 @@ class Scheduler
 
   public:
     Scheduler(VirtualClock& clock, std::chrono::nanoseconds latencyWindow);
+    ~Scheduler();
 
-    // Adds an action to the named ActionQueue with a given type.
-    void enqueue(std::string&& name, Action&& action, ActionType type);
+    // Adds an action to the named ActionQueue with a given type. Whether the
+    // queue is thread-safe is fixed by the action that creates it.
+    void enqueue(std::string&& name, Action&& action, ActionType type,
+                 bool threadSafe = false);
 
-    // Runs 0 or 1 action from the next ActionQueue in the queue-of-queues.
+    // Runs 0 or 1 action from the next ActionQueue in the queue-of-queues;
+    // called from the main thread.
     size_t runOne();
 
+    // Makes sure at least n threads run the actions of thread-safe
+    // ActionQueues, until the matching stopWorkers call.
+    void startWorkers(size_t n);
+    // Once every startWorkers call is matched, waits for the actions being
+    // run by workers to finish and stops the workers; thread-safe
+    // ActionQueues are run by runOne from then on.
+    void stopWorkers();
+
     // Returns how long ActionQueues have been overloaded (0 means not
     // overloaded)
     std::chrono::seconds getOverloadedDuration() const;
@@ -217,18 +267,21 @@ class Scheduler
     size_t
     size() const
     {
+        std::lock_guard<std::mutex> lock(mMutex);
         return mSize;
     }
 
     std::chrono::nanoseconds
     maxTotalService() const
     {
+        std::lock_guard<std::mutex> lock(mMutex);
         return mMaxTotalService;
     }
 
-    Stats const&
+    Stats
     stats() const
     {
+        std::lock_guard<std::mutex> lock(mMutex);
         return mStats;
     }
 
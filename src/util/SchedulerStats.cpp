@@ -0,0 +1,162 @@
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/SchedulerStats.h"
+#include "lib/json/json.h"
+#include <medida/metrics_registry.h>
+#include <medida/stats/snapshot.h>
+#include <medida/timer.h>
+
+#include <algorithm>
+
+namespace diamnet
+{
+
+constexpr std::chrono::seconds SchedulerStats::DEFAULT_WINDOW;
+size_t const SchedulerStats::DEFAULT_SLOWEST;
+
+namespace
+{
+bool
+slower(SchedulerStats::SlowAction const& a, SchedulerStats::SlowAction const& b)
+{
+    return a.mRuntime > b.mRuntime;
+}
+
+Json::Value
+timerJson(medida::Timer& timer)
+{
+    // medida timers report in their duration unit, milliseconds by default
+    auto snap = timer.GetSnapshot();
+    Json::Value res;
+    res["count"] = static_cast<Json::UInt64>(timer.count());
+    res["p50"] = snap.getMedian();
+    res["p99"] = snap.get99thPercentile();
+    res["max"] = timer.max();
+    return res;
+}
+}
+
+SchedulerStats::SchedulerStats(medida::MetricsRegistry& registry,
+                               std::chrono::seconds window, size_t slowest)
+    : mRegistry(registry)
+    , mWindow(window)
+    , mSlowest(slowest)
+    , mWindowStart(Clock::now())
+{
+}
+
+SchedulerStats::ActionTimers&
+SchedulerStats::getTimers(std::string const& name)
+{
+    auto it = mTimers.find(name);
+    if (it == mTimers.end())
+    {
+        ActionTimers timers{
+            mRegistry.NewTimer({"scheduler", "action-delay", name}),
+            mRegistry.NewTimer({"scheduler", "action-runtime", name})};
+        it = mTimers.emplace(name, timers).first;
+    }
+    return it->second;
+}
+
+void
+SchedulerStats::rotate(Clock::time_point now)
+{
+    if (now - mWindowStart < mWindow)
+    {
+        return;
+    }
+    if (now - mWindowStart < 2 * mWindow)
+    {
+        mPreviousSlowest = std::move(mCurrentSlowest);
+    }
+    else
+    {
+        // nothing ran for a whole window
+        mPreviousSlowest.clear();
+    }
+    mCurrentSlowest.clear();
+    mWindowStart = now;
+}
+
+void
+SchedulerStats::recordAction(std::string const& name,
+                             std::chrono::nanoseconds delay,
+                             std::chrono::nanoseconds runtime,
+                             Clock::time_point finished)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto& timers = getTimers(name);
+    timers.mDelay.Update(delay);
+    timers.mRuntime.Update(runtime);
+
+    rotate(finished);
+    if (mSlowest == 0 || (mCurrentSlowest.size() == mSlowest &&
+                          mCurrentSlowest.back().mRuntime >= runtime))
+    {
+        return;
+    }
+    SlowAction action{name, delay, runtime, finished};
+    auto pos = std::upper_bound(mCurrentSlowest.begin(), mCurrentSlowest.end(),
+                                action, slower);
+    mCurrentSlowest.insert(pos, std::move(action));
+    if (mCurrentSlowest.size() > mSlowest)
+    {
+        mCurrentSlowest.pop_back();
+    }
+}
+
+std::vector<SchedulerStats::SlowAction>
+SchedulerStats::getSlowestActions(Clock::time_point now) const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::vector<SlowAction> res;
+    for (auto const* v : {&mCurrentSlowest, &mPreviousSlowest})
+    {
+        std::copy_if(v->begin(), v->end(), std::back_inserter(res),
+                     [&](SlowAction const& a) {
+                         return a.mFinished + mWindow >= now;
+                     });
+    }
+    std::stable_sort(res.begin(), res.end(), slower);
+    if (res.size() > mSlowest)
+    {
+        res.resize(mSlowest);
+    }
+    return res;
+}
+
+Json::Value
+SchedulerStats::getJson(Clock::time_point now) const
+{
+    using std::chrono::duration;
+    Json::Value res;
+    res["window_seconds"] = static_cast<Json::UInt64>(mWindow.count());
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto& actions = res["actions"];
+        for (auto const& kv : mTimers)
+        {
+            auto& a = actions[kv.first];
+            a["delay_ms"] = timerJson(kv.second.mDelay);
+            a["runtime_ms"] = timerJson(kv.second.mRuntime);
+        }
+    }
+
+    auto& slowest = res["slowest"];
+    slowest = Json::arrayValue;
+    for (auto const& a : getSlowestActions(now))
+    {
+        Json::Value v;
+        v["name"] = a.mName;
+        v["delay_ms"] = duration<double, std::milli>(a.mDelay).count();
+        v["runtime_ms"] = duration<double, std::milli>(a.mRuntime).count();
+        v["seconds_ago"] =
+            std::chrono::duration<double>(now - a.mFinished).count();
+        slowest.append(v);
+    }
+    return res;
+}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "lib/json/json-forwards.h"
+#include "util/NonCopyable.h"
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace medida
+{
+class MetricsRegistry;
+class Timer;
+}
+
+namespace diamnet
+{
+
+// Records, for each name of action run by the Scheduler, how long actions
+// waited in their queue and how long they ran, as the medida timers
+// scheduler.action-delay.<name> and scheduler.action-runtime.<name>; and
+// keeps the slowest actions of the last window, so a late ledger close can be
+// traced to what held up the main thread without attaching a profiler.
+// Actions may run on several threads, so this is thread-safe.
+class SchedulerStats : NonMovableOrCopyable
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    struct SlowAction
+    {
+        std::string mName;
+        std::chrono::nanoseconds mDelay;
+        std::chrono::nanoseconds mRuntime;
+        Clock::time_point mFinished;
+    };
+
+    SchedulerStats(medida::MetricsRegistry& registry,
+                   std::chrono::seconds window = DEFAULT_WINDOW,
+                   size_t slowest = DEFAULT_SLOWEST);
+
+    void recordAction(std::string const& name, std::chrono::nanoseconds delay,
+                      std::chrono::nanoseconds runtime,
+                      Clock::time_point finished = Clock::now());
+
+    // The slowest actions that finished in the last window, slowest first.
+    std::vector<SlowAction> getSlowestActions(Clock::time_point now) const;
+
+    // Per-action percentiles and the slowest actions, for the
+    // schedulerstats command.
+    Json::Value getJson(Clock::time_point now = Clock::now()) const;
+
+    static constexpr std::chrono::seconds DEFAULT_WINDOW{60};
+    static size_t const DEFAULT_SLOWEST = 20;
+
+  private:
+    struct ActionTimers
+    {
+        medida::Timer& mDelay;
+        medida::Timer& mRuntime;
+    };
+
+    medida::MetricsRegistry& mRegistry;
+    std::chrono::seconds const mWindow;
+    size_t const mSlowest;
+
+    mutable std::mutex mMutex;
+    std::map<std::string, ActionTimers> mTimers;
+    // The slowest actions of the window starting at mWindowStart and of the
+    // one before, each kept sorted slowest first and at most mSlowest long.
+    Clock::time_point mWindowStart;
+    std::vector<SlowAction> mCurrentSlowest;
+    std::vector<SlowAction> mPreviousSlowest;
+
+    ActionTimers& getTimers(std::string const& name);
+    void rotate(Clock::time_point now);
+};
+}
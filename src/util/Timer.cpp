@@ -392,7 +392,7 @@ VirtualClock::crank(bool block)
 
 void
 VirtualClock::postAction(std::function<void()>&& f, std::string&& name,
-                         Scheduler::ActionType type)
+                         Scheduler::ActionType type, bool threadSafe)
 {
     std::lock_guard<std::recursive_mutex> lock(mDispatchingMutex);
     if (!mDispatching)
@@ -406,7 +406,25 @@ VirtualClock::postAction(std::function<void()>&& f, std::string&& name,
         mDispatching = true;
         asio::post(mIOContext, []() {});
     }
-    mActionScheduler->enqueue(std::move(name), std::move(f), type);
+    mActionScheduler->enqueue(std::move(name), std::move(f), type, threadSafe);
+}
+
+void
+VirtualClock::startActionWorkers(size_t n)
+{
+    if (mMode == REAL_TIME)
+    {
+        mActionScheduler->startWorkers(n);
+    }
+}
+
+void
+VirtualClock::stopActionWorkers()
+{
+    if (mMode == REAL_TIME)
+    {
+        mActionScheduler->stopWorkers();
+    }
 }
 
 size_t
@@ -193,7 +193,14 @@ class VirtualClock
     time_point next() const;
 
     void postAction(std::function<void()>&& f, std::string&& name,
-                    Scheduler::ActionType type);
+                    Scheduler::ActionType type, bool threadSafe = false);
+
+    // Makes sure n threads run the actions posted as thread-safe, which
+    // otherwise run in crank() like any other, until the matching
+    // stopActionWorkers call. Only in REAL_TIME mode: tests in VIRTUAL_TIME
+    // count on every action running in crank().
+    void startActionWorkers(size_t n);
+    void stopActionWorkers();
 
     size_t getActionQueueSize() const;
     bool actionQueueIsOverloaded() const;
@@ -278,40 +278,22 @@ class XDROutputFileStream
         return isOpen();
     }
 
-    template <typename T>
+    // Writes raw, already framed bytes to the stream.
     void
-    writeOne(T const& t, SHA256* hasher = nullptr, size_t* bytesPut = nullptr)
+    writeBytes(char const* buf, size_t size)
     {
         ZoneScoped;
         if (!isOpen())
         {
             FileSystemException::failWith(
-                "XDROutputFileStream::writeOne() on non-open stream");
+                "XDROutputFileStream::writeBytes() on non-open stream");
         }
 
-        uint32_t sz = (uint32_t)xdr::xdr_size(t);
-        assert(sz < 0x80000000);
-
-        if (mBuf.size() < sz + 4)
-        {
-            mBuf.resize(sz + 4);
-        }
-
-        // Write 4 bytes of size, big-endian, with XDR 'continuation' bit set on
-        // high bit of high byte.
-        mBuf[0] = static_cast<char>((sz >> 24) & 0xFF) | '\x80';
-        mBuf[1] = static_cast<char>((sz >> 16) & 0xFF);
-        mBuf[2] = static_cast<char>((sz >> 8) & 0xFF);
-        mBuf[3] = static_cast<char>(sz & 0xFF);
-        xdr::xdr_put p(mBuf.data() + 4, mBuf.data() + 4 + sz);
-        xdr_argpack_archive(p, t);
-
-        size_t const to_write = sz + 4;
         size_t written = 0;
-        while (written < to_write)
+        while (written < size)
         {
             asio::error_code ec;
-            auto buf = asio::buffer(mBuf.data() + written, to_write - written);
+            auto b = asio::buffer(buf + written, size - written);
 #ifdef _WIN32
             // Calling asio::write_at on the asio::posix::stream_descriptor
             // will not even compile; so this one bit has to also be platform
@@ -319,14 +301,14 @@ class XDROutputFileStream
             if (mUsingRandomAccessHandle)
             {
                 size_t n = asio::write_at(
-                    mRandomAccessHandle, mRandomAccessNextWriteOffset, buf, ec);
+                    mRandomAccessHandle, mRandomAccessNextWriteOffset, b, ec);
                 written += n;
                 mRandomAccessNextWriteOffset += n;
             }
             else
 #endif
             {
-                written += asio::write(mBufferedWriteStream, buf, ec);
+                written += asio::write(mBufferedWriteStream, b, ec);
             }
             if (ec)
             {
@@ -338,11 +320,43 @@ class XDROutputFileStream
                 {
                     FileSystemException::failWith(
                         std::string(
-                            "XDROutputFileStream::writeOne() failed: ") +
+                            "XDROutputFileStream::writeBytes() failed: ") +
                         ec.message());
                 }
             }
         }
+    }
+
+    template <typename T>
+    void
+    writeOne(T const& t, SHA256* hasher = nullptr, size_t* bytesPut = nullptr)
+    {
+        ZoneScoped;
+        if (!isOpen())
+        {
+            FileSystemException::failWith(
+                "XDROutputFileStream::writeOne() on non-open stream");
+        }
+
+        uint32_t sz = (uint32_t)xdr::xdr_size(t);
+        assert(sz < 0x80000000);
+
+        if (mBuf.size() < sz + 4)
+        {
+            mBuf.resize(sz + 4);
+        }
+
+        // Write 4 bytes of size, big-endian, with XDR 'continuation' bit set on
+        // high bit of high byte.
+        mBuf[0] = static_cast<char>((sz >> 24) & 0xFF) | '\x80';
+        mBuf[1] = static_cast<char>((sz >> 16) & 0xFF);
+        mBuf[2] = static_cast<char>((sz >> 8) & 0xFF);
+        mBuf[3] = static_cast<char>(sz & 0xFF);
+        xdr::xdr_put p(mBuf.data() + 4, mBuf.data() + 4 + sz);
+        xdr_argpack_archive(p, t);
+
+        writeBytes(mBuf.data(), sz + 4);
+
         if (hasher)
         {
             hasher->add(ByteSlice(mBuf.data(), sz + 4));
@@ -0,0 +1,487 @@
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/ZoneStats.h"
+#include "lib/json/json.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace diamnet
+{
+
+size_t const ZoneStats::MAX_SITES;
+size_t const ZoneStats::MAX_TRACES;
+size_t const ZoneStats::MAX_TRACE_EVENTS;
+size_t const ZoneStats::HISTOGRAM_BUCKETS;
+
+namespace
+{
+using Counter = std::atomic<uint64_t>;
+
+struct Site
+{
+    char const* mName;
+    char const* mFunction;
+    char const* mFile;
+    uint32_t mLine;
+};
+
+// Counters of one site on one thread. Only the owning thread writes them, so
+// increments are plain loads and stores; the atomics let readers look at them
+// from other threads.
+struct SiteCounters
+{
+    Counter mCount{0};
+    Counter mTotalNs{0};
+    Counter mMaxNs{0};
+    std::array<Counter, ZoneStats::HISTOGRAM_BUCKETS> mHistogram{};
+};
+
+// The same, summed over threads.
+struct SiteTotals
+{
+    uint64_t mCount{0};
+    uint64_t mTotalNs{0};
+    uint64_t mMaxNs{0};
+    std::array<uint64_t, ZoneStats::HISTOGRAM_BUCKETS> mHistogram{};
+
+    void
+    add(SiteCounters const& c)
+    {
+        mCount += c.mCount.load(std::memory_order_relaxed);
+        mTotalNs += c.mTotalNs.load(std::memory_order_relaxed);
+        mMaxNs = std::max(mMaxNs, c.mMaxNs.load(std::memory_order_relaxed));
+        for (size_t i = 0; i < mHistogram.size(); ++i)
+        {
+            mHistogram[i] += c.mHistogram[i].load(std::memory_order_relaxed);
+        }
+    }
+};
+
+struct ThreadCounters
+{
+    // allocated on first use of each site
+    std::array<std::atomic<SiteCounters*>, ZoneStats::MAX_SITES> mSites{};
+    // generation of clear() the counters belong to
+    std::atomic<uint64_t> mGeneration{0};
+
+    ~ThreadCounters()
+    {
+        for (auto& s : mSites)
+        {
+            delete s.load(std::memory_order_relaxed);
+        }
+    }
+};
+
+struct TraceEvent
+{
+    size_t mSite;
+    uint32_t mDepth;
+    uint64_t mStartNs;
+    uint64_t mDurationNs;
+};
+
+struct TraceRecord
+{
+    uint64_t mId;
+    ZoneStats::Clock::time_point mStart;
+    uint64_t mDurationNs{0};
+    uint64_t mDropped{0};
+    std::vector<TraceEvent> mEvents;
+};
+
+struct Registry
+{
+    std::mutex mMutex;
+    std::array<Site, ZoneStats::MAX_SITES> mSites;
+    std::atomic<size_t> mNumSites{0};
+    std::vector<ThreadCounters*> mThreads;
+    // counters of the threads that exited
+    std::vector<SiteTotals> mRetired =
+        std::vector<SiteTotals>(ZoneStats::MAX_SITES);
+    std::atomic<uint64_t> mGeneration{0};
+    std::deque<std::unique_ptr<TraceRecord>> mTraces;
+};
+
+Registry&
+registry()
+{
+    // never destroyed: threads may exit, and retire their counters, after
+    // static destructors ran
+    static Registry* r = new Registry();
+    return *r;
+}
+
+// Registers the counters of the calling thread, and retires them when it
+// exits.
+class ThreadCountersHolder
+{
+    ThreadCounters* mCounters;
+
+  public:
+    ThreadCountersHolder() : mCounters(new ThreadCounters())
+    {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mMutex);
+        mCounters->mGeneration.store(r.mGeneration.load());
+        r.mThreads.emplace_back(mCounters);
+    }
+
+    ~ThreadCountersHolder()
+    {
+        auto& r = registry();
+        std::lock_guard<std::mutex> lock(r.mMutex);
+        if (mCounters->mGeneration.load() == r.mGeneration.load())
+        {
+            for (size_t i = 0; i < ZoneStats::MAX_SITES; ++i)
+            {
+                if (auto c = mCounters->mSites[i].load())
+                {
+                    r.mRetired[i].add(*c);
+                }
+            }
+        }
+        r.mThreads.erase(
+            std::find(r.mThreads.begin(), r.mThreads.end(), mCounters));
+        delete mCounters;
+    }
+
+    ThreadCounters&
+    get()
+    {
+        return *mCounters;
+    }
+};
+
+ThreadCounters&
+threadCounters()
+{
+    thread_local ThreadCountersHolder holder;
+    return holder.get();
+}
+
+// The trace being recorded by this thread, if any.
+struct ActiveTrace
+{
+    std::unique_ptr<TraceRecord> mRecord;
+    uint32_t mDepth{0};
+    // beginTrace calls not yet matched by endTrace
+    uint32_t mNesting{0};
+};
+thread_local ActiveTrace tTrace;
+
+size_t const NO_TRACE_EVENT = SIZE_MAX;
+
+uint64_t
+nanoseconds(ZoneStats::Clock::duration d)
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+}
+
+size_t
+histogramBucket(uint64_t ns)
+{
+    // floor(log2(ns)), by binary search over the bit positions
+    size_t b = 0;
+    for (size_t shift = 32; shift > 0; shift /= 2)
+    {
+        if (ns >> shift)
+        {
+            ns >>= shift;
+            b += shift;
+        }
+    }
+    return std::min(b, ZoneStats::HISTOGRAM_BUCKETS - 1);
+}
+
+void
+bump(Counter& c, uint64_t n)
+{
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+void
+record(size_t site, uint64_t ns)
+{
+    auto& tc = threadCounters();
+    auto generation = registry().mGeneration.load(std::memory_order_relaxed);
+    if (tc.mGeneration.load(std::memory_order_relaxed) != generation)
+    {
+        // clear() was called: start over
+        for (auto& s : tc.mSites)
+        {
+            if (auto c = s.load(std::memory_order_relaxed))
+            {
+                c->mCount.store(0, std::memory_order_relaxed);
+                c->mTotalNs.store(0, std::memory_order_relaxed);
+                c->mMaxNs.store(0, std::memory_order_relaxed);
+                for (auto& h : c->mHistogram)
+                {
+                    h.store(0, std::memory_order_relaxed);
+                }
+            }
+        }
+        tc.mGeneration.store(generation, std::memory_order_release);
+    }
+
+    auto c = tc.mSites[site].load(std::memory_order_relaxed);
+    if (!c)
+    {
+        c = new SiteCounters();
+        tc.mSites[site].store(c, std::memory_order_release);
+    }
+    bump(c->mCount, 1);
+    bump(c->mTotalNs, ns);
+    if (ns > c->mMaxNs.load(std::memory_order_relaxed))
+    {
+        c->mMaxNs.store(ns, std::memory_order_relaxed);
+    }
+    bump(c->mHistogram[histogramBucket(ns)], 1);
+}
+
+std::string
+siteName(Site const& s)
+{
+    return s.mName ? s.mName : s.mFunction;
+}
+
+double
+microseconds(uint64_t ns)
+{
+    return static_cast<double>(ns) / 1e3;
+}
+}
+
+size_t
+ZoneStats::registerSite(char const* name, char const* function,
+                        char const* file, uint32_t line)
+{
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mMutex);
+    auto id = r.mNumSites.load();
+    if (id == MAX_SITES)
+    {
+        // out of sites: this zone is not counted
+        return MAX_SITES;
+    }
+    r.mSites[id] = Site{name, function, file, line};
+    r.mNumSites.store(id + 1);
+    return id;
+}
+
+ZoneStats::Scope::Scope(size_t site, bool active)
+    : mSite(site), mActive(active && site < MAX_SITES)
+{
+    mTraceEvent = NO_TRACE_EVENT;
+    if (!mActive)
+    {
+        return;
+    }
+    mStart = Clock::now();
+    if (tracing() && tTrace.mRecord)
+    {
+        auto& rec = *tTrace.mRecord;
+        if (rec.mEvents.size() < MAX_TRACE_EVENTS)
+        {
+            mTraceEvent = rec.mEvents.size();
+            rec.mEvents.emplace_back(TraceEvent{
+                site, tTrace.mDepth, nanoseconds(mStart - rec.mStart), 0});
+        }
+        else
+        {
+            ++rec.mDropped;
+        }
+        ++tTrace.mDepth;
+    }
+}
+
+ZoneStats::Scope::~Scope()
+{
+    if (!mActive)
+    {
+        return;
+    }
+    auto ns = nanoseconds(Clock::now() - mStart);
+    record(mSite, ns);
+    if (tracing() && tTrace.mRecord && tTrace.mDepth > 0)
+    {
+        --tTrace.mDepth;
+        if (mTraceEvent < tTrace.mRecord->mEvents.size())
+        {
+            tTrace.mRecord->mEvents[mTraceEvent].mDurationNs = ns;
+        }
+    }
+}
+
+void
+ZoneStats::beginTrace(uint64_t id)
+{
+    if (!tracing() || tTrace.mNesting++ > 0)
+    {
+        return;
+    }
+    tTrace.mRecord = std::make_unique<TraceRecord>();
+    tTrace.mRecord->mId = id;
+    tTrace.mRecord->mStart = Clock::now();
+    tTrace.mDepth = 0;
+}
+
+void
+ZoneStats::endTrace()
+{
+    if (!tracing() || tTrace.mNesting == 0 || --tTrace.mNesting > 0)
+    {
+        return;
+    }
+    auto rec = std::move(tTrace.mRecord);
+    rec->mDurationNs = nanoseconds(Clock::now() - rec->mStart);
+    if (rec->mEvents.empty())
+    {
+        // nothing to show, as when zone statistics are not built in
+        return;
+    }
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mMutex);
+    r.mTraces.emplace_back(std::move(rec));
+    while (r.mTraces.size() > MAX_TRACES)
+    {
+        r.mTraces.pop_front();
+    }
+}
+
+Json::Value
+ZoneStats::getJson()
+{
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mMutex);
+    auto numSites = r.mNumSites.load();
+    auto generation = r.mGeneration.load();
+
+    std::vector<SiteTotals> totals(r.mRetired.begin(),
+                                   r.mRetired.begin() + numSites);
+    for (auto t : r.mThreads)
+    {
+        if (t->mGeneration.load(std::memory_order_acquire) != generation)
+        {
+            // not counted anything since clear()
+            continue;
+        }
+        for (size_t i = 0; i < numSites; ++i)
+        {
+            if (auto c = t->mSites[i].load(std::memory_order_acquire))
+            {
+                totals[i].add(*c);
+            }
+        }
+    }
+
+    std::vector<size_t> order;
+    for (size_t i = 0; i < numSites; ++i)
+    {
+        if (totals[i].mCount > 0)
+        {
+            order.emplace_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return totals[a].mTotalNs > totals[b].mTotalNs;
+    });
+
+    Json::Value res;
+    res["enabled"] = enabled();
+    res["tracing"] = tracing();
+    auto& zones = res["zones"];
+    zones = Json::arrayValue;
+    for (auto i : order)
+    {
+        auto const& s = r.mSites[i];
+        auto const& t = totals[i];
+        Json::Value z;
+        z["name"] = siteName(s);
+        z["function"] = s.mFunction;
+        z["file"] = s.mFile;
+        z["line"] = s.mLine;
+        z["count"] = static_cast<Json::UInt64>(t.mCount);
+        z["total_us"] = microseconds(t.mTotalNs);
+        z["mean_us"] = microseconds(t.mTotalNs) / t.mCount;
+        z["max_us"] = microseconds(t.mMaxNs);
+        // non-empty buckets, by upper bound
+        auto& hist = z["histogram"];
+        hist = Json::arrayValue;
+        for (size_t b = 0; b < t.mHistogram.size(); ++b)
+        {
+            if (t.mHistogram[b] > 0)
+            {
+                Json::Value bucket;
+                bucket["lt_us"] = microseconds(uint64_t(2) << b);
+                bucket["count"] = static_cast<Json::UInt64>(t.mHistogram[b]);
+                hist.append(bucket);
+            }
+        }
+        zones.append(z);
+    }
+
+    auto& traces = res["traces"];
+    traces = Json::arrayValue;
+    for (auto const& rec : r.mTraces)
+    {
+        Json::Value t;
+        t["id"] = static_cast<Json::UInt64>(rec->mId);
+        t["duration_us"] = microseconds(rec->mDurationNs);
+        t["dropped"] = static_cast<Json::UInt64>(rec->mDropped);
+        auto& events = t["events"];
+        events = Json::arrayValue;
+        for (auto const& e : rec->mEvents)
+        {
+            Json::Value ev;
+            ev["name"] = siteName(r.mSites[e.mSite]);
+            ev["depth"] = e.mDepth;
+            ev["start_us"] = microseconds(e.mStartNs);
+            ev["duration_us"] = microseconds(e.mDurationNs);
+            events.append(ev);
+        }
+        traces.append(t);
+    }
+    return res;
+}
+
+void
+ZoneStats::clear()
+{
+    auto& r = registry();
+    std::lock_guard<std::mutex> lock(r.mMutex);
+    // threads zero their own counters when they next count anything
+    r.mGeneration.fetch_add(1);
+    std::fill(r.mRetired.begin(), r.mRetired.end(), SiteTotals());
+    r.mTraces.clear();
+}
+
+bool
+ZoneStats::enabled()
+{
+#if defined(USE_ZONE_STATS) && !defined(TRACY_ENABLE)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool
+ZoneStats::tracing()
+{
+#ifdef USE_ZONE_TRACES
+    return enabled();
+#else
+    return false;
+#endif
+}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "lib/json/json-forwards.h"
+#include <Tracy.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace diamnet
+{
+
+// In-process statistics of tracy zones, for when no tracy client is built in.
+//
+// Tracy records every zone and needs a live connection from a tracy server to
+// be of any use, which is not something to leave attached to production
+// validators. ZoneStats instead aggregates the time spent in each zone as it
+// goes: per zone (that is, per ZoneScoped / ZoneNamedN site), the number of
+// times it ran, the total and maximum time spent in it and a histogram of
+// durations by powers of two. Each thread counts into counters of its own, so
+// a zone costs two clock reads and a few uncontended stores.
+//
+// Built with USE_ZONE_TRACES, it also traces ledger closes: between
+// beginTrace and endTrace, every zone run on the thread that began the trace
+// is recorded in order, with its start time and nesting depth, and the last
+// few traces are kept. Otherwise beginTrace and endTrace do nothing.
+//
+// When built with USE_ZONE_STATS (and without TRACY_ENABLE), as by default,
+// this header is included ahead of every source file and replaces tracy's
+// no-op zone macros with ZoneStats scopes, so the existing zones need no
+// change.
+class ZoneStats
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    // Registers a zone site once, when it first runs; returns its id.
+    static size_t registerSite(char const* name, char const* function,
+                               char const* file, uint32_t line);
+
+    class Scope
+    {
+        size_t const mSite;
+        bool const mActive;
+        Clock::time_point mStart;
+        // index of this scope's event in the current trace, if traced
+        size_t mTraceEvent;
+
+      public:
+        Scope(size_t site, bool active);
+        ~Scope();
+        Scope(Scope const&) = delete;
+        Scope& operator=(Scope const&) = delete;
+    };
+
+    // Traces the zones run on this thread until endTrace, as trace `id` (the
+    // ledger sequence number).
+    static void beginTrace(uint64_t id);
+    static void endTrace();
+
+    class Trace
+    {
+      public:
+        explicit Trace(uint64_t id)
+        {
+            beginTrace(id);
+        }
+        ~Trace()
+        {
+            endTrace();
+        }
+        Trace(Trace const&) = delete;
+        Trace& operator=(Trace const&) = delete;
+    };
+
+    // Statistics of all zones that ran so far, most total time first, and
+    // the kept traces; times in microseconds.
+    static Json::Value getJson();
+
+    // Forgets all statistics and traces.
+    static void clear();
+
+    // True if the zone macros are replaced, that is if there is anything to
+    // collect.
+    static bool enabled();
+
+    // True if traces are kept.
+    static bool tracing();
+
+    static size_t const MAX_SITES = 4096;
+    static size_t const MAX_TRACES = 16;
+    static size_t const MAX_TRACE_EVENTS = 20000;
+    // bucket i counts durations in [2^i, 2^(i+1)) nanoseconds
+    static size_t const HISTOGRAM_BUCKETS = 48;
+};
+}
+
+#if defined(USE_ZONE_STATS) && !defined(TRACY_ENABLE)
+#undef ZoneNamedN
+#undef ZoneScopedN
+#undef ZoneScoped
+
+#define DIAMNET_ZONE_STATS_CONCAT2(a, b) a##b
+#define DIAMNET_ZONE_STATS_CONCAT(a, b) DIAMNET_ZONE_STATS_CONCAT2(a, b)
+
+#define ZoneNamedN(varname, name, active)                                      \
+    static size_t const DIAMNET_ZONE_STATS_CONCAT(varname, Site) =             \
+        ::diamnet::ZoneStats::registerSite(name, __func__, __FILE__,           \
+                                           __LINE__);                          \
+    ::diamnet::ZoneStats::Scope varname(                                       \
+        DIAMNET_ZONE_STATS_CONCAT(varname, Site), active)
+#define ZoneScopedN(name) ZoneNamedN(diamnetZoneStatsScope, name, true)
+#define ZoneScoped ZoneNamedN(diamnetZoneStatsScope, nullptr, true)
+#endif
@@ -5,9 +5,17 @@
 #include "util/Scheduler.h"
 
 #include "lib/catch.hpp"
+#include "lib/json/json.h"
 #include "util/Logging.h"
+#include "util/SchedulerStats.h"
 #include "util/Timer.h"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <map>
+#include <medida/metrics_registry.h>
+#include <medida/timer.h>
+#include <thread>
 
 using namespace diamnet;
 
@@ -125,3 +133,137 @@ TEST_CASE("scheduler load shedding -- overload", "[scheduler]")
                sched.stats().mActionsDroppedDueToOverload;
     CHECK(sched.stats().mActionsEnqueued == tot);
 }
+
+TEST_CASE("scheduler runs thread-safe queues on workers", "[scheduler]")
+{
+    std::chrono::seconds window(10);
+    VirtualClock clock(VirtualClock::REAL_TIME);
+    Scheduler sched(clock, window);
+    sched.startWorkers(3);
+
+    auto mainThread = std::this_thread::get_id();
+    size_t const n = 1000;
+    std::vector<std::string> queues{"a", "b", "c", "d"};
+    std::map<std::string, std::vector<size_t>> ran;
+    std::atomic<size_t> ranOnMain{0};
+    std::atomic<size_t> done{0};
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (auto const& q : queues)
+        {
+            // each queue's vector is only touched by that queue's actions,
+            // which never run concurrently
+            auto& v = ran[q];
+            sched.enqueue(
+                std::string(q),
+                [&v, i, &ranOnMain, &done, mainThread]() {
+                    v.emplace_back(i);
+                    if (std::this_thread::get_id() == mainThread)
+                    {
+                        ++ranOnMain;
+                    }
+                    ++done;
+                },
+                Scheduler::ActionType::NORMAL_ACTION, true);
+        }
+    }
+
+    // thread-safe queues are not for the main thread
+    size_t mainRan = 0;
+    sched.enqueue(std::string("main"), [&mainRan]() { ++mainRan; },
+                  Scheduler::ActionType::NORMAL_ACTION);
+    while (sched.runOne() != 0)
+    {
+    }
+    CHECK(mainRan == 1);
+
+    while (done != n * queues.size())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    sched.stopWorkers();
+    CHECK(ranOnMain == 0);
+    for (auto const& q : queues)
+    {
+        REQUIRE(ran[q].size() == n);
+        CHECK(std::is_sorted(ran[q].begin(), ran[q].end()));
+    }
+    CHECK(sched.stats().mActionsDequeued == n * queues.size() + 1);
+    CHECK(sched.stats().mActionsDequeuedOnWorkers == n * queues.size());
+
+    // without workers, the main thread runs them
+    sched.enqueue(std::string("a"), [&mainRan]() { ++mainRan; },
+                  Scheduler::ActionType::NORMAL_ACTION, true);
+    CHECK(sched.runOne() == 1);
+    CHECK(mainRan == 2);
+    CHECK(sched.size() == 0);
+
+    // workers are kept until every user is done with them
+    sched.startWorkers(1);
+    sched.startWorkers(1);
+    sched.stopWorkers();
+    done = 0;
+    sched.enqueue(std::string("a"),
+                  [&ranOnMain, &done, mainThread]() {
+                      if (std::this_thread::get_id() == mainThread)
+                      {
+                          ++ranOnMain;
+                      }
+                      ++done;
+                  },
+                  Scheduler::ActionType::NORMAL_ACTION, true);
+    CHECK(sched.runOne() == 0);
+    while (done != 1)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    sched.stopWorkers();
+    CHECK(ranOnMain == 0);
+}
+
+TEST_CASE("scheduler stats", "[scheduler]")
+{
+    using namespace std::chrono;
+    medida::MetricsRegistry registry;
+    SchedulerStats stats(registry, seconds(60), 3);
+    auto t0 = SchedulerStats::Clock::now();
+
+    for (int i = 1; i <= 10; ++i)
+    {
+        stats.recordAction("a", milliseconds(i), milliseconds(i), t0);
+    }
+    stats.recordAction("b", milliseconds(1), milliseconds(50), t0);
+
+    auto& runtimeA = registry.NewTimer({"scheduler", "action-runtime", "a"});
+    auto& delayB = registry.NewTimer({"scheduler", "action-delay", "b"});
+    CHECK(runtimeA.count() == 10);
+    CHECK(runtimeA.max() == 10);
+    CHECK(delayB.count() == 1);
+
+    auto slowest = stats.getSlowestActions(t0);
+    REQUIRE(slowest.size() == 3);
+    CHECK(slowest[0].mName == "b");
+    CHECK(slowest[1].mRuntime == milliseconds(10));
+    CHECK(slowest[2].mRuntime == milliseconds(9));
+
+    // the slowest actions are those of the last window, even across the start
+    // of a new one
+    stats.recordAction("c", milliseconds(1), milliseconds(30),
+                       t0 + seconds(50));
+    auto t1 = t0 + seconds(70);
+    stats.recordAction("a", milliseconds(1), milliseconds(20), t1);
+    slowest = stats.getSlowestActions(t1);
+    REQUIRE(slowest.size() == 2);
+    CHECK(slowest[0].mName == "c");
+    CHECK(slowest[1].mRuntime == milliseconds(20));
+
+    slowest = stats.getSlowestActions(t0 + seconds(111));
+    REQUIRE(slowest.size() == 1);
+    CHECK(slowest[0].mName == "a");
+    CHECK(stats.getSlowestActions(t1 + seconds(61)).empty());
+
+    auto json = stats.getJson(t1);
+    CHECK(json["actions"]["a"]["runtime_ms"]["count"].asUInt64() == 11);
+    CHECK(json["actions"]["b"]["runtime_ms"]["max"].asDouble() == 50);
+    CHECK(json["slowest"].size() == 2);
+}
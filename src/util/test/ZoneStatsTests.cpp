@@ -0,0 +1,136 @@
+// Copyright 2020 Diamnet Development Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+
+#include "util/ZoneStats.h"
+
+#include "lib/catch.hpp"
+#include "lib/json/json.h"
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace diamnet;
+
+namespace
+{
+Json::Value
+findZone(Json::Value const& stats, std::string const& name)
+{
+    for (auto const& z : stats["zones"])
+    {
+        if (z["name"].asString() == name)
+        {
+            return z;
+        }
+    }
+    return Json::Value();
+}
+}
+
+TEST_CASE("zone stats", "[zonestats]")
+{
+    ZoneStats::clear();
+    static size_t const outer =
+        ZoneStats::registerSite("test outer", __func__, __FILE__, __LINE__);
+    static size_t const inner =
+        ZoneStats::registerSite("test inner", __func__, __FILE__, __LINE__);
+    static size_t const inactive =
+        ZoneStats::registerSite("test inactive", __func__, __FILE__, __LINE__);
+
+    auto run = [&]() {
+        ZoneStats::Scope o(outer, true);
+        for (int i = 0; i < 3; ++i)
+        {
+            ZoneStats::Scope in(inner, true);
+            ZoneStats::Scope off(inactive, false);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    };
+
+    SECTION("counts zones across threads")
+    {
+        run();
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 3; ++i)
+        {
+            threads.emplace_back(run);
+        }
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+
+        auto stats = ZoneStats::getJson();
+        auto o = findZone(stats, "test outer");
+        auto in = findZone(stats, "test inner");
+        REQUIRE(o["count"].asUInt64() == 4);
+        REQUIRE(in["count"].asUInt64() == 12);
+        REQUIRE(findZone(stats, "test inactive").isNull());
+        REQUIRE(in["total_us"].asDouble() >= 12000);
+        REQUIRE(o["total_us"].asDouble() >= in["total_us"].asDouble() / 4);
+        REQUIRE(in["max_us"].asDouble() >= 1000);
+        uint64_t inHistogram = 0;
+        for (auto const& b : in["histogram"])
+        {
+            inHistogram += b["count"].asUInt64();
+            // sleeps of 1ms fall in buckets of at least 2^19ns
+            REQUIRE(b["lt_us"].asDouble() >= 1000);
+        }
+        REQUIRE(inHistogram == 12);
+
+        ZoneStats::clear();
+        run();
+        stats = ZoneStats::getJson();
+        REQUIRE(findZone(stats, "test outer")["count"].asUInt64() == 1);
+        REQUIRE(findZone(stats, "test inner")["count"].asUInt64() == 3);
+    }
+
+    SECTION("traces zones in order")
+    {
+        if (!ZoneStats::tracing())
+        {
+            ZoneStats::Trace trace(42);
+            run();
+            REQUIRE(ZoneStats::getJson()["traces"].empty());
+            return;
+        }
+        {
+            ZoneStats::Trace trace(42);
+            run();
+        }
+        // zones outside of a trace, or on other threads, are not traced
+        run();
+        std::thread(run).join();
+
+        auto traces = ZoneStats::getJson()["traces"];
+        REQUIRE(traces.size() == 1);
+        auto const& t = traces[0];
+        REQUIRE(t["id"].asUInt64() == 42);
+        REQUIRE(t["dropped"].asUInt64() == 0);
+        auto const& events = t["events"];
+        REQUIRE(events.size() == 4);
+        REQUIRE(events[0]["name"].asString() == "test outer");
+        REQUIRE(events[0]["depth"].asUInt() == 0);
+        double last = 0;
+        for (Json::ArrayIndex i = 1; i < events.size(); ++i)
+        {
+            REQUIRE(events[i]["name"].asString() == "test inner");
+            REQUIRE(events[i]["depth"].asUInt() == 1);
+            REQUIRE(events[i]["start_us"].asDouble() >= last);
+            last = events[i]["start_us"].asDouble() +
+                   events[i]["duration_us"].asDouble();
+        }
+        REQUIRE(events[0]["duration_us"].asDouble() <=
+                t["duration_us"].asDouble());
+
+        for (uint64_t i = 0; i < ZoneStats::MAX_TRACES + 2; ++i)
+        {
+            ZoneStats::Trace trace(i);
+            ZoneStats::Scope o(outer, true);
+        }
+        traces = ZoneStats::getJson()["traces"];
+        REQUIRE(traces.size() == ZoneStats::MAX_TRACES);
+        REQUIRE(traces[0]["id"].asUInt64() == 2);
+    }
+}
@@ -61,6 +61,12 @@ BatchWork::doWork()
     return State::WORK_RUNNING;
 }
 
+size_t
+BatchWork::getBandwidth() const
+{
+    return static_cast<size_t>(mApp.getConfig().MAX_CONCURRENT_SUBPROCESSES);
+}
+
 void
 BatchWork::addMoreWorkIfNeeded()
 {
@@ -70,7 +76,7 @@ BatchWork::addMoreWorkIfNeeded()
         throw std::runtime_error(getName() + " is being aborted!");
     }
 
-    int nChildren = mApp.getConfig().MAX_CONCURRENT_SUBPROCESSES;
+    auto nChildren = getBandwidth();
     while (mBatch.size() < nChildren && hasNext())
     {
         auto w = yieldMoreWork();